@@ -0,0 +1,499 @@
+// Compiler throughput benchmarks.
+//
+// Each front-end/back-end phase is timed on its own against generated .next
+// programs of 1K..1M lines:
+//   BM_Lex        tokens/s
+//   BM_Parse      nodes/s (includes lexing, the parser pulls tokens on demand)
+//   BM_TypeCheck  nodes/s
+//   BM_CodeGen    IR instructions/s
+//
+// BM_CodeGenFunctions generates code for programs of 100..10K functions of
+// the generator's default size, where per-function bookkeeping adds up.
+//
+// and the pointer tree of AST.h is compared with the flat arrays of
+// FlatAST.h on the same type-checked program:
+//   BM_TreeWalk / BM_FlatWalk   nodes/s of a full depth-first traversal,
+//                               with the bytes each representation holds
+//   BM_TreeCalls / BM_FlatCalls calls/s when collecting every call
+//   BM_FlatBuild                nodes/s when flattening a tree
+//
+// Export results with --benchmark_out=<file> --benchmark_out_format=json, or
+// build the `run_bench` target.
+
+#include <benchmark/benchmark.h>
+#include <llvm/IR/LLVMContext.h>
+#include <map>
+#include <memory>
+#include <string>
+#include "lexer/Lexer.h"
+#include "parser/FlatAST.h"
+#include "parser/Parser.h"
+#include "sema/TypeChecker.h"
+#include "codegen/CodeGen.h"
+#include "ProgramGenerator.h"
+
+namespace {
+
+// Programs of roughly `lines` lines from the synthetic generator, with a
+// fixed seed so results stay comparable across runs.
+std::string generateSource(int lines) {
+    pynext::GeneratorConfig config;
+    config.functions = 1;
+    config.targetLines = lines;
+    config.seed = 42;
+    return pynext::generateProgram(config);
+}
+
+// Inputs are generated once per size and shared across benchmarks.
+const std::string& sourceForLines(int lines) {
+    static std::map<int, std::string> cache;
+    auto it = cache.find(lines);
+    if (it == cache.end()) {
+        it = cache.emplace(lines, generateSource(lines)).first;
+    }
+    return it->second;
+}
+
+// Programs of `functions` functions with the generator's default shape
+const std::string& sourceForFunctions(int functions) {
+    static std::map<int, std::string> cache;
+    auto it = cache.find(functions);
+    if (it == cache.end()) {
+        pynext::GeneratorConfig config;
+        config.functions = functions;
+        config.seed = 42;
+        it = cache.emplace(functions, pynext::generateProgram(config)).first;
+    }
+    return it->second;
+}
+
+// Counts every AST node reachable from the module's statements.
+class NodeCounter : public pynext::ASTVisitor {
+public:
+    size_t count = 0;
+
+    void visit(pynext::LiteralExpr&) override { count++; }
+    void visit(pynext::VariableExpr&) override { count++; }
+    void visit(pynext::BinaryExpr& expr) override {
+        count++;
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(pynext::CallExpr& expr) override {
+        count++;
+        for (auto& arg : expr.args) arg->accept(*this);
+    }
+    void visit(pynext::MemberAccessExpr& expr) override {
+        count++;
+        expr.object->accept(*this);
+    }
+    void visit(pynext::IndexExpr& expr) override {
+        count++;
+        expr.object->accept(*this);
+        expr.index->accept(*this);
+    }
+    void visit(pynext::ArrayLiteralExpr& expr) override {
+        count++;
+        for (auto& e : expr.elements) e->accept(*this);
+    }
+    void visit(pynext::ReturnStmt& stmt) override {
+        count++;
+        if (stmt.value) stmt.value->accept(*this);
+    }
+    void visit(pynext::Block& stmt) override {
+        count++;
+        for (auto& s : stmt.statements) s->accept(*this);
+    }
+    void visit(pynext::IfStmt& stmt) override {
+        count++;
+        stmt.condition->accept(*this);
+        stmt.thenBranch->accept(*this);
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(pynext::WhileStmt& stmt) override {
+        count++;
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(pynext::ForStmt& stmt) override {
+        count++;
+        stmt.iterator->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(pynext::FunctionStmt& stmt) override {
+        count++;
+        if (stmt.body) stmt.body->accept(*this);
+    }
+    void visit(pynext::VarDeclStmt& stmt) override {
+        count++;
+        if (stmt.initializer) stmt.initializer->accept(*this);
+    }
+    void visit(pynext::StructDeclStmt&) override { count++; }
+    void visit(pynext::EnumDeclStmt&) override { count++; }
+    void visit(pynext::MatchStmt& stmt) override {
+        count++;
+        stmt.subject->accept(*this);
+        for (auto& c : stmt.cases) c.body->accept(*this);
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(pynext::ExprStmt& stmt) override {
+        count++;
+        stmt.expr->accept(*this);
+    }
+};
+
+size_t countNodes(const std::vector<std::unique_ptr<pynext::Stmt>>& stmts) {
+    NodeCounter counter;
+    for (const auto& s : stmts) s->accept(counter);
+    return counter.count;
+}
+
+std::vector<std::unique_ptr<pynext::Stmt>> parseSource(const std::string& source) {
+    pynext::Lexer lexer(source);
+    pynext::Parser parser(lexer);
+    return parser.parseModule();
+}
+
+// Bytes of the tree: every node object, plus the heap buffers of its strings
+// and child vectors. Types are shared and not counted.
+class TreeSizer : public pynext::ASTVisitor {
+public:
+    size_t bytes = 0;
+
+    static size_t heap(const std::string& text) {
+        return text.capacity() > std::string().capacity() ? text.capacity() + 1 : 0;
+    }
+    template <typename T>
+    static size_t heap(const std::vector<T>& items) {
+        return items.capacity() * sizeof(T);
+    }
+    static size_t heap(const std::vector<std::pair<std::string, std::string>>& pairs) {
+        size_t total = pairs.capacity() * sizeof(pairs[0]);
+        for (const auto& [first, second] : pairs) total += heap(first) + heap(second);
+        return total;
+    }
+    template <typename T>
+    void each(const std::vector<std::unique_ptr<T>>& nodes) {
+        for (const auto& node : nodes) node->accept(*this);
+    }
+
+    void visit(pynext::LiteralExpr& expr) override { bytes += sizeof(expr) + heap(expr.value); }
+    void visit(pynext::VariableExpr& expr) override { bytes += sizeof(expr) + heap(expr.name); }
+    void visit(pynext::BinaryExpr& expr) override {
+        bytes += sizeof(expr) + heap(expr.op);
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(pynext::CallExpr& expr) override {
+        bytes += sizeof(expr) + heap(expr.callee) + heap(expr.args);
+        each(expr.args);
+    }
+    void visit(pynext::MemberAccessExpr& expr) override {
+        bytes += sizeof(expr) + heap(expr.member);
+        expr.object->accept(*this);
+    }
+    void visit(pynext::IndexExpr& expr) override {
+        bytes += sizeof(expr);
+        expr.object->accept(*this);
+        expr.index->accept(*this);
+    }
+    void visit(pynext::ArrayLiteralExpr& expr) override {
+        bytes += sizeof(expr) + heap(expr.elements);
+        each(expr.elements);
+    }
+    void visit(pynext::ReturnStmt& stmt) override {
+        bytes += sizeof(stmt);
+        if (stmt.value) stmt.value->accept(*this);
+    }
+    void visit(pynext::Block& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.statements);
+        each(stmt.statements);
+    }
+    void visit(pynext::IfStmt& stmt) override {
+        bytes += sizeof(stmt);
+        stmt.condition->accept(*this);
+        stmt.thenBranch->accept(*this);
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(pynext::WhileStmt& stmt) override {
+        bytes += sizeof(stmt);
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(pynext::ForStmt& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.variable);
+        stmt.iterator->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(pynext::FunctionStmt& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.name) + heap(stmt.params) + heap(stmt.returnType);
+        if (stmt.body) stmt.body->accept(*this);
+    }
+    void visit(pynext::VarDeclStmt& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.name) + heap(stmt.typeName);
+        if (stmt.initializer) stmt.initializer->accept(*this);
+    }
+    void visit(pynext::StructDeclStmt& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.name) + heap(stmt.fields);
+    }
+    void visit(pynext::EnumDeclStmt& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.name) + heap(stmt.variants);
+        for (const auto& v : stmt.variants) bytes += heap(v.name) + heap(v.fields);
+    }
+    void visit(pynext::MatchStmt& stmt) override {
+        bytes += sizeof(stmt) + heap(stmt.cases);
+        stmt.subject->accept(*this);
+        for (auto& c : stmt.cases) {
+            bytes += heap(c.variant) + heap(c.bindings);
+            for (const auto& name : c.bindings) bytes += heap(name);
+            c.body->accept(*this);
+        }
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(pynext::ExprStmt& stmt) override {
+        bytes += sizeof(stmt);
+        stmt.expr->accept(*this);
+    }
+};
+
+// The flat counterpart of NodeCounter
+class FlatNodeCounter : public pynext::FlatVisitor<FlatNodeCounter> {
+public:
+    using FlatVisitor::FlatVisitor;
+    size_t count = 0;
+
+    void visit(pynext::NodeRef ref) {
+        count++;
+        FlatVisitor::visit(ref);
+    }
+};
+
+// Callee names of every call, by tree walk
+class CallCollector : public pynext::ASTVisitor {
+public:
+    std::vector<const std::string*> callees;
+
+    void visit(pynext::LiteralExpr&) override {}
+    void visit(pynext::VariableExpr&) override {}
+    void visit(pynext::BinaryExpr& expr) override {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(pynext::CallExpr& expr) override {
+        callees.push_back(&expr.callee);
+        for (auto& arg : expr.args) arg->accept(*this);
+    }
+    void visit(pynext::MemberAccessExpr& expr) override { expr.object->accept(*this); }
+    void visit(pynext::IndexExpr& expr) override {
+        expr.object->accept(*this);
+        expr.index->accept(*this);
+    }
+    void visit(pynext::ArrayLiteralExpr& expr) override {
+        for (auto& e : expr.elements) e->accept(*this);
+    }
+    void visit(pynext::ReturnStmt& stmt) override {
+        if (stmt.value) stmt.value->accept(*this);
+    }
+    void visit(pynext::Block& stmt) override {
+        for (auto& s : stmt.statements) s->accept(*this);
+    }
+    void visit(pynext::IfStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.thenBranch->accept(*this);
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(pynext::WhileStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(pynext::ForStmt& stmt) override {
+        stmt.iterator->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(pynext::FunctionStmt& stmt) override {
+        if (stmt.body) stmt.body->accept(*this);
+    }
+    void visit(pynext::VarDeclStmt& stmt) override {
+        if (stmt.initializer) stmt.initializer->accept(*this);
+    }
+    void visit(pynext::StructDeclStmt&) override {}
+    void visit(pynext::EnumDeclStmt&) override {}
+    void visit(pynext::MatchStmt& stmt) override {
+        stmt.subject->accept(*this);
+        for (auto& c : stmt.cases) c.body->accept(*this);
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(pynext::ExprStmt& stmt) override { stmt.expr->accept(*this); }
+};
+
+void setLineCounters(benchmark::State& state, double lines) {
+    state.counters["lines"] = lines;
+    state.counters["lines/s"] = benchmark::Counter(lines, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_Lex(benchmark::State& state) {
+    const std::string& source = sourceForLines(state.range(0));
+    size_t tokens = 0;
+    for (auto _ : state) {
+        pynext::Lexer lexer(source);
+        tokens = 0;
+        while (lexer.nextToken().kind != pynext::TokenKind::EndOfFile) {
+            tokens++;
+        }
+        benchmark::DoNotOptimize(tokens);
+    }
+    state.counters["tokens"] = tokens;
+    state.counters["tokens/s"] = benchmark::Counter(tokens, benchmark::Counter::kIsIterationInvariantRate);
+    state.SetBytesProcessed(state.iterations() * source.size());
+    setLineCounters(state, state.range(0));
+}
+
+void BM_Parse(benchmark::State& state) {
+    const std::string& source = sourceForLines(state.range(0));
+    size_t nodes = 0;
+    for (auto _ : state) {
+        auto stmts = parseSource(source);
+        state.PauseTiming();
+        nodes = countNodes(stmts);
+        stmts.clear();
+        state.ResumeTiming();
+    }
+    state.counters["nodes"] = nodes;
+    state.counters["nodes/s"] = benchmark::Counter(nodes, benchmark::Counter::kIsIterationInvariantRate);
+    setLineCounters(state, state.range(0));
+}
+
+void BM_TypeCheck(benchmark::State& state) {
+    auto stmts = parseSource(sourceForLines(state.range(0)));
+    size_t nodes = countNodes(stmts);
+    for (auto _ : state) {
+        pynext::TypeChecker checker;
+        checker.check(stmts);
+    }
+    state.counters["nodes"] = nodes;
+    state.counters["nodes/s"] = benchmark::Counter(nodes, benchmark::Counter::kIsIterationInvariantRate);
+    setLineCounters(state, state.range(0));
+}
+
+void runCodeGen(benchmark::State& state, const std::string& source) {
+    auto stmts = parseSource(source);
+    pynext::TypeChecker checker;
+    checker.check(stmts);
+
+    size_t instructions = 0;
+    for (auto _ : state) {
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto codegen = std::make_unique<pynext::CodeGen>(*context);
+        codegen->generate(stmts);
+        state.PauseTiming();
+        instructions = codegen->getModule()->getInstructionCount();
+        codegen.reset();
+        context.reset();
+        state.ResumeTiming();
+    }
+    state.counters["instructions"] = instructions;
+    state.counters["instructions/s"] = benchmark::Counter(instructions, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_CodeGen(benchmark::State& state) {
+    runCodeGen(state, sourceForLines(state.range(0)));
+    setLineCounters(state, state.range(0));
+}
+
+void BM_CodeGenFunctions(benchmark::State& state) {
+    runCodeGen(state, sourceForFunctions(state.range(0)));
+    state.counters["functions"] = state.range(0);
+}
+
+std::vector<std::unique_ptr<pynext::Stmt>> checkedSource(int lines) {
+    auto stmts = parseSource(sourceForLines(lines));
+    pynext::TypeChecker checker;
+    checker.check(stmts);
+    return stmts;
+}
+
+void setNodeCounters(benchmark::State& state, size_t nodes, size_t bytes) {
+    state.counters["nodes"] = nodes;
+    state.counters["nodes/s"] = benchmark::Counter(nodes, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["bytes/node"] = static_cast<double>(bytes) / nodes;
+}
+
+void BM_TreeWalk(benchmark::State& state) {
+    auto stmts = checkedSource(state.range(0));
+    TreeSizer sizer;
+    for (const auto& s : stmts) s->accept(sizer);
+    size_t nodes = 0;
+    for (auto _ : state) {
+        nodes = countNodes(stmts);
+        benchmark::DoNotOptimize(nodes);
+    }
+    setNodeCounters(state, nodes, sizer.bytes);
+}
+
+void BM_FlatWalk(benchmark::State& state) {
+    pynext::FlatAST ast = pynext::FlatAST::fromTree(checkedSource(state.range(0)));
+    size_t nodes = 0;
+    for (auto _ : state) {
+        FlatNodeCounter counter(ast);
+        counter.visitAll();
+        nodes = counter.count;
+        benchmark::DoNotOptimize(nodes);
+    }
+    setNodeCounters(state, nodes, ast.bytes());
+}
+
+void BM_TreeCalls(benchmark::State& state) {
+    auto stmts = checkedSource(state.range(0));
+    size_t calls = 0;
+    for (auto _ : state) {
+        CallCollector collector;
+        for (const auto& s : stmts) s->accept(collector);
+        calls = collector.callees.size();
+        benchmark::DoNotOptimize(collector.callees.data());
+    }
+    state.counters["calls/s"] = benchmark::Counter(calls, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// No traversal: every call is in one array
+void BM_FlatCalls(benchmark::State& state) {
+    pynext::FlatAST ast = pynext::FlatAST::fromTree(checkedSource(state.range(0)));
+    size_t calls = 0;
+    for (auto _ : state) {
+        std::vector<pynext::NameId> callees;
+        callees.reserve(ast.calls().size());
+        for (const pynext::CallNode& call : ast.calls()) callees.push_back(call.callee);
+        calls = callees.size();
+        benchmark::DoNotOptimize(callees.data());
+    }
+    state.counters["calls/s"] = benchmark::Counter(calls, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_FlatBuild(benchmark::State& state) {
+    auto stmts = checkedSource(state.range(0));
+    size_t nodes = 0;
+    for (auto _ : state) {
+        pynext::FlatAST ast = pynext::FlatAST::fromTree(stmts);
+        nodes = ast.nodeCount();
+        benchmark::DoNotOptimize(nodes);
+    }
+    state.counters["nodes/s"] = benchmark::Counter(nodes, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void lineSizes(benchmark::internal::Benchmark* b) {
+    b->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+}
+
+} // namespace
+
+BENCHMARK(BM_Lex)->Apply(lineSizes);
+BENCHMARK(BM_Parse)->Apply(lineSizes);
+BENCHMARK(BM_TypeCheck)->Apply(lineSizes);
+BENCHMARK(BM_CodeGen)->Apply(lineSizes);
+BENCHMARK(BM_CodeGenFunctions)->RangeMultiplier(10)->Range(100, 10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TreeWalk)->Apply(lineSizes);
+BENCHMARK(BM_FlatWalk)->Apply(lineSizes);
+BENCHMARK(BM_TreeCalls)->Apply(lineSizes);
+BENCHMARK(BM_FlatCalls)->Apply(lineSizes);
+BENCHMARK(BM_FlatBuild)->Apply(lineSizes);
+
+BENCHMARK_MAIN();
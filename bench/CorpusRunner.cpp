@@ -0,0 +1,298 @@
+// Runtime regression gate for compiled .next programs.
+//
+// Runs every program of the benchmark corpus through `pynext -O<n> --time`
+// several times, reports the median and median absolute deviation (MAD) of
+// the execution time of main, and compares the medians against a stored
+// baseline. Exits with status 1 when any program regresses by more than the
+// threshold, fails to run, or has no baseline at this level.
+//
+// With --pgo, each program is instead trained once with --pgo-gen and timed
+// with and without --pgo-use, to report the speedup from profile-guided
+// optimization.
+//
+//   pynext_corpus [-O<n>] [--runs=N] [--threshold=PCT] [--baseline=FILE]
+//                 [--corpus=DIR] [--pynext=PATH] [--filter=NAME] [--update-baseline] [--pgo]
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct RunnerOptions {
+    std::string pynext = PYNEXT_PATH;
+    std::string corpusDir = PYNEXT_CORPUS_DIR;
+    std::string baselinePath = PYNEXT_CORPUS_DIR "/baseline.json";
+    std::string filter;
+    unsigned optLevel = 2;
+    unsigned runs = 5;
+    double thresholdPct = 10.0;
+    bool updateBaseline = false;
+    bool pgo = false;
+};
+
+struct Measurement {
+    std::string name;
+    double medianMs = 0;
+    double madMs = 0;
+};
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    if (n == 0) return 0;
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Runs `pynext -O<n> --no-ir <extraArgs> <program>` with stdout discarded and
+// stderr captured to `stderrPath`. Returns the exit status.
+int runPynext(const RunnerOptions& options, const std::string& program,
+              const std::vector<std::string>& extraArgs, llvm::StringRef stderrPath, std::string& errMsg) {
+    std::string optFlag = "-O" + std::to_string(options.optLevel);
+    std::vector<llvm::StringRef> args = {options.pynext, optFlag, "--no-ir"};
+    args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+    args.push_back(program);
+    std::optional<llvm::StringRef> redirects[] = {std::nullopt, llvm::StringRef(""), stderrPath};
+    return llvm::sys::ExecuteAndWait(options.pynext, args, std::nullopt, redirects, 0, 0, &errMsg);
+}
+
+// Runs `pynext` once on `program` and returns the execution time it reports.
+std::optional<double> timeOnce(const RunnerOptions& options, const std::string& program,
+                               const std::vector<std::string>& extraArgs) {
+    llvm::SmallString<128> stderrPath;
+    if (llvm::sys::fs::createTemporaryFile("pynext_corpus", "txt", stderrPath)) {
+        llvm::errs() << "Could not create temporary file\n";
+        return std::nullopt;
+    }
+
+    std::vector<std::string> args = extraArgs;
+    args.push_back("--time");
+    std::string errMsg;
+    int rc = runPynext(options, program, args, stderrPath, errMsg);
+
+    auto buffer = llvm::MemoryBuffer::getFile(stderrPath);
+    llvm::sys::fs::remove(stderrPath);
+    if (rc != 0) {
+        llvm::errs() << "  " << program << " exited with status " << rc << " " << errMsg << "\n";
+        return std::nullopt;
+    }
+    if (!buffer) return std::nullopt;
+
+    llvm::StringRef output = (*buffer)->getBuffer();
+    const llvm::StringRef marker = "Execution time: ";
+    size_t pos = output.find(marker);
+    if (pos == llvm::StringRef::npos) {
+        llvm::errs() << "  " << program << " did not report an execution time\n";
+        return std::nullopt;
+    }
+
+    double ms = 0;
+    if (output.substr(pos + marker.size()).take_until([](char c) { return c == ' '; }).getAsDouble(ms)) {
+        return std::nullopt;
+    }
+    return ms;
+}
+
+std::optional<Measurement> measure(const RunnerOptions& options, const std::string& program,
+                                   const std::vector<std::string>& extraArgs = {}) {
+    std::vector<double> samples;
+    for (unsigned i = 0; i < options.runs; ++i) {
+        auto ms = timeOnce(options, program, extraArgs);
+        if (!ms) return std::nullopt;
+        samples.push_back(*ms);
+    }
+
+    Measurement m;
+    m.name = llvm::sys::path::stem(program).str();
+    m.medianMs = median(samples);
+    std::vector<double> deviations;
+    for (double s : samples) deviations.push_back(std::fabs(s - m.medianMs));
+    m.madMs = median(deviations);
+    return m;
+}
+
+std::vector<std::string> listCorpus(const RunnerOptions& options) {
+    std::vector<std::string> programs;
+    std::error_code ec;
+    for (llvm::sys::fs::directory_iterator it(options.corpusDir, ec), end; it != end && !ec; it.increment(ec)) {
+        llvm::StringRef path = it->path();
+        if (path.ends_with(".next") &&
+            (options.filter.empty() || llvm::sys::path::stem(path) == options.filter)) {
+            programs.push_back(path.str());
+        }
+    }
+    std::sort(programs.begin(), programs.end());
+    return programs;
+}
+
+// Trains a profile for `program` with --pgo-gen; returns its path, or an empty string.
+std::string trainProfile(const RunnerOptions& options, const std::string& program) {
+    llvm::SmallString<128> profilePath, stderrPath;
+    if (llvm::sys::fs::createTemporaryFile("pynext_corpus", "profdata", profilePath) ||
+        llvm::sys::fs::createTemporaryFile("pynext_corpus", "txt", stderrPath)) {
+        llvm::errs() << "Could not create temporary file\n";
+        return "";
+    }
+    std::string errMsg;
+    int rc = runPynext(options, program, {"--pgo-gen=" + profilePath.str().str()}, stderrPath, errMsg);
+    llvm::sys::fs::remove(stderrPath);
+    if (rc != 0) {
+        llvm::errs() << "  " << program << " training run exited with status " << rc << " " << errMsg << "\n";
+        llvm::sys::fs::remove(profilePath);
+        return "";
+    }
+    return profilePath.str().str();
+}
+
+// --pgo: time every program without and with its own profile
+int runPGOComparison(const RunnerOptions& options) {
+    llvm::outs() << llvm::formatv("{0,-16} {1,12} {2,12} {3,9}\n", "program", "plain(ms)", "pgo(ms)", "speedup");
+    bool failed = false;
+    for (const auto& program : listCorpus(options)) {
+        std::string profile = trainProfile(options, program);
+        auto plain = profile.empty() ? std::nullopt : measure(options, program);
+        auto pgo = plain ? measure(options, program, {"--pgo-use=" + profile}) : std::nullopt;
+        if (!profile.empty()) llvm::sys::fs::remove(profile);
+        if (!pgo) {
+            llvm::outs() << llvm::formatv("{0,-16} FAILED\n", llvm::sys::path::stem(program));
+            failed = true;
+            continue;
+        }
+        llvm::outs() << llvm::formatv("{0,-16} {1,12:F3} {2,12:F3} {3,8:F2}x\n",
+                                      plain->name, plain->medianMs, pgo->medianMs, plain->medianMs / pgo->medianMs);
+    }
+    return failed ? 1 : 0;
+}
+
+llvm::json::Object loadBaseline(const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) return {};
+    auto parsed = llvm::json::parse((*buffer)->getBuffer());
+    if (!parsed) {
+        llvm::errs() << "Ignoring malformed baseline " << path << ": " << llvm::toString(parsed.takeError()) << "\n";
+        return {};
+    }
+    if (auto* obj = parsed->getAsObject()) return std::move(*obj);
+    return {};
+}
+
+bool parseArgs(int argc, char** argv, RunnerOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        llvm::StringRef arg = argv[i];
+        if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' && arg[2] <= '3') {
+            options.optLevel = arg[2] - '0';
+        } else if (arg.consume_front("--runs=")) {
+            if (arg.getAsInteger(10, options.runs) || options.runs == 0) return false;
+        } else if (arg.consume_front("--threshold=")) {
+            if (arg.getAsDouble(options.thresholdPct)) return false;
+        } else if (arg.consume_front("--baseline=")) {
+            options.baselinePath = arg.str();
+        } else if (arg.consume_front("--corpus=")) {
+            options.corpusDir = arg.str();
+        } else if (arg.consume_front("--pynext=")) {
+            options.pynext = arg.str();
+        } else if (arg.consume_front("--filter=")) {
+            options.filter = arg.str();
+        } else if (arg == "--update-baseline") {
+            options.updateBaseline = true;
+        } else if (arg == "--pgo") {
+            options.pgo = true;
+        } else {
+            llvm::errs() << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    RunnerOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        llvm::errs() << "Usage: pynext_corpus [-O<n>] [--runs=N] [--threshold=PCT] [--baseline=FILE]\n"
+                     << "                     [--corpus=DIR] [--pynext=PATH] [--filter=NAME] [--update-baseline] [--pgo]\n";
+        return 2;
+    }
+
+    if (options.pgo) {
+        return runPGOComparison(options);
+    }
+
+    std::string levelKey = "O" + std::to_string(options.optLevel);
+    llvm::json::Object baseline = loadBaseline(options.baselinePath);
+    llvm::json::Object* levelBaseline = baseline.getObject(levelKey);
+    if (!levelBaseline && !options.updateBaseline) {
+        llvm::errs() << "No -" << levelKey << " baseline in " << options.baselinePath
+                     << "; record one with --update-baseline\n";
+        return 1;
+    }
+
+    llvm::outs() << llvm::formatv("{0,-16} {1,12} {2,10} {3,12} {4,9}\n",
+                                  "program", "median(ms)", "MAD(ms)", "baseline(ms)", "delta");
+
+    bool failed = false;
+    llvm::json::Object updated;
+    for (const auto& program : listCorpus(options)) {
+        auto m = measure(options, program);
+        if (!m) {
+            llvm::outs() << llvm::formatv("{0,-16} FAILED\n", llvm::sys::path::stem(program));
+            failed = true;
+            continue;
+        }
+
+        std::string baseCol = "-", deltaCol = "-";
+        const llvm::json::Object* entry = levelBaseline ? levelBaseline->getObject(m->name) : nullptr;
+        std::optional<double> base;
+        if (entry) {
+            if (auto number = entry->getNumber("median_ms")) base = *number;
+        }
+        if (base && *base > 0) {
+            double deltaPct = (m->medianMs - *base) / *base * 100.0;
+            baseCol = llvm::formatv("{0:F3}", *base).str();
+            deltaCol = (deltaPct >= 0 ? "+" : "") + llvm::formatv("{0:F1}%", deltaPct).str();
+            if (deltaPct > options.thresholdPct) {
+                deltaCol += " REGRESSION";
+                failed = true;
+            }
+        } else if (!options.updateBaseline) {
+            deltaCol = "MISSING";
+            failed = true;
+        }
+        llvm::outs() << llvm::formatv("{0,-16} {1,12:F3} {2,10:F3} {3,12} {4,9}\n",
+                                      m->name, m->medianMs, m->madMs, baseCol, deltaCol);
+
+        updated[m->name] = llvm::json::Object{{"median_ms", m->medianMs}, {"mad_ms", m->madMs}};
+    }
+
+    if (options.updateBaseline) {
+        baseline[levelKey] = std::move(updated);
+        std::error_code ec;
+        llvm::raw_fd_ostream out(options.baselinePath, ec);
+        if (ec) {
+            llvm::errs() << "Could not write baseline " << options.baselinePath << ": " << ec.message() << "\n";
+            return 1;
+        }
+        out << llvm::formatv("{0:2}", llvm::json::Value(std::move(baseline))) << "\n";
+        llvm::outs() << "Baseline for -" << levelKey << " written to " << options.baselinePath << "\n";
+        return 0;
+    }
+
+    if (failed) {
+        llvm::outs() << llvm::formatv("Regression threshold {0:F1}% exceeded, or a program failed or has no baseline\n",
+                                      options.thresholdPct);
+        return 1;
+    }
+    return 0;
+}
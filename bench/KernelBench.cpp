@@ -0,0 +1,227 @@
+// Compiled loop benchmarks, next to the compiler and runtime ones in
+// pynext_bench.
+//
+// PyNext kernels are compiled at -O2 for the host CPU, as `pynext repl`
+// compiles them, and run over arrays of 64M elements of each element type:
+//   BM_Sum    bytes/s of `total = total + a[i]` over the array
+//   BM_Scale  bytes/s of `a[i] = a[i] * 3 + 1` over the array
+// Every array is larger than a typical L3 cache, so the loops are
+// memory-bound and the narrow types (u8, i16, i32, f32) gain from packing
+// more elements into each cache line and vector register. The label names
+// the element type. Run with --benchmark_filter='Sum|Scale'.
+//
+// BM_Match and BM_IfChain sum the areas of 4M shapes of four kinds in a
+// random order, stored as an enum matched through a switch on its tag, and
+// as a struct with a `kind: int` field tested by an if chain. Run with
+// --benchmark_filter='Match|IfChain'.
+
+#include <benchmark/benchmark.h>
+#include <llvm/Support/TargetSelect.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "jit/ReplSession.h"
+
+namespace {
+
+constexpr int64_t kElements = 1 << 26;
+
+// One session for every kernel; each is compiled on first use
+pynext::ReplSession& session() {
+    static pynext::ReplSession* instance = [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        auto* created = new pynext::ReplSession(2);
+        std::string error;
+        if (!created->init(error)) {
+            std::cerr << "Could not create the JIT: " << error << "\n";
+            exit(1);
+        }
+        return created;
+    }();
+    return *instance;
+}
+
+void* compileKernel(const std::string& name, const std::string& source) {
+    static std::map<std::string, void*> kernels;
+    auto it = kernels.find(name);
+    if (it != kernels.end()) return it->second;
+    if (!session().run(source) || !session().lookup(name)) {
+        std::cerr << "Could not compile kernel " << name << "\n";
+        exit(1);
+    }
+    return kernels[name] = session().lookup(name);
+}
+
+// Elements of an array as PyNext lays them out, after an 8-byte count
+struct Array {
+    char* memory;
+    char* data;
+    Array(int64_t count, size_t size) {
+        memory = static_cast<char*>(malloc(8 + count * size));
+        data = memory + 8;
+        memcpy(memory, &count, 8);
+        // Bytes below 61: small ints, and normal floats since no exponent is all zeros
+        for (int64_t i = 0; i < int64_t(count * size); ++i) data[i] = char(1 + i * 7 % 60);
+    }
+    ~Array() { free(memory); }
+};
+
+size_t elementSize(const std::string& type) {
+    if (type == "u8" || type == "i8") return 1;
+    if (type == "i16" || type == "u16") return 2;
+    if (type == "i32" || type == "u32" || type == "f32") return 4;
+    return 8;
+}
+
+void BM_Sum(benchmark::State& state, const std::string& type) {
+    std::string name = "sum_" + type;
+    auto* sum = reinterpret_cast<int64_t (*)(char*, int64_t)>(compileKernel(name,
+        "def " + name + "(a: " + type + "[], n: int) -> int\n"
+        "    var total = 0\n"
+        "    var i = 0\n"
+        "    while i < n\n"
+        "        total = total + a[i]\n"
+        "        i = i + 1\n"
+        "    end\n"
+        "    return total\n"
+        "end\n"));
+    Array array(kElements, elementSize(type));
+    for (auto _ : state) benchmark::DoNotOptimize(sum(array.data, kElements));
+    state.SetBytesProcessed(state.iterations() * kElements * elementSize(type));
+    state.SetLabel(type);
+}
+
+void BM_Scale(benchmark::State& state, const std::string& type) {
+    std::string name = "scale_" + type;
+    auto* scale = reinterpret_cast<void (*)(char*, int64_t)>(compileKernel(name,
+        "def " + name + "(a: " + type + "[], n: int)\n"
+        "    var i = 0\n"
+        "    while i < n\n"
+        "        a[i] = a[i] * 3 + 1\n"
+        "        i = i + 1\n"
+        "    end\n"
+        "end\n"));
+    Array array(kElements, elementSize(type));
+    for (auto _ : state) {
+        scale(array.data, kElements);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * kElements * elementSize(type));
+    state.SetLabel(type);
+}
+
+constexpr int64_t kShapes = 1 << 22;
+
+// Kinds 0..3 in an order the branch predictor cannot learn
+std::vector<int> shapeKinds() {
+    std::vector<int> kinds(kShapes);
+    uint64_t state = 12345;
+    for (auto& kind : kinds) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        kind = int(state >> 62);
+    }
+    return kinds;
+}
+
+void BM_Match(benchmark::State& state) {
+    auto* areas = reinterpret_cast<double (*)(char*, int64_t)>(compileKernel("areas_match",
+        "enum Shape\n"
+        "    Circle(r: float)\n"
+        "    Square(side: float)\n"
+        "    Rect(w: float, h: float)\n"
+        "    Empty\n"
+        "end\n"
+        "def areas_match(a: Shape[], n: int) -> float\n"
+        "    var total = 0.0\n"
+        "    var i = 0\n"
+        "    while i < n\n"
+        "        match a[i]\n"
+        "        case Circle(r)\n"
+        "            total = total + 3.0 * r * r\n"
+        "        case Square(side)\n"
+        "            total = total + side * side\n"
+        "        case Rect(w, h)\n"
+        "            total = total + w * h\n"
+        "        case Empty\n"
+        "        end\n"
+        "        i = i + 1\n"
+        "    end\n"
+        "    return total\n"
+        "end\n"));
+    // { i8 tag, [2 x i64] payload }: the tag, then up to two doubles
+    constexpr size_t kSize = 24;
+    Array array(kShapes, kSize);
+    std::vector<int> kinds = shapeKinds();
+    for (int64_t i = 0; i < kShapes; ++i) {
+        char* shape = array.data + i * kSize;
+        double fields[2] = {1.5, 2.0};
+        shape[0] = char(kinds[i]);
+        memcpy(shape + 8, fields, sizeof(fields));
+    }
+    for (auto _ : state) benchmark::DoNotOptimize(areas(array.data, kShapes));
+    state.SetItemsProcessed(state.iterations() * kShapes);
+    state.SetBytesProcessed(state.iterations() * kShapes * kSize);
+}
+
+void BM_IfChain(benchmark::State& state) {
+    auto* areas = reinterpret_cast<double (*)(char*, int64_t)>(compileKernel("areas_if",
+        "struct ShapeRecord\n"
+        "    kind: int\n"
+        "    r: float\n"
+        "    side: float\n"
+        "    w: float\n"
+        "    h: float\n"
+        "end\n"
+        "def areas_if(a: ShapeRecord[], n: int) -> float\n"
+        "    var total = 0.0\n"
+        "    var i = 0\n"
+        "    while i < n\n"
+        "        var kind = a[i].kind\n"
+        "        if kind == 0\n"
+        "            total = total + 3.0 * a[i].r * a[i].r\n"
+        "        else\n"
+        "            if kind == 1\n"
+        "                total = total + a[i].side * a[i].side\n"
+        "            else\n"
+        "                if kind == 2\n"
+        "                    total = total + a[i].w * a[i].h\n"
+        "                end\n"
+        "            end\n"
+        "        end\n"
+        "        i = i + 1\n"
+        "    end\n"
+        "    return total\n"
+        "end\n"));
+    // kind, r, side, w, h
+    constexpr size_t kSize = 40;
+    Array array(kShapes, kSize);
+    std::vector<int> kinds = shapeKinds();
+    for (int64_t i = 0; i < kShapes; ++i) {
+        int64_t kind = kinds[i];
+        double fields[4] = {1.5, 1.5, 1.5, 2.0};
+        memcpy(array.data + i * kSize, &kind, 8);
+        memcpy(array.data + i * kSize + 8, fields, sizeof(fields));
+    }
+    for (auto _ : state) benchmark::DoNotOptimize(areas(array.data, kShapes));
+    state.SetItemsProcessed(state.iterations() * kShapes);
+    state.SetBytesProcessed(state.iterations() * kShapes * kSize);
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_Sum, u8, std::string("u8"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Sum, i16, std::string("i16"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Sum, i32, std::string("i32"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Sum, int, std::string("int"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scale, u8, std::string("u8"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scale, i32, std::string("i32"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scale, int, std::string("int"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scale, f32, std::string("f32"))->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_Scale, float, std::string("float"))->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Match)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IfChain)->Unit(benchmark::kMillisecond);
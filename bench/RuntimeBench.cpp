@@ -0,0 +1,360 @@
+// Runtime library benchmarks, next to the compiler ones in pynext_bench.
+//
+// The Swiss table behind `dict[K, V]` (runtime/Dict.h) against
+// std::unordered_map, with int keys and int values, from 100K to 10M keys:
+//   BM_DictInsert / BM_UnorderedMapInsert   keys/s inserting into an empty map
+//   BM_DictLookup / BM_UnorderedMapLookup   keys/s finding every key, in a
+//                                           shuffled order
+//   BM_DictErase  / BM_UnorderedMapErase    keys/s erasing every key
+//
+// Keys are spread with a multiplicative step so neither table sees them in
+// hash order. Run with --benchmark_filter='Dict|UnorderedMap'.
+//
+// The sorts behind `sort(arr)` and `sort_by(arr, field)` (runtime/Sort.h)
+// against std::sort, on random values from 1K to 10M elements:
+//   BM_SortInt     / BM_StdSortInt       elements/s sorting an int[]
+//   BM_SortFloat   / BM_StdSortFloat     elements/s sorting a float[]
+//   BM_SortByField / BM_StdSortByField   elements/s sorting 32-byte structs
+//                                        by an int field
+//   BM_SortIntThreads                    BM_SortInt at 10M with 1 to 8
+//                                        threads, in wall time
+// Inputs are copied in between iterations, untimed.
+// Run with --benchmark_filter=Sort.
+//
+// Line input (runtime/File.h) on a file of 64 MB or 1 GB of short CSV lines,
+// in the page cache after the first iteration, and number parsing:
+//   BM_FileLines             bytes/s iterating the lines of the file
+//   BM_ReadCountNewlines     bytes/s counting its newlines with read() and
+//                            memchr, as `wc -l` does
+//   BM_ParseInt / BM_Strtoll numbers/s parsing decimal ints
+// The file is written to the temporary directory and removed at exit. Run
+// with --benchmark_filter='Lines|Newlines|ParseInt|Strtoll'.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "runtime/Dict.h"
+#include "runtime/File.h"
+#include "runtime/Sort.h"
+
+namespace {
+
+std::vector<int64_t> keys(int64_t count) {
+    std::vector<int64_t> result(count);
+    for (int64_t i = 0; i < count; ++i) result[i] = i * 0x9E3779B97F4A7C15LL;
+    return result;
+}
+
+std::vector<int64_t> shuffledKeys(int64_t count) {
+    std::vector<int64_t> result = keys(count);
+    std::shuffle(result.begin(), result.end(), std::mt19937_64(42));
+    return result;
+}
+
+void setKeyCounters(benchmark::State& state) {
+    state.counters["keys/s"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void* filledDict(const std::vector<int64_t>& keys) {
+    void* dict = __pynext_dict_new(sizeof(int64_t), -1);
+    for (int64_t key : keys) *static_cast<int64_t*>(__pynext_dict_int_insert(dict, key)) = key;
+    return dict;
+}
+
+std::unordered_map<int64_t, int64_t> filledMap(const std::vector<int64_t>& keys) {
+    std::unordered_map<int64_t, int64_t> map;
+    for (int64_t key : keys) map[key] = key;
+    return map;
+}
+
+void BM_DictInsert(benchmark::State& state) {
+    std::vector<int64_t> input = keys(state.range(0));
+    for (auto _ : state) {
+        void* dict = filledDict(input);
+        benchmark::DoNotOptimize(__pynext_dict_len(dict));
+        state.PauseTiming();
+        __pynext_dict_free(dict, -1);
+        state.ResumeTiming();
+    }
+    setKeyCounters(state);
+}
+
+void BM_UnorderedMapInsert(benchmark::State& state) {
+    std::vector<int64_t> input = keys(state.range(0));
+    for (auto _ : state) {
+        auto* map = new std::unordered_map<int64_t, int64_t>(filledMap(input));
+        benchmark::DoNotOptimize(map->size());
+        state.PauseTiming();
+        delete map;
+        state.ResumeTiming();
+    }
+    setKeyCounters(state);
+}
+
+void BM_DictLookup(benchmark::State& state) {
+    void* dict = filledDict(keys(state.range(0)));
+    std::vector<int64_t> probes = shuffledKeys(state.range(0));
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (int64_t key : probes) sum += *static_cast<int64_t*>(__pynext_dict_int_find(dict, key));
+        benchmark::DoNotOptimize(sum);
+    }
+    __pynext_dict_free(dict, -1);
+    setKeyCounters(state);
+}
+
+void BM_UnorderedMapLookup(benchmark::State& state) {
+    auto map = filledMap(keys(state.range(0)));
+    std::vector<int64_t> probes = shuffledKeys(state.range(0));
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (int64_t key : probes) sum += map.find(key)->second;
+        benchmark::DoNotOptimize(sum);
+    }
+    setKeyCounters(state);
+}
+
+void BM_DictErase(benchmark::State& state) {
+    std::vector<int64_t> input = keys(state.range(0));
+    std::vector<int64_t> probes = shuffledKeys(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        void* dict = filledDict(input);
+        state.ResumeTiming();
+        for (int64_t key : probes) __pynext_dict_int_erase(dict, key);
+        benchmark::DoNotOptimize(__pynext_dict_len(dict));
+        state.PauseTiming();
+        __pynext_dict_free(dict, -1);
+        state.ResumeTiming();
+    }
+    setKeyCounters(state);
+}
+
+void BM_UnorderedMapErase(benchmark::State& state) {
+    std::vector<int64_t> input = keys(state.range(0));
+    std::vector<int64_t> probes = shuffledKeys(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto* map = new std::unordered_map<int64_t, int64_t>(filledMap(input));
+        state.ResumeTiming();
+        for (int64_t key : probes) map->erase(key);
+        benchmark::DoNotOptimize(map->size());
+        state.PauseTiming();
+        delete map;
+        state.ResumeTiming();
+    }
+    setKeyCounters(state);
+}
+
+void keyCounts(benchmark::internal::Benchmark* b) {
+    b->RangeMultiplier(10)->Range(100000, 10000000)->Unit(benchmark::kMillisecond);
+}
+
+struct Record {
+    int64_t id;
+    int64_t key;
+    double weight;
+    const char* name;
+};
+
+template <typename T>
+std::vector<T> randomValues(int64_t count, uint64_t seed = 42) {
+    std::mt19937_64 rng(seed);
+    std::vector<T> result(count);
+    for (T& value : result) value = T(int64_t(rng())) / T(1 << 20);
+    return result;
+}
+
+std::vector<Record> randomRecords(int64_t count, uint64_t seed = 42) {
+    std::vector<int64_t> keys = randomValues<int64_t>(count, seed);
+    std::vector<Record> result(count);
+    for (int64_t i = 0; i < count; ++i) result[i] = {i, keys[i], 1.0, nullptr};
+    return result;
+}
+
+void setElementCounters(benchmark::State& state) {
+    state.counters["elements/s"] = benchmark::Counter(state.range(0), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Times `sort` on a fresh copy of an input from `generate(count, seed)`
+// each iteration. Small sizes cycle through several inputs: sorting the
+// same few thousand values again and again trains the branch predictor.
+template <typename Generate, typename Sort>
+void runSort(benchmark::State& state, Generate generate, Sort sort) {
+    int64_t count = state.range(0);
+    std::vector<decltype(generate(count, 0))> inputs;
+    for (int64_t seed = 0; seed < std::clamp<int64_t>(1000000 / count, 1, 64); ++seed) {
+        inputs.push_back(generate(count, seed));
+    }
+    decltype(generate(count, 0)) data;
+    size_t next = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        data = inputs[next++ % inputs.size()];
+        state.ResumeTiming();
+        sort(data);
+        benchmark::DoNotOptimize(data.data());
+    }
+    setElementCounters(state);
+}
+
+void BM_SortInt(benchmark::State& state) {
+    pynext::setSortThreads(1);
+    runSort(state, randomValues<int64_t>,
+            [](std::vector<int64_t>& data) { __pynext_sort_int(data.data(), data.size()); });
+}
+
+void BM_StdSortInt(benchmark::State& state) {
+    runSort(state, randomValues<int64_t>,
+            [](std::vector<int64_t>& data) { std::sort(data.begin(), data.end()); });
+}
+
+void BM_SortFloat(benchmark::State& state) {
+    pynext::setSortThreads(1);
+    runSort(state, randomValues<double>,
+            [](std::vector<double>& data) { __pynext_sort_float(data.data(), data.size()); });
+}
+
+void BM_StdSortFloat(benchmark::State& state) {
+    runSort(state, randomValues<double>,
+            [](std::vector<double>& data) { std::sort(data.begin(), data.end()); });
+}
+
+void BM_SortByField(benchmark::State& state) {
+    pynext::setSortThreads(1);
+    runSort(state, randomRecords, [](std::vector<Record>& data) {
+        __pynext_sort_by_int(data.data(), data.size(), sizeof(Record), offsetof(Record, key));
+    });
+}
+
+void BM_StdSortByField(benchmark::State& state) {
+    runSort(state, randomRecords, [](std::vector<Record>& data) {
+        std::sort(data.begin(), data.end(), [](const Record& a, const Record& b) { return a.key < b.key; });
+    });
+}
+
+void BM_SortIntThreads(benchmark::State& state) {
+    pynext::setSortThreads(state.range(1));
+    runSort(state, randomValues<int64_t>,
+            [](std::vector<int64_t>& data) { __pynext_sort_int(data.data(), data.size()); });
+    pynext::setSortThreads(0);
+}
+
+void elementCounts(benchmark::internal::Benchmark* b) {
+    b->RangeMultiplier(10)->Range(1000, 10000000)->Unit(benchmark::kMillisecond);
+}
+
+struct TempFile {
+    std::string path;
+    ~TempFile() { std::filesystem::remove(path); }
+};
+
+// Path of a file of about `megabytes` MB of lines like "123456789,42.125,item17"
+const std::string& lineFile(int64_t megabytes) {
+    static std::map<int64_t, TempFile> files;
+    TempFile& file = files[megabytes];
+    if (!file.path.empty()) return file.path;
+    file.path = (std::filesystem::temp_directory_path() / ("pynext_bench_lines_" + std::to_string(megabytes))).string();
+    std::mt19937_64 rng(42);
+    std::string chunk;
+    for (int i = 0; chunk.size() < (1 << 20); ++i) {
+        chunk += std::to_string(rng() % 1000000000) + "," + std::to_string(rng() % 100000 / 1000.0) + ",item" +
+                 std::to_string(i % 1000) + "\n";
+    }
+    FILE* out = fopen(file.path.c_str(), "wb");
+    for (int64_t written = 0; written < megabytes << 20; written += chunk.size()) {
+        fwrite(chunk.data(), 1, chunk.size(), out);
+    }
+    fclose(out);
+    return file.path;
+}
+
+void BM_FileLines(benchmark::State& state) {
+    const std::string& path = lineFile(state.range(0));
+    for (auto _ : state) {
+        void* file = __pynext_file_open(path.c_str(), -1);
+        int64_t lines = 0;
+        while (__pynext_file_next_line(file)) lines++;
+        __pynext_file_close(file, -1);
+        benchmark::DoNotOptimize(lines);
+    }
+    state.SetBytesProcessed(state.iterations() * std::filesystem::file_size(path));
+}
+
+void BM_ReadCountNewlines(benchmark::State& state) {
+    const std::string& path = lineFile(state.range(0));
+    std::vector<char> buffer(pynext::kReadBufferSize);
+    for (auto _ : state) {
+        int fd = open(path.c_str(), O_RDONLY);
+        int64_t lines = 0;
+        ssize_t count;
+        while ((count = read(fd, buffer.data(), buffer.size())) > 0) {
+            const char* end = buffer.data() + count;
+            for (const char* p = buffer.data(); (p = static_cast<const char*>(memchr(p, '\n', end - p))); ++p) lines++;
+        }
+        close(fd);
+        benchmark::DoNotOptimize(lines);
+    }
+    state.SetBytesProcessed(state.iterations() * std::filesystem::file_size(path));
+}
+
+void fileSizes(benchmark::internal::Benchmark* b) {
+    b->Arg(64)->Arg(1024)->Unit(benchmark::kMillisecond);
+}
+
+std::vector<std::string> numberTexts() {
+    std::vector<std::string> result;
+    for (int64_t value : randomValues<int64_t>(1000000)) result.push_back(std::to_string(value));
+    return result;
+}
+
+void BM_ParseInt(benchmark::State& state) {
+    std::vector<std::string> texts = numberTexts();
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (const std::string& text : texts) sum += __pynext_parse_int(text.c_str());
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * texts.size());
+}
+
+void BM_Strtoll(benchmark::State& state) {
+    std::vector<std::string> texts = numberTexts();
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (const std::string& text : texts) sum += strtoll(text.c_str(), nullptr, 10);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * texts.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_DictInsert)->Apply(keyCounts);
+BENCHMARK(BM_UnorderedMapInsert)->Apply(keyCounts);
+BENCHMARK(BM_DictLookup)->Apply(keyCounts);
+BENCHMARK(BM_UnorderedMapLookup)->Apply(keyCounts);
+BENCHMARK(BM_DictErase)->Apply(keyCounts);
+BENCHMARK(BM_UnorderedMapErase)->Apply(keyCounts);
+BENCHMARK(BM_SortInt)->Apply(elementCounts);
+BENCHMARK(BM_StdSortInt)->Apply(elementCounts);
+BENCHMARK(BM_SortFloat)->Apply(elementCounts);
+BENCHMARK(BM_StdSortFloat)->Apply(elementCounts);
+BENCHMARK(BM_SortByField)->Apply(elementCounts);
+BENCHMARK(BM_StdSortByField)->Apply(elementCounts);
+BENCHMARK(BM_SortIntThreads)->ArgsProduct({{10000000}, {1, 2, 4, 8}})->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FileLines)->Apply(fileSizes);
+BENCHMARK(BM_ReadCountNewlines)->Apply(fileSizes);
+BENCHMARK(BM_ParseInt);
+BENCHMARK(BM_Strtoll);
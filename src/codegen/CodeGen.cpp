@@ -1,10 +1,212 @@
 #include "CodeGen.h"
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
 #include <iostream>
+#include <map>
 
 namespace pynext {
 
-void CodeGen::generate(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+namespace {
+
+// Names whose value may be kept beyond the expression that reads it:
+// returned, stored in a variable, element or field, or passed to a function
+// that may keep that parameter. An array freed through such a copy must
+// have come from malloc. Parameters are tracked per function and the
+// program is walked until no more of them escape.
+//
+// The same walk finds the locals that may hold a top-level variable's value,
+// directly or through a call that returns it. Top-level values are never
+// freed, so such a local borrows it and its scope must not free it.
+class ArrayEscapes : public ASTVisitor {
+public:
+    explicit ArrayEscapes(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+        for (const auto& stmt : stmts) {
+            if (auto* func = dynamic_cast<FunctionStmt*>(stmt.get())) {
+                functions[func->name] = func;
+                keptParams[func->name].assign(func->params.size(), false);
+            }
+        }
+        do {
+            changed = false;
+            locals.clear();
+            for (const auto& stmt : stmts) stmt->accept(*this);
+        } while (changed);
+    }
+
+    llvm::StringSet<> escaped;
+    llvm::SmallPtrSet<const VarDeclStmt*, 8> borrowed;
+
+    void visit(LiteralExpr&) override {}
+    void visit(VariableExpr&) override {}
+    void visit(BinaryExpr& expr) override {
+        use(*expr.left, false);
+        use(*expr.right, expr.op == "=");
+        if (expr.op == "=" && expr.left->kind == NodeKind::Variable && aliasesGlobal(*expr.right)) {
+            borrow(locals.lookup(static_cast<VariableExpr&>(*expr.left).name));
+        }
+    }
+    void visit(CallExpr& expr) override {
+        auto it = functions.find(expr.callee);
+        for (size_t i = 0; i < expr.args.size(); ++i) {
+            bool kept = true; // Enum variants keep their fields
+            if (expr.namesBuiltin()) {
+                kept = false;
+            } else if (it != functions.end() && it->second->body) {
+                kept = i < keptParams[expr.callee].size() && keptParams[expr.callee][i];
+            } else if (it != functions.end()) {
+                // Externs keep nothing; an imported function may return it
+                kept = llvm::StringRef(it->second->returnType).ends_with("[]");
+            }
+            use(*expr.args[i], kept);
+        }
+    }
+    void visit(MemberAccessExpr& expr) override { use(*expr.object, false); }
+    void visit(IndexExpr& expr) override {
+        use(*expr.object, false);
+        use(*expr.index, false);
+    }
+    void visit(ArrayLiteralExpr& expr) override {
+        for (auto& element : expr.elements) use(*element, true);
+    }
+    void visit(ReturnStmt& stmt) override {
+        if (!stmt.value) return;
+        use(*stmt.value, true);
+        if (current && !returnsGlobal[current->name] && aliasesGlobal(*stmt.value)) {
+            returnsGlobal[current->name] = true;
+            changed = true;
+        }
+    }
+    void visit(Block& stmt) override {
+        ++depth;
+        for (auto& s : stmt.statements) s->accept(*this);
+        --depth;
+    }
+    void visit(IfStmt& stmt) override {
+        use(*stmt.condition, false);
+        stmt.thenBranch->accept(*this);
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(WhileStmt& stmt) override {
+        use(*stmt.condition, false);
+        stmt.body->accept(*this);
+    }
+    void visit(ForStmt& stmt) override {
+        use(*stmt.iterator, false);
+        llvm::StringMap<VarDeclStmt*> outer = locals;
+        locals[stmt.variable] = nullptr;
+        stmt.body->accept(*this);
+        locals = std::move(outer);
+    }
+    void visit(FunctionStmt& stmt) override {
+        if (!stmt.body) return;
+        current = &stmt;
+        llvm::StringMap<VarDeclStmt*> outer = std::move(locals);
+        locals.clear();
+        for (const auto& param : stmt.params) locals[param.first] = nullptr;
+        stmt.body->accept(*this);
+        locals = std::move(outer);
+        current = nullptr;
+    }
+    void visit(VarDeclStmt& stmt) override {
+        if (stmt.initializer) use(*stmt.initializer, true);
+        // Top-level declarations are the globals; any other is freed with its scope
+        if (depth == 0) {
+            locals.erase(stmt.name);
+            return;
+        }
+        locals[stmt.name] = &stmt;
+        if (stmt.initializer && aliasesGlobal(*stmt.initializer)) borrow(&stmt);
+    }
+    void visit(StructDeclStmt&) override {}
+    void visit(EnumDeclStmt&) override {}
+    void visit(MatchStmt& stmt) override {
+        use(*stmt.subject, false);
+        for (auto& matchCase : stmt.cases) {
+            llvm::StringMap<VarDeclStmt*> outer = locals;
+            for (const auto& binding : matchCase.bindings) locals[binding] = nullptr;
+            matchCase.body->accept(*this);
+            locals = std::move(outer);
+        }
+        if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    }
+    void visit(ExprStmt& stmt) override { use(*stmt.expr, false); }
+
+private:
+    std::map<std::string, FunctionStmt*> functions;
+    std::map<std::string, std::vector<bool>> keptParams;
+    std::map<std::string, bool> returnsGlobal;
+    // Names declared in the scopes open at this point of the walk: the
+    // local's declaration, or null for a parameter, loop variable or binding
+    llvm::StringMap<VarDeclStmt*> locals;
+    FunctionStmt* current = nullptr;
+    int depth = 0; // Blocks entered; 0 at the top level
+    bool changed = false;
+
+    void borrow(const VarDeclStmt* decl) {
+        if (decl && borrowed.insert(decl).second) changed = true;
+    }
+
+    // Whether the value may be a top-level variable's, or a part of one
+    bool aliasesGlobal(Expr& expr) {
+        switch (expr.kind) {
+        case NodeKind::Variable: {
+            auto it = locals.find(static_cast<VariableExpr&>(expr).name);
+            if (it == locals.end()) return true;
+            return it->second && borrowed.count(it->second);
+        }
+        case NodeKind::Index:
+            return aliasesGlobal(*static_cast<IndexExpr&>(expr).object);
+        case NodeKind::MemberAccess:
+            return aliasesGlobal(*static_cast<MemberAccessExpr&>(expr).object);
+        case NodeKind::Call: {
+            auto& call = static_cast<CallExpr&>(expr);
+            auto it = functions.find(call.callee);
+            if (call.namesBuiltin() || it == functions.end()) return false;
+            if (it->second->body && returnsGlobal[call.callee]) return true;
+            const std::vector<bool>& kept = keptParams[call.callee];
+            for (size_t i = 0; i < call.args.size(); ++i) {
+                bool mayReturn = it->second->body ? i < kept.size() && kept[i] : true;
+                if (mayReturn && aliasesGlobal(*call.args[i])) return true;
+            }
+            return false;
+        }
+        default:
+            return false;
+        }
+    }
+
+    void use(Expr& expr, bool kept) {
+        if (expr.kind != NodeKind::Variable) {
+            expr.accept(*this);
+            return;
+        }
+        if (!kept) return;
+        const std::string& name = static_cast<VariableExpr&>(expr).name;
+        escaped.insert(name);
+        for (size_t i = 0; current && i < current->params.size(); ++i) {
+            std::vector<bool>& params = keptParams[current->name];
+            if (current->params[i].first != name || params[i]) continue;
+            params[i] = true;
+            changed = true;
+        }
+    }
+};
+
+} // namespace
+
+void CodeGen::generate(const std::vector<std::unique_ptr<Stmt>>& stmts, const std::string& entryName) {
     scopeStack.push_back({}); // Global Scope
+    initDebugInfo();
+
+    ArrayEscapes escapes(stmts);
+    borrowedLocals = std::move(escapes.borrowed);
+    for (const auto& s : stmts) {
+        auto* decl = dynamic_cast<VarDeclStmt*>(s.get());
+        if (decl && decl->initializer && decl->initializer->kind == NodeKind::ArrayLiteral &&
+            !escapes.escaped.count(decl->name)) {
+            staticArrays.insert(decl->name);
+        }
+    }
 
     // Check for user-defined main
     bool hasUserMain = false;
@@ -15,26 +217,234 @@ void CodeGen::generate(const std::vector<std::unique_ptr<Stmt>>& stmts) {
     }
 
     // Create entry function (default "main", or "__init" if main exists)
-    std::string entryName = hasUserMain ? "__init" : "main";
-    
+    if (!entryName.empty()) {
+        emitEntryFunction(stmts, entryName);
+    } else {
+        emitEntryFunction(stmts, hasUserMain ? "__init" : "main");
+    }
+    if (debugBuilder) debugBuilder->finalize();
+}
+
+std::unique_ptr<llvm::Module> CodeGen::generateChunk(const std::vector<std::unique_ptr<Stmt>>& stmts,
+                                                     const std::string& entryName) {
+    module = std::make_unique<llvm::Module>("PyNextChunk", context);
+    scopeStack.assign(1, {}); // Top-level arrays live as long as the session
+    namedValues.clear();
+    staticArrays.clear();
+    borrowedLocals = ArrayEscapes(stmts).borrowed;
+    emitEntryFunction(stmts, entryName);
+    return std::move(module);
+}
+
+CodeGen::ChunkState CodeGen::saveChunkState() const {
+    return {structTypes, functionTypes, enumLayouts, globalVariables, globalRedefinitions, structFieldTypeNames};
+}
+
+void CodeGen::restoreChunkState(ChunkState state) {
+    structTypes = std::move(state.structTypes);
+    functionTypes = std::move(state.functionTypes);
+    enumLayouts = std::move(state.enumLayouts);
+    globalVariables = std::move(state.globalVariables);
+    globalRedefinitions = state.globalRedefinitions;
+    structFieldTypeNames = std::move(state.structFieldTypeNames);
+}
+
+void CodeGen::emitEntryFunction(const std::vector<std::unique_ptr<Stmt>>& stmts, const std::string& entryName) {
     llvm::FunctionType* ft = llvm::FunctionType::get(llvm::Type::getInt64Ty(context), false);
     llvm::Function* entryFunc = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, entryName, module.get());
+    setFunctionAttributes(entryFunc);
     llvm::BasicBlock* bb = llvm::BasicBlock::Create(context, "entry", entryFunc);
     builder.SetInsertPoint(bb);
+    debugScope = createDebugFunction(entryFunc, entryName, 0, nullptr);
+    emitFunctionEntryHook(entryName, 0);
+    beginCleanups();
 
     for (const auto& stmt : stmts) {
-        stmt->accept(*this);
+        currentLine = stmt->line;
+        emitDebugLocation(*stmt);
+        visitStmt(*stmt);
     }
     
     // Ensure entry function returns
     if (!builder.GetInsertBlock()->getTerminator()) {
-        builder.CreateRet(llvm::ConstantInt::get(context, llvm::APInt(64, 0)));
+        emitReturnBranch(llvm::ConstantInt::get(context, llvm::APInt(64, 0)), nullptr);
+    }
+    finishCleanups(entryFunc);
+}
+
+// Functions defined by earlier modules are declared in this one on first use
+llvm::Function* CodeGen::getFunction(const std::string& name) {
+    if (llvm::Function* func = module->getFunction(name)) return func;
+    auto it = functionTypes.find(name);
+    if (it == functionTypes.end()) return nullptr;
+    return llvm::Function::Create(it->second, llvm::Function::ExternalLinkage, name, module.get());
+}
+
+llvm::GlobalVariable* CodeGen::getGlobalVariable(const std::string& name) {
+    auto it = globalVariables.find(name);
+    if (it == globalVariables.end()) return nullptr;
+    if (llvm::GlobalVariable* var = module->getNamedGlobal(it->second.symbol)) return var;
+    return new llvm::GlobalVariable(*module, it->second.type, false, llvm::GlobalValue::ExternalLinkage, nullptr,
+                                    it->second.symbol);
+}
+
+// Source-level spelling of a sema type, as getType/getDebugType expect it
+static std::string typeNameOf(const std::shared_ptr<Type>& type) {
+    if (!type) return "int";
+    if (auto st = std::dynamic_pointer_cast<pynext::StructType>(type)) return st->name;
+    if (auto et = std::dynamic_pointer_cast<pynext::EnumType>(type)) return et->name;
+    if (auto at = std::dynamic_pointer_cast<pynext::ArrayType>(type)) return typeNameOf(at->elementType) + "[]";
+    if (auto dt = std::dynamic_pointer_cast<pynext::DictType>(type)) {
+        return "dict[" + typeNameOf(dt->keyType) + "," + typeNameOf(dt->valueType) + "]";
+    }
+    return type->toString();
+}
+
+void CodeGen::initDebugInfo() {
+    if (options.debugInfo == DebugInfoLevel::None) return;
+
+    debugBuilder = std::make_unique<llvm::DIBuilder>(*module);
+    llvm::StringRef path = options.sourceFile;
+    size_t slash = path.rfind('/');
+    llvm::StringRef dir = slash == llvm::StringRef::npos ? "." : path.take_front(slash);
+    debugFile = debugBuilder->createFile(path.drop_front(slash == llvm::StringRef::npos ? 0 : slash + 1), dir);
+
+    // There is no DWARF language code for PyNext; C is what debuggers handle best
+    auto kind = options.debugInfo == DebugInfoLevel::Full ? llvm::DICompileUnit::FullDebug
+                                                          : llvm::DICompileUnit::LineTablesOnly;
+    debugUnit = debugBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C, debugFile, "pynext", options.optimized,
+                                                "", 0, "", kind);
+    module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+// Attaches a subprogram to `func`; `stmt` supplies parameter types in -g mode.
+llvm::DISubprogram* CodeGen::createDebugFunction(llvm::Function* func, const std::string& name, int line,
+                                                 const FunctionStmt* stmt) {
+    if (!debugBuilder) return nullptr;
+
+    llvm::SmallVector<llvm::Metadata*, 8> signature;
+    if (options.debugInfo == DebugInfoLevel::Full && stmt) {
+        signature.push_back(getDebugType(stmt->returnType));
+        for (const auto& param : stmt->params) signature.push_back(getDebugType(param.second));
+    }
+    auto* type = debugBuilder->createSubroutineType(debugBuilder->getOrCreateTypeArray(signature));
+
+    auto spFlags = llvm::DISubprogram::SPFlagDefinition;
+    if (options.optimized) spFlags |= llvm::DISubprogram::SPFlagOptimized;
+    auto flags = stmt ? llvm::DINode::FlagPrototyped : llvm::DINode::FlagArtificial;
+    llvm::DISubprogram* sp = debugBuilder->createFunction(debugFile, name, "", debugFile, line, type, line,
+                                                          flags, spFlags);
+    func->setSubprogram(sp);
+    return sp;
+}
+
+void CodeGen::emitDebugLocation(const ASTNode& node) {
+    if (!debugScope || node.line == 0) return;
+    builder.SetCurrentDebugLocation(llvm::DILocation::get(context, node.line, node.column, debugScope));
+}
+
+llvm::DIType* CodeGen::getDebugType(const std::string& typeName) {
+    auto it = debugTypes.find(typeName);
+    if (it != debugTypes.end()) return it->second;
+
+    // A struct of `fields` laid out as `structTy`
+    llvm::DataLayout dl = dataLayout();
+    auto describeStruct = [&](const std::string& name, llvm::StructType* structTy,
+                              const std::vector<std::pair<std::string, std::string>>& fields) {
+        const llvm::StructLayout* layout = dl.getStructLayout(structTy);
+        llvm::SmallVector<llvm::Metadata*, 8> members;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            llvm::Type* fieldTy = structTy->getElementType(i);
+            members.push_back(debugBuilder->createMemberType(
+                debugUnit, fields[i].first, debugFile, 0, dl.getTypeSizeInBits(fieldTy),
+                dl.getABITypeAlign(fieldTy).value() * 8, layout->getElementOffsetInBits(i),
+                llvm::DINode::FlagZero, getDebugType(fields[i].second)));
+        }
+        return debugBuilder->createStructType(debugUnit, name, debugFile, 0, layout->getSizeInBits(),
+                                              layout->getAlignment().value() * 8, llvm::DINode::FlagZero,
+                                              nullptr, debugBuilder->getOrCreateArray(members));
+    };
+
+    llvm::DIType* type = nullptr;
+    if (auto numeric = numericType(typeName)) {
+        auto* intType = numeric->kind == TypeKind::Int ? static_cast<IntType*>(numeric.get()) : nullptr;
+        unsigned bits = intType ? intType->bits : static_cast<FloatType&>(*numeric).bits;
+        unsigned encoding = !intType ? llvm::dwarf::DW_ATE_float
+                            : intType->isSigned ? llvm::dwarf::DW_ATE_signed : llvm::dwarf::DW_ATE_unsigned;
+        type = debugBuilder->createBasicType(numeric->toString(), bits, encoding);
+    } else if (typeName == "bool") {
+        type = debugBuilder->createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+    } else if (typeName == "string") {
+        auto* charTy = debugBuilder->createBasicType("char", 8, llvm::dwarf::DW_ATE_signed_char);
+        type = debugBuilder->createPointerType(charTy, 64, 0, std::nullopt, "string");
+    } else if (typeName.size() > 2 && typeName.compare(typeName.size() - 2, 2, "[]") == 0) {
+        // Arrays are pointers to their first element
+        type = debugBuilder->createPointerType(getDebugType(typeName.substr(0, typeName.size() - 2)), 64);
+    } else if (typeName.compare(0, 5, "dict[") == 0 || typeName == "file") {
+        // Dicts and files are opaque runtime handles
+        type = debugBuilder->createPointerType(nullptr, 64, 0, std::nullopt, typeName);
+    } else if (llvm::StructType* structTy = structTypes.lookup(typeName)) {
+        type = describeStruct(typeName, structTy, structFieldTypeNames[typeName]);
+    } else if (auto it = enumLayouts.find(typeName); it != enumLayouts.end() && it->second.pointerVariant >= 0) {
+        // Reads as the pointer field, under the enum's name
+        const auto& field = it->second.variants[it->second.pointerVariant].fields[0];
+        type = debugBuilder->createTypedef(getDebugType(field.second), typeName, debugFile, 0, debugUnit);
+    } else if (it != enumLayouts.end()) {
+        // { tag, payload } with the payload a union of the variants' fields
+        const EnumLayout& layout = it->second;
+        auto* enumTy = llvm::cast<llvm::StructType>(layout.type);
+        const llvm::StructLayout* enumLayout = dl.getStructLayout(enumTy);
+        unsigned tagBits = enumTy->getElementType(0)->getIntegerBitWidth();
+        llvm::SmallVector<llvm::Metadata*, 3> members{debugBuilder->createMemberType(
+            debugUnit, "tag", debugFile, 0, tagBits, tagBits, 0, llvm::DINode::FlagZero,
+            debugBuilder->createBasicType("tag", tagBits, llvm::dwarf::DW_ATE_unsigned))};
+        if (enumTy->getNumElements() > 1) {
+            llvm::SmallVector<llvm::Metadata*, 8> variants;
+            for (size_t i = 0; i < layout.variants.size(); ++i) {
+                const EnumVariant& variant = layout.variants[i];
+                if (variant.fields.empty()) continue;
+                llvm::DIType* payload = describeStruct(typeName + "." + variant.name, layout.payloads[i],
+                                                       variant.fields);
+                variants.push_back(debugBuilder->createMemberType(debugUnit, variant.name, debugFile, 0,
+                                                                  payload->getSizeInBits(),
+                                                                  payload->getAlignInBits(), 0,
+                                                                  llvm::DINode::FlagZero, payload));
+            }
+            llvm::Type* payloadTy = enumTy->getElementType(1);
+            uint64_t payloadBits = dl.getTypeSizeInBits(payloadTy);
+            uint32_t payloadAlign = dl.getABITypeAlign(payloadTy).value() * 8;
+            llvm::DIType* payload = debugBuilder->createUnionType(
+                debugUnit, typeName + ".payload", debugFile, 0, payloadBits, payloadAlign, llvm::DINode::FlagZero,
+                debugBuilder->getOrCreateArray(variants));
+            members.push_back(debugBuilder->createMemberType(debugUnit, "payload", debugFile, 0, payloadBits,
+                                                             payloadAlign, enumLayout->getElementOffsetInBits(1),
+                                                             llvm::DINode::FlagZero, payload));
+        }
+        type = debugBuilder->createStructType(debugUnit, typeName, debugFile, 0, enumLayout->getSizeInBits(),
+                                              enumLayout->getAlignment().value() * 8, llvm::DINode::FlagZero,
+                                              nullptr, debugBuilder->getOrCreateArray(members));
     }
+    // "void" stays null, which DWARF reads as no type
+    debugTypes[typeName] = type;
+    return type;
+}
+
+// Describes a stack variable in -g mode; argNo is 1-based for parameters, 0 for locals.
+void CodeGen::declareDebugVariable(llvm::AllocaInst* alloca, const std::string& name, const std::string& typeName,
+                                   const ASTNode& node, unsigned argNo) {
+    if (!debugScope || options.debugInfo != DebugInfoLevel::Full) return;
+    llvm::DILocalVariable* var =
+        argNo ? debugBuilder->createParameterVariable(debugScope, name, argNo, debugFile, node.line,
+                                                      getDebugType(typeName), true)
+              : debugBuilder->createAutoVariable(debugScope, name, debugFile, node.line, getDebugType(typeName), true);
+    debugBuilder->insertDeclare(alloca, var, debugBuilder->createExpression(),
+                                llvm::DILocation::get(context, node.line, node.column, debugScope),
+                                builder.GetInsertBlock());
 }
 
 llvm::Type* CodeGen::getType(const std::string& typeName) {
-    if (typeName == "int") return llvm::Type::getInt64Ty(context);
-    if (typeName == "float") return llvm::Type::getDoubleTy(context);
+    if (auto numeric = numericType(typeName)) return valueType(numeric.get());
     if (typeName == "bool") return llvm::Type::getInt1Ty(context);
     if (typeName == "string") return llvm::PointerType::get(llvm::Type::getInt8Ty(context), 0);
     if (typeName == "void") return llvm::Type::getVoidTy(context);
@@ -57,206 +467,732 @@ llvm::Type* CodeGen::getType(const std::string& typeName) {
          return llvm::PointerType::get(elemType, 0); 
     }
 
-    if (structTypes.count(typeName)) return structTypes[typeName];
+    // Dicts and files are handles from runtime/Dict.h and runtime/File.h
+    if (typeName.compare(0, 5, "dict[") == 0 || typeName == "file") return llvm::PointerType::get(context, 0);
+
+    if (llvm::StructType* structTy = structTypes.lookup(typeName)) return structTy;
+    if (auto it = enumLayouts.find(typeName); it != enumLayouts.end()) return it->second.type;
     return llvm::Type::getInt64Ty(context); // Default
 }
 
+// The LLVM type of values of a sema type; int for a type sema rejected
+llvm::Type* CodeGen::valueType(const Type* type) {
+    if (!type) return builder.getInt64Ty();
+    switch (type->kind) {
+    case TypeKind::Int: return builder.getIntNTy(static_cast<const IntType*>(type)->bits);
+    case TypeKind::Float:
+        return static_cast<const FloatType*>(type)->bits == 32 ? builder.getFloatTy() : builder.getDoubleTy();
+    case TypeKind::Bool: return builder.getInt1Ty();
+    case TypeKind::String:
+    case TypeKind::Array:
+    case TypeKind::Dict:
+    case TypeKind::File: return llvm::PointerType::get(context, 0);
+    case TypeKind::Struct:
+        if (llvm::StructType* structTy = structTypes.lookup(static_cast<const pynext::StructType*>(type)->name)) {
+            return structTy;
+        }
+        break;
+    case TypeKind::Enum:
+        if (auto it = enumLayouts.find(static_cast<const EnumType*>(type)->name); it != enumLayouts.end()) {
+            return it->second.type;
+        }
+        break;
+    default: break;
+    }
+    return builder.getInt64Ty();
+}
+
+// Converts a number (or bool) of sema type `from` to `to`. Ints widen by the
+// signedness of `from` and narrow by truncation. Floats converted to ints
+// round toward zero and saturate at the range of `to`; NaN gives 0. Anything
+// else is returned unchanged.
+llvm::Value* CodeGen::emitConversion(llvm::Value* value, const Type* from, llvm::Type* to, bool toSigned) {
+    llvm::Type* type = value->getType();
+    if (!from || type == to) return value;
+    bool fromSigned = from->kind == TypeKind::Int && static_cast<const IntType*>(from)->isSigned;
+    if (type->isIntegerTy() && to->isIntegerTy()) return builder.CreateIntCast(value, to, fromSigned, "conv");
+    if (type->isIntegerTy() && to->isFloatingPointTy()) {
+        return fromSigned ? builder.CreateSIToFP(value, to, "conv") : builder.CreateUIToFP(value, to, "conv");
+    }
+    if (type->isFloatingPointTy() && to->isFloatingPointTy()) return builder.CreateFPCast(value, to, "conv");
+    if (type->isFloatingPointTy() && to->isIntegerTy()) {
+        auto saturating = toSigned ? llvm::Intrinsic::fptosi_sat : llvm::Intrinsic::fptoui_sat;
+        return builder.CreateIntrinsic(saturating, {to, type}, {value}, nullptr, "conv");
+    }
+    return value;
+}
+
+void CodeGen::setFunctionAttributes(llvm::Function* func) {
+    if (options.framePointers) {
+        func->addFnAttr("frame-pointer", "all");
+    }
+}
+
+llvm::FunctionCallee CodeGen::getRuntimeHook(const char* name, llvm::ArrayRef<llvm::Type*> params) {
+    llvm::FunctionType* ft = llvm::FunctionType::get(llvm::Type::getVoidTy(context), params, false);
+    return module->getOrInsertFunction(name, ft);
+}
+
+// Instrumentation hooks. Nothing is emitted unless options.instrument is set,
+// so regular builds carry no trace of them.
+void CodeGen::emitFunctionEntryHook(const std::string& name, int line) {
+    currentFunction = name;
+    currentFunctionId = -1;
+    if (!options.instrument) return;
+    currentFunctionId = instrumentedFunctions.size();
+    instrumentedFunctions.push_back({name, "def", line});
+    auto hook = getRuntimeHook("__pynext_instr_enter", {llvm::Type::getInt32Ty(context)});
+    builder.CreateCall(hook, {builder.getInt32(currentFunctionId)});
+}
+
+// Flushes the trip counts of the loops a return leaves early
+void CodeGen::emitLoopExitHooks() {
+    if (currentFunctionId < 0) return;
+    for (auto it = activeLoops.rbegin(); it != activeLoops.rend(); ++it) {
+        auto loopHook = getRuntimeHook("__pynext_instr_loop",
+                                       {llvm::Type::getInt32Ty(context), llvm::Type::getInt64Ty(context)});
+        llvm::Value* trips = builder.CreateLoad(llvm::Type::getInt64Ty(context), it->second, "trips");
+        builder.CreateCall(loopHook, {builder.getInt32(it->first), trips});
+    }
+}
+
+// Must precede every `ret`: flushes the trip counts of loops left early, then
+// closes the function's timing frame.
+void CodeGen::emitFunctionExitHook() {
+    if (currentFunctionId < 0) return;
+    emitLoopExitHooks();
+    auto hook = getRuntimeHook("__pynext_instr_exit", {llvm::Type::getInt32Ty(context)});
+    builder.CreateCall(hook, {builder.getInt32(currentFunctionId)});
+}
+
+void CodeGen::beginLoopCounter(const char* kind, int line) {
+    if (!options.instrument) return;
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+    llvm::AllocaInst* counter = createEntryBlockAlloca(func, "trips", llvm::Type::getInt64Ty(context));
+    builder.CreateStore(builder.getInt64(0), counter);
+    activeLoops.push_back({(int)instrumentedLoops.size(), counter});
+    instrumentedLoops.push_back({currentFunction, kind, line});
+}
+
+void CodeGen::countLoopTrip() {
+    if (!options.instrument) return;
+    llvm::AllocaInst* counter = activeLoops.back().second;
+    llvm::Value* trips = builder.CreateLoad(llvm::Type::getInt64Ty(context), counter, "trips");
+    builder.CreateStore(builder.CreateAdd(trips, builder.getInt64(1), "trips.next"), counter);
+}
+
+void CodeGen::endLoopCounter() {
+    if (!options.instrument) return;
+    auto [id, counter] = activeLoops.back();
+    activeLoops.pop_back();
+    auto hook = getRuntimeHook("__pynext_instr_loop",
+                               {llvm::Type::getInt32Ty(context), llvm::Type::getInt64Ty(context)});
+    llvm::Value* trips = builder.CreateLoad(llvm::Type::getInt64Ty(context), counter, "trips");
+    builder.CreateCall(hook, {builder.getInt32(id), trips});
+}
+
+// Array storage is malloc(8 + n * elemSize) with the element count in the
+// first 8 bytes; the array value points just past it.
+llvm::Value* CodeGen::emitArrayAlloc(llvm::Value* size) {
+    if (options.trackAllocations) {
+        int site = allocationSites.size();
+        allocationSites.push_back({currentFunction, "array literal", currentLine});
+        llvm::FunctionType* ft = llvm::FunctionType::get(
+            llvm::PointerType::get(context, 0), {llvm::Type::getInt64Ty(context), llvm::Type::getInt32Ty(context)}, false);
+        return builder.CreateCall(module->getOrInsertFunction("__pynext_alloc", ft), {size, builder.getInt32(site)},
+                                  "malloccall");
+    }
+
+    // We need `malloc` declared.
+    llvm::Function* mallocFunc = module->getFunction("malloc");
+    if (!mallocFunc) {
+        // Declare malloc: i8* malloc(i64)
+        std::vector<llvm::Type*> args = { llvm::Type::getInt64Ty(context) };
+        llvm::FunctionType* ft = llvm::FunctionType::get(llvm::PointerType::get(llvm::Type::getInt8Ty(context), 0), args, false);
+        mallocFunc = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "malloc", module.get());
+    }
+    return builder.CreateCall(mallocFunc, {size}, "malloccall");
+}
+
+void CodeGen::emitArrayFree(llvm::Value* dataPtr, const char* kind, int line) {
+    // The pointer points to Data (+8). We need Free(-8).
+    llvm::Value* neg8 = llvm::ConstantInt::get(context, llvm::APInt(64, -8, true));
+    llvm::Value* rawPtr = builder.CreateGEP(llvm::Type::getInt8Ty(context), dataPtr, neg8, "rawPtr");
+
+    if (options.trackAllocations) {
+        int site = allocationSites.size();
+        allocationSites.push_back({currentFunction, kind, line});
+        auto hook = getRuntimeHook("__pynext_free", {llvm::PointerType::get(context, 0), llvm::Type::getInt32Ty(context)});
+        builder.CreateCall(hook, {rawPtr, builder.getInt32(site)});
+        return;
+    }
+
+    llvm::Function* freeFunc = module->getFunction("free");
+    if (!freeFunc) {
+        std::vector<llvm::Type*> args = { llvm::PointerType::get(context, 0) };
+        llvm::FunctionType* ft = llvm::FunctionType::get(llvm::Type::getVoidTy(context), args, false);
+        freeFunc = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "free", module.get());
+    }
+    builder.CreateCall(freeFunc, {rawPtr});
+}
+
+// Frees an array or dict variable's value, or closes a file, when it goes
+// out of scope
+void CodeGen::emitRelease(llvm::Value* ptr, TypeKind type, const char* kind, int line) {
+    if (type == TypeKind::Array) {
+        emitArrayFree(ptr, kind, line);
+        return;
+    }
+    int site = -1;
+    if (options.trackAllocations) {
+        site = allocationSites.size();
+        allocationSites.push_back({currentFunction, kind, line});
+    }
+    auto release = getRuntimeFunction(type == TypeKind::File ? "__pynext_file_close" : "__pynext_dict_free",
+                                      llvm::Type::getVoidTy(context),
+                                      {llvm::PointerType::get(context, 0), llvm::Type::getInt32Ty(context)});
+    builder.CreateCall(release, {ptr, builder.getInt32(site)});
+}
+
+// The driver sets the target layout after codegen; until then assume a
+// 64-bit target, where every scalar is naturally aligned
+llvm::DataLayout CodeGen::dataLayout() const {
+    return llvm::DataLayout(module->getDataLayoutStr().empty() ? "e-i64:64" : module->getDataLayoutStr());
+}
+
+llvm::FunctionCallee CodeGen::getRuntimeFunction(const char* name, llvm::Type* result,
+                                                 llvm::ArrayRef<llvm::Type*> params) {
+    return module->getOrInsertFunction(name, llvm::FunctionType::get(result, params, false));
+}
+
+// Values are stored inline in the table, so it needs their size
+llvm::Value* CodeGen::emitDictNew(const DictType& type) {
+    llvm::DataLayout dl = dataLayout();
+    uint64_t valueSize = dl.getTypeAllocSize(getType(typeNameOf(type.valueType)));
+    int site = -1;
+    if (options.trackAllocations) {
+        site = allocationSites.size();
+        allocationSites.push_back({currentFunction, "dict", currentLine});
+    }
+    auto dictNew = getRuntimeFunction("__pynext_dict_new", llvm::PointerType::get(context, 0),
+                                      {llvm::Type::getInt64Ty(context), llvm::Type::getInt32Ty(context)});
+    return builder.CreateCall(dictNew, {builder.getInt64(valueSize), builder.getInt32(site)}, "dict");
+}
+
+// Keys go to the runtime as one word: see runtime/Dict.h. Narrower numbers
+// are widened by the signedness of their own type `from`, as assignments
+// convert them, so a u8 of 200 is the key 200 in a dict[int, V] too.
+llvm::Value* CodeGen::emitDictKey(llvm::Value* key, const Type* from, const Type& keyType) {
+    if (keyType.kind == TypeKind::Bool || (keyType.kind == TypeKind::Int && key->getType()->isIntegerTy())) {
+        return emitConversion(key, from, builder.getInt64Ty());
+    }
+    if (keyType.kind == TypeKind::Float && key->getType()->isFloatingPointTy()) {
+        key = emitConversion(key, from, builder.getDoubleTy());
+        // -0.0 + 0.0 is 0.0, so both zeros hash alike
+        llvm::Value* folded = builder.CreateFAdd(key, llvm::ConstantFP::get(key->getType(), 0.0), "key.zero");
+        return builder.CreateBitCast(folded, builder.getInt64Ty(), "key");
+    }
+    return key;
+}
+
+enum class DictOp { Find, Insert, Erase };
+
+static const char* dictEntryPoint(const DictType& type, DictOp op) {
+    static const char* const names[2][3] = {
+        {"__pynext_dict_int_find", "__pynext_dict_int_insert", "__pynext_dict_int_erase"},
+        {"__pynext_dict_str_find", "__pynext_dict_str_insert", "__pynext_dict_str_erase"},
+    };
+    return names[type.keyType->kind == TypeKind::String][int(op)];
+}
+
+// Address of the value of `d[k]`. A read of a missing key reports it and
+// exits; a store inserts it.
+llvm::Value* CodeGen::emitDictSlot(IndexExpr& expr, bool insert) {
+    auto& type = static_cast<DictType&>(*expr.object->type);
+    if (!expr.index->type || expr.index->type->kind != type.keyType->kind) {
+        std::cerr << "CodeGen Error: Dict key must be " << type.keyType->toString() << "\n";
+        return nullptr;
+    }
+    llvm::Value* dict = visitExpr(*expr.object);
+    llvm::Value* key = dict ? visitExpr(*expr.index) : nullptr;
+    if (!key) return nullptr;
+    key = emitDictKey(key, expr.index->type.get(), *type.keyType);
+
+    llvm::Type* ptrTy = llvm::PointerType::get(context, 0);
+    llvm::Type* keyTy = type.keyType->kind == TypeKind::String ? ptrTy : builder.getInt64Ty();
+    if (key->getType() != keyTy) return nullptr; // A key type sema rejected
+    DictOp op = insert ? DictOp::Insert : DictOp::Find;
+    auto lookup = getRuntimeFunction(dictEntryPoint(type, op), ptrTy, {ptrTy, keyTy});
+    emitDebugLocation(expr);
+    llvm::Value* slot = builder.CreateCall(lookup, {dict, key}, "slot");
+    if (insert) return slot;
+
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* missingBB = llvm::BasicBlock::Create(context, "dict.missing", func);
+    llvm::BasicBlock* foundBB = llvm::BasicBlock::Create(context, "dict.found", func);
+    builder.CreateCondBr(builder.CreateIsNull(slot), missingBB, foundBB,
+                         llvm::MDBuilder(context).createBranchWeights(1, 1000));
+    builder.SetInsertPoint(missingBB);
+    auto missing = getRuntimeFunction("__pynext_dict_missing_key", llvm::Type::getVoidTy(context), {});
+    if (auto* decl = llvm::dyn_cast<llvm::Function>(missing.getCallee())) {
+        decl->setDoesNotReturn();
+        decl->addFnAttr(llvm::Attribute::Cold);
+    }
+    builder.CreateCall(missing);
+    builder.CreateUnreachable();
+    builder.SetInsertPoint(foundBB);
+    return slot;
+}
+
+// The runtime entry point family for sort keys of this type: see runtime/Sort.h
+static const char* sortKeyFamily(const Type* keyType) {
+    if (!keyType) return nullptr;
+    switch (keyType->kind) {
+    case TypeKind::Int: return static_cast<const IntType*>(keyType)->bits == 64 ? "int" : nullptr;
+    case TypeKind::Float: return static_cast<const FloatType*>(keyType)->bits == 64 ? "float" : nullptr;
+    case TypeKind::Bool: return "bool";
+    case TypeKind::String: return "string";
+    default: return nullptr;
+    }
+}
+
+// sort(a) passes the elements; sort_by(a, field) also where the field is in
+// each element and how far apart elements are
+llvm::Value* CodeGen::emitSort(CallExpr& expr) {
+    bool byField = expr.callee == "sort_by";
+    Type* objectType = expr.args.size() == (byField ? 2u : 1u) ? expr.args[0]->type.get() : nullptr;
+    auto* arrayType = objectType && objectType->kind == TypeKind::Array ? static_cast<ArrayType*>(objectType) : nullptr;
+    const Type* keyType = !arrayType ? nullptr : byField ? expr.args[1]->type.get() : arrayType->elementType.get();
+    auto structInfo = arrayType ? std::dynamic_pointer_cast<pynext::StructType>(arrayType->elementType) : nullptr;
+    llvm::StructType* structTy = structInfo ? structTypes.lookup(structInfo->name) : nullptr;
+    int field = structTy && expr.args[1]->kind == NodeKind::Variable
+                    ? structInfo->getMemberIndex(static_cast<VariableExpr&>(*expr.args[1]).name)
+                    : -1;
+    const char* family = sortKeyFamily(keyType);
+    if (!family || (byField && field < 0)) {
+        std::cerr << "Invalid arguments to " << expr.callee << "\n";
+        return nullptr;
+    }
+    llvm::Value* data = visitExpr(*expr.args[0]);
+    if (!data) return nullptr;
+    llvm::Value* sizePtr = builder.CreateGEP(builder.getInt8Ty(), data, builder.getInt64(-8), "sizePtr");
+    llvm::Value* count = builder.CreateLoad(builder.getInt64Ty(), sizePtr, "arraysize");
+
+    llvm::Type* ptrTy = llvm::PointerType::get(context, 0);
+    llvm::Type* voidTy = llvm::Type::getVoidTy(context);
+    std::string name = std::string(byField ? "__pynext_sort_by_" : "__pynext_sort_") + family;
+    emitDebugLocation(expr);
+    if (!byField) {
+        auto sort = getRuntimeFunction(name.c_str(), voidTy, {ptrTy, builder.getInt64Ty()});
+        return builder.CreateCall(sort, {data, count});
+    }
+    llvm::DataLayout dl = dataLayout();
+    uint64_t stride = dl.getTypeAllocSize(structTy);
+    uint64_t offset = dl.getStructLayout(structTy)->getElementOffset(field);
+    auto sortBy = getRuntimeFunction(name.c_str(), voidTy,
+                                     {ptrTy, builder.getInt64Ty(), builder.getInt64Ty(), builder.getInt64Ty()});
+    return builder.CreateCall(sortBy, {data, count, builder.getInt64(stride), builder.getInt64(offset)});
+}
+
+// open(path), parse_int(s) and parse_float(s): see runtime/File.h
+llvm::Value* CodeGen::emitStringBuiltin(CallExpr& expr) {
+    if (expr.args.size() != 1 || !expr.args[0]->type || expr.args[0]->type->kind != TypeKind::String) {
+        std::cerr << "Invalid arguments to " << expr.callee << "\n";
+        return nullptr;
+    }
+    llvm::Value* text = visitExpr(*expr.args[0]);
+    if (!text) return nullptr;
+    llvm::Type* ptrTy = llvm::PointerType::get(context, 0);
+    emitDebugLocation(expr);
+    if (expr.callee == "open") {
+        int site = -1;
+        if (options.trackAllocations) {
+            site = allocationSites.size();
+            allocationSites.push_back({currentFunction, "file", currentLine});
+        }
+        auto open = getRuntimeFunction("__pynext_file_open", ptrTy, {ptrTy, builder.getInt32Ty()});
+        return builder.CreateCall(open, {text, builder.getInt32(site)}, "file");
+    }
+    if (expr.callee == "parse_int") {
+        auto parse = getRuntimeFunction("__pynext_parse_int", builder.getInt64Ty(), {ptrTy});
+        return builder.CreateCall(parse, {text}, "parsed");
+    }
+    auto parse = getRuntimeFunction("__pynext_parse_float", builder.getDoubleTy(), {ptrTy});
+    return builder.CreateCall(parse, {text}, "parsed");
+}
+
+// The builtins TypeChecker::checkBuiltin accepts
+llvm::Value* CodeGen::emitBuiltin(CallExpr& expr) {
+    if (auto target = numericType(expr.callee)) {
+        const Type* from = expr.args.size() == 1 ? expr.args[0]->type.get() : nullptr;
+        if (!isNumeric(from) && !(from && from->kind == TypeKind::Bool)) {
+            std::cerr << "Invalid arguments to " << expr.callee << "\n";
+            return nullptr;
+        }
+        llvm::Value* value = visitExpr(*expr.args[0]);
+        if (!value) return nullptr;
+        bool toSigned = target->kind != TypeKind::Int || static_cast<IntType&>(*target).isSigned;
+        return emitConversion(value, from, valueType(target.get()), toSigned);
+    }
+    if (expr.callee == "sort" || expr.callee == "sort_by") return emitSort(expr);
+    if (expr.callee == "open" || expr.callee == "parse_int" || expr.callee == "parse_float") {
+        return emitStringBuiltin(expr);
+    }
+    if (expr.callee == "lines") {
+        std::cerr << "lines() outside a for loop\n";
+        return nullptr;
+    }
+    size_t arity = expr.callee == "len" ? 1 : 2;
+    Type* objectType = expr.args.size() == arity ? expr.args[0]->type.get() : nullptr;
+    bool valid = objectType && (objectType->kind == TypeKind::Dict ||
+                                (objectType->kind == TypeKind::Array && expr.callee == "len"));
+    if (valid && arity == 2) {
+        valid = expr.args[1]->type && expr.args[1]->type->kind == static_cast<DictType*>(objectType)->keyType->kind;
+    }
+    if (!valid) {
+        std::cerr << "Invalid arguments to " << expr.callee << "\n";
+        return nullptr;
+    }
+    llvm::Value* object = visitExpr(*expr.args[0]);
+    if (!object) return nullptr;
+    llvm::Type* ptrTy = llvm::PointerType::get(context, 0);
+
+    if (expr.callee == "len" && objectType->kind == TypeKind::Array) {
+        // The element count is stored just before the first element
+        llvm::Value* sizePtr = builder.CreateGEP(builder.getInt8Ty(), object, builder.getInt64(-8), "sizePtr");
+        return builder.CreateLoad(builder.getInt64Ty(), sizePtr, "arraysize");
+    }
+    if (expr.callee == "len") {
+        auto dictLen = getRuntimeFunction("__pynext_dict_len", builder.getInt64Ty(), {ptrTy});
+        return builder.CreateCall(dictLen, {object}, "dictsize");
+    }
+
+    auto& type = static_cast<DictType&>(*objectType);
+    llvm::Value* key = visitExpr(*expr.args[1]);
+    if (!key) return nullptr;
+    key = emitDictKey(key, expr.args[1]->type.get(), *type.keyType);
+    llvm::Type* keyTy = type.keyType->kind == TypeKind::String ? ptrTy : builder.getInt64Ty();
+    if (key->getType() != keyTy) return nullptr; // A key type sema rejected
+    emitDebugLocation(expr);
+    if (expr.callee == "contains") {
+        auto find = getRuntimeFunction(dictEntryPoint(type, DictOp::Find), ptrTy, {ptrTy, keyTy});
+        return builder.CreateIsNotNull(builder.CreateCall(find, {object, key}, "slot"), "contains");
+    }
+    auto erase = getRuntimeFunction(dictEntryPoint(type, DictOp::Erase), builder.getInt1Ty(), {ptrTy, keyTy});
+    return builder.CreateCall(erase, {object, key}, "removed");
+}
+
 llvm::AllocaInst* CodeGen::createEntryBlockAlloca(llvm::Function* fun, const std::string& varName, llvm::Type* type) {
     llvm::IRBuilder<> tmpB(&fun->getEntryBlock(), fun->getEntryBlock().begin());
     return tmpB.CreateAlloca(type, nullptr, varName);
 }
 
-void CodeGen::visit(LiteralExpr& expr) {
+llvm::Value* CodeGen::visit(LiteralExpr& expr) {
     if (expr.isBool) {
-        lastValue = llvm::ConstantInt::get(context, llvm::APInt(1, expr.value == "true" ? 1 : 0));
+        return llvm::ConstantInt::get(context, llvm::APInt(1, expr.value == "true" ? 1 : 0));
     } else if (expr.isString) {
-        lastValue = builder.CreateGlobalStringPtr(expr.value);
-    } else if (expr.isFloat) {
-        lastValue = llvm::ConstantFP::get(context, llvm::APFloat(std::stod(expr.value)));
-    } else {
-        lastValue = llvm::ConstantInt::get(context, llvm::APInt(64, std::stoll(expr.value), true));
+        return builder.CreateGlobalStringPtr(expr.value);
+    }
+    // Sema may have given a number literal a narrower or float type
+    llvm::Type* type = valueType(expr.type.get());
+    if (expr.isFloat || type->isFloatingPointTy()) {
+        return llvm::ConstantFP::get(type->isFloatingPointTy() ? type : builder.getDoubleTy(), std::stod(expr.value));
     }
+    return llvm::ConstantInt::get(type, std::stoull(expr.value));
 }
 
-void CodeGen::visit(VariableExpr& expr) {
-    llvm::AllocaInst* alloca = namedValues[expr.name];
+llvm::Value* CodeGen::visit(VariableExpr& expr) {
+    auto it = namedValues.find(expr.name);
+    llvm::AllocaInst* alloca = it != namedValues.end() ? it->second : nullptr;
     if (!alloca) {
+        if (llvm::GlobalVariable* global = getGlobalVariable(expr.name)) {
+            return builder.CreateLoad(global->getValueType(), global, expr.name.c_str());
+        }
         std::cerr << "Unknown variable name: " << expr.name << "\n";
-        lastValue = nullptr;
-        return;
+        return nullptr;
     }
-    lastValue = builder.CreateLoad(alloca->getAllocatedType(), alloca, expr.name.c_str());
+    return builder.CreateLoad(alloca->getAllocatedType(), alloca, expr.name.c_str());
 }
 
-void CodeGen::visit(BinaryExpr& expr) {
+// d[k] = v, or d[k].field = v
+static bool storesIntoDict(const Expr& target) {
+    const Expr* expr = &target;
+    while (expr->kind == NodeKind::MemberAccess) expr = static_cast<const MemberAccessExpr*>(expr)->object.get();
+    if (expr->kind != NodeKind::Index) return false;
+    const Expr& object = *static_cast<const IndexExpr*>(expr)->object;
+    return object.type && object.type->kind == TypeKind::Dict;
+}
+
+llvm::Value* CodeGen::visit(BinaryExpr& expr) {
     // Special handling for Assignment
     if (expr.op == "=") {
-        llvm::Value* lvalAddr = getLValueAddress(expr.left.get());
+        // A dict slot moves when the dict grows, so the value is computed
+        // before the key is inserted
+        llvm::Value* val = storesIntoDict(*expr.left) ? visitExpr(*expr.right) : nullptr;
+        llvm::Value* lvalAddr = getLValueAddress(expr.left.get(), true);
         if (!lvalAddr) {
             std::cerr << "Error: Invalid l-value in assignment\n";
-            lastValue = nullptr;
-            return;
+            return nullptr;
         }
 
         // Generate RHS
-        expr.right->accept(*this);
-        llvm::Value* val = lastValue;
-        if (!val) return;
+        if (!val) val = visitExpr(*expr.right);
+        if (!val) return nullptr;
+        if (isNumeric(expr.left->type.get())) {
+            val = emitConversion(val, expr.right->type.get(), valueType(expr.left->type.get()));
+        }
 
         builder.CreateStore(val, lvalAddr);
         // Assignment result is the value
-        lastValue = val;
-        return;
+        return val;
     }
 
-    expr.left->accept(*this);
-    llvm::Value* l = lastValue;
-    expr.right->accept(*this);
-    llvm::Value* r = lastValue;
+    llvm::Value* l = visitExpr(*expr.left);
+    llvm::Value* r = visitExpr(*expr.right);
 
     if (!l || !r) {
-        lastValue = nullptr;
-        return;
+        return nullptr;
     }
 
-    if (expr.op == "+") lastValue = builder.CreateAdd(l, r, "addtmp");
-    else if (expr.op == "-") lastValue = builder.CreateSub(l, r, "subtmp");
-    else if (expr.op == "*") lastValue = builder.CreateMul(l, r, "multmp");
-    else if (expr.op == "/") lastValue = builder.CreateSDiv(l, r, "divtmp"); // Signed div
-    else if (expr.op == "<") {
-        lastValue = builder.CreateICmpSLT(l, r, "cmptmp");
-        // Convert bool to int 0/1 if needed or keep as i1
-        // Usually logical ops return i1 in LLVM
+    // Numbers convert to the type sema chose for both operands
+    bool isSigned = true;
+    if (auto common = promote(expr.left->type, expr.right->type)) {
+        llvm::Type* type = valueType(common.get());
+        l = emitConversion(l, expr.left->type.get(), type);
+        r = emitConversion(r, expr.right->type.get(), type);
+        isSigned = common->kind != TypeKind::Int || static_cast<IntType&>(*common).isSigned;
+    }
+    if (l->getType() != r->getType()) {
+        std::cerr << "Operands of '" << expr.op << "' have different types\n";
+        return nullptr;
     }
-    else if (expr.op == ">") lastValue = builder.CreateICmpSGT(l, r, "cmptmp");
-    else if (expr.op == "==") lastValue = builder.CreateICmpEQ(l, r, "cmptmp");
-    else if (expr.op == "!=") lastValue = builder.CreateICmpNE(l, r, "cmptmp");
-    else {
+    if (l->getType()->isAggregateType()) {
+        std::cerr << "Operator '" << expr.op << "' does not apply to structs and enums\n";
+        return nullptr;
+    }
+
+    if (l->getType()->isFloatingPointTy()) {
+        if (expr.op == "+") return builder.CreateFAdd(l, r, "addtmp");
+        if (expr.op == "-") return builder.CreateFSub(l, r, "subtmp");
+        if (expr.op == "*") return builder.CreateFMul(l, r, "multmp");
+        if (expr.op == "/") return builder.CreateFDiv(l, r, "divtmp");
+        if (expr.op == "<") return builder.CreateFCmpOLT(l, r, "cmptmp");
+        if (expr.op == ">") return builder.CreateFCmpOGT(l, r, "cmptmp");
+        if (expr.op == "==") return builder.CreateFCmpOEQ(l, r, "cmptmp");
+        if (expr.op == "!=") return builder.CreateFCmpONE(l, r, "cmptmp");
         std::cerr << "Unknown operator: " << expr.op << "\n";
-        lastValue = nullptr;
+        return nullptr;
     }
+
+    if (expr.op == "+") return builder.CreateAdd(l, r, "addtmp");
+    if (expr.op == "-") return builder.CreateSub(l, r, "subtmp");
+    if (expr.op == "*") return builder.CreateMul(l, r, "multmp");
+    if (expr.op == "/") return isSigned ? builder.CreateSDiv(l, r, "divtmp") : builder.CreateUDiv(l, r, "divtmp");
+    // Comparisons stay i1, as usual for logical ops in LLVM
+    if (expr.op == "<") return isSigned ? builder.CreateICmpSLT(l, r, "cmptmp") : builder.CreateICmpULT(l, r, "cmptmp");
+    if (expr.op == ">") return isSigned ? builder.CreateICmpSGT(l, r, "cmptmp") : builder.CreateICmpUGT(l, r, "cmptmp");
+    if (expr.op == "==") return builder.CreateICmpEQ(l, r, "cmptmp");
+    if (expr.op == "!=") return builder.CreateICmpNE(l, r, "cmptmp");
+    std::cerr << "Unknown operator: " << expr.op << "\n";
+    return nullptr;
 }
 
-void CodeGen::visit(CallExpr& expr) {
-    llvm::Function* callee = module->getFunction(expr.callee);
+llvm::Value* CodeGen::visit(CallExpr& expr) {
+    llvm::Function* callee = getFunction(expr.callee);
+    if (!callee && expr.namesBuiltin()) {
+        return emitBuiltin(expr);
+    }
+    size_t dot = expr.callee.find('.');
+    if (!callee && dot != std::string::npos && expr.type && expr.type->kind == TypeKind::Enum) {
+        return emitEnumValue(static_cast<EnumType&>(*expr.type), expr.callee.substr(dot + 1), expr.args);
+    }
     if (!callee) {
         std::cerr << "Unknown function referenced: " << expr.callee << "\n";
-        lastValue = nullptr;
-        return;
+        return nullptr;
     }
 
     if (callee->arg_size() != expr.args.size()) {
         std::cerr << "Incorrect # arguments passed\n";
-        lastValue = nullptr;
-        return;
+        return nullptr;
     }
 
     std::vector<llvm::Value*> argsV;
     for (auto& arg : expr.args) {
-        arg->accept(*this);
-        if (!lastValue) return;
-        argsV.push_back(lastValue);
+        llvm::Value* argV = visitExpr(*arg);
+        if (!argV) return nullptr;
+        argsV.push_back(emitConversion(argV, arg->type.get(), callee->getArg(argsV.size())->getType()));
     }
 
-    lastValue = builder.CreateCall(callee, argsV, "calltmp");
+    // Void calls cannot carry a value name
+    emitDebugLocation(expr);
+    return builder.CreateCall(callee, argsV, callee->getReturnType()->isVoidTy() ? "" : "calltmp");
 }
 
 void CodeGen::visit(ReturnStmt& stmt) {
-    if (stmt.value) {
-        stmt.value->accept(*this);
-    }
-    llvm::Value* retVal = lastValue; // nullable
-    
-    // Identify if we are returning a cleanup-tracked variable
-    // If so, we must NOT free it (Move semantics)
-    llvm::Value* returnedAlloca = nullptr;
-    if (stmt.value) {
-        if (auto varExpr = dynamic_cast<VariableExpr*>(stmt.value.get())) {
-             if (namedValues.count(varExpr->name)) {
-                 returnedAlloca = namedValues[varExpr->name];
-             }
-        }
-    }
-
-    // Cleanup all scopes from top to function-level (excluding Global which is index 0)
-    // We assume 0 is global.
-    for (int i = scopeStack.size() - 1; i >= 1; --i) {
-        auto& cleanupList = scopeStack[i];
-        for (auto& item : cleanupList) {
-            llvm::Value* allocaInst = item.first;
-            bool isArray = item.second;
-            
-            // Skip if this is the variable being returned
-            if (allocaInst == returnedAlloca) continue;
-            
-            if (isArray) {
-                llvm::Value* dataPtr = builder.CreateLoad(llvm::PointerType::get(context, 0), allocaInst);
-                // Free(ptr - 8)
-                llvm::Value* neg8 = llvm::ConstantInt::get(context, llvm::APInt(64, -8, true));
-                llvm::Value* rawPtr = builder.CreateGEP(llvm::Type::getInt8Ty(context), dataPtr, neg8, "rawPtr");
-                
-                llvm::Function* freeFunc = module->getFunction("free");
-                if (!freeFunc) {
-                    std::vector<llvm::Type*> args = { llvm::PointerType::get(context, 0) };
-                    llvm::FunctionType* ft = llvm::FunctionType::get(llvm::Type::getVoidTy(context), args, false);
-                    freeFunc = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "free", module.get());
-                }
-                builder.CreateCall(freeFunc, {rawPtr});
-            }
+    llvm::Value* retVal = stmt.value ? visitExpr(*stmt.value) : nullptr; // nullable
+    if (retVal) {
+        llvm::Type* retTy = builder.GetInsertBlock()->getParent()->getReturnType();
+        if (!retTy->isVoidTy()) retVal = emitConversion(retVal, stmt.value->type.get(), retTy);
+    }
+
+    // Returning an array or dict variable moves it to the caller (it must
+    // NOT be freed): clearing the variable makes its cleanup skip the free
+    if (stmt.value && stmt.value->kind == NodeKind::Variable) {
+        llvm::AllocaInst* alloca = namedValues.lookup(static_cast<VariableExpr&>(*stmt.value).name);
+        for (int node = cleanups.current; alloca && node >= 0; node = cleanups.nodes[node].next) {
+            if (cleanups.nodes[node].variable != alloca) continue;
+            builder.CreateStore(llvm::Constant::getNullValue(alloca->getAllocatedType()), alloca);
+            if (!llvm::is_contained(cleanups.returnedVariables, alloca)) cleanups.returnedVariables.push_back(alloca);
+            break;
         }
     }
 
-    if (retVal) {
-        builder.CreateRet(retVal);
+    emitReturnBranch(retVal, &stmt);
+}
+
+void CodeGen::beginCleanups() {
+    cleanups = FunctionCleanups();
+    cleanups.returnBlock = llvm::BasicBlock::Create(context, "return");
+}
+
+llvm::BasicBlock* CodeGen::cleanupBlock(int node, const ASTNode& origin) {
+    if (node < 0) return cleanups.returnBlock;
+    CleanupNode& cleanup = cleanups.nodes[node];
+    if (!cleanup.block) {
+        cleanup.block = llvm::BasicBlock::Create(context, "cleanup");
+        cleanup.origin = &origin;
+    }
+    return cleanup.block;
+}
+
+// `origin` is null when the entry function falls off its end. With no array
+// live there is nothing to share, so the return is emitted in place.
+void CodeGen::emitReturnBranch(llvm::Value* value, const ASTNode* origin) {
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+    if (cleanups.current < 0) {
+        emitFunctionExitHook();
+        if (value) {
+            builder.CreateRet(value);
+        } else {
+            builder.CreateRetVoid();
+        }
+        return;
+    }
+
+    llvm::Type* retTy = func->getReturnType();
+    if (value && !retTy->isVoidTy()) {
+        if (!cleanups.returnSlot) cleanups.returnSlot = createEntryBlockAlloca(func, "retval", retTy);
+        builder.CreateStore(value, cleanups.returnSlot);
+    }
+    emitLoopExitHooks();
+    if (!cleanups.firstReturn) cleanups.firstReturn = origin;
+    builder.CreateBr(cleanupBlock(cleanups.current, *origin));
+}
+
+// A function body that falls off its end returns through the same cleanup
+// chain as its `return` statements
+void CodeGen::emitFallthroughReturn(const Block& body) {
+    llvm::Type* retTy = builder.GetInsertBlock()->getParent()->getReturnType();
+    if (retTy->isVoidTy()) {
+        emitReturnBranch(nullptr, &body);
+    } else if (retTy->isIntegerTy()) {
+        // For non-void, returning 0/undef is better than crashing
+        // But ideally we should sema check this.
+        emitReturnBranch(llvm::ConstantInt::get(context, llvm::APInt(retTy->getIntegerBitWidth(), 0)), &body);
     } else {
+        emitReturnBranch(llvm::UndefValue::get(retTy), &body);
+    }
+}
+
+// Emits the cleanup blocks that returns branched to, newest first, and the
+// return block they lead to
+void CodeGen::finishCleanups(llvm::Function* func) {
+    std::vector<llvm::BasicBlock*> emitted;
+    for (int i = (int)cleanups.nodes.size() - 1; i >= 0; --i) {
+        CleanupNode& cleanup = cleanups.nodes[i];
+        llvm::BasicBlock* block = cleanup.block;
+        if (!block) continue;
+        emitted.push_back(block);
+        func->insert(func->end(), block);
+        builder.SetInsertPoint(block);
+        emitDebugLocation(*cleanup.origin);
+        llvm::BasicBlock* next = cleanupBlock(cleanup.next, *cleanup.origin);
+
+        llvm::Value* dataPtr = builder.CreateLoad(llvm::PointerType::get(context, 0), cleanup.variable);
+        if (llvm::is_contained(cleanups.returnedVariables, cleanup.variable)) {
+            llvm::BasicBlock* freeBB = llvm::BasicBlock::Create(context, "cleanup.free", func);
+            builder.CreateCondBr(builder.CreateIsNull(dataPtr), next, freeBB);
+            builder.SetInsertPoint(freeBB);
+        }
+        // Named after the first exit through it: a return, or the end of the body
+        const char* kind = cleanup.origin->kind == NodeKind::Block ? "scope exit" : "return";
+        emitRelease(dataPtr, cleanup.kind, kind, cleanup.origin->line);
+        builder.CreateBr(next);
+    }
+
+    llvm::BasicBlock* returnBB = cleanups.returnBlock;
+    if (!cleanups.firstReturn) {
+        delete returnBB; // No return went through a cleanup
+        return;
+    }
+    func->insert(func->end(), returnBB);
+    builder.SetInsertPoint(returnBB);
+    emitDebugLocation(*cleanups.firstReturn);
+    emitFunctionExitHook();
+    llvm::Type* retTy = func->getReturnType();
+    if (retTy->isVoidTy()) {
         builder.CreateRetVoid();
+    } else if (cleanups.returnSlot) {
+        builder.CreateRet(builder.CreateLoad(retTy, cleanups.returnSlot, "retval"));
+    } else {
+        builder.CreateRet(llvm::UndefValue::get(retTy));
+    }
+
+    // A cleanup reached from a single place is merged into it, so a chain
+    // only one return uses costs no extra branches
+    emitted.push_back(returnBB);
+    for (llvm::BasicBlock* block : emitted) {
+        llvm::MergeBlockIntoPredecessor(block);
     }
 }
 
 void CodeGen::visit(Block& stmt) {
     scopeStack.push_back({});
+    int cleanupsAtEntry = cleanups.current;
     for (const auto& s : stmt.statements) {
-        s->accept(*this);
+        currentLine = s->line;
+        emitDebugLocation(*s);
+        visitStmt(*s);
+    }
+    if (&stmt == cleanups.body && !builder.GetInsertBlock()->getTerminator()) {
+        emitFallthroughReturn(stmt);
     }
     
-    // Cleanup Scope
+    // Cleanup Scope (a return inside the block has already freed everything)
     auto& cleanupList = scopeStack.back();
+    bool terminated = builder.GetInsertBlock()->getTerminator() != nullptr;
     for (auto& item : cleanupList) {
+        if (terminated) break;
         llvm::Value* allocaInst = item.first;
-        bool isArray = item.second;
-        
-        if (isArray) {
-            // Load the pointer from alloca
-            llvm::Value* dataPtr = builder.CreateLoad(llvm::PointerType::get(context, 0), allocaInst);
-            
-            // Check if null (optional, safety)
-            // For now assume non-null if initialized.
-            
-            // The pointer points to Data (+8). We need Free(-8).
-            llvm::Value* neg8 = llvm::ConstantInt::get(context, llvm::APInt(64, -8, true));
-            llvm::Value* rawPtr = builder.CreateGEP(llvm::Type::getInt8Ty(context), dataPtr, neg8, "rawPtr");
-            
-            // Call free(rawPtr)
-            llvm::Function* freeFunc = module->getFunction("free");
-            if (!freeFunc) {
-                std::vector<llvm::Type*> args = { llvm::PointerType::get(context, 0) };
-                llvm::FunctionType* ft = llvm::FunctionType::get(llvm::Type::getVoidTy(context), args, false);
-                freeFunc = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "free", module.get());
-            }
-            builder.CreateCall(freeFunc, {rawPtr});
-        }
+
+        // Load the pointer from alloca
+        llvm::Value* dataPtr = builder.CreateLoad(llvm::PointerType::get(context, 0), allocaInst);
+
+        // Check if null (optional, safety)
+        // For now assume non-null if initialized.
+        emitRelease(dataPtr, item.second, "scope exit", stmt.line);
     }
     scopeStack.pop_back();
+    cleanups.current = cleanupsAtEntry;
 }
 
 void CodeGen::visit(IfStmt& stmt) {
-    stmt.condition->accept(*this);
-    if (!lastValue) return;
-    
-    llvm::Value* condV = lastValue;
+    llvm::Value* condV = visitExpr(*stmt.condition);
+    if (!condV) return;
+
     // Ensure condition is boolean i1
-    if (condV->getType()->isIntegerTy(64)) {
-        condV = builder.CreateICmpNE(condV, llvm::ConstantInt::get(context, llvm::APInt(64, 0)), "ifcond");
+    if (condV->getType()->isIntegerTy() && !condV->getType()->isIntegerTy(1)) {
+        condV = builder.CreateICmpNE(condV, llvm::Constant::getNullValue(condV->getType()), "ifcond");
     }
 
     llvm::Function* func = builder.GetInsertBlock()->getParent();
@@ -271,7 +1207,7 @@ void CodeGen::visit(IfStmt& stmt) {
 
     // Emit Then
     builder.SetInsertPoint(thenBB);
-    stmt.thenBranch->accept(*this);
+    visit(*stmt.thenBranch);
     
     // Check if the block already has a terminator (like return)
     if (!builder.GetInsertBlock()->getTerminator()) {
@@ -282,7 +1218,7 @@ void CodeGen::visit(IfStmt& stmt) {
     if (hasElse) {
         func->insert(func->end(), elseBB);
         builder.SetInsertPoint(elseBB);
-        stmt.elseBranch->accept(*this);
+        visit(*stmt.elseBranch);
         if (!builder.GetInsertBlock()->getTerminator()) {
             builder.CreateBr(mergeBB);
         }
@@ -302,16 +1238,16 @@ void CodeGen::visit(WhileStmt& stmt) {
     llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(context, "afterwhile");
 
     // 2. Jump to Condition
+    beginLoopCounter("while loop", stmt.line);
     builder.CreateBr(condBB);
 
     // 3. Emit Condition
     builder.SetInsertPoint(condBB);
-    stmt.condition->accept(*this);
-    if (!lastValue) return;
+    llvm::Value* condV = visitExpr(*stmt.condition);
+    if (!condV) return;
 
-    llvm::Value* condV = lastValue;
-    if (condV->getType()->isIntegerTy(64)) {
-        condV = builder.CreateICmpNE(condV, llvm::ConstantInt::get(context, llvm::APInt(64, 0)), "loopcond");
+    if (condV->getType()->isIntegerTy() && !condV->getType()->isIntegerTy(1)) {
+        condV = builder.CreateICmpNE(condV, llvm::Constant::getNullValue(condV->getType()), "loopcond");
     }
 
     builder.CreateCondBr(condV, loopBB, afterBB);
@@ -319,8 +1255,9 @@ void CodeGen::visit(WhileStmt& stmt) {
     // 4. Emit Loop Body
     func->insert(func->end(), loopBB);
     builder.SetInsertPoint(loopBB);
+    countLoopTrip();
     
-    stmt.body->accept(*this);
+    visit(*stmt.body);
     
     // Jump back to condition if no terminator (fix flow)
     if (!builder.GetInsertBlock()->getTerminator()) {
@@ -330,14 +1267,66 @@ void CodeGen::visit(WhileStmt& stmt) {
     // 5. Continue
     func->insert(func->end(), afterBB);
     builder.SetInsertPoint(afterBB);
+    endLoopCounter();
+}
+
+// for line in lines(f): asks the runtime for lines until it returns null
+void CodeGen::emitLinesLoop(ForStmt& stmt, CallExpr& call) {
+    if (call.args.size() != 1 || !call.args[0]->type || call.args[0]->type->kind != TypeKind::File) {
+        std::cerr << "Invalid arguments to lines\n";
+        return;
+    }
+    llvm::Value* file = visitExpr(*call.args[0]);
+    if (!file) return;
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+    llvm::Type* ptrTy = llvm::PointerType::get(context, 0);
+    auto nextLine = getRuntimeFunction("__pynext_file_next_line", ptrTy, {ptrTy});
+
+    llvm::BasicBlock* condBB = llvm::BasicBlock::Create(context, "linescond", func);
+    llvm::BasicBlock* bodyBB = llvm::BasicBlock::Create(context, "linesbody");
+    llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(context, "afterlines");
+    llvm::AllocaInst* varAlloca = createEntryBlockAlloca(func, stmt.variable, ptrTy);
+
+    beginLoopCounter("for loop", stmt.line);
+    builder.CreateBr(condBB);
+
+    builder.SetInsertPoint(condBB);
+    llvm::Value* line = builder.CreateCall(nextLine, {file}, "line");
+    builder.CreateCondBr(builder.CreateIsNull(line), afterBB, bodyBB);
+
+    func->insert(func->end(), bodyBB);
+    builder.SetInsertPoint(bodyBB);
+    countLoopTrip();
+    builder.CreateStore(line, varAlloca);
+    declareDebugVariable(varAlloca, stmt.variable, "string", stmt);
+
+    llvm::AllocaInst* oldVal = namedValues.lookup(stmt.variable);
+    namedValues[stmt.variable] = varAlloca;
+    visit(*stmt.body);
+    if (oldVal) namedValues[stmt.variable] = oldVal;
+    else namedValues.erase(stmt.variable);
+
+    if (!builder.GetInsertBlock()->getTerminator()) {
+        builder.CreateBr(condBB);
+    }
+
+    func->insert(func->end(), afterBB);
+    builder.SetInsertPoint(afterBB);
+    endLoopCounter();
 }
 
 void CodeGen::visit(ForStmt& stmt) {
+    // lines(f) unless a function named lines hides the builtin
+    auto* call = stmt.iterator->kind == NodeKind::Call ? static_cast<CallExpr*>(stmt.iterator.get()) : nullptr;
+    if (call && call->callee == "lines" && !getFunction("lines")) {
+        emitLinesLoop(stmt, *call);
+        return;
+    }
+
     llvm::Function* func = builder.GetInsertBlock()->getParent();
 
     // 1. Evaluate Array
-    stmt.iterator->accept(*this);
-    llvm::Value* arrayPtr = lastValue;
+    llvm::Value* arrayPtr = visitExpr(*stmt.iterator);
     if (!arrayPtr) return;
 
     // 2. Get Size (stored at -8 bytes)
@@ -356,6 +1345,7 @@ void CodeGen::visit(ForStmt& stmt) {
     llvm::AllocaInst* idxAlloca = createEntryBlockAlloca(func, "idx", llvm::Type::getInt64Ty(context));
     builder.CreateStore(llvm::ConstantInt::get(context, llvm::APInt(64, 0)), idxAlloca);
 
+    beginLoopCounter("for loop", stmt.line);
     builder.CreateBr(condBB);
 
     // 4. Condition
@@ -367,17 +1357,12 @@ void CodeGen::visit(ForStmt& stmt) {
     // 5. Body
     func->insert(func->end(), bodyBB);
     builder.SetInsertPoint(bodyBB);
+    countLoopTrip();
 
     // Get Element Type
     llvm::Type* elemType = llvm::Type::getInt64Ty(context); 
     if (auto arrT = std::dynamic_pointer_cast<pynext::ArrayType>(stmt.iterator->type)) {
-         auto et = arrT->elementType;
-         if (et->kind == TypeKind::Int) elemType = llvm::Type::getInt64Ty(context);
-         else if (et->kind == TypeKind::Float) elemType = llvm::Type::getDoubleTy(context);
-         else if (et->kind == TypeKind::Bool) elemType = llvm::Type::getInt1Ty(context);
-         else if (auto st = std::dynamic_pointer_cast<pynext::StructType>(et)) {
-             if (structTypes.count(st->name)) elemType = structTypes[st->name];
-         }
+        elemType = valueType(arrT->elementType.get());
     }
 
     llvm::Value* elemAddr = builder.CreateGEP(elemType, arrayPtr, currIdx, "elemaddr");
@@ -385,11 +1370,14 @@ void CodeGen::visit(ForStmt& stmt) {
 
     llvm::AllocaInst* varAlloca = createEntryBlockAlloca(func, stmt.variable, elemType);
     builder.CreateStore(elemVal, varAlloca);
+    if (auto arrT = std::dynamic_pointer_cast<pynext::ArrayType>(stmt.iterator->type)) {
+        declareDebugVariable(varAlloca, stmt.variable, typeNameOf(arrT->elementType), stmt);
+    }
 
-    llvm::AllocaInst* oldVal = namedValues[stmt.variable];
+    llvm::AllocaInst* oldVal = namedValues.lookup(stmt.variable);
     namedValues[stmt.variable] = varAlloca;
 
-    stmt.body->accept(*this);
+    visit(*stmt.body);
 
     if (oldVal) namedValues[stmt.variable] = oldVal;
     else namedValues.erase(stmt.variable);
@@ -409,15 +1397,26 @@ void CodeGen::visit(ForStmt& stmt) {
     // 7. After
     func->insert(func->end(), afterBB);
     builder.SetInsertPoint(afterBB);
+    endLoopCounter();
 }
 
 void CodeGen::visit(VarDeclStmt& stmt) {
     llvm::Function* func = builder.GetInsertBlock()->getParent();
+    bool topLevel = scopeStack.size() == 1;
     
     llvm::Value* initVal = nullptr;
-    if (stmt.initializer) {
-        stmt.initializer->accept(*this);
-        initVal = lastValue; 
+    if (topLevel && stmt.initializer && stmt.initializer->kind == NodeKind::ArrayLiteral &&
+        staticArrays.count(stmt.name)) {
+        initVal = emitStaticArray(static_cast<ArrayLiteralExpr&>(*stmt.initializer), stmt.name);
+    }
+    if (stmt.initializer && !initVal) {
+        initVal = visitExpr(*stmt.initializer);
+    }
+    if (initVal && isNumeric(stmt.type.get())) {
+        initVal = emitConversion(initVal, stmt.initializer->type.get(), valueType(stmt.type.get()));
+    }
+    if (!stmt.initializer && stmt.type && stmt.type->kind == TypeKind::Dict) {
+        initVal = emitDictNew(static_cast<DictType&>(*stmt.type)); // Starts empty
     }
     
     llvm::Type* varType = nullptr;
@@ -430,6 +1429,25 @@ void CodeGen::visit(VarDeclStmt& stmt) {
         return;
     }
     
+    if (topLevel && (stmt.global || options.topLevelGlobals)) {
+        GlobalInfo& info = globalVariables[stmt.name];
+        auto* constant = llvm::dyn_cast_or_null<llvm::Constant>(initVal);
+        if (constant && constant->getType() != varType) constant = nullptr;
+        if (info.type != varType) {
+            info.symbol = "global." + stmt.name;
+            if (info.type) info.symbol += "." + std::to_string(++globalRedefinitions);
+            info.type = varType;
+            // Later REPL chunks link against it by name
+            auto linkage = options.topLevelGlobals ? llvm::GlobalValue::ExternalLinkage
+                                                   : llvm::GlobalValue::InternalLinkage;
+            new llvm::GlobalVariable(*module, varType, false, linkage,
+                                     constant ? constant : llvm::Constant::getNullValue(varType), info.symbol);
+            if (!initVal || constant) return;
+        }
+        builder.CreateStore(initVal ? initVal : llvm::Constant::getNullValue(varType), getGlobalVariable(stmt.name));
+        return;
+    }
+
     // 2. Alloca
     llvm::AllocaInst* alloca = createEntryBlockAlloca(func, stmt.name, varType);
     
@@ -441,21 +1459,28 @@ void CodeGen::visit(VarDeclStmt& stmt) {
     }
     
     // 3. Register info
+    declareDebugVariable(alloca, stmt.name, stmt.typeName.empty() ? typeNameOf(stmt.type) : stmt.typeName, stmt);
     namedValues[stmt.name] = alloca;
     
-    // Register for cleanup in current scope if Array
-    bool isArray = false;
-    if (stmt.type && stmt.type->kind == TypeKind::Array) {
-        isArray = true;
+    // Register for cleanup in current scope if Array, Dict or File it owns
+    bool owned = false;
+    if (stmt.type && (stmt.type->kind == TypeKind::Array || stmt.type->kind == TypeKind::Dict ||
+                      stmt.type->kind == TypeKind::File)) {
+        owned = !borrowedLocals.count(&stmt);
     }
     
-    if (isArray && !scopeStack.empty()) {
-        scopeStack.back().push_back({alloca, isArray});
+    if (owned && !scopeStack.empty()) {
+        scopeStack.back().push_back({alloca, stmt.type->kind});
+        // Returns free the arrays, dicts and files of every scope but the top level's
+        if (scopeStack.size() > 1) {
+            cleanups.nodes.push_back({alloca, stmt.type->kind, cleanups.current});
+            cleanups.current = cleanups.nodes.size() - 1;
+        }
     }
 }
 
 void CodeGen::visit(ExprStmt& stmt) {
-    stmt.expr->accept(*this);
+    visitExpr(*stmt.expr);
 }
 
 void CodeGen::visit(FunctionStmt& stmt) {
@@ -468,18 +1493,34 @@ void CodeGen::visit(FunctionStmt& stmt) {
     llvm::Type* retType = getType(stmt.returnType);
     llvm::FunctionType* ft = llvm::FunctionType::get(retType, argTypes, false);
     llvm::Function* func = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, stmt.name, module.get());
+    functionTypes[stmt.name] = ft;
 
     if (!stmt.body) return; // Extern declaration
+    setFunctionAttributes(func);
 
     // 2. Body
     llvm::BasicBlock* bb = llvm::BasicBlock::Create(context, "entry", func);
     
     // Save previous block and context
     llvm::BasicBlock* oldBB = builder.GetInsertBlock();
-    auto oldNamedValues = namedValues;
+    // The caller's locals are not visible in the body; moving them aside is O(1)
+    llvm::StringMap<llvm::AllocaInst*> oldNamedValues = std::move(namedValues);
     
     builder.SetInsertPoint(bb);
     namedValues.clear();
+
+    std::string oldFunction = currentFunction;
+    int oldFunctionId = currentFunctionId;
+    auto oldActiveLoops = std::move(activeLoops);
+    activeLoops.clear();
+    FunctionCleanups oldCleanups = std::move(cleanups);
+    beginCleanups();
+    cleanups.body = stmt.body.get();
+    llvm::DISubprogram* oldDebugScope = debugScope;
+    llvm::DebugLoc oldDebugLoc = builder.getCurrentDebugLocation();
+    debugScope = createDebugFunction(func, stmt.name, stmt.line, &stmt);
+    emitDebugLocation(stmt);
+    emitFunctionEntryHook(stmt.name, stmt.line);
     
     unsigned idx = 0;
     for (auto& arg : func->args()) {
@@ -489,58 +1530,277 @@ void CodeGen::visit(FunctionStmt& stmt) {
         // Create Stack var
         llvm::AllocaInst* alloca = createEntryBlockAlloca(func, argName, arg.getType());
         builder.CreateStore(&arg, alloca);
+        declareDebugVariable(alloca, argName, stmt.params[idx].second, stmt, idx + 1);
         namedValues[argName] = alloca;
         idx++;
     }
     
-    stmt.body->accept(*this);
-    
-    // Auto-insert return void if missing
-    llvm::BasicBlock* curBB = builder.GetInsertBlock();
-    if (!curBB->getTerminator()) {
-        if (stmt.returnType == "void") {
-            builder.CreateRetVoid();
-        } else {
-            // For non-void, returning 0/undef is better than crashing
-            // But ideally we should sema check this.
-            // For now, return 0.
-            llvm::Type* retTy = func->getReturnType();
-            if (retTy->isIntegerTy()) {
-                builder.CreateRet(llvm::ConstantInt::get(context, llvm::APInt(retTy->getIntegerBitWidth(), 0)));
-            } else {
-                builder.CreateRet(llvm::UndefValue::get(retTy));
-            }
-        }
-    }
+    visit(*stmt.body); // Ends in a return, see emitFallthroughReturn()
+    finishCleanups(func);
     
     llvm::verifyFunction(*func);
     
     // Restore context
     if (oldBB) builder.SetInsertPoint(oldBB);
-    namedValues = oldNamedValues;
+    namedValues = std::move(oldNamedValues);
+    currentFunction = oldFunction;
+    currentFunctionId = oldFunctionId;
+    activeLoops = std::move(oldActiveLoops);
+    cleanups = std::move(oldCleanups);
+    debugScope = oldDebugScope;
+    builder.SetCurrentDebugLocation(oldDebugLoc);
 }
 
 void CodeGen::visit(StructDeclStmt& stmt) {
     if (structTypes.count(stmt.name)) return;
 
     std::vector<llvm::Type*> fieldTypes;
-    std::map<std::string, int> fieldIndices;
-    int idx = 0;
     for (const auto& field : stmt.fields) {
         fieldTypes.push_back(getType(field.second));
-        fieldIndices[field.first] = idx++;
     }
 
     llvm::StructType* structTy = llvm::StructType::create(context, fieldTypes, stmt.name);
     structTypes[stmt.name] = structTy;
-    structFieldIndices[stmt.name] = fieldIndices;
+    structFieldTypeNames[stmt.name] = stmt.fields;
+}
+
+// Sema types the enum name of Shape.Empty as the enum, which no variable of
+// that name can be: enums have no members
+static bool namesVariant(const MemberAccessExpr& expr) {
+    return expr.object->kind == NodeKind::Variable && expr.object->type &&
+           expr.object->type->kind == TypeKind::Enum;
+}
+
+void CodeGen::visit(EnumDeclStmt& stmt) {
+    if (enumLayouts.count(stmt.name)) return;
+
+    EnumLayout layout;
+    layout.variants = stmt.variants;
+    llvm::DataLayout dl = dataLayout();
+    uint64_t payloadSize = 0;
+    uint64_t payloadAlign = 1;
+    for (const auto& variant : stmt.variants) {
+        std::vector<llvm::Type*> fieldTypes;
+        for (const auto& field : variant.fields) {
+            fieldTypes.push_back(getType(field.second));
+        }
+        llvm::StructType* payload = llvm::StructType::create(context, fieldTypes, stmt.name + "." + variant.name);
+        payloadSize = std::max<uint64_t>(payloadSize, dl.getTypeAllocSize(payload));
+        payloadAlign = std::max<uint64_t>(payloadAlign, dl.getABITypeAlign(payload).value());
+        layout.payloads.push_back(payload);
+    }
+
+    // Null means the other variant. A string or array declared without a
+    // value is null too, so emitEnumValue stores it as an empty one
+    auto isPointer = [](llvm::StringRef typeName) { return typeName == "string" || typeName.ends_with("[]"); };
+    for (int i = 0; i < 2 && stmt.variants.size() == 2; ++i) {
+        const auto& fields = stmt.variants[i].fields;
+        if (fields.size() == 1 && isPointer(fields[0].second) && stmt.variants[1 - i].fields.empty()) {
+            layout.pointerVariant = i;
+        }
+    }
+
+    if (layout.pointerVariant >= 0) {
+        layout.type = llvm::PointerType::get(context, 0);
+    } else {
+        size_t count = stmt.variants.size();
+        std::vector<llvm::Type*> elements{builder.getIntNTy(count <= 256 ? 8 : count <= 65536 ? 16 : 32)};
+        if (payloadSize) {
+            // Integers as wide as the payload's alignment, so every variant's fields are aligned
+            elements.push_back(llvm::ArrayType::get(builder.getIntNTy(payloadAlign * 8),
+                                                    llvm::alignTo(payloadSize, payloadAlign) / payloadAlign));
+        }
+        layout.type = llvm::StructType::create(context, elements, stmt.name);
+    }
+    enumLayouts[stmt.name] = std::move(layout);
+}
+
+// Shape.Circle(r), or Shape.Empty with no `args`
+llvm::Value* CodeGen::emitEnumValue(const EnumType& type, const std::string& variant,
+                                    llvm::ArrayRef<std::unique_ptr<Expr>> args) {
+    auto it = enumLayouts.find(type.name);
+    int index = type.getVariantIndex(variant);
+    if (it == enumLayouts.end() || index < 0 || index >= (int)it->second.payloads.size()) {
+        std::cerr << "Unknown enum variant: " << type.name << "." << variant << "\n";
+        return nullptr;
+    }
+    const EnumLayout& layout = it->second;
+    llvm::StructType* payload = layout.payloads[index];
+    if (args.size() != payload->getNumElements()) {
+        std::cerr << "Incorrect # arguments passed\n";
+        return nullptr;
+    }
+
+    std::vector<llvm::Value*> fields;
+    for (const auto& arg : args) {
+        llvm::Value* value = visitExpr(*arg);
+        if (!value) return nullptr;
+        fields.push_back(emitConversion(value, arg->type.get(), payload->getElementType(fields.size())));
+    }
+    if (layout.pointerVariant >= 0) {
+        auto* null = llvm::ConstantPointerNull::get(llvm::PointerType::get(context, 0));
+        if (index != layout.pointerVariant) return null;
+        if (llvm::isa<llvm::GlobalValue, llvm::ConstantExpr>(fields[0])) return fields[0]; // A literal
+        llvm::Value* empty = emptyPointerValue(layout.variants[index].fields[0].second);
+        return builder.CreateSelect(builder.CreateICmpEQ(fields[0], null), empty, fields[0]);
+    }
+
+    auto* enumTy = llvm::cast<llvm::StructType>(layout.type);
+    llvm::Constant* tag = llvm::ConstantInt::get(enumTy->getElementType(0), index);
+    if (fields.empty()) {
+        std::vector<llvm::Constant*> elements{tag};
+        if (enumTy->getNumElements() > 1) elements.push_back(llvm::Constant::getNullValue(enumTy->getElementType(1)));
+        return llvm::ConstantStruct::get(enumTy, elements);
+    }
+    // Built in memory, since the fields are stored through the variant's struct
+    llvm::AllocaInst* slot = createEntryBlockAlloca(builder.GetInsertBlock()->getParent(), "enumtmp", enumTy);
+    builder.CreateStore(tag, builder.CreateStructGEP(enumTy, slot, 0));
+    llvm::Value* payloadAddr = builder.CreateStructGEP(enumTy, slot, 1, "payload");
+    for (size_t i = 0; i < fields.size(); ++i) {
+        builder.CreateStore(fields[i], builder.CreateStructGEP(payload, payloadAddr, i));
+    }
+    return builder.CreateLoad(enumTy, slot, "enumval");
+}
+
+// A non-null string or array with nothing in it, shared by the module: ""
+// or a zero count followed by no elements
+llvm::Constant* CodeGen::emptyPointerValue(llvm::StringRef typeName) {
+    if (typeName == "string") {
+        if (llvm::GlobalVariable* empty = module->getNamedGlobal("empty.string")) return empty;
+        return builder.CreateGlobalStringPtr("", "empty.string", 0, module.get());
+    }
+    llvm::StructType* storageType =
+        llvm::StructType::get(context, {builder.getInt64Ty(), llvm::ArrayType::get(builder.getInt64Ty(), 0)});
+    llvm::GlobalVariable* storage = module->getNamedGlobal("empty.array");
+    if (!storage) {
+        storage = new llvm::GlobalVariable(*module, storageType, true, llvm::GlobalValue::InternalLinkage,
+                                           llvm::Constant::getNullValue(storageType), "empty.array");
+        storage->setAlignment(llvm::Align(8));
+    }
+    return llvm::ConstantExpr::getInBoundsGetElementPtr(storageType, storage,
+                                                        llvm::ArrayRef<llvm::Constant*>{builder.getInt32(0),
+                                                                                        builder.getInt32(1)});
+}
+
+// A switch on the tag with one block per case; without an else every
+// variant has a case, and the default is unreachable, which spares the jump
+// table its range check. The pointer layout tests for null instead.
+void CodeGen::visit(MatchStmt& stmt) {
+    const Type* subjectType = stmt.subject->type.get();
+    auto* enumType = subjectType && subjectType->kind == TypeKind::Enum ? static_cast<const EnumType*>(subjectType)
+                                                                         : nullptr;
+    auto layoutIt = enumType ? enumLayouts.find(enumType->name) : enumLayouts.end();
+    if (layoutIt == enumLayouts.end()) {
+        std::cerr << "Match on a non-enum value\n";
+        return;
+    }
+    const EnumLayout& layout = layoutIt->second;
+    llvm::Function* func = builder.GetInsertBlock()->getParent();
+
+    // Fields are loaded from where the subject is stored: the variable or
+    // element itself, or a copy of any other value
+    llvm::Value* subject = nullptr;
+    NodeKind kind = stmt.subject->kind;
+    bool addressable = kind == NodeKind::Variable || kind == NodeKind::Index ||
+                       (kind == NodeKind::MemberAccess && !namesVariant(static_cast<MemberAccessExpr&>(*stmt.subject)));
+    if (addressable) {
+        subject = getLValueAddress(stmt.subject.get());
+    } else if (llvm::Value* value = visitExpr(*stmt.subject)) {
+        subject = createEntryBlockAlloca(func, "matchsubject", layout.type);
+        builder.CreateStore(value, subject);
+    }
+    if (!subject) return;
+
+    llvm::BasicBlock* otherwiseBB = llvm::BasicBlock::Create(context, stmt.elseBranch ? "matchelse" : "matchnone");
+    llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(context, "matchcont");
+    std::vector<llvm::BasicBlock*> caseBlocks;
+    std::vector<llvm::BasicBlock*> targets(layout.payloads.size(), otherwiseBB); // By variant
+    for (const auto& matchCase : stmt.cases) {
+        caseBlocks.push_back(llvm::BasicBlock::Create(context, "case." + matchCase.variant));
+        int index = enumType->getVariantIndex(matchCase.variant);
+        if (index >= 0 && index < (int)targets.size() && targets[index] == otherwiseBB) {
+            targets[index] = caseBlocks.back();
+        }
+    }
+
+    llvm::Value* pointer = nullptr;
+    llvm::Value* payloadAddr = nullptr;
+    if (layout.pointerVariant >= 0) {
+        pointer = builder.CreateLoad(layout.type, subject, "payload");
+        builder.CreateCondBr(builder.CreateIsNull(pointer), targets[1 - layout.pointerVariant],
+                             targets[layout.pointerVariant]);
+    } else {
+        auto* enumTy = llvm::cast<llvm::StructType>(layout.type);
+        auto* tagTy = llvm::cast<llvm::IntegerType>(enumTy->getElementType(0));
+        llvm::Value* tag = builder.CreateLoad(tagTy, builder.CreateStructGEP(enumTy, subject, 0), "tag");
+        if (enumTy->getNumElements() > 1) payloadAddr = builder.CreateStructGEP(enumTy, subject, 1, "payload");
+        llvm::SwitchInst* dispatch = builder.CreateSwitch(tag, otherwiseBB, targets.size());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (targets[i] != otherwiseBB) dispatch->addCase(llvm::ConstantInt::get(tagTy, i), targets[i]);
+        }
+    }
+
+    for (size_t c = 0; c < stmt.cases.size(); ++c) {
+        MatchCase& matchCase = stmt.cases[c];
+        llvm::BasicBlock* caseBB = caseBlocks[c];
+        func->insert(func->end(), caseBB);
+        builder.SetInsertPoint(caseBB);
+        emitDebugLocation(*matchCase.body);
+
+        // Each bound field gets a variable of its own for the case
+        int index = enumType->getVariantIndex(matchCase.variant);
+        std::vector<std::pair<std::string, llvm::AllocaInst*>> hidden;
+        for (size_t i = 0; index >= 0 && index < (int)layout.payloads.size() && i < matchCase.bindings.size(); ++i) {
+            llvm::StructType* payload = layout.payloads[index];
+            const std::string& name = matchCase.bindings[i];
+            if (name == "_" || i >= payload->getNumElements()) continue;
+            llvm::Type* fieldTy = payload->getElementType(i);
+            llvm::Value* value = pointer;
+            if (!value) value = builder.CreateLoad(fieldTy, builder.CreateStructGEP(payload, payloadAddr, i), name);
+            llvm::AllocaInst* alloca = createEntryBlockAlloca(func, name, fieldTy);
+            builder.CreateStore(value, alloca);
+            declareDebugVariable(alloca, name, layout.variants[index].fields[i].second, *matchCase.body);
+            hidden.emplace_back(name, namedValues.lookup(name));
+            namedValues[name] = alloca;
+        }
+
+        visit(*matchCase.body);
+
+        for (auto it = hidden.rbegin(); it != hidden.rend(); ++it) {
+            if (it->second) namedValues[it->first] = it->second;
+            else namedValues.erase(it->first);
+        }
+        if (!builder.GetInsertBlock()->getTerminator()) {
+            builder.CreateBr(mergeBB);
+        }
+    }
+
+    if (otherwiseBB->hasNPredecessors(0)) {
+        delete otherwiseBB; // A null test with both variants matched
+    } else {
+        func->insert(func->end(), otherwiseBB);
+        builder.SetInsertPoint(otherwiseBB);
+        if (stmt.elseBranch) {
+            visit(*stmt.elseBranch);
+            if (!builder.GetInsertBlock()->getTerminator()) {
+                builder.CreateBr(mergeBB);
+            }
+        } else {
+            builder.CreateUnreachable(); // Sema checked that every variant has a case
+        }
+    }
+
+    func->insert(func->end(), mergeBB);
+    builder.SetInsertPoint(mergeBB);
 }
 
-void CodeGen::visit(MemberAccessExpr& expr) {
+llvm::Value* CodeGen::visit(MemberAccessExpr& expr) {
+    if (namesVariant(expr)) {
+        return emitEnumValue(static_cast<EnumType&>(*expr.object->type), expr.member, {});
+    }
     llvm::Value* addr = getLValueAddress(&expr);
     if (!addr) {
-        lastValue = nullptr;
-        return;
+        return nullptr;
     }
     // Load the value (R-value access)
     // addr is a pointer to the field.
@@ -549,37 +1809,11 @@ void CodeGen::visit(MemberAccessExpr& expr) {
     // No, addr is an opaque ptr.
     // We should use expr.type if populated.
     
-    llvm::Type* loadType = nullptr;
-    if (expr.type) {
-        // Map Sema Type to LLVM Type
-        // We need a helper for Type -> llvm::Type
-        // Currently getType takes string.
-        // But StructType in Sema has name.
-        if (expr.type->kind == TypeKind::Int) loadType = llvm::Type::getInt64Ty(context);
-        else if (expr.type->kind == TypeKind::Float) loadType = llvm::Type::getDoubleTy(context);
-        else if (expr.type->kind == TypeKind::Bool) loadType = llvm::Type::getInt1Ty(context);
-        else if (expr.type->kind == TypeKind::String) loadType = llvm::PointerType::get(llvm::Type::getInt8Ty(context), 0);
-        else if (auto st = std::dynamic_pointer_cast<pynext::StructType>(expr.type)) {
-            if (structTypes.count(st->name)) loadType = structTypes[st->name];
-        }
-    }
-    
-    if (!loadType) {
-        // Fallback: try to deduce from LValue address generation? 
-        // We know the struct type and index.
-        // We can get field type from struct definition.
-        // Re-do lookups.
-        // ... (Implement simpler logic that recalculates)
-        
-        // Let's assume Sema worked. If not, we might crash on Load.
-        // Try Int64 as fallback purely to avoid segfault right here.
-        loadType = llvm::Type::getInt64Ty(context);
-    }
-    
-    lastValue = builder.CreateLoad(loadType, addr, "memberload");
+    // Sema types the field; int after a type error
+    return builder.CreateLoad(valueType(expr.type.get()), addr, "memberload");
 }
 
-void CodeGen::visit(IndexExpr& expr) {
+llvm::Value* CodeGen::visit(IndexExpr& expr) {
     // 1. Calculate Address
     // This logic duplicates getLValueAddress mostly, but...
     // Let's use getLValueAddress to get the pointer to the element.
@@ -587,67 +1821,75 @@ void CodeGen::visit(IndexExpr& expr) {
     
     llvm::Value* addr = getLValueAddress(&expr);
     if (!addr) {
-        lastValue = nullptr;
-        return;
+        return nullptr;
     }
     
     // 2. Load
     // We need the type.
-    llvm::Type* loadType = llvm::Type::getInt64Ty(context); // default
-    if (expr.type) {
-         if (expr.type->kind == TypeKind::Int) loadType = llvm::Type::getInt64Ty(context);
-         else if (expr.type->kind == TypeKind::Float) loadType = llvm::Type::getDoubleTy(context);
-         else if (expr.type->kind == TypeKind::Bool) loadType = llvm::Type::getInt1Ty(context);
-         else if (auto st = std::dynamic_pointer_cast<pynext::StructType>(expr.type)) {
-             if (structTypes.count(st->name)) loadType = structTypes[st->name];
-         }
+    return builder.CreateLoad(valueType(expr.type.get()), addr, "indexload");
+}
+
+// Element type the TypeChecker inferred; int when it could not
+llvm::Type* CodeGen::arrayElementType(const ArrayLiteralExpr& expr) {
+    auto arrT = std::dynamic_pointer_cast<pynext::ArrayType>(expr.type);
+    return valueType(arrT ? arrT->elementType.get() : nullptr);
+}
+
+// Numbers and bool literals, and operators on them, which IRBuilder folds.
+// A division might fold a division by zero to poison.
+static bool isConstantExpr(const Expr& expr) {
+    if (expr.kind == NodeKind::Literal) return !static_cast<const LiteralExpr&>(expr).isString;
+    if (expr.kind != NodeKind::Binary) return false;
+    const auto& binary = static_cast<const BinaryExpr&>(expr);
+    return binary.op != "=" && binary.op != "/" && isConstantExpr(*binary.left) && isConstantExpr(*binary.right);
+}
+
+// A top-level array literal of constants is laid out like emitArrayAlloc's
+// storage, count first, in a writable global, so creating it costs nothing
+// at startup. Only for staticArrays: nothing can free such an array, since
+// top-level arrays are never freed and no copy of it outlives the read.
+// Returns null if an element is not constant.
+llvm::Constant* CodeGen::emitStaticArray(ArrayLiteralExpr& expr, const std::string& name) {
+    llvm::Type* elemType = arrayElementType(expr);
+    std::vector<llvm::Constant*> elements;
+    for (const auto& element : expr.elements) {
+        if (!isConstantExpr(*element)) return nullptr;
     }
-    
-    lastValue = builder.CreateLoad(loadType, addr, "indexload");
+    for (const auto& element : expr.elements) {
+        auto* value = llvm::dyn_cast_or_null<llvm::Constant>(visitExpr(*element));
+        if (!value || value->getType() != elemType) return nullptr;
+        elements.push_back(value);
+    }
+
+    llvm::ArrayType* dataType = llvm::ArrayType::get(elemType, elements.size());
+    llvm::StructType* storageType = llvm::StructType::get(context, {llvm::Type::getInt64Ty(context), dataType});
+    llvm::Constant* init = llvm::ConstantStruct::get(
+        storageType, {builder.getInt64(elements.size()), llvm::ConstantArray::get(dataType, elements)});
+    auto* storage = new llvm::GlobalVariable(*module, storageType, false, llvm::GlobalValue::InternalLinkage, init,
+                                             "global." + name + ".data");
+    storage->setAlignment(llvm::Align(8));
+    return llvm::ConstantExpr::getInBoundsGetElementPtr(storageType, storage,
+                                                        llvm::ArrayRef<llvm::Constant*>{builder.getInt32(0),
+                                                                                        builder.getInt32(1)});
 }
 
-void CodeGen::visit(ArrayLiteralExpr& expr) {
+llvm::Value* CodeGen::visit(ArrayLiteralExpr& expr) {
     // Create an Array on Heap? 
     // Malloc (size * sizeof(element))
     
     int size = expr.elements.size();
     
     // 1. Determine element size/type
-    // Assume homogeneous based on first element or TypeChecker
-    llvm::Type* elemType = llvm::Type::getInt64Ty(context);
-    if (expr.type) {
-         auto arrT = std::dynamic_pointer_cast<pynext::ArrayType>(expr.type);
-         if (arrT && arrT->elementType) {
-             // Map Type... (Refactor this mapping!)
-             // Quick Mapping again:
-             auto et = arrT->elementType;
-             if (et->kind == TypeKind::Int) elemType = llvm::Type::getInt64Ty(context);
-             else if (et->kind == TypeKind::Float) elemType = llvm::Type::getDoubleTy(context);
-             else if (et->kind == TypeKind::Bool) elemType = llvm::Type::getInt1Ty(context);
-             else if (auto st = std::dynamic_pointer_cast<pynext::StructType>(et)) {
-                 if (structTypes.count(st->name)) elemType = structTypes[st->name];
-             }
-             // ...
-         }
-    }
+    llvm::Type* elemType = arrayElementType(expr);
     
     // 2. Malloc
-    // We need `malloc` declared.
-    llvm::Function* mallocFunc = module->getFunction("malloc");
-    if (!mallocFunc) {
-        // Declare malloc: i8* malloc(i64)
-        std::vector<llvm::Type*> args = { llvm::Type::getInt64Ty(context) };
-        llvm::FunctionType* ft = llvm::FunctionType::get(llvm::PointerType::get(llvm::Type::getInt8Ty(context), 0), args, false);
-        mallocFunc = llvm::Function::Create(ft, llvm::Function::ExternalLinkage, "malloc", module.get());
-    }
-    
     // Size required?
-    llvm::DataLayout dl(module.get());
+    llvm::DataLayout dl = dataLayout();
     uint64_t typeSize = dl.getTypeAllocSize(elemType);
     uint64_t totalSize = typeSize * size + 8; // Extra 8 bytes for size header
     
     llvm::Value* sizeVal = llvm::ConstantInt::get(context, llvm::APInt(64, totalSize));
-    llvm::Value* voidPtr = builder.CreateCall(mallocFunc, {sizeVal}, "malloccall");
+    llvm::Value* voidPtr = emitArrayAlloc(sizeVal);
     
     // Store Size at beginning
     llvm::Value* sizePtr = voidPtr; // i8*
@@ -661,29 +1903,36 @@ void CodeGen::visit(ArrayLiteralExpr& expr) {
     llvm::Value* arrayPtr = builder.CreateGEP(llvm::Type::getInt8Ty(context), voidPtr, offset, "arraydata");
     
     // 3. Store elements
+    auto arrT = std::dynamic_pointer_cast<pynext::ArrayType>(expr.type);
     for (int i=0; i < size; ++i) {
-        expr.elements[i]->accept(*this);
-        llvm::Value* val = lastValue;
+        llvm::Value* val = visitExpr(*expr.elements[i]);
+        if (!val) return nullptr;
+        if (arrT && isNumeric(arrT->elementType.get())) {
+            val = emitConversion(val, expr.elements[i]->type.get(), elemType);
+        }
         
         llvm::Value* idxVal = llvm::ConstantInt::get(context, llvm::APInt(64, i));
         llvm::Value* gep = builder.CreateGEP(elemType, arrayPtr, idxVal, "initidx");
         builder.CreateStore(val, gep);
     }
     
-    lastValue = arrayPtr;
+    return arrayPtr;
 }
 
-llvm::Value* CodeGen::getLValueAddress(Expr* expr) {
-    if (auto varFn = dynamic_cast<VariableExpr*>(expr)) {
-        if (namedValues.count(varFn->name)) {
-            return namedValues[varFn->name];
+llvm::Value* CodeGen::getLValueAddress(Expr* expr, bool forStore) {
+    if (expr->kind == NodeKind::Variable) {
+        auto* varFn = static_cast<VariableExpr*>(expr);
+        if (llvm::AllocaInst* alloca = namedValues.lookup(varFn->name)) {
+            return alloca;
         }
+        if (llvm::GlobalVariable* global = getGlobalVariable(varFn->name)) return global;
         std::cerr << "Unknown variable: " << varFn->name << "\n";
         return nullptr;
     } 
     
-    if (auto memFn = dynamic_cast<MemberAccessExpr*>(expr)) {
-        llvm::Value* base = getLValueAddress(memFn->object.get());
+    if (expr->kind == NodeKind::MemberAccess) {
+        auto* memFn = static_cast<MemberAccessExpr*>(expr);
+        llvm::Value* base = getLValueAddress(memFn->object.get(), forStore);
         if (!base) return nullptr;
         
         // Need to find which struct type 'base' points to.
@@ -699,20 +1948,18 @@ llvm::Value* CodeGen::getLValueAddress(Expr* expr) {
             return nullptr;
         }
 
-        std::string structName = structInfo->name;
-        if (structTypes.find(structName) == structTypes.end()) {
-             std::cerr << "Unknown struct type in codegen: " << structName << "\n";
+        llvm::StructType* st = structTypes.lookup(structInfo->name);
+        if (!st) {
+             std::cerr << "Unknown struct type in codegen: " << structInfo->name << "\n";
              return nullptr;
         }
         
-        llvm::StructType* st = structTypes[structName];
-        if (structFieldIndices[structName].count(memFn->member) == 0) {
+        int idx = structInfo->getMemberIndex(memFn->member);
+        if (idx < 0) {
              std::cerr << "Unknown member: " << memFn->member << "\n";
              return nullptr;
         }
         
-        int idx = structFieldIndices[structName][memFn->member];
-        
         llvm::Value* indices[] = {
             llvm::ConstantInt::get(context, llvm::APInt(32, 0)), // Dereference pointer
             llvm::ConstantInt::get(context, llvm::APInt(32, idx)) // Field index
@@ -721,28 +1968,25 @@ llvm::Value* CodeGen::getLValueAddress(Expr* expr) {
         return builder.CreateGEP(st, base, indices, "memberaddr");
     }
     
-    if (auto idxExpr = dynamic_cast<IndexExpr*>(expr)) {
+    if (expr->kind == NodeKind::Index) {
+        auto* idxExpr = static_cast<IndexExpr*>(expr);
+        if (idxExpr->object->type && idxExpr->object->type->kind == TypeKind::Dict) {
+            return emitDictSlot(*idxExpr, forStore);
+        }
         llvm::Value* base = getLValueAddress(idxExpr->object.get()); // Recursion? No, see below.
         // Wait, getLValueAddress is for getting address of a VARIABLE.
         // If we have `a[i]`, we want value of `a` (pointer), then GEP.
         // But `a` is an LValue (VariableExpr). `getLValueAddress(a)` gives address of `a` (stack slot).
         // If we Load `a`, we get the array pointer.
         
-        // My previous logic:
-        // idxExpr->object->accept(*this);
-        // llvm::Value* arrayPtr = lastValue;
-        
-        // Let's verify this logic.
-        idxExpr->object->accept(*this);
-        llvm::Value* arrayPtr = lastValue;
+        llvm::Value* arrayPtr = visitExpr(*idxExpr->object);
         
         if (!arrayPtr) {
             std::cerr << "CodeGen Error: Array base eval failed\n";
             return nullptr;
         }
 
-        idxExpr->index->accept(*this);
-        llvm::Value* indexVal = lastValue;
+        llvm::Value* indexVal = visitExpr(*idxExpr->index);
         
         if (!indexVal) {
              std::cerr << "CodeGen Error: Index eval failed\n";
@@ -755,17 +1999,9 @@ llvm::Value* CodeGen::getLValueAddress(Expr* expr) {
         }
 
         if (auto arrType = std::dynamic_pointer_cast<pynext::ArrayType>(idxExpr->object->type)) {
-             llvm::Type* elemLLVMType = nullptr;
-             auto et = arrType->elementType;
-             if (et->kind == TypeKind::Int) elemLLVMType = llvm::Type::getInt64Ty(context);
-             else if (et->kind == TypeKind::Float) elemLLVMType = llvm::Type::getDoubleTy(context);
-             else if (et->kind == TypeKind::Bool) elemLLVMType = llvm::Type::getInt1Ty(context);
-             else if (auto st = std::dynamic_pointer_cast<pynext::StructType>(et)) {
-                 if (structTypes.count(st->name)) elemLLVMType = structTypes[st->name];
-             }
-             
-             if (!elemLLVMType) elemLLVMType = llvm::Type::getInt64Ty(context); 
-             
+             llvm::Type* elemLLVMType = valueType(arrType->elementType.get());
+             // GEP would sign-extend a narrower index, so u8 200 would be -56
+             indexVal = emitConversion(indexVal, idxExpr->index->type.get(), builder.getInt64Ty());
              return builder.CreateGEP(elemLLVMType, arrayPtr, indexVal, "indexaddr");
         } else {
              std::cerr << "CodeGen Error: Object type is not ArrayType: " << idxExpr->object->type->toString() << "\n";
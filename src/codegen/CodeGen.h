@@ -2,65 +2,242 @@
 #define PYNEXT_CODEGEN_H
 
 #include "../parser/AST.h"
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
-#include <map>
 #include <string>
 
 namespace pynext {
 
-class CodeGen : public ASTVisitor {
+enum class DebugInfoLevel {
+    None,
+    LineTablesOnly, // -gline-tables-only: source locations only, no variables or types
+    Full,           // -g: also types and variable locations
+};
+
+// Code generation switches selected by the driver
+struct CodeGenOptions {
+    bool framePointers = false; // Keep a frame pointer in every function (--profile unwinds with it)
+    bool instrument = false;    // Call the entry/exit and loop trip hooks of runtime/Instrumentation.h
+    bool trackAllocations = false; // Route array malloc/free through runtime/AllocTracker.h
+    DebugInfoLevel debugInfo = DebugInfoLevel::None;
+    std::string sourceFile = "<input>"; // Source path recorded in debug info
+    bool optimized = false;             // Marks the debug info as describing optimized code
+    bool topLevelGlobals = false; // Top-level variables become globals that later modules can use (REPL)
+};
+
+// Source location of an instrumented function, loop or allocation site; the
+// index in the CodeGen::getInstrumented*()/getAllocationSites() table is its
+// hook id.
+struct InstrumentedSite {
+    std::string function;
+    std::string kind; // "def", "while loop", "for loop", "array literal", "dict", "scope exit" or "return"
+    int line;
+};
+
+class CodeGen : public StaticASTVisitor<CodeGen, llvm::Value*> {
 public:
-    CodeGen(llvm::LLVMContext& context) 
-        : context(context), builder(context) {
+    CodeGen(llvm::LLVMContext& context, CodeGenOptions options = {}) 
+        : context(context), builder(context), options(options) {
         module = std::make_unique<llvm::Module>("PyNextModule", context);
     }
 
     llvm::Module* getModule() const { return module.get(); }
     std::unique_ptr<llvm::Module> releaseModule() { return std::move(module); }
-    void generate(const std::vector<std::unique_ptr<Stmt>>& stmts);
-
-    // Visitor Implementation
-    void visit(LiteralExpr& expr) override;
-    void visit(VariableExpr& expr) override;
-    void visit(BinaryExpr& expr) override;
-    void visit(CallExpr& expr) override;
-    void visit(ReturnStmt& stmt) override;
-    void visit(Block& stmt) override;
-    void visit(IfStmt& stmt) override;
-    void visit(WhileStmt& stmt) override;
-    void visit(ForStmt& stmt) override;
-    void visit(FunctionStmt& stmt) override;
-    void visit(VarDeclStmt& stmt) override;
-    void visit(StructDeclStmt& stmt) override;
-    void visit(ExprStmt& stmt) override;
-    void visit(MemberAccessExpr& expr) override;
-    void visit(IndexExpr& expr) override;
-    void visit(ArrayLiteralExpr& expr) override;
-
-    llvm::Value* getLastValue() { return lastValue; }
+    // Top-level statements run in `entryName`; by default "main", or "__init"
+    // when the program defines main itself
+    void generate(const std::vector<std::unique_ptr<Stmt>>& stmts, const std::string& entryName = "");
+    // Incremental compilation for `pynext repl`: compiles `stmts` into a new
+    // module whose entry function `entryName` runs their top-level statements.
+    // Functions, structs and top-level globals of earlier chunks are declared
+    // in it on first use.
+    std::unique_ptr<llvm::Module> generateChunk(const std::vector<std::unique_ptr<Stmt>>& stmts,
+                                                const std::string& entryName);
+
+    // The symbols a chunk adds for later ones. A chunk that fails after
+    // generateChunk() is undone by restoring what was saved before it.
+    struct ChunkState;
+    ChunkState saveChunkState() const;
+    void restoreChunkState(ChunkState state);
+
+    // Visitor Implementation; expressions return their value, or null after an error
+    llvm::Value* visit(LiteralExpr& expr);
+    llvm::Value* visit(VariableExpr& expr);
+    llvm::Value* visit(BinaryExpr& expr);
+    llvm::Value* visit(CallExpr& expr);
+    llvm::Value* visit(MemberAccessExpr& expr);
+    llvm::Value* visit(IndexExpr& expr);
+    llvm::Value* visit(ArrayLiteralExpr& expr);
+    void visit(ReturnStmt& stmt);
+    void visit(Block& stmt);
+    void visit(IfStmt& stmt);
+    void visit(WhileStmt& stmt);
+    void visit(ForStmt& stmt);
+    void visit(FunctionStmt& stmt);
+    void visit(VarDeclStmt& stmt);
+    void visit(StructDeclStmt& stmt);
+    void visit(EnumDeclStmt& stmt);
+    void visit(MatchStmt& stmt);
+    void visit(ExprStmt& stmt);
+
+    const std::vector<InstrumentedSite>& getInstrumentedFunctions() const { return instrumentedFunctions; }
+    const std::vector<InstrumentedSite>& getInstrumentedLoops() const { return instrumentedLoops; }
+    const std::vector<InstrumentedSite>& getAllocationSites() const { return allocationSites; }
 
 private:
     llvm::LLVMContext& context;
     llvm::IRBuilder<> builder;
+    CodeGenOptions options;
     std::unique_ptr<llvm::Module> module;
     
-    std::map<std::string, llvm::AllocaInst*> namedValues;
-    std::map<std::string, llvm::StructType*> structTypes;
-    std::map<std::string, std::map<std::string, int>> structFieldIndices;
-    llvm::Value* lastValue = nullptr;
+    llvm::StringMap<llvm::AllocaInst*> namedValues; // Locals of the function being generated
+    llvm::StringMap<llvm::StructType*> structTypes; // Field indices are on the sema StructType
+    llvm::StringMap<llvm::FunctionType*> functionTypes; // Every function seen, for cross-module calls
+
+    // An enum is { tag, payload }: the tag is the variant's index, as i8 up to
+    // 256 variants, and the payload an integer array as large and as aligned
+    // as the largest variant's fields, which are read through that variant's
+    // struct. An enum of one variant with a single string or array field and
+    // one variant without fields is only the pointer, null for the empty one;
+    // a null string or array is stored in the other variant as an empty one.
+    struct EnumLayout {
+        llvm::Type* type = nullptr;
+        std::vector<llvm::StructType*> payloads; // By variant
+        int pointerVariant = -1;                 // The variant holding the pointer, or -1 for { tag, payload }
+        std::vector<EnumVariant> variants;       // Field type names, for debug info
+    };
+    llvm::StringMap<EnumLayout> enumLayouts;
+
+    // Top-level variables that functions use (VarDeclStmt::global), or all of
+    // them with options.topLevelGlobals. A constant initializer becomes the
+    // global's initial value; any other is stored when the entry function
+    // reaches the declaration. A redefinition with a different type gets a
+    // fresh symbol; code compiled earlier keeps the old one.
+    struct GlobalInfo {
+        std::string symbol;
+        llvm::Type* type;
+    };
+    llvm::StringMap<GlobalInfo> globalVariables;
+    unsigned globalRedefinitions = 0;
+    // Top-level array variables whose value never leaves them, so a literal
+    // initializer can live in static storage (emitStaticArray). Empty for
+    // REPL chunks, since later chunks may return the array.
+    llvm::StringSet<> staticArrays;
+    // Locals that may hold a top-level variable's array, dict or file. They
+    // borrow it, so their scope does not free it.
+    llvm::SmallPtrSet<const VarDeclStmt*, 8> borrowedLocals;
     
     // Memory Management
     // Stack of scopes. Each scope contains list of variables (alloca pointers) to cleanup.
-    // Pair: <AllocaInst*, isArray>
-    std::vector<std::vector<std::pair<llvm::Value*, bool>>> scopeStack; 
+    // Pair: <AllocaInst*, TypeKind::Array, TypeKind::Dict or TypeKind::File>
+    std::vector<std::vector<std::pair<llvm::Value*, TypeKind>>> scopeStack; 
+
+    // Returns do not free arrays and dicts themselves. Each such local of a
+    // function gets a cleanup block, created by the first return that needs
+    // it, which frees the variable and branches to the cleanup of the one
+    // declared before it; the chain ends in the function's return block. A
+    // return with any live stores its value in the return slot and branches
+    // to the cleanup of the newest one, so every free is emitted once however
+    // many returns there are. A return with none live returns in place.
+    // Falling off the end of the function body enters the chain the same way.
+    struct CleanupNode {
+        llvm::AllocaInst* variable;
+        TypeKind kind;
+        int next;                          // Node index, -1 for the return block
+        llvm::BasicBlock* block = nullptr; // Filled in by finishCleanups()
+        const ASTNode* origin = nullptr;   // First return through it, for its location
+    };
+    struct FunctionCleanups {
+        llvm::AllocaInst* returnSlot = nullptr; // Null in void functions
+        llvm::BasicBlock* returnBlock = nullptr;
+        std::vector<CleanupNode> nodes;
+        int current = -1; // Node a return at the insertion point enters
+        // Variables moved to the caller by `return a`; their cleanups check for null
+        std::vector<llvm::AllocaInst*> returnedVariables;
+        const ASTNode* firstReturn = nullptr; // Through a cleanup; null leaves the return block unused
+        const Block* body = nullptr;          // Null in the entry function
+    };
+    FunctionCleanups cleanups;
+
+    // Instrumentation (--instrument)
+    std::vector<InstrumentedSite> instrumentedFunctions;
+    std::vector<InstrumentedSite> instrumentedLoops;
+    std::string currentFunction;
+    int currentFunctionId = -1;
+    // Loops enclosing the insertion point: <hook id, trip counter>
+    std::vector<std::pair<int, llvm::AllocaInst*>> activeLoops;
+    std::vector<InstrumentedSite> allocationSites;
+    int currentLine = 0; // Line of the statement being generated
+
+    // Debug info (-g / -gline-tables-only); debugBuilder is null when disabled
+    std::unique_ptr<llvm::DIBuilder> debugBuilder;
+    llvm::DICompileUnit* debugUnit = nullptr;
+    llvm::DIFile* debugFile = nullptr;
+    llvm::DISubprogram* debugScope = nullptr; // Subprogram of the function being generated
+    llvm::StringMap<llvm::DIType*> debugTypes;
+    llvm::StringMap<std::vector<std::pair<std::string, std::string>>> structFieldTypeNames;
 
     // Helpers
+    void emitEntryFunction(const std::vector<std::unique_ptr<Stmt>>& stmts, const std::string& entryName);
+    llvm::Function* getFunction(const std::string& name);
+    llvm::GlobalVariable* getGlobalVariable(const std::string& name);
+    void setFunctionAttributes(llvm::Function* func);
+    llvm::FunctionCallee getRuntimeHook(const char* name, llvm::ArrayRef<llvm::Type*> params);
+    void emitFunctionEntryHook(const std::string& name, int line);
+    void emitFunctionExitHook();
+    void emitLoopExitHooks();
+    void beginCleanups();
+    llvm::BasicBlock* cleanupBlock(int node, const ASTNode& origin);
+    void emitReturnBranch(llvm::Value* value, const ASTNode* origin);
+    void emitFallthroughReturn(const Block& body);
+    void finishCleanups(llvm::Function* func);
+    void beginLoopCounter(const char* kind, int line);
+    void countLoopTrip();
+    void endLoopCounter();
+    void initDebugInfo();
+    llvm::DISubprogram* createDebugFunction(llvm::Function* func, const std::string& name, int line,
+                                            const FunctionStmt* stmt);
+    void emitDebugLocation(const ASTNode& node);
+    llvm::DIType* getDebugType(const std::string& typeName);
+    void declareDebugVariable(llvm::AllocaInst* alloca, const std::string& name, const std::string& typeName,
+                              const ASTNode& node, unsigned argNo = 0);
+    llvm::Value* emitArrayAlloc(llvm::Value* size);
+    llvm::Type* arrayElementType(const ArrayLiteralExpr& expr);
+    llvm::Constant* emitStaticArray(ArrayLiteralExpr& expr, const std::string& name);
+    void emitArrayFree(llvm::Value* dataPtr, const char* kind, int line);
+    void emitRelease(llvm::Value* ptr, TypeKind type, const char* kind, int line);
+    llvm::DataLayout dataLayout() const;
+    llvm::FunctionCallee getRuntimeFunction(const char* name, llvm::Type* result, llvm::ArrayRef<llvm::Type*> params);
+    llvm::Value* emitDictNew(const DictType& type);
+    llvm::Value* emitDictKey(llvm::Value* key, const Type* from, const Type& keyType);
+    llvm::Value* emitDictSlot(IndexExpr& expr, bool insert);
+    llvm::Value* emitSort(CallExpr& expr);
+    llvm::Value* emitStringBuiltin(CallExpr& expr);
+    void emitLinesLoop(ForStmt& stmt, CallExpr& call);
+    llvm::Value* emitBuiltin(CallExpr& expr);
+    llvm::Value* emitEnumValue(const EnumType& type, const std::string& variant,
+                               llvm::ArrayRef<std::unique_ptr<Expr>> args);
+    llvm::Constant* emptyPointerValue(llvm::StringRef typeName);
     llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* fun, const std::string& varName, llvm::Type* type);
     llvm::Type* getType(const std::string& typeName);
-    llvm::Value* getLValueAddress(Expr* expr);
+    llvm::Type* valueType(const Type* type);
+    llvm::Value* emitConversion(llvm::Value* value, const Type* from, llvm::Type* to, bool toSigned = true);
+    // `forStore` inserts a missing dict key instead of reporting it
+    llvm::Value* getLValueAddress(Expr* expr, bool forStore = false);
+};
+
+struct CodeGen::ChunkState {
+    llvm::StringMap<llvm::StructType*> structTypes;
+    llvm::StringMap<llvm::FunctionType*> functionTypes;
+    llvm::StringMap<EnumLayout> enumLayouts;
+    llvm::StringMap<GlobalInfo> globalVariables;
+    unsigned globalRedefinitions;
+    llvm::StringMap<std::vector<std::pair<std::string, std::string>>> structFieldTypeNames;
 };
 
 } // namespace pynext
@@ -0,0 +1,272 @@
+#include "IncrementalBuild.h"
+#include "Optimizer.h"
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <unistd.h>
+
+namespace pynext {
+
+namespace {
+
+// Bump when the object layout or the key derivation changes
+constexpr const char* kFormatVersion = "pynext-incremental-1";
+
+void addField(llvm::MD5& hash, llvm::StringRef field) {
+    hash.update(field);
+    hash.update(llvm::ArrayRef<uint8_t>{0});
+}
+
+std::string hexDigest(llvm::MD5& hash) {
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return result.digest().str().str();
+}
+
+// Struct names mentioned by a layout such as "p:Point,xs:int[],"
+std::vector<std::string> fieldStructs(const std::string& layout) {
+    std::vector<std::string> names;
+    std::stringstream fields(layout);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        std::string type = field.substr(field.find(':') + 1);
+        while (llvm::StringRef(type).ends_with("[]")) type.resize(type.size() - 2);
+        names.push_back(type);
+    }
+    return names;
+}
+
+} // namespace
+
+void IncrementalBuild::summarize(const std::vector<std::unique_ptr<Stmt>>& stmts, const std::string& entryName) {
+    summaries = summarizeFunctions(stmts, entryName, config.withPositions);
+    layouts = structLayouts(stmts);
+}
+
+void IncrementalBuild::addImportedBody(const std::string& name, const std::string& bodyKey) {
+    FunctionSummary& summary = summaries[name];
+    summary.isDefinition = true;
+    summary.bodyHash = bodyKey;
+}
+
+std::set<std::string> IncrementalBuild::inlinedBodies(const std::string& function) const {
+    std::set<std::string> bodies{function};
+    if (config.optLevel == 0) return bodies;
+    for (const auto& callee : summaries.at(function).callees) {
+        auto it = summaries.find(callee);
+        if (it != summaries.end() && it->second.isDefinition) bodies.insert(callee);
+    }
+    return bodies;
+}
+
+std::string IncrementalBuild::cacheKey(const std::string& function) const {
+    llvm::MD5 hash;
+    addField(hash, configTag);
+
+    std::set<std::string> bodies = inlinedBodies(function);
+    std::set<std::string> callees;
+    std::set<std::string> structs;
+    for (const auto& name : bodies) {
+        const FunctionSummary& summary = summaries.at(name);
+        addField(hash, name);
+        addField(hash, summary.signature);
+        addField(hash, summary.bodyHash);
+        callees.insert(summary.callees.begin(), summary.callees.end());
+        structs.insert(summary.structs.begin(), summary.structs.end());
+    }
+
+    for (const auto& callee : callees) {
+        auto it = summaries.find(callee);
+        addField(hash, callee);
+        addField(hash, it != summaries.end() ? it->second.signature : "?");
+    }
+
+    // Layouts of the structs used, and of the structs nested in those
+    std::vector<std::string> worklist(structs.begin(), structs.end());
+    while (!worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+        auto it = layouts.find(name);
+        if (it == layouts.end()) continue;
+        for (const auto& nested : fieldStructs(it->second)) {
+            if (layouts.count(nested) && structs.insert(nested).second) worklist.push_back(nested);
+        }
+    }
+    for (const auto& name : structs) {
+        auto it = layouts.find(name);
+        addField(hash, name);
+        addField(hash, it != layouts.end() ? it->second : "?");
+    }
+    return hexDigest(hash);
+}
+
+std::string IncrementalBuild::rebuildReason(const std::string& function, const std::string& key) const {
+    auto it = previous.find(function);
+    if (it == previous.end()) return "new";
+    if (it->second.key == key) return "not in cache";
+    if (previousConfigTag != configTag) return "options changed";
+    if (it->second.bodyHash != summaries.at(function).bodyHash) return "changed";
+    return "dependency changed";
+}
+
+std::string IncrementalBuild::indexPath() const {
+    return config.cacheDir + "/" + llvm::sys::path::filename(config.sourceName).str() + ".O" +
+           std::to_string(config.optLevel) + ".index";
+}
+
+// Index format: a config line, then "<function> <key> <body hash> <build ms>"
+void IncrementalBuild::loadIndex() {
+    std::ifstream in(indexPath());
+    if (!in) return;
+    std::getline(in, previousConfigTag);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        IndexEntry entry;
+        if (fields >> name >> entry.key >> entry.bodyHash >> entry.buildMs) previous[name] = entry;
+    }
+}
+
+bool IncrementalBuild::saveIndex(std::string& error) const {
+    std::string path = indexPath();
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(temp);
+        if (!out) {
+            error = "cannot write " + temp;
+            return false;
+        }
+        out << configTag << "\n";
+        for (const auto& [name, entry] : current) {
+            out << name << " " << entry.key << " " << entry.bodyHash << " " << entry.buildMs << "\n";
+        }
+    }
+    if (std::error_code ec = llvm::sys::fs::rename(temp, path)) {
+        error = "cannot write " + path + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+bool IncrementalBuild::build(llvm::Module& module, llvm::TargetMachine& targetMachine, std::string& error,
+                             llvm::raw_ostream* irOut) {
+    if (std::error_code ec = llvm::sys::fs::create_directories(config.cacheDir)) {
+        error = "cannot create " + config.cacheDir + ": " + ec.message();
+        return false;
+    }
+    configTag = std::string(kFormatVersion) + ";O" + std::to_string(config.optLevel) + ";" + config.codegenTag +
+                ";" + targetMachine.getTargetTriple().str() + ";" + targetMachine.getTargetCPU().str() + ";" +
+                targetMachine.getTargetFeatureString().str();
+    loadIndex();
+
+    // Top-level variables must exist once: they stay defined in `module` and
+    // every object refers to them by name
+    for (llvm::GlobalVariable& global : module.globals()) {
+        if (global.hasLocalLinkage() && !global.isConstant()) global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+
+    for (llvm::Function& function : module) {
+        // Imported bodies are only copied into their callers' modules
+        if (function.isDeclaration() || function.hasAvailableExternallyLinkage()) continue;
+        std::string name = function.getName().str();
+        if (!summaries.count(name)) {
+            error = "no fingerprint for function '" + name + "'";
+            return false;
+        }
+
+        std::string key = cacheKey(name);
+        std::string objectPath = config.cacheDir + "/" + key + ".o";
+        IndexEntry& entry = current[name];
+        entry.key = key;
+        entry.bodyHash = summaries.at(name).bodyHash;
+
+        if (auto cached = llvm::MemoryBuffer::getFile(objectPath)) {
+            auto it = previous.find(name);
+            if (it != previous.end() && it->second.key == key) {
+                entry.buildMs = it->second.buildMs;
+                savedMs += entry.buildMs;
+            }
+            objects.push_back(std::move(*cached));
+            reused++;
+            continue;
+        }
+        rebuilt.emplace_back(name, rebuildReason(name, key));
+
+        auto start = std::chrono::steady_clock::now();
+
+        // The function itself, plus at -O1+ the bodies of its callees for the
+        // inliner. Those are available_externally, so they are dropped after
+        // optimization and calls left in place link against the callee's object.
+        std::set<std::string> bodies = inlinedBodies(name);
+        llvm::ValueToValueMapTy valueMap;
+        std::unique_ptr<llvm::Module> unit = llvm::CloneModule(module, valueMap, [&](const llvm::GlobalValue* value) {
+            if (llvm::isa<llvm::Function>(value)) return bodies.count(value->getName().str()) > 0;
+            // String constants are private; each object gets its own copy
+            return value->hasLocalLinkage();
+        });
+        for (const auto& body : bodies) {
+            if (body != name) unit->getFunction(body)->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+        }
+        for (llvm::GlobalVariable& global : llvm::make_early_inc_range(unit->globals())) {
+            if (global.hasLocalLinkage() && global.use_empty()) global.eraseFromParent();
+        }
+
+        optimizeModule(*unit, config.optLevel, &targetMachine);
+
+        llvm::SmallVector<char, 0> buffer;
+        if (!emitObjectFile(*unit, targetMachine, buffer, error)) return false;
+        entry.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        compileMs += entry.buildMs;
+
+        if (irOut) unit->print(*irOut, nullptr);
+
+        // Written under a temporary name first so a concurrent build never
+        // loads a partial object
+        std::string temp = objectPath + ".tmp" + std::to_string(getpid());
+        {
+            std::error_code ec;
+            llvm::raw_fd_ostream out(temp, ec);
+            if (ec) {
+                error = "cannot write " + temp + ": " + ec.message();
+                return false;
+            }
+            out.write(buffer.data(), buffer.size());
+        }
+        if (std::error_code ec = llvm::sys::fs::rename(temp, objectPath)) {
+            error = "cannot write " + objectPath + ": " + ec.message();
+            return false;
+        }
+        objects.push_back(llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef(buffer.data(), buffer.size()),
+                                                               objectPath));
+    }
+
+    // The JIT resolves these functions in the objects; string constants only
+    // referenced from the deleted bodies go with them
+    for (llvm::Function& function : module) {
+        if (!function.isDeclaration()) function.deleteBody();
+    }
+    for (llvm::GlobalVariable& global : llvm::make_early_inc_range(module.globals())) {
+        if (global.hasLocalLinkage() && global.use_empty()) global.eraseFromParent();
+    }
+
+    return saveIndex(error);
+}
+
+void IncrementalBuild::report(llvm::raw_ostream& out) const {
+    out << llvm::formatv("Incremental build: {0} functions, {1} rebuilt, {2} reused (compile {3:F1} ms, saved ~{4:F1} ms)\n",
+                         rebuilt.size() + reused, rebuilt.size(), reused, compileMs, savedMs);
+    for (const auto& [function, reason] : rebuilt) {
+        out << "  rebuilt " << function << ": " << reason << "\n";
+    }
+}
+
+} // namespace pynext
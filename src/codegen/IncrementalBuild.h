@@ -0,0 +1,96 @@
+#ifndef PYNEXT_INCREMENTAL_BUILD_H
+#define PYNEXT_INCREMENTAL_BUILD_H
+
+#include "../sema/Fingerprint.h"
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// Function-granular incremental compilation (--incremental). Every function
+// is optimized and compiled to its own object file, cached under a key that
+// covers everything its code depends on:
+//   - its signature and normalized body (sema/Fingerprint.h),
+//   - the signatures of the functions it calls,
+//   - the layouts of the structs it uses,
+//   - at -O1 and above, the bodies of its callees, which are copied into
+//     its module as available_externally definitions for the inliner,
+//   - the optimization level, target and code generation options.
+// Editing one function therefore rebuilds it, and at -O1+ its direct callers,
+// which may have inlined it; everything else is loaded from the cache. Only
+// one level of callee bodies is visible, so inlining stops at the edge of a
+// caller's module: a deeper call chain is not flattened as in a whole-module
+// build.
+class IncrementalBuild {
+public:
+    struct Config {
+        std::string cacheDir;   // Object files and the per-source index
+        std::string sourceName; // Names the index, so rebuild reasons survive across runs
+        unsigned optLevel = 0;
+        std::string codegenTag; // CodeGenOptions that change the emitted IR
+        bool withPositions = false; // Debug info records source positions
+    };
+
+    explicit IncrementalBuild(Config config) : config(std::move(config)) {}
+
+    // Fingerprints the functions of a type-checked module whose top-level
+    // statements CodeGen emitted as `entryName`
+    void summarize(const std::vector<std::unique_ptr<Stmt>>& stmts, const std::string& entryName);
+
+    // `name` was imported from another module (--thin-lto) as an
+    // available_externally definition; `bodyKey` changes whenever its body
+    // can. Callers are keyed on it like on the body of a local callee.
+    void addImportedBody(const std::string& name, const std::string& bodyKey);
+
+    // Builds or loads the object of every function defined in `module`, then
+    // deletes those bodies from `module` so the JIT only resolves them. With
+    // `irOut`, the optimized IR of the rebuilt functions is printed there.
+    // Returns false with `error` set if the cache cannot be written.
+    bool build(llvm::Module& module, llvm::TargetMachine& targetMachine, std::string& error,
+               llvm::raw_ostream* irOut = nullptr);
+
+    // Objects to hand to the JIT, one per function
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> takeObjects() { return std::move(objects); }
+
+    // "Incremental build: 12 functions, 2 rebuilt, 10 reused (...)" and why
+    // each function was rebuilt
+    void report(llvm::raw_ostream& out) const;
+
+private:
+    struct IndexEntry {
+        std::string key;
+        std::string bodyHash;
+        double buildMs = 0;
+    };
+
+    std::set<std::string> inlinedBodies(const std::string& function) const;
+    std::string cacheKey(const std::string& function) const;
+    std::string rebuildReason(const std::string& function, const std::string& key) const;
+    std::string indexPath() const;
+    void loadIndex();
+    bool saveIndex(std::string& error) const;
+
+    Config config;
+    std::string configTag;         // Optimization level, options and target of this build
+    std::string previousConfigTag; // ... of the build that wrote the index
+    std::map<std::string, FunctionSummary> summaries;
+    std::map<std::string, std::string> layouts;
+    std::map<std::string, IndexEntry> previous; // From the last build of this source
+    std::map<std::string, IndexEntry> current;
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+    std::vector<std::pair<std::string, std::string>> rebuilt; // Function, reason
+    size_t reused = 0;
+    double compileMs = 0;
+    double savedMs = 0;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_INCREMENTAL_BUILD_H
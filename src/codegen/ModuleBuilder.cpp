@@ -0,0 +1,569 @@
+#include "ModuleBuilder.h"
+#include "Optimizer.h"
+#include "../lexer/Lexer.h"
+#include "../sema/TypeChecker.h"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/IRMover.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Target/TargetOptions.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <unistd.h>
+
+namespace pynext {
+
+namespace {
+
+// Bump when the object layout or the key derivation changes
+constexpr const char* kFormatVersion = "pynext-module-1";
+
+void addField(llvm::MD5& hash, llvm::StringRef field) {
+    hash.update(field);
+    hash.update(llvm::ArrayRef<uint8_t>{0});
+}
+
+std::string hexDigest(llvm::MD5& hash) {
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return result.digest().str().str();
+}
+
+// Null when `path` is empty (no cache) or not cached yet
+std::unique_ptr<llvm::MemoryBuffer> readCacheFile(const std::string& path) {
+    if (path.empty()) return nullptr;
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    return buffer ? std::move(*buffer) : nullptr;
+}
+
+// Written under a temporary name first so a concurrent build never loads a
+// partial file
+void writeCacheFile(const std::string& path, llvm::StringRef data, std::string& error) {
+    if (path.empty()) return;
+    if (std::error_code ec = llvm::sys::fs::create_directories(llvm::sys::path::parent_path(path))) {
+        error = "cannot create " + llvm::sys::path::parent_path(path).str() + ": " + ec.message();
+        return;
+    }
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::error_code ec;
+        llvm::raw_fd_ostream out(temp, ec);
+        if (ec) {
+            error = "cannot write " + temp + ": " + ec.message();
+            return;
+        }
+        out << data;
+    }
+    if (std::error_code ec = llvm::sys::fs::rename(temp, path)) {
+        error = "cannot write " + path + ": " + ec.message();
+    }
+}
+
+} // namespace
+
+bool ModuleBuilder::load(const std::string& importerPath, const std::vector<ImportDecl>& imports,
+                         std::string& error) {
+    std::vector<std::string> stack{importerPath};
+    for (const auto& import : imports) {
+        size_t index;
+        if (!loadModule(importerPath, import, stack, index, error)) return false;
+    }
+    return true;
+}
+
+// Depth-first, so each module is appended after everything it imports.
+// `stack` holds the files being loaded, to report cycles.
+bool ModuleBuilder::loadModule(const std::string& importerPath, const ImportDecl& import,
+                               std::vector<std::string>& stack, size_t& index, std::string& error) {
+    llvm::SmallString<256> path(llvm::sys::path::parent_path(importerPath));
+    llvm::sys::path::append(path, import.module + ".next");
+    llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+    std::string location = importerPath + ":" + std::to_string(import.line) + ": ";
+
+    if (std::find(stack.begin(), stack.end(), std::string(path)) != stack.end()) {
+        error = location + "import cycle: ";
+        for (auto it = std::find(stack.begin(), stack.end(), std::string(path)); it != stack.end(); ++it) {
+            error += llvm::sys::path::stem(*it).str() + " -> ";
+        }
+        error += import.module;
+        return false;
+    }
+    for (size_t i = 0; i < modules.size(); ++i) {
+        if (modules[i]->path == path) {
+            index = i;
+            return true;
+        }
+    }
+
+    std::ifstream file(std::string(path), std::ios::binary);
+    if (!file) {
+        error = location + "cannot find module '" + import.module + "' (looked for " + std::string(path) + ")";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    auto module = std::make_unique<SourceModule>();
+    module->name = import.module;
+    module->path = std::string(path);
+    module->source = buffer.str();
+
+    Lexer lexer(module->source);
+    Parser parser(lexer);
+    module->statements = parser.parseModule();
+    if (parser.hadError()) {
+        error = "syntax error in module '" + import.module + "' (" + module->path + ")";
+        return false;
+    }
+    for (const auto& stmt : module->statements) {
+        auto* func = dynamic_cast<FunctionStmt*>(stmt.get());
+        if (func && func->name == "main") {
+            error = module->path + ":" + std::to_string(func->line) +
+                    ": only the program's own file may define main, not module '" + import.module + "'";
+            return false;
+        }
+    }
+    module->interface = ModuleInterface::fromStatements(module->statements);
+
+    stack.push_back(module->path);
+    for (const auto& nested : parser.getImports()) {
+        size_t nestedIndex;
+        if (!loadModule(module->path, nested, stack, nestedIndex, error)) return false;
+        if (std::find(module->imports.begin(), module->imports.end(), nestedIndex) == module->imports.end()) {
+            module->imports.push_back(nestedIndex);
+        }
+    }
+    stack.pop_back();
+
+    index = modules.size();
+    modules.push_back(std::move(module));
+    return true;
+}
+
+// Everything `module` imports directly or indirectly, in dependency order
+std::vector<size_t> ModuleBuilder::visibleFrom(size_t module) const {
+    std::set<size_t> seen;
+    std::vector<size_t> worklist(modules[module]->imports);
+    while (!worklist.empty()) {
+        size_t next = worklist.back();
+        worklist.pop_back();
+        if (!seen.insert(next).second) continue;
+        worklist.insert(worklist.end(), modules[next]->imports.begin(), modules[next]->imports.end());
+    }
+    return std::vector<size_t>(seen.begin(), seen.end());
+}
+
+std::string ModuleBuilder::interfaceSummary() const {
+    std::string text;
+    for (const auto& module : modules) {
+        text += "module " + module->name + "\n" + module->interface.summary();
+    }
+    return text;
+}
+
+bool ModuleBuilder::declarations(const std::vector<size_t>& visible, const std::vector<std::unique_ptr<Stmt>>& own,
+                                 const std::string& ownName, std::vector<std::unique_ptr<Stmt>>& out,
+                                 std::string& error) const {
+    std::map<std::string, std::string> owners;
+    auto claim = [&](const std::string& name, const std::string& owner) {
+        auto [it, inserted] = owners.emplace(name, owner);
+        if (inserted || it->second == owner) return true;
+        error = "'" + name + "' is defined in both " + it->second + " and " + owner;
+        return false;
+    };
+
+    for (size_t i : visible) {
+        const SourceModule& module = *modules[i];
+        for (const auto& decl : module.interface.structs) {
+            if (!claim(decl.name, module.path)) return false;
+        }
+        for (const auto& decl : module.interface.enums) {
+            if (!claim(decl.name, module.path)) return false;
+        }
+        for (const auto& func : module.interface.functions) {
+            if (!claim(func.name, module.path)) return false;
+        }
+    }
+    for (const auto& stmt : own) {
+        if (auto* decl = dynamic_cast<StructDeclStmt*>(stmt.get())) {
+            if (!claim(decl->name, ownName)) return false;
+        } else if (auto* decl = dynamic_cast<EnumDeclStmt*>(stmt.get())) {
+            if (!claim(decl->name, ownName)) return false;
+        } else if (auto* func = dynamic_cast<FunctionStmt*>(stmt.get())) {
+            if (func->body && !claim(func->name, ownName)) return false;
+        }
+    }
+
+    for (size_t i : visible) modules[i]->interface.appendDeclarations(out);
+    return true;
+}
+
+bool ModuleBuilder::prependInterfaces(std::vector<std::unique_ptr<Stmt>>& statements, std::string& error) const {
+    std::vector<size_t> all(modules.size());
+    for (size_t i = 0; i < all.size(); ++i) all[i] = i;
+
+    std::vector<std::unique_ptr<Stmt>> combined;
+    if (!declarations(all, statements, "the program", combined, error)) return false;
+    for (auto& stmt : statements) combined.push_back(std::move(stmt));
+    statements = std::move(combined);
+    return true;
+}
+
+// Everything a module's code depends on: its own text, the interfaces it was
+// checked against, the options and the target
+std::string ModuleBuilder::moduleKey(size_t index, const llvm::TargetMachine& targetMachine) const {
+    const SourceModule& module = *modules[index];
+    llvm::MD5 hash;
+    addField(hash, kFormatVersion);
+    addField(hash, "O" + std::to_string(options.optLevel));
+    addField(hash, "fp" + std::to_string(options.codegen.framePointers) + ";g" +
+                       std::to_string(static_cast<int>(options.codegen.debugInfo)));
+    addField(hash, targetMachine.getTargetTriple().str());
+    addField(hash, targetMachine.getTargetCPU());
+    addField(hash, targetMachine.getTargetFeatureString());
+    addField(hash, module.path);
+    addField(hash, module.source);
+    for (size_t i : visibleFrom(index)) addField(hash, modules[i]->interface.summary());
+    return hexDigest(hash);
+}
+
+std::string ModuleBuilder::cachePath(size_t index, const std::string& key, const std::string& extension) const {
+    if (options.cacheDir.empty()) return "";
+    return options.cacheDir + "/module." + modules[index]->name + "." + key + extension;
+}
+
+void ModuleBuilder::startCompile(const llvm::TargetMachine& targetMachine, const Options& buildOptions) {
+    options = buildOptions;
+    if (options.optLevel == 0) options.thinLTO = false; // Nothing would be inlined
+    compileStart = std::chrono::steady_clock::now();
+    results.resize(modules.size());
+    errors.assign(modules.size(), "");
+
+    // Target machines are not shared between threads
+    for (size_t i = 0; i < modules.size(); ++i) {
+        modules[i]->key = moduleKey(i, targetMachine);
+        results[i].name = modules[i]->name;
+        results[i].initFunction = "__init." + modules[i]->name;
+        targetMachines.emplace_back(targetMachine.getTarget().createTargetMachine(
+            targetMachine.getTargetTriple().str(), targetMachine.getTargetCPU(),
+            targetMachine.getTargetFeatureString(), targetMachine.Options, targetMachine.getRelocationModel(),
+            targetMachine.getCodeModel(), targetMachine.getOptLevel(), /*JIT=*/true));
+    }
+
+    // Modules only depend on each other's interfaces, so all of them compile at once
+    pool = std::make_unique<llvm::ThreadPool>(llvm::hardware_concurrency(options.threads));
+    for (size_t i = 0; i < modules.size(); ++i) {
+        if (options.thinLTO) {
+            pool->async([this, i] { preLinkModule(i, *targetMachines[i]); });
+        } else {
+            pool->async([this, i] { compileModule(i, *targetMachines[i]); });
+        }
+    }
+}
+
+// Type-checks and generates the IR of a module. Returns null with the
+// module's error set on failure.
+std::unique_ptr<llvm::Module> ModuleBuilder::generateModule(size_t index, llvm::LLVMContext& context,
+                                                            llvm::TargetMachine& targetMachine) {
+    SourceModule& module = *modules[index];
+    std::vector<std::unique_ptr<Stmt>> statements;
+    if (!declarations(visibleFrom(index), module.statements, module.path, statements, errors[index])) return nullptr;
+    for (auto& stmt : module.statements) statements.push_back(std::move(stmt));
+
+    TypeChecker checker;
+    checker.check(statements);
+    if (checker.getErrorCount() > 0) {
+        errors[index] = std::to_string(checker.getErrorCount()) + " type error(s) in module '" + module.name +
+                        "' (" + module.path + ")";
+        return nullptr;
+    }
+
+    CodeGenOptions codegenOptions = options.codegen;
+    codegenOptions.sourceFile = module.path;
+    CodeGen codegen(context, codegenOptions);
+    codegen.generate(statements, results[index].initFunction);
+    std::unique_ptr<llvm::Module> irModule = codegen.releaseModule();
+    irModule->setModuleIdentifier(module.name);
+    irModule->setDataLayout(targetMachine.createDataLayout());
+    irModule->setTargetTriple(targetMachine.getTargetTriple().str());
+    return irModule;
+}
+
+// Compiles an optimized module to the object the JIT links, and caches it
+void ModuleBuilder::emitModule(size_t index, llvm::Module& module, llvm::TargetMachine& targetMachine,
+                               const std::string& key, std::chrono::steady_clock::time_point start) {
+    CompiledModule& result = results[index];
+    llvm::SmallVector<char, 0> object;
+    if (!emitObjectFile(module, targetMachine, object, errors[index])) return;
+    llvm::StringRef data(object.data(), object.size());
+    result.object = llvm::MemoryBuffer::getMemBufferCopy(data, modules[index]->path);
+    result.compileMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    writeCacheFile(cachePath(index, key, ".o"), data, errors[index]);
+}
+
+void ModuleBuilder::compileModule(size_t index, llvm::TargetMachine& targetMachine) {
+    auto start = std::chrono::steady_clock::now();
+    CompiledModule& result = results[index];
+    std::string key = modules[index]->key;
+    if (auto cached = readCacheFile(cachePath(index, key, ".o"))) {
+        result.object = std::move(cached);
+        result.reused = true;
+        return;
+    }
+
+    llvm::LLVMContext context;
+    std::unique_ptr<llvm::Module> irModule = generateModule(index, context, targetMachine);
+    if (!irModule) return;
+    optimizeModule(*irModule, options.optLevel, &targetMachine);
+    emitModule(index, *irModule, targetMachine, key, start);
+}
+
+// ThinLTO pre-link: simplify the module, then keep it as bitcode with its
+// summary until the thin link has decided what it imports
+void ModuleBuilder::preLinkModule(size_t index, llvm::TargetMachine& targetMachine) {
+    auto start = std::chrono::steady_clock::now();
+    SourceModule& module = *modules[index];
+    std::string path = cachePath(index, module.key, ".thin.bc");
+    if (auto cached = readCacheFile(path)) {
+        auto summary = llvm::getModuleSummaryIndex(cached->getMemBufferRef());
+        if (summary) {
+            module.bitcode = std::move(cached);
+            module.summary = std::move(*summary);
+            return;
+        }
+        llvm::consumeError(summary.takeError()); // Rebuilt below
+    }
+
+    llvm::LLVMContext context;
+    std::unique_ptr<llvm::Module> irModule = generateModule(index, context, targetMachine);
+    if (!irModule) return;
+    // An imported function that uses the module's top-level variables must
+    // refer to the exporter's copy, so they get exported, under names
+    // qualified by the module
+    for (llvm::GlobalVariable& global : irModule->globals()) {
+        if (!global.hasLocalLinkage() || global.isConstant()) continue;
+        global.setName(module.name + "." + global.getName());
+        global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+    optimizeModule(*irModule, options.optLevel, &targetMachine, {}, LTOPhase::ThinPreLink);
+
+    llvm::ProfileSummaryInfo profileSummary(*irModule);
+    module.summary = std::make_unique<llvm::ModuleSummaryIndex>(
+        llvm::buildModuleSummaryIndex(*irModule, nullptr, &profileSummary));
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream(bitcode);
+    llvm::WriteBitcodeToFile(*irModule, stream, /*ShouldPreserveUseListOrder=*/false, module.summary.get());
+    llvm::StringRef data(bitcode.data(), bitcode.size());
+    module.bitcode = llvm::MemoryBuffer::getMemBufferCopy(data, module.path);
+    results[index].compileMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    writeCacheFile(path, data, errors[index]);
+}
+
+// The functions `importer` should import, by exporting module: the callees
+// of its functions that are defined elsewhere and no larger than an
+// instruction limit, then their callees under a limit 0.7 times as large,
+// and so on, as LLVM's function importer does without a profile.
+// `importer` is modules.size() for the program.
+std::map<size_t, std::vector<std::string>> ModuleBuilder::selectImports(const llvm::ModuleSummaryIndex& summary,
+                                                                        size_t importer) const {
+    constexpr double kInstructionLimit = 100;
+    constexpr double kLimitDecay = 0.7;
+
+    std::vector<std::pair<llvm::GlobalValue::GUID, double>> worklist;
+    auto addCalls = [&worklist](const llvm::GlobalValueSummary& caller, double limit) {
+        if (auto* function = llvm::dyn_cast<llvm::FunctionSummary>(caller.getBaseObject())) {
+            for (const auto& call : function->calls()) worklist.emplace_back(call.first.getGUID(), limit);
+        }
+    };
+    for (const auto& [guid, info] : summary) {
+        for (const auto& caller : info.SummaryList) addCalls(*caller, kInstructionLimit);
+    }
+
+    std::map<llvm::GlobalValue::GUID, double> importedAt;
+    std::map<size_t, std::set<std::string>> chosen;
+    while (!worklist.empty()) {
+        auto [guid, limit] = worklist.back();
+        worklist.pop_back();
+        auto owner = definedIn.find(guid);
+        if (owner == definedIn.end() || owner->second == importer) continue;
+        if (importedAt.count(guid) && importedAt[guid] >= limit) continue;
+
+        llvm::ValueInfo callee = modules[owner->second]->summary->getValueInfo(guid);
+        if (!callee || callee.getSummaryList().empty()) continue;
+        const llvm::GlobalValueSummary& definition = *callee.getSummaryList().front();
+        auto* function = llvm::dyn_cast<llvm::FunctionSummary>(definition.getBaseObject());
+        if (!function || function->fflags().NoInline || function->instCount() > limit) continue;
+
+        importedAt[guid] = limit;
+        chosen[owner->second].insert(functionNames.at(guid));
+        addCalls(definition, limit * kLimitDecay);
+    }
+
+    std::map<size_t, std::vector<std::string>> imports;
+    for (auto& [module, names] : chosen) imports[module].assign(names.begin(), names.end());
+    return imports;
+}
+
+// Links the chosen functions into `into` as available_externally
+// definitions. Only their bodies are read from the exporters' bitcode;
+// whatever else they reference becomes a declaration resolved by the JIT.
+bool ModuleBuilder::linkImports(llvm::Module& into, const std::map<size_t, std::vector<std::string>>& imports,
+                                std::string& error) const {
+    llvm::IRMover mover(into);
+    for (const auto& [exporter, names] : imports) {
+        auto source = llvm::getLazyBitcodeModule(modules[exporter]->bitcode->getMemBufferRef(), into.getContext());
+        if (!source) {
+            error = "cannot read the bitcode of module '" + modules[exporter]->name +
+                    "': " + llvm::toString(source.takeError());
+            return false;
+        }
+        std::vector<llvm::GlobalValue*> functions;
+        for (const auto& name : names) {
+            llvm::Function* function = (*source)->getFunction(name);
+            if (!function) continue;
+            if (llvm::Error e = function->materialize()) {
+                error = "cannot import '" + name + "': " + llvm::toString(std::move(e));
+                return false;
+            }
+            function->setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+            functions.push_back(function);
+        }
+        if (llvm::Error e = (*source)->materializeMetadata()) {
+            error = "cannot import from module '" + modules[exporter]->name + "': " + llvm::toString(std::move(e));
+            return false;
+        }
+        if (llvm::Error e = mover.move(std::move(*source), functions,
+                                       [](llvm::GlobalValue&, llvm::IRMover::ValueAdder) {},
+                                       /*IsPerformingImport=*/true)) {
+            error = "cannot import from module '" + modules[exporter]->name + "': " + llvm::toString(std::move(e));
+            return false;
+        }
+    }
+    return true;
+}
+
+// ThinLTO post-link: import, then optimize and compile as usual. The object
+// is keyed by the module and by the modules it imported from.
+void ModuleBuilder::postLinkModule(size_t index, llvm::TargetMachine& targetMachine) {
+    auto start = std::chrono::steady_clock::now();
+    SourceModule& module = *modules[index];
+    CompiledModule& result = results[index];
+
+    llvm::MD5 hash;
+    addField(hash, module.key);
+    addField(hash, "thin-lto");
+    for (const auto& [exporter, names] : module.importedFunctions) {
+        addField(hash, modules[exporter]->key);
+        for (const auto& name : names) {
+            addField(hash, name);
+            result.imported.push_back(name);
+        }
+    }
+    std::string key = hexDigest(hash);
+    if (auto cached = readCacheFile(cachePath(index, key, ".o"))) {
+        result.object = std::move(cached);
+        result.reused = true;
+        return;
+    }
+
+    llvm::LLVMContext context;
+    auto irModule = llvm::parseBitcodeFile(module.bitcode->getMemBufferRef(), context);
+    if (!irModule) {
+        errors[index] = "cannot read the bitcode of module '" + module.name +
+                        "': " + llvm::toString(irModule.takeError());
+        return;
+    }
+    if (!linkImports(**irModule, module.importedFunctions, errors[index])) return;
+    optimizeModule(**irModule, options.optLevel, &targetMachine, {}, LTOPhase::ThinPostLink);
+    emitModule(index, **irModule, targetMachine, key, start);
+}
+
+// The thin link: once every summary is in, decide what each module imports
+// and start the post-link half
+bool ModuleBuilder::thinLink(std::string& error) {
+    if (!options.thinLTO || linked) return true;
+    linked = true;
+    pool->wait();
+    for (const auto& message : errors) {
+        if (message.empty()) continue;
+        error = message;
+        return false;
+    }
+
+    for (size_t i = 0; i < modules.size(); ++i) {
+        for (const auto& function : modules[i]->interface.functions) {
+            llvm::GlobalValue::GUID guid = llvm::GlobalValue::getGUID(function.name);
+            definedIn[guid] = i;
+            functionNames[guid] = function.name;
+        }
+    }
+    for (size_t i = 0; i < modules.size(); ++i) {
+        modules[i]->importedFunctions = selectImports(*modules[i]->summary, i);
+    }
+    for (size_t i = 0; i < modules.size(); ++i) {
+        pool->async([this, i] { postLinkModule(i, *targetMachines[i]); });
+    }
+    return true;
+}
+
+bool ModuleBuilder::importInto(llvm::Module& program, std::map<std::string, std::string>& imported,
+                               std::string& error) {
+    if (!options.thinLTO) return true;
+    if (!thinLink(error)) return false;
+
+    llvm::ProfileSummaryInfo profileSummary(program);
+    llvm::ModuleSummaryIndex summary = llvm::buildModuleSummaryIndex(program, nullptr, &profileSummary);
+    std::map<size_t, std::vector<std::string>> imports = selectImports(summary, modules.size());
+    if (!linkImports(program, imports, error)) return false;
+    for (const auto& [exporter, names] : imports) {
+        for (const auto& name : names) {
+            imported[name] = modules[exporter]->key;
+            programImports.push_back(name);
+        }
+    }
+    return true;
+}
+
+bool ModuleBuilder::finishCompile(std::string& error) {
+    if (!pool) return true;
+    if (!thinLink(error)) return false;
+    pool->wait();
+    wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+    targetMachines.clear();
+    for (const auto& message : errors) {
+        if (message.empty()) continue;
+        error = message;
+        return false;
+    }
+    return true;
+}
+
+void ModuleBuilder::report(llvm::raw_ostream& out) const {
+    size_t reused = std::count_if(results.begin(), results.end(), [](const CompiledModule& m) { return m.reused; });
+    unsigned threads = pool ? pool->getThreadCount() : 0;
+    out << llvm::formatv("Modules: {0} ({1} compiled, {2} reused) in {3:F1} ms on {4} thread{5}\n", results.size(),
+                         results.size() - reused, reused, wallMs, threads, threads == 1 ? "" : "s");
+    if (!options.thinLTO) return;
+    auto list = [](const std::vector<std::string>& names) {
+        if (names.empty()) return std::string("(none)");
+        std::string text;
+        for (const auto& name : names) text += (text.empty() ? "" : ", ") + name;
+        return text;
+    };
+    out << "  imported into the program: " << list(programImports) << "\n";
+    for (const auto& result : results) {
+        out << "  imported into " << result.name << ": " << list(result.imported) << "\n";
+    }
+}
+
+} // namespace pynext
@@ -0,0 +1,66 @@
+#include "Optimizer.h"
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <optional>
+
+namespace pynext {
+
+void optimizeModule(llvm::Module& module, unsigned optLevel, llvm::TargetMachine* targetMachine,
+                    const ProfileGuidance& profile, LTOPhase phase) {
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    // Match clang: vectorize from -O2 up
+    llvm::PipelineTuningOptions tuning;
+    tuning.LoopVectorization = optLevel >= 2;
+    tuning.SLPVectorization = optLevel >= 2;
+
+    std::optional<llvm::PGOOptions> pgo;
+    if (profile.mode == ProfileGuidance::Mode::Generate) {
+        pgo = llvm::PGOOptions("", "", "", "", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRInstr);
+    } else if (profile.mode == ProfileGuidance::Mode::Use) {
+        pgo = llvm::PGOOptions(profile.profilePath, "", "", "", llvm::vfs::getRealFileSystem(),
+                               llvm::PGOOptions::IRUse);
+    }
+
+    llvm::PassBuilder passBuilder(targetMachine, tuning, pgo);
+    passBuilder.registerModuleAnalyses(mam);
+    passBuilder.registerCGSCCAnalyses(cgam);
+    passBuilder.registerFunctionAnalyses(fam);
+    passBuilder.registerLoopAnalyses(lam);
+    passBuilder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::OptimizationLevel level = optLevel == 1   ? llvm::OptimizationLevel::O1
+                                    : optLevel == 2 ? llvm::OptimizationLevel::O2
+                                                    : llvm::OptimizationLevel::O3;
+    llvm::ModulePassManager mpm;
+    if (optLevel == 0) {
+        mpm = passBuilder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+    } else if (phase == LTOPhase::ThinPreLink) {
+        mpm = passBuilder.buildThinLTOPreLinkDefaultPipeline(level);
+    } else if (phase == LTOPhase::ThinPostLink) {
+        // Imports were chosen by ModuleBuilder, so there is no combined index
+        mpm = passBuilder.buildThinLTODefaultPipeline(level, nullptr);
+    } else {
+        mpm = passBuilder.buildPerModuleDefaultPipeline(level);
+    }
+    mpm.run(module, mam);
+}
+
+bool emitObjectFile(llvm::Module& module, llvm::TargetMachine& targetMachine, llvm::SmallVectorImpl<char>& object,
+                    std::string& error) {
+    llvm::raw_svector_ostream stream(object);
+    llvm::legacy::PassManager passes;
+    if (targetMachine.addPassesToEmitFile(passes, stream, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+        error = "the target cannot emit object files";
+        return false;
+    }
+    passes.run(module);
+    return true;
+}
+
+} // namespace pynext
@@ -0,0 +1,52 @@
+#ifndef PYNEXT_OPTIMIZER_H
+#define PYNEXT_OPTIMIZER_H
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+#include <string>
+
+namespace pynext {
+
+// Profile-guided optimization (--pgo-gen / --pgo-use)
+struct ProfileGuidance {
+    enum class Mode { None, Generate, Use };
+    Mode mode = Mode::None;
+    std::string profilePath; // Indexed .profdata file read in Mode::Use
+};
+
+// Which half of a ThinLTO build a module is optimized for (--thin-lto).
+// ThinPreLink simplifies a module before its summary is taken and stops short
+// of the passes that would get in the way of importing; ThinPostLink runs
+// the full pipeline over a module that functions of other modules were
+// imported into.
+enum class LTOPhase { None, ThinPreLink, ThinPostLink };
+
+// Runs LLVM's default -O<level> module pipeline (level 0..3) over `module`.
+// `targetMachine` may be null, in which case target-independent cost models are used.
+// Mode::Generate adds LLVM's IR-level PGO instrumentation, collected afterwards by
+// runtime/ProfileRuntime.h; Mode::Use attaches branch weights and function entry
+// counts from the profile before the optimization passes run. Train and use a
+// profile at the same optimization level, since the pipeline determines the CFG
+// the counters describe.
+void optimizeModule(llvm::Module& module, unsigned optLevel, llvm::TargetMachine* targetMachine,
+                    const ProfileGuidance& profile = {}, LTOPhase phase = LTOPhase::None);
+
+// Compiles `module`, already optimized, to a relocatable object for the
+// target of `targetMachine` and appends it to `object`
+bool emitObjectFile(llvm::Module& module, llvm::TargetMachine& targetMachine, llvm::SmallVectorImpl<char>& object,
+                    std::string& error);
+
+// Backend (instruction selection, scheduling, register allocation) level for -O<level>
+inline llvm::CodeGenOptLevel codeGenOptLevel(unsigned optLevel) {
+    switch (optLevel) {
+        case 0: return llvm::CodeGenOptLevel::None;
+        case 1: return llvm::CodeGenOptLevel::Less;
+        case 2: return llvm::CodeGenOptLevel::Default;
+        default: return llvm::CodeGenOptLevel::Aggressive;
+    }
+}
+
+} // namespace pynext
+
+#endif // PYNEXT_OPTIMIZER_H
@@ -0,0 +1,113 @@
+#include "Remarks.h"
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/Remarks/RemarkStreamer.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/raw_ostream.h>
+#include <vector>
+
+namespace pynext {
+
+namespace {
+
+class RemarkPrinter : public llvm::DiagnosticHandler {
+public:
+    RemarkPrinter(const RemarkOptions& options, llvm::StringRef source) {
+        if (!options.passed.empty()) passed = std::make_unique<llvm::Regex>(options.passed);
+        if (!options.missed.empty()) missed = std::make_unique<llvm::Regex>(options.missed);
+        if (!options.analysis.empty()) analysis = std::make_unique<llvm::Regex>(options.analysis);
+        source.split(lines, '\n');
+    }
+
+    bool isPassedOptRemarkEnabled(llvm::StringRef pass) const override { return passed && passed->match(pass); }
+    bool isMissedOptRemarkEnabled(llvm::StringRef pass) const override { return missed && missed->match(pass); }
+    bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override { return analysis && analysis->match(pass); }
+    bool isAnyRemarkEnabled() const override { return passed || missed || analysis; }
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+        auto* remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+        if (!remark) return false; // Errors and warnings keep LLVM's default printing
+
+        llvm::StringRef pass = remark->getPassName();
+        const char* flag = "-Rpass-analysis";
+        bool enabled = isAnalysisRemarkEnabled(pass);
+        if (remark->isPassed()) {
+            flag = "-Rpass";
+            enabled = isPassedOptRemarkEnabled(pass);
+        } else if (remark->isMissed()) {
+            flag = "-Rpass-missed";
+            enabled = isMissedOptRemarkEnabled(pass);
+        }
+        if (!enabled) return true;
+
+        llvm::raw_ostream& out = llvm::errs();
+        if (!remark->isLocationAvailable()) {
+            out << remark->getFunction().getName() << ": remark: " << remark->getMsg() << " [" << flag << "="
+                << pass << "]\n";
+            return true;
+        }
+
+        llvm::StringRef file;
+        unsigned line = 0, column = 0;
+        remark->getLocation(file, line, column);
+        out << file << ":" << line << ":" << column << ": remark: " << remark->getMsg() << " [" << flag << "="
+            << pass << "]\n";
+        if (line == 0 || line > lines.size()) return true;
+
+        // Quote the line with a caret under the column, keeping tabs so it lines up
+        llvm::StringRef text = lines[line - 1].rtrim();
+        out << text << "\n";
+        if (column > 0) {
+            std::string caret;
+            for (unsigned i = 0; i + 1 < column && i < text.size(); ++i) caret += text[i] == '\t' ? '\t' : ' ';
+            out << caret << "^\n";
+        }
+        return true;
+    }
+
+private:
+    std::unique_ptr<llvm::Regex> passed;
+    std::unique_ptr<llvm::Regex> missed;
+    std::unique_ptr<llvm::Regex> analysis;
+    llvm::SmallVector<llvm::StringRef, 0> lines;
+};
+
+} // namespace
+
+bool OptimizationRemarks::enable(llvm::LLVMContext& context, const RemarkOptions& options, llvm::StringRef source,
+                                 std::string& error) {
+    for (const std::string* pattern : {&options.passed, &options.missed, &options.analysis}) {
+        if (pattern->empty()) continue;
+        std::string reason;
+        if (!llvm::Regex(*pattern).isValid(reason)) {
+            error = "invalid remark regex '" + *pattern + "': " + reason;
+            return false;
+        }
+    }
+
+    if (!options.yamlPath.empty()) {
+        auto file = llvm::setupLLVMOptimizationRemarks(context, options.yamlPath, "", "yaml", false);
+        if (!file) {
+            error = "cannot create " + options.yamlPath + ": " + llvm::toString(file.takeError());
+            return false;
+        }
+        yamlFile = std::move(*file);
+        this->context = &context;
+    }
+
+    context.setDiagnosticHandler(std::make_unique<RemarkPrinter>(options, source));
+    return true;
+}
+
+void OptimizationRemarks::finish() {
+    if (!yamlFile) return;
+    // Detach the streamers first, they write through the file's stream
+    context->setLLVMRemarkStreamer(nullptr);
+    context->setMainRemarkStreamer(nullptr);
+    yamlFile->keep();
+    yamlFile.reset();
+}
+
+} // namespace pynext
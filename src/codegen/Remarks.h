@@ -0,0 +1,44 @@
+#ifndef PYNEXT_REMARKS_H
+#define PYNEXT_REMARKS_H
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <memory>
+#include <string>
+
+namespace pynext {
+
+// Optimization remarks (-Rpass=, -Rpass-missed=, -Rpass-analysis=, --remarks-yaml=)
+struct RemarkOptions {
+    std::string passed;   // Regex over pass names whose applied optimizations are printed
+    std::string missed;   // ... whose missed optimizations are printed
+    std::string analysis; // ... whose analysis remarks (reasons for missing) are printed
+    std::string yamlPath; // Every remark of every pass, as YAML for opt-viewer and scripts
+
+    bool enabled() const { return !passed.empty() || !missed.empty() || !analysis.empty() || !yamlPath.empty(); }
+};
+
+// Collects the optimization remarks that LLVM's passes emit while `context`
+// optimizes and JIT-compiles a module. Remarks are located through the
+// module's debug locations, so compile with at least line tables.
+class OptimizationRemarks {
+public:
+    // Installs a diagnostic handler that prints selected remarks to stderr as
+    // "file:line:col: remark: ..." followed by the line from `source`, and
+    // opens the YAML file if requested. Returns false with `error` set if a
+    // regex is invalid or the file cannot be created.
+    bool enable(llvm::LLVMContext& context, const RemarkOptions& options, llvm::StringRef source,
+                std::string& error);
+
+    // Closes the YAML file. Call once the JIT has compiled the module, since
+    // the code generator emits remarks too (register allocation, for example).
+    void finish();
+
+private:
+    llvm::LLVMContext* context = nullptr;
+    std::unique_ptr<llvm::ToolOutputFile> yamlFile;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_REMARKS_H
@@ -0,0 +1,221 @@
+#include "ReplSession.h"
+#include "../codegen/Optimizer.h"
+#include "../lexer/Lexer.h"
+#include "../parser/Parser.h"
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <chrono>
+
+namespace pynext {
+
+bool ReplSession::init(std::string& error) {
+    auto machineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!machineBuilder) {
+        error = llvm::toString(machineBuilder.takeError());
+        return false;
+    }
+    machineBuilder->setCodeGenOptLevel(codeGenOptLevel(optLevel));
+
+    auto machine = machineBuilder->createTargetMachine();
+    if (!machine) {
+        error = llvm::toString(machine.takeError());
+        return false;
+    }
+    targetMachine = std::move(*machine);
+
+    llvm::orc::LLJITBuilder builder;
+    builder.setJITTargetMachineBuilder(std::move(*machineBuilder));
+    if (!listeners.empty()) {
+        builder.setObjectLinkingLayerCreator([this](llvm::orc::ExecutionSession& session, const llvm::Triple&) {
+            auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+                session, [] { return std::make_unique<llvm::SectionMemoryManager>(); });
+            for (llvm::JITEventListener* listener : listeners) layer->registerJITEventListener(*listener);
+            return std::unique_ptr<llvm::orc::ObjectLayer>(std::move(layer));
+        });
+    }
+    auto created = builder.create();
+    if (!created) {
+        error = llvm::toString(created.takeError());
+        return false;
+    }
+    jit = std::move(*created);
+
+    // malloc, free and the runtime hooks come from the host process
+    auto processSymbols =
+        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(jit->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        error = llvm::toString(processSymbols.takeError());
+        return false;
+    }
+    jit->getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+    auto llvmContext = std::make_unique<llvm::LLVMContext>();
+    context = llvm::orc::ThreadSafeContext(std::move(llvmContext));
+
+    CodeGenOptions options;
+    options.topLevelGlobals = true;
+    codegen = std::make_unique<CodeGen>(*context.getContext(), options);
+    return true;
+}
+
+void ReplSession::addSymbol(llvm::StringRef name, void* address) {
+    llvm::orc::SymbolMap symbols;
+    symbols[jit->mangleAndIntern(name)] =
+        llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(address), llvm::JITSymbolFlags::Exported);
+    llvm::cantFail(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))));
+}
+
+bool ReplSession::isComplete(const std::string& source) {
+    Lexer lexer(source);
+    int depth = 0;
+    TokenKind previous = TokenKind::EndOfFile;
+    for (Token token = lexer.nextToken(); token.kind != TokenKind::EndOfFile; token = lexer.nextToken()) {
+        switch (token.kind) {
+            case TokenKind::Def:
+                if (previous != TokenKind::Extern) depth++; // Externs have no body
+                break;
+            case TokenKind::Struct:
+            case TokenKind::Enum:
+            case TokenKind::Match:
+            case TokenKind::If:
+            case TokenKind::While:
+            case TokenKind::For:
+            case TokenKind::LParen:
+            case TokenKind::LBracket:
+                depth++;
+                break;
+            case TokenKind::End:
+            case TokenKind::RParen:
+            case TokenKind::RBracket:
+                depth--;
+                break;
+            default:
+                break;
+        }
+        previous = token.kind;
+    }
+    // Excess closers are left for the parser to report
+    return depth <= 0;
+}
+
+bool ReplSession::run(const std::string& source) {
+    auto start = std::chrono::steady_clock::now();
+
+    Lexer lexer(source);
+    Parser parser(lexer);
+    auto stmts = parser.parseModule();
+    if (parser.hadError()) return false;
+    if (!parser.getImports().empty()) {
+        std::cerr << "Error: 'import' is not supported in the REPL\n";
+        return false;
+    }
+    if (stmts.empty()) return true;
+
+    // Callers compiled earlier are bound to the first definition
+    for (const auto& stmt : stmts) {
+        if (auto func = dynamic_cast<FunctionStmt*>(stmt.get())) {
+            if (func->body && definedFunctions.count(func->name)) {
+                std::cerr << "Error: function '" << func->name << "' is already defined in this session\n";
+                return false;
+            }
+        } else if (auto decl = dynamic_cast<StructDeclStmt*>(stmt.get())) {
+            if (definedStructs.count(decl->name)) {
+                std::cerr << "Error: struct '" << decl->name << "' is already defined in this session\n";
+                return false;
+            }
+        } else if (auto decl = dynamic_cast<EnumDeclStmt*>(stmt.get())) {
+            if (definedEnums.count(decl->name)) {
+                std::cerr << "Error: enum '" << decl->name << "' is already defined in this session\n";
+                return false;
+            }
+        }
+    }
+
+    // Everything the chunk adds is undone if any later step fails
+    TypeChecker previous = checker;
+    CodeGen::ChunkState previousCodegen = codegen->saveChunkState();
+    llvm::orc::ResourceTrackerSP tracker = jit->getMainJITDylib().createResourceTracker();
+    auto discard = [&] {
+        checker = std::move(previous);
+        codegen->restoreChunkState(std::move(previousCodegen));
+        llvm::cantFail(tracker->remove());
+        return false;
+    };
+
+    size_t errors = checker.getErrorCount();
+    checker.check(stmts);
+    if (checker.getErrorCount() != errors) return discard();
+
+    // Echo the value of a trailing expression
+    if (auto exprStmt = dynamic_cast<ExprStmt*>(stmts.back().get())) {
+        auto binary = dynamic_cast<BinaryExpr*>(exprStmt->expr.get());
+        const char* printer = nullptr;
+        switch (exprStmt->expr->type->kind) {
+            case TypeKind::Int: printer = "print_int"; break;
+            case TypeKind::Float: printer = "print_float"; break;
+            case TypeKind::String: printer = "print_string"; break;
+            default: break;
+        }
+        if (printer && !(binary && binary->op == "=")) {
+            std::vector<std::unique_ptr<Expr>> args;
+            args.push_back(std::move(exprStmt->expr));
+            exprStmt->expr = std::make_unique<CallExpr>(printer, std::move(args));
+        }
+    }
+
+    std::string entryName = "__repl." + std::to_string(++chunks);
+    std::unique_ptr<llvm::Module> module = codegen->generateChunk(stmts, entryName);
+    if (llvm::verifyModule(*module, &llvm::errs())) {
+        std::cerr << "Error: invalid code generated for this input\n";
+        return discard();
+    }
+    module->setDataLayout(jit->getDataLayout());
+    module->setTargetTriple(jit->getTargetTriple().str());
+    optimizeModule(*module, optLevel, targetMachine.get());
+
+    if (llvm::Error error = jit->addIRModule(tracker, llvm::orc::ThreadSafeModule(std::move(module), context))) {
+        std::cerr << "JIT Error: " << llvm::toString(std::move(error)) << "\n";
+        return discard();
+    }
+
+    // Looking the entry up compiles this chunk (and only this chunk)
+    auto symbol = jit->lookup(entryName);
+    if (!symbol) {
+        std::cerr << "JIT Error: " << llvm::toString(symbol.takeError()) << "\n";
+        return discard();
+    }
+    for (const auto& stmt : stmts) {
+        if (auto func = dynamic_cast<FunctionStmt*>(stmt.get())) {
+            if (func->body) definedFunctions.insert(func->name);
+        } else if (auto decl = dynamic_cast<StructDeclStmt*>(stmt.get())) {
+            definedStructs.insert(decl->name);
+        } else if (auto decl = dynamic_cast<EnumDeclStmt*>(stmt.get())) {
+            definedEnums.insert(decl->name);
+        }
+    }
+    auto* entry = symbol->toPtr<int64_t (*)()>();
+    auto compiled = std::chrono::steady_clock::now();
+    entry();
+
+    if (timing) {
+        auto done = std::chrono::steady_clock::now();
+        llvm::errs() << llvm::formatv("[compile {0:F2} ms, run {1:F2} ms]\n",
+                                      std::chrono::duration<double, std::milli>(compiled - start).count(),
+                                      std::chrono::duration<double, std::milli>(done - compiled).count());
+    }
+    return true;
+}
+
+void* ReplSession::lookup(llvm::StringRef name) {
+    auto symbol = jit->lookup(name);
+    if (!symbol) {
+        llvm::consumeError(symbol.takeError());
+        return nullptr;
+    }
+    return symbol->toPtr<void*>();
+}
+
+} // namespace pynext
@@ -0,0 +1,67 @@
+#ifndef PYNEXT_REPL_SESSION_H
+#define PYNEXT_REPL_SESSION_H
+
+#include "../codegen/CodeGen.h"
+#include "../sema/TypeChecker.h"
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// One ORC JIT session behind `pynext repl`. Each chunk of input is parsed,
+// checked against the symbols of all earlier chunks, compiled into its own
+// module and run. Earlier chunks are never recompiled: their functions,
+// structs and top-level variables are linked by symbol name.
+class ReplSession {
+public:
+    explicit ReplSession(unsigned optLevel) : optLevel(optLevel) {}
+
+    // Creates the JIT for the host. Returns false with `error` set on failure.
+    bool init(std::string& error);
+
+    // Tells `listener` about every object the session loads (--perf-map,
+    // --jitdump, --gdb-jit). Call before init(): with listeners, objects are
+    // linked by RuntimeDyld, which notifies them, instead of JITLink.
+    void addEventListener(llvm::JITEventListener* listener) { listeners.push_back(listener); }
+
+    // Makes a host function callable from PyNext code (declare it with `extern def`)
+    void addSymbol(llvm::StringRef name, void* address);
+
+    // Compiles and runs one chunk. A chunk with errors, in checking,
+    // code generation or linking, is discarded as a whole, leaving the
+    // session as it was. If the last statement is an int,
+    // float or string expression, its value is printed.
+    bool run(const std::string& source);
+
+    // Address of a function compiled by an earlier chunk, or null
+    void* lookup(llvm::StringRef name);
+
+    // True once every block and bracket opened in `source` is closed, i.e.
+    // the chunk can be run.
+    static bool isComplete(const std::string& source);
+
+    void setTiming(bool enabled) { timing = enabled; }
+
+private:
+    unsigned optLevel;
+    bool timing = false;
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    std::vector<llvm::JITEventListener*> listeners;
+    std::unique_ptr<llvm::TargetMachine> targetMachine; // Cost models for the optimizer
+    llvm::orc::ThreadSafeContext context;
+    std::unique_ptr<CodeGen> codegen;
+    TypeChecker checker;
+    std::set<std::string> definedFunctions;
+    std::set<std::string> definedStructs;
+    std::set<std::string> definedEnums;
+    unsigned chunks = 0;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_REPL_SESSION_H
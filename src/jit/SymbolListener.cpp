@@ -0,0 +1,65 @@
+#include "SymbolListener.h"
+#include <llvm/DebugInfo/DWARF/DWARFContext.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/Error.h>
+#include <unistd.h>
+
+namespace pynext {
+
+void SymbolListener::notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile& obj,
+                                        const llvm::RuntimeDyld::LoadedObjectInfo& info) {
+    // The debug copy of the object has its sections relocated to load addresses
+    llvm::object::OwningBinary<llvm::object::ObjectFile> debugObj = info.getObjectForDebug(obj);
+    if (!debugObj.getBinary()) return;
+
+    // Objects compiled without debug info have an empty line table
+    std::unique_ptr<llvm::DIContext> lines;
+    if (lineCallback) lines = llvm::DWARFContext::create(*debugObj.getBinary());
+
+    for (const auto& [symbol, size] : llvm::object::computeSymbolSizes(*debugObj.getBinary())) {
+        auto type = symbol.getType();
+        if (!type) {
+            llvm::consumeError(type.takeError());
+            continue;
+        }
+        if (*type != llvm::object::SymbolRef::ST_Function) continue;
+
+        auto name = symbol.getName();
+        auto address = symbol.getAddress();
+        if (!name || !address) {
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(address.takeError());
+            continue;
+        }
+        callback(*name, *address, size);
+        if (!lines) continue;
+
+        uint64_t sectionIndex = llvm::object::SectionedAddress::UndefSection;
+        if (auto section = symbol.getSection()) {
+            if (*section != debugObj.getBinary()->section_end()) sectionIndex = (*section)->getIndex();
+        } else {
+            llvm::consumeError(section.takeError());
+        }
+        for (const auto& [rowAddress, row] : lines->getLineInfoForAddressRange({*address, sectionIndex}, size)) {
+            lineCallback(rowAddress, row.Line);
+        }
+    }
+}
+
+PerfMapWriter::PerfMapWriter() {
+    std::string path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+    file = fopen(path.c_str(), "w");
+}
+
+PerfMapWriter::~PerfMapWriter() {
+    if (file) fclose(file);
+}
+
+void PerfMapWriter::add(llvm::StringRef name, uint64_t address, uint64_t size) {
+    if (!file) return;
+    fprintf(file, "%llx %llx %.*s\n", (unsigned long long)address, (unsigned long long)size,
+            (int)name.size(), name.data());
+    fflush(file);
+}
+
+} // namespace pynext
@@ -0,0 +1,49 @@
+#ifndef PYNEXT_SYMBOL_LISTENER_H
+#define PYNEXT_SYMBOL_LISTENER_H
+
+#include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+
+namespace pynext {
+
+// Reports the load address and size of every function in each object the JIT
+// loads, so external tools and the runtime can symbolize JIT-compiled code.
+// With a line callback, it also reports the rows of the object's DWARF line
+// table (the address where each source line starts) for those functions.
+class SymbolListener : public llvm::JITEventListener {
+public:
+    using Callback = std::function<void(llvm::StringRef name, uint64_t address, uint64_t size)>;
+    using LineCallback = std::function<void(uint64_t address, int line)>;
+
+    explicit SymbolListener(Callback callback, LineCallback lineCallback = nullptr)
+        : callback(std::move(callback)), lineCallback(std::move(lineCallback)) {}
+
+    void notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile& obj,
+                            const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+
+private:
+    Callback callback;
+    LineCallback lineCallback;
+};
+
+// Writes /tmp/perf-<pid>.map entries ("<start> <size> <name>" in hex), which
+// `perf report` reads to name samples in JIT-compiled code.
+class PerfMapWriter {
+public:
+    PerfMapWriter();
+    ~PerfMapWriter();
+
+    bool isOpen() const { return file != nullptr; }
+    void add(llvm::StringRef name, uint64_t address, uint64_t size);
+
+private:
+    FILE* file = nullptr;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_SYMBOL_LISTENER_H
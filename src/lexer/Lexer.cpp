@@ -58,7 +58,11 @@ Token Lexer::identifier() {
     if (text == "return") return atom(TokenKind::Return);
     if (text == "var") return atom(TokenKind::Var);
     if (text == "struct") return atom(TokenKind::Struct);
+    if (text == "enum") return atom(TokenKind::Enum);
+    if (text == "match") return atom(TokenKind::Match);
+    if (text == "case") return atom(TokenKind::Case);
     if (text == "extern") return atom(TokenKind::Extern);
+    if (text == "import") return atom(TokenKind::Import);
     if (text == "while") return atom(TokenKind::While);
     if (text == "for") return atom(TokenKind::For);
     if (text == "in") return atom(TokenKind::In);
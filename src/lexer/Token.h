@@ -28,7 +28,11 @@ enum class TokenKind {
     Return,
     Var,
     Struct,
+    Enum,
+    Match,
+    Case,
     Extern,
+    Import,
     While,
     For,
     In,
@@ -84,7 +88,11 @@ inline std::string toString(TokenKind kind) {
         case TokenKind::Return: return "Return";
         case TokenKind::Var: return "Var";
         case TokenKind::Struct: return "Struct";
+        case TokenKind::Enum: return "Enum";
+        case TokenKind::Match: return "Match";
+        case TokenKind::Case: return "Case";
         case TokenKind::Extern: return "Extern";
+        case TokenKind::Import: return "Import";
         case TokenKind::While: return "While";
         case TokenKind::True: return "True";
         case TokenKind::False: return "False";
@@ -4,17 +4,40 @@
 #include <llvm/ExecutionEngine/GenericValue.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/TargetParser/Host.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include "lexer/Lexer.h"
+#include "parser/FlatAST.h"
 #include "parser/Parser.h"
 #include "codegen/CodeGen.h"
+#include "codegen/IncrementalBuild.h"
+#include "codegen/ModuleBuilder.h"
+#include "codegen/Optimizer.h"
+#include "codegen/Remarks.h"
 #include "sema/TypeChecker.h"
+#include "serialization/ModuleFile.h"
+#include "jit/ReplSession.h"
+#include "jit/SymbolListener.h"
+#include "runtime/AllocTracker.h"
+#include "runtime/Dict.h"
+#include "runtime/File.h"
+#include "runtime/Instrumentation.h"
+#include "runtime/ProfileRuntime.h"
+#include "runtime/Profiler.h"
+#include "runtime/Sort.h"
 
 #include <cstdio>
+#include <unistd.h>
 
 extern "C" void print_int(int64_t val) {
     printf("Output: %ld\n", val);
@@ -26,39 +49,312 @@ extern "C" void print_string(const char* val) {
     fflush(stdout);
 }
 
-void executeSource(const std::string& code) {
-    pynext::Lexer lexer(code);
-    pynext::Parser parser(lexer);
-    
-    auto statements = parser.parseModule();
-    
-    pynext::TypeChecker checker;
-    checker.check(statements);
-    
+extern "C" void print_float(double val) {
+    printf("Output: %f\n", val);
+    fflush(stdout);
+}
+
+struct DriverOptions {
+    unsigned optLevel = 0;  // -O0..-O3
+    bool printIR = true;    // --no-ir disables the IR dump
+    bool timeRun = false;   // --time reports the execution time of main
+    bool perfMap = false;   // --perf-map writes /tmp/perf-<pid>.map for perf report
+    bool jitdump = false;   // --jitdump emits a perf jitdump file for perf inject --jit
+    bool gdbJit = false;    // --gdb-jit registers JIT objects with an attached gdb
+    bool profile = false;   // --profile samples the running program and prints a profile
+    std::string profileOut = "pynext.folded"; // --profile-out: collapsed stacks for flamegraph.pl
+    bool instrument = false; // --instrument counts calls, time and loop trips per function
+    std::string pgoGen;     // --pgo-gen[=file]: write an edge profile of this run
+    std::string pgoUse;     // --pgo-use=file: optimize with a profile from --pgo-gen
+    bool trackAlloc = false; // --track-alloc reports allocation sites, leaks and double frees
+    pynext::DebugInfoLevel debugInfo = pynext::DebugInfoLevel::None; // -g, -gline-tables-only
+    pynext::RemarkOptions remarks; // -Rpass=, -Rpass-missed=, -Rpass-analysis=, --remarks-yaml=
+    bool incremental = false; // --incremental[=dir] caches optimized object code per function
+    std::string cacheDir;     // Defaults to .pynext-cache next to the source
+    bool astCache = false;    // --ast-cache keeps the type-checked AST in <file>c and reuses it
+    bool thinLTO = false;     // --thin-lto imports small functions across modules for inlining
+    bool flatAstRoundTrip = false; // --flat-ast-roundtrip compiles the tree rebuilt from its FlatAST
+};
+
+// "fib (line 3)", "while loop in fib (line 5)", ...
+static std::vector<std::string> siteLabels(const std::vector<pynext::InstrumentedSite>& sites) {
+    std::vector<std::string> labels;
+    for (const auto& site : sites) {
+        std::string label = site.kind == "def" ? site.function : site.kind + " in " + site.function;
+        if (site.line > 0) label += " (line " + std::to_string(site.line) + ")";
+        labels.push_back(label);
+    }
+    return labels;
+}
+
+// --perf-map, --jitdump and --gdb-jit, for the MCJIT of a file run and the
+// ORC JIT of the REPL
+struct JITListeners {
+    std::unique_ptr<pynext::PerfMapWriter> perfMap;
+    std::unique_ptr<pynext::SymbolListener> perfMapListener;
+    std::vector<llvm::JITEventListener*> all;
+};
+
+static void createJITListeners(const DriverOptions& options, JITListeners& listeners) {
+    if (options.perfMap) {
+        listeners.perfMap = std::make_unique<pynext::PerfMapWriter>();
+        if (!listeners.perfMap->isOpen()) {
+            std::cerr << "Warning: could not create perf map file\n";
+        }
+        pynext::PerfMapWriter* perfMap = listeners.perfMap.get();
+        listeners.perfMapListener = std::make_unique<pynext::SymbolListener>(
+            [perfMap](llvm::StringRef name, uint64_t address, uint64_t size) { perfMap->add(name, address, size); });
+        listeners.all.push_back(listeners.perfMapListener.get());
+    }
+
+    if (options.jitdump) {
+        if (llvm::JITEventListener* perfListener = llvm::JITEventListener::createPerfJITEventListener()) {
+            listeners.all.push_back(perfListener);
+        } else {
+            std::cerr << "Warning: --jitdump needs LLVM built with LLVM_USE_PERF=ON; use --perf-map instead\n";
+        }
+    }
+
+    if (options.gdbJit) {
+        listeners.all.push_back(llvm::JITEventListener::createGDBRegistrationListener());
+    }
+}
+
+void executeSource(const std::string& code, const DriverOptions& options,
+                   const std::string& sourceName = "<input>") {
+    auto frontEndStart = std::chrono::steady_clock::now();
+
+    // Imported modules are parsed here and compiled separately below
+    pynext::ModuleBuilder modules;
+    {
+        pynext::Lexer lexer(code);
+        pynext::Parser parser(lexer);
+        const auto& imports = parser.parseImports();
+        std::string error;
+        if (!imports.empty() && !modules.load(sourceName, imports, error)) {
+            std::cerr << "Import Error: " << error << "\n";
+            std::exit(1);
+        }
+    }
+
+    std::vector<std::unique_ptr<pynext::Stmt>> statements;
+    std::unique_ptr<pynext::ModuleFile> cached;
+    std::string cachePath = pynext::ModuleFile::cachePathFor(sourceName);
+    // The saved AST includes the imported declarations, so it is only valid
+    // while their interfaces are unchanged
+    std::string cacheKey = modules.empty() ? code : code + modules.interfaceSummary();
+    if (options.astCache) {
+        std::string error;
+        cached = pynext::ModuleFile::open(cachePath, cacheKey, error);
+        if (!error.empty()) std::cerr << "Warning: " << error << "; reparsing\n";
+    }
+
+    if (cached) {
+        statements = cached->materialize();
+    } else {
+        pynext::Lexer lexer(code);
+        pynext::Parser parser(lexer);
+
+        statements = parser.parseModule();
+        if (parser.hadError()) std::exit(1);
+
+        std::string error;
+        if (!modules.prependInterfaces(statements, error)) {
+            std::cerr << "Import Error: " << error << "\n";
+            std::exit(1);
+        }
+
+        pynext::TypeChecker checker;
+        checker.check(statements);
+        if (!checker.checkEntryPoint(statements)) std::exit(1);
+
+        if (options.astCache && checker.getErrorCount() == 0) {
+            std::string error;
+            if (!pynext::ModuleFile::write(cachePath, statements, cacheKey, error)) {
+                std::cerr << "Warning: " << error << "\n";
+            }
+        }
+    }
+    // The rebuilt tree must compile to the same IR, debug locations included
+    if (options.flatAstRoundTrip) statements = pynext::FlatAST::fromTree(statements).toTree();
+    auto frontEndTime = std::chrono::steady_clock::now() - frontEndStart;
+
     llvm::LLVMContext context;
-    pynext::CodeGen codegen(context);
+    pynext::OptimizationRemarks remarks;
+    if (options.remarks.enabled()) {
+        std::string error;
+        if (!remarks.enable(context, options.remarks, code, error)) {
+            std::cerr << "Remarks: " << error << "\n";
+            return;
+        }
+    }
+
+    pynext::CodeGenOptions codegenOptions;
+    codegenOptions.framePointers = options.profile;
+    codegenOptions.instrument = options.instrument;
+    codegenOptions.trackAllocations = options.trackAlloc;
+    codegenOptions.debugInfo = options.debugInfo;
+    // Remarks and profiled lines are located through debug locations; line
+    // tables leave the code unchanged
+    if ((options.remarks.enabled() || options.profile) &&
+        codegenOptions.debugInfo == pynext::DebugInfoLevel::None) {
+        codegenOptions.debugInfo = pynext::DebugInfoLevel::LineTablesOnly;
+    }
+    codegenOptions.sourceFile = sourceName;
+    codegenOptions.optimized = options.optLevel > 0;
+    pynext::CodeGen codegen(context, codegenOptions);
     codegen.generate(statements);
-    
-    llvm::outs() << "Generated LLVM IR:\n";
-    codegen.getModule()->print(llvm::outs(), nullptr);
-    llvm::outs() << "\n";
-    
-    // Cache function pointers before transferring module ownership
-    llvm::Function* irPrintFunc = codegen.getModule()->getFunction("print_int");
-    llvm::Function* irPrintStringFunc = codegen.getModule()->getFunction("print_string");
-    llvm::Function* irMainFunc = codegen.getModule()->getFunction("main");
 
     // Initialize JIT
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
 
+    // The builder owns the module from here on; keep a handle for optimization
+    llvm::Module* irModule = codegen.getModule();
     std::string errStr;
-    // releaseModule() passes ownership to the Engine
-    llvm::ExecutionEngine* engine = llvm::EngineBuilder(codegen.releaseModule())
-                                        .setErrorStr(&errStr)
-                                        .setEngineKind(llvm::EngineKind::JIT)
-                                        .create();
+    llvm::EngineBuilder engineBuilder(codegen.releaseModule());
+    engineBuilder.setErrorStr(&errStr)
+                 .setEngineKind(llvm::EngineKind::JIT)
+                 .setOptLevel(pynext::codeGenOptLevel(options.optLevel));
+
+    // Code runs where it is compiled, so loops vectorize for the host's
+    // vector width (AVX2, AVX-512) rather than baseline SSE2
+    llvm::StringMap<bool> hostFeatures;
+    llvm::SmallVector<std::string, 64> attributes;
+    if (llvm::sys::getHostCPUFeatures(hostFeatures)) {
+        for (const auto& feature : hostFeatures) {
+            attributes.push_back((feature.second ? "+" : "-") + feature.first().str());
+        }
+    }
+    engineBuilder.setMCPU(llvm::sys::getHostCPUName()).setMAttrs(attributes);
+
+    llvm::TargetMachine* targetMachine = engineBuilder.selectTarget();
+    if (!targetMachine) {
+        std::cerr << "Failed to select JIT target: " << errStr << "\n";
+        return;
+    }
+    irModule->setDataLayout(targetMachine->createDataLayout());
+    irModule->setTargetTriple(targetMachine->getTargetTriple().str());
+
+    // Imported modules compile on worker threads while the program itself
+    // is optimized here
+    if (!modules.empty()) {
+        if (options.instrument || options.trackAlloc || !options.pgoGen.empty() || !options.pgoUse.empty()) {
+            std::cerr << "Warning: --instrument, --track-alloc and PGO only apply to " << sourceName
+                      << ", not to the modules it imports\n";
+        }
+        pynext::ModuleBuilder::Options moduleOptions;
+        moduleOptions.optLevel = options.optLevel;
+        moduleOptions.codegen.framePointers = codegenOptions.framePointers;
+        moduleOptions.codegen.debugInfo = codegenOptions.debugInfo;
+        moduleOptions.codegen.optimized = codegenOptions.optimized;
+        if (options.incremental) {
+            moduleOptions.cacheDir = options.cacheDir;
+            if (moduleOptions.cacheDir.empty()) {
+                llvm::SmallString<128> dir(llvm::sys::path::parent_path(sourceName));
+                llvm::sys::path::append(dir, ".pynext-cache");
+                moduleOptions.cacheDir = std::string(dir);
+            }
+        }
+        moduleOptions.thinLTO = options.thinLTO;
+        modules.startCompile(*targetMachine, moduleOptions);
+    }
+
+    // --thin-lto: functions of the modules that main and friends may inline
+    std::map<std::string, std::string> importedBodies;
+    {
+        std::string error;
+        if (!modules.importInto(*irModule, importedBodies, error)) {
+            std::cerr << "Import Error: " << error << "\n";
+            std::exit(1);
+        }
+    }
+
+    pynext::ProfileGuidance profileGuidance;
+    if (!options.pgoGen.empty()) {
+        profileGuidance.mode = pynext::ProfileGuidance::Mode::Generate;
+    } else if (!options.pgoUse.empty()) {
+        if (!llvm::sys::fs::exists(options.pgoUse)) {
+            std::cerr << "Profile not found: " << options.pgoUse << "\n";
+            return;
+        }
+        if (options.optLevel == 0) {
+            std::cerr << "Warning: --pgo-use has no effect at -O0\n";
+        }
+        profileGuidance.mode = pynext::ProfileGuidance::Mode::Use;
+        profileGuidance.profilePath = options.pgoUse;
+    }
+
+    // Instrumented code numbers sites per program, so it is never cached
+    bool incremental = options.incremental;
+    if (incremental && (options.instrument || options.trackAlloc || !options.pgoGen.empty() || !options.pgoUse.empty())) {
+        std::cerr << "Warning: --incremental is ignored with --instrument, --track-alloc and PGO\n";
+        incremental = false;
+    }
+
+    std::unique_ptr<pynext::IncrementalBuild> incrementalBuild;
+    if (incremental) {
+        pynext::IncrementalBuild::Config config;
+        config.cacheDir = options.cacheDir;
+        if (config.cacheDir.empty()) {
+            llvm::SmallString<128> dir(llvm::sys::path::parent_path(sourceName));
+            llvm::sys::path::append(dir, ".pynext-cache");
+            config.cacheDir = std::string(dir);
+        }
+        config.sourceName = sourceName;
+        config.optLevel = options.optLevel;
+        config.codegenTag = "fp" + std::to_string(codegenOptions.framePointers) + ";g" +
+                            std::to_string(static_cast<int>(codegenOptions.debugInfo));
+        config.withPositions = codegenOptions.debugInfo != pynext::DebugInfoLevel::None;
+
+        bool hasUserMain = false;
+        for (const auto& stmt : statements) {
+            auto* func = dynamic_cast<pynext::FunctionStmt*>(stmt.get());
+            if (func && func->name == "main") hasUserMain = true;
+        }
+        incrementalBuild = std::make_unique<pynext::IncrementalBuild>(config);
+        incrementalBuild->summarize(statements, hasUserMain ? "__init" : "main");
+        for (const auto& [name, moduleKey] : importedBodies) incrementalBuild->addImportedBody(name, moduleKey);
+
+        if (options.printIR) llvm::outs() << "Generated LLVM IR:\n";
+        std::string error;
+        if (!incrementalBuild->build(*irModule, *targetMachine, error, options.printIR ? &llvm::outs() : nullptr)) {
+            std::cerr << "Incremental build failed: " << error << "\n";
+            return;
+        }
+        incrementalBuild->report(llvm::errs());
+    } else {
+        pynext::optimizeModule(*irModule, options.optLevel, targetMachine, profileGuidance);
+    }
+
+    if (!modules.empty()) {
+        std::string error;
+        if (!modules.finishCompile(error)) {
+            std::cerr << "Import Error: " << error << "\n";
+            std::exit(1);
+        }
+        if (options.timeRun || options.incremental) modules.report(llvm::errs());
+    }
+
+    pynext::ProfileCollector profileCollector;
+    if (profileGuidance.mode == pynext::ProfileGuidance::Mode::Generate) {
+        profileCollector.collect(*irModule);
+    }
+
+    if (options.printIR && !incrementalBuild) {
+        llvm::outs() << "Generated LLVM IR:\n";
+        irModule->print(llvm::outs(), nullptr);
+        llvm::outs() << "\n";
+    }
+    
+    // Cache function pointers before the engine takes the module
+    llvm::Function* irPrintFunc = irModule->getFunction("print_int");
+    llvm::Function* irPrintStringFunc = irModule->getFunction("print_string");
+    llvm::Function* irPrintFloatFunc = irModule->getFunction("print_float");
+    llvm::Function* irMainFunc = irModule->getFunction("main");
+
+    llvm::ExecutionEngine* engine = engineBuilder.create(targetMachine);
 
     if (!engine) {
         std::cerr << "Failed to construct ExecutionEngine: " << errStr << "\n";
@@ -75,14 +371,127 @@ void executeSource(const std::string& code) {
     if (irPrintStringFunc) {
         engine->addGlobalMapping(irPrintStringFunc, (void*)print_string);
     }
+
+    if (irPrintFloatFunc) {
+        engine->addGlobalMapping(irPrintFloatFunc, (void*)print_float);
+    }
     
     if (!irMainFunc) {
         std::cerr << "Function 'main' not found in module.\n";
         return;
     }
 
+    // Profiler and debugger integration; listeners see objects as finalizeObject emits them
+    JITListeners listeners;
+    createJITListeners(options, listeners);
+    for (llvm::JITEventListener* listener : listeners.all) engine->RegisterJITEventListener(listener);
+
+    std::unique_ptr<pynext::SamplingProfiler> profiler;
+    std::unique_ptr<pynext::SymbolListener> profilerListener;
+    if (options.profile) {
+        std::map<std::string, int> functionLines;
+        for (const auto& stmt : statements) {
+            if (auto* func = dynamic_cast<pynext::FunctionStmt*>(stmt.get())) {
+                functionLines[func->name] = func->line;
+            }
+        }
+        profiler = std::make_unique<pynext::SamplingProfiler>();
+        profilerListener = std::make_unique<pynext::SymbolListener>(
+            [&profiler, functionLines](llvm::StringRef name, uint64_t address, uint64_t size) {
+                auto it = functionLines.find(name.str());
+                profiler->addFunction(name, address, size, it != functionLines.end() ? it->second : 0);
+            },
+            [&profiler](uint64_t address, int line) { profiler->addLine(address, line); });
+        engine->RegisterJITEventListener(profilerListener.get());
+    }
+
+    if (options.instrument) {
+        pynext::registerInstrumentationRuntime();
+    }
+
+    if (!options.pgoGen.empty()) {
+        pynext::ProfileCollector::registerRuntime();
+    }
+
+    if (options.trackAlloc) {
+        pynext::registerAllocTrackerRuntime();
+    }
+    pynext::registerDictRuntime();
+    pynext::registerFileRuntime();
+    pynext::registerSortRuntime();
+
+    // Cached and rebuilt functions and the imported modules; loaded after
+    // the listeners so they see them too
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects;
+    if (incrementalBuild) objects = incrementalBuild->takeObjects();
+    for (auto& module : modules.compiled()) objects.push_back(std::move(module.object));
+    for (auto& buffer : objects) {
+        auto object = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+        if (!object) {
+            std::cerr << "Invalid cached object " << buffer->getBufferIdentifier().str() << ": "
+                      << llvm::toString(object.takeError()) << "\n";
+            return;
+        }
+        engine->addObjectFile(llvm::object::OwningBinary<llvm::object::ObjectFile>(std::move(*object),
+                                                                                   std::move(buffer)));
+    }
+
+    // Resolve and JIT-compile everything up front so --time measures execution only
+    engine->finalizeObject();
+    remarks.finish();
+
+    if (profiler && !profiler->start()) {
+        std::cerr << "Warning: could not start the sampling profiler\n";
+    }
+
     std::vector<llvm::GenericValue> args;
+    auto start = std::chrono::steady_clock::now();
+    // Imports first, in dependency order
+    for (const auto& module : modules.compiled()) {
+        auto init = reinterpret_cast<int64_t (*)()>(engine->getFunctionAddress(module.initFunction));
+        if (init) init();
+    }
+    // Then the program's own top-level code, which is __init when it defines main
+    if (auto init = reinterpret_cast<int64_t (*)()>(engine->getFunctionAddress("__init"))) init();
     engine->runFunction(irMainFunc, args);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (profiler) {
+        profiler->stop();
+        profiler->report(llvm::errs());
+        if (profiler->writeCollapsed(options.profileOut)) {
+            llvm::errs() << "Collapsed stacks written to " << options.profileOut << "\n";
+        } else {
+            std::cerr << "Could not write collapsed stacks to " << options.profileOut << "\n";
+        }
+    }
+
+    if (!options.pgoGen.empty()) {
+        std::string error;
+        auto addressOf = [engine](const std::string& name) { return engine->getGlobalValueAddress(name); };
+        if (profileCollector.write(options.pgoGen, addressOf, error)) {
+            llvm::errs() << "Profile of " << profileCollector.functionCount() << " functions written to "
+                         << options.pgoGen << "\n";
+        } else {
+            std::cerr << "Could not write profile " << options.pgoGen << ": " << error << "\n";
+        }
+    }
+
+    if (options.instrument) {
+        pynext::reportInstrumentation(llvm::errs(), siteLabels(codegen.getInstrumentedFunctions()),
+                                      siteLabels(codegen.getInstrumentedLoops()));
+    }
+
+    if (options.trackAlloc) {
+        pynext::reportAllocations(llvm::errs(), siteLabels(codegen.getAllocationSites()));
+    }
+
+    if (options.timeRun) {
+        double frontEndMs = std::chrono::duration<double, std::milli>(frontEndTime).count();
+        fprintf(stderr, "Front end time: %.3f ms%s\n", frontEndMs, cached ? " (from AST cache)" : "");
+        double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+        fprintf(stderr, "Execution time: %.3f ms\n", ms);
+    }
 }
 
 void runTest() {
@@ -102,10 +511,10 @@ void runTest() {
     )";
     
     llvm::outs() << "Running Internal Test:\n" << code << "\n\n";
-    executeSource(code);
+    executeSource(code, DriverOptions{});
 }
 
-void runFile(const std::string& path) {
+void runFile(const std::string& path, const DriverOptions& options) {
     std::ifstream file(path);
     if (!file.is_open()) {
         std::cerr << "Could not open file: " << path << "\n";
@@ -114,20 +523,173 @@ void runFile(const std::string& path) {
     
     std::stringstream buffer;
     buffer << file.rdbuf();
-    executeSource(buffer.str());
+    executeSource(buffer.str(), options, path);
+}
+
+// `pynext repl`: reads chunks until their blocks are closed and runs each one
+// in a single JIT session
+static int runRepl(const DriverOptions& options) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    JITListeners listeners; // Outlives the session, which notifies them as it frees objects
+    createJITListeners(options, listeners);
+    pynext::ReplSession session(options.optLevel);
+    for (llvm::JITEventListener* listener : listeners.all) session.addEventListener(listener);
+    std::string error;
+    if (!session.init(error)) {
+        std::cerr << "Failed to create JIT session: " << error << "\n";
+        return 1;
+    }
+    session.addSymbol("print_int", (void*)print_int);
+    session.addSymbol("print_string", (void*)print_string);
+    session.addSymbol("print_float", (void*)print_float);
+    for (const pynext::RuntimeSymbol& symbol : pynext::dictRuntimeSymbols()) {
+        session.addSymbol(symbol.name, symbol.address);
+    }
+    for (const pynext::RuntimeSymbol& symbol : pynext::sortRuntimeSymbols()) {
+        session.addSymbol(symbol.name, symbol.address);
+    }
+    for (const pynext::RuntimeSymbol& symbol : pynext::fileRuntimeSymbols()) {
+        session.addSymbol(symbol.name, symbol.address);
+    }
+    session.run("extern def print_int(val: int)\n"
+                "extern def print_string(val: string)\n"
+                "extern def print_float(val: float)\n");
+    session.setTiming(options.timeRun);
+
+    bool interactive = isatty(STDIN_FILENO);
+    std::string chunk;
+    std::string line;
+    while (true) {
+        if (interactive) {
+            llvm::outs() << (chunk.empty() ? ">>> " : "... ");
+            llvm::outs().flush();
+        }
+        if (!std::getline(std::cin, line)) break;
+        chunk += line + "\n";
+        if (!pynext::ReplSession::isComplete(chunk)) continue;
+        session.run(chunk);
+        chunk.clear();
+    }
+    if (!chunk.empty()) session.run(chunk); // Reports the unclosed block
+    if (interactive) llvm::outs() << "\n";
+    return 0;
+}
+
+static void printUsage() {
+    llvm::outs() << "Usage: pynext [options] <file.next>, pynext repl or pynext test\n"
+                 << "Options:\n"
+                 << "  -O0..-O3    Optimization level (default -O0)\n"
+                 << "  --no-ir     Do not print the generated LLVM IR\n"
+                 << "  -g          Emit DWARF line tables, function and variable info\n"
+                 << "  -gline-tables-only    Emit only line tables (does not change optimized code)\n"
+                 << "  -Rpass=<regex>          Report optimizations applied by passes matching regex (e.g. inline)\n"
+                 << "  -Rpass-missed=<regex>   Report optimizations those passes failed to apply\n"
+                 << "  -Rpass-analysis=<regex> Report why (e.g. -Rpass-analysis=loop-vectorize)\n"
+                 << "  --remarks-yaml=<file>   Write all optimization remarks as YAML\n"
+                 << "  --time      Report the execution time of main on stderr\n"
+                 << "  --perf-map  Write /tmp/perf-<pid>.map so perf report names JIT code\n"
+                 << "  --jitdump   Write a perf jitdump file (use with perf record -k 1 and perf inject --jit)\n"
+                 << "  --gdb-jit   Register JIT code with gdb's JIT interface\n"
+                 << "  --profile   Sample the program and print a flat and cumulative profile on exit\n"
+                 << "  --profile-out=<file>  Collapsed stacks for flamegraph.pl (default pynext.folded)\n"
+                 << "  --instrument  Count calls, self/total time and loop trips per function\n"
+                 << "  --pgo-gen[=<file>]    Write an edge profile of this run (default pynext.profdata)\n"
+                 << "  --pgo-use=<file>      Optimize with a profile written by --pgo-gen\n"
+                 << "  --track-alloc Report allocation sites, peak memory, leaks and double frees\n"
+                 << "  --incremental[=<dir>] Cache optimized code per function; rebuild only what changed\n"
+                 << "                        (default <source dir>/.pynext-cache)\n"
+                 << "  --ast-cache Reuse the type-checked AST saved in <file>c while <file> is unchanged\n"
+                 << "  --thin-lto  Import small functions of imported modules so they can be inlined (-O1+)\n"
+                 << "  --flat-ast-roundtrip  Compile the tree rebuilt from its FlatAST (for testing)\n";
 }
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        llvm::outs() << "Usage: pynext <file.next> or pynext test\n";
+        printUsage();
+        return 0;
+    }
+
+    DriverOptions options;
+    std::string input;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            options.optLevel = arg[2] - '0';
+        } else if (arg == "-g") {
+            options.debugInfo = pynext::DebugInfoLevel::Full;
+        } else if (arg == "-gline-tables-only") {
+            options.debugInfo = pynext::DebugInfoLevel::LineTablesOnly;
+        } else if (arg.rfind("-Rpass=", 0) == 0) {
+            options.remarks.passed = arg.substr(std::string("-Rpass=").size());
+        } else if (arg.rfind("-Rpass-missed=", 0) == 0) {
+            options.remarks.missed = arg.substr(std::string("-Rpass-missed=").size());
+        } else if (arg.rfind("-Rpass-analysis=", 0) == 0) {
+            options.remarks.analysis = arg.substr(std::string("-Rpass-analysis=").size());
+        } else if (arg.rfind("--remarks-yaml=", 0) == 0) {
+            options.remarks.yamlPath = arg.substr(std::string("--remarks-yaml=").size());
+        } else if (arg == "--no-ir") {
+            options.printIR = false;
+        } else if (arg == "--time") {
+            options.timeRun = true;
+        } else if (arg == "--perf-map") {
+            options.perfMap = true;
+        } else if (arg == "--jitdump") {
+            options.jitdump = true;
+        } else if (arg == "--gdb-jit") {
+            options.gdbJit = true;
+        } else if (arg == "--pgo-gen") {
+            options.pgoGen = "pynext.profdata";
+        } else if (arg.rfind("--pgo-gen=", 0) == 0) {
+            options.pgoGen = arg.substr(std::string("--pgo-gen=").size());
+        } else if (arg.rfind("--pgo-use=", 0) == 0) {
+            options.pgoUse = arg.substr(std::string("--pgo-use=").size());
+        } else if (arg == "--track-alloc") {
+            options.trackAlloc = true;
+        } else if (arg == "--ast-cache") {
+            options.astCache = true;
+        } else if (arg == "--flat-ast-roundtrip") {
+            options.flatAstRoundTrip = true;
+        } else if (arg == "--thin-lto") {
+            options.thinLTO = true;
+        } else if (arg == "--incremental") {
+            options.incremental = true;
+        } else if (arg.rfind("--incremental=", 0) == 0) {
+            options.incremental = true;
+            options.cacheDir = arg.substr(std::string("--incremental=").size());
+        } else if (arg == "--instrument") {
+            options.instrument = true;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg.rfind("--profile-out=", 0) == 0) {
+            options.profileOut = arg.substr(std::string("--profile-out=").size());
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage();
+            return 1;
+        } else {
+            input = arg;
+        }
+    }
+
+    // One run either writes a profile or optimizes with one, not both
+    if (!options.pgoGen.empty() && !options.pgoUse.empty()) {
+        std::cerr << "--pgo-gen and --pgo-use cannot be combined: record a profile first, then use it\n";
+        return 1;
+    }
+
+    if (input.empty()) {
+        printUsage();
         return 0;
     }
 
-    std::string arg1 = argv[1];
-    if (arg1 == "test") {
+    if (input == "test") {
         runTest();
+    } else if (input == "repl") {
+        return runRepl(options);
     } else {
-        runFile(arg1);
+        runFile(input, options);
     }
 
     return 0;
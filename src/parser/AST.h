@@ -1,10 +1,12 @@
 #ifndef PYNEXT_AST_H
 #define PYNEXT_AST_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <llvm/Support/ErrorHandling.h>
 #include "../sema/Type.h"
 
 namespace pynext {
@@ -24,8 +26,34 @@ struct ForStmt;
 struct FunctionStmt;
 struct VarDeclStmt;
 struct StructDeclStmt;
+struct EnumDeclStmt;
+struct MatchStmt;
 struct ExprStmt;
 
+// Concrete class of a node, for dispatch without virtual calls
+// (StaticASTVisitor) and for the per-kind arrays of FlatAST.h. Expressions
+// come first.
+enum class NodeKind : uint8_t {
+    Literal,
+    Variable,
+    Binary,
+    Call,
+    MemberAccess,
+    Index,
+    ArrayLiteral,
+    ExprStmt,
+    Return,
+    Block,
+    If,
+    While,
+    For,
+    Function,
+    VarDecl,
+    StructDecl,
+    EnumDecl,
+    Match,
+};
+
 class ASTVisitor {
 public:
     virtual ~ASTVisitor() = default;
@@ -44,10 +72,17 @@ public:
     virtual void visit(FunctionStmt& stmt) = 0;
     virtual void visit(VarDeclStmt& stmt) = 0;
     virtual void visit(StructDeclStmt& stmt) = 0;
+    virtual void visit(EnumDeclStmt& stmt) = 0;
+    virtual void visit(MatchStmt& stmt) = 0;
     virtual void visit(ExprStmt& stmt) = 0;
 };
 
 struct ASTNode {
+    const NodeKind kind;
+    int line = 0;   // 1-based source position of the node's first token (operator for
+    int column = 0; // binary expressions), 0 if unknown
+
+    explicit ASTNode(NodeKind kind) : kind(kind) {}
     virtual ~ASTNode() = default;
     virtual void print(int indent = 0) const = 0;
     virtual void accept(ASTVisitor& visitor) = 0;
@@ -55,8 +90,11 @@ struct ASTNode {
 
 struct Expr : public ASTNode {
     std::shared_ptr<Type> type;
+    using ASTNode::ASTNode;
+};
+struct Stmt : public ASTNode {
+    using ASTNode::ASTNode;
 };
-struct Stmt : public ASTNode {};
 
 // --- Expressions ---
 
@@ -67,7 +105,7 @@ struct LiteralExpr : public Expr {
     bool isString;
     
     LiteralExpr(std::string val, bool isFloat, bool isBool = false, bool isString = false) 
-        : value(std::move(val)), isFloat(isFloat), isBool(isBool), isString(isString) {}
+        : Expr(NodeKind::Literal), value(std::move(val)), isFloat(isFloat), isBool(isBool), isString(isString) {}
 
     void print(int indent) const override {
         std::string typeStr = isString ? " (string)" : (isBool ? " (bool)" : "");
@@ -78,7 +116,7 @@ struct LiteralExpr : public Expr {
 
 struct VariableExpr : public Expr {
     std::string name;
-    VariableExpr(std::string name) : name(std::move(name)) {}
+    VariableExpr(std::string name) : Expr(NodeKind::Variable), name(std::move(name)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "Variable: " << name << "\n";
@@ -92,7 +130,7 @@ struct BinaryExpr : public Expr {
     std::unique_ptr<Expr> right;
 
     BinaryExpr(std::string op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right)
-        : op(std::move(op)), left(std::move(left)), right(std::move(right)) {}
+        : Expr(NodeKind::Binary), op(std::move(op)), left(std::move(left)), right(std::move(right)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "BinaryExpr (" << op << ")\n";
@@ -107,7 +145,16 @@ struct CallExpr : public Expr {
     std::vector<std::unique_ptr<Expr>> args;
 
     CallExpr(std::string callee, std::vector<std::unique_ptr<Expr>> args)
-        : callee(std::move(callee)), args(std::move(args)) {}
+        : Expr(NodeKind::Call), callee(std::move(callee)), args(std::move(args)) {}
+
+    // len, contains, remove, sort, sort_by, open, lines, parse_int,
+    // parse_float and the numeric conversions (int, u8, f32, ...). A function
+    // of the same name takes precedence.
+    bool namesBuiltin() const {
+        return callee == "len" || callee == "contains" || callee == "remove" || callee == "sort" ||
+               callee == "sort_by" || callee == "open" || callee == "lines" || callee == "parse_int" ||
+               callee == "parse_float" || numericType(callee);
+    }
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "CallExpr: " << callee << "\n";
@@ -123,7 +170,7 @@ struct MemberAccessExpr : public Expr {
     std::string member;
 
     MemberAccessExpr(std::unique_ptr<Expr> object, std::string member)
-        : object(std::move(object)), member(std::move(member)) {}
+        : Expr(NodeKind::MemberAccess), object(std::move(object)), member(std::move(member)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "MemberAccess: ." << member << "\n";
@@ -137,7 +184,7 @@ struct IndexExpr : public Expr {
     std::unique_ptr<Expr> index;
 
     IndexExpr(std::unique_ptr<Expr> object, std::unique_ptr<Expr> index)
-        : object(std::move(object)), index(std::move(index)) {}
+        : Expr(NodeKind::Index), object(std::move(object)), index(std::move(index)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "IndexExpr\n";
@@ -152,7 +199,7 @@ struct ArrayLiteralExpr : public Expr {
     std::vector<std::unique_ptr<Expr>> elements;
 
     ArrayLiteralExpr(std::vector<std::unique_ptr<Expr>> elements)
-        : elements(std::move(elements)) {}
+        : Expr(NodeKind::ArrayLiteral), elements(std::move(elements)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "ArrayLiteral\n";
@@ -167,7 +214,7 @@ struct ArrayLiteralExpr : public Expr {
 
 struct ExprStmt : public Stmt {
     std::unique_ptr<Expr> expr;
-    ExprStmt(std::unique_ptr<Expr> expr) : expr(std::move(expr)) {}
+    ExprStmt(std::unique_ptr<Expr> expr) : Stmt(NodeKind::ExprStmt), expr(std::move(expr)) {}
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "ExprStmt\n";
         expr->print(indent + 2);
@@ -178,7 +225,7 @@ struct ExprStmt : public Stmt {
 struct ReturnStmt : public Stmt {
     std::unique_ptr<Expr> value; 
 
-    ReturnStmt(std::unique_ptr<Expr> value) : value(std::move(value)) {}
+    ReturnStmt(std::unique_ptr<Expr> value) : Stmt(NodeKind::Return), value(std::move(value)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "ReturnStmt\n";
@@ -190,6 +237,8 @@ struct ReturnStmt : public Stmt {
 struct Block : public Stmt {
     std::vector<std::unique_ptr<Stmt>> statements;
 
+    Block() : Stmt(NodeKind::Block) {}
+
     void print(int indent) const override {
         for (const auto& stmt : statements) {
             stmt->print(indent);
@@ -204,7 +253,7 @@ struct IfStmt : public Stmt {
     std::unique_ptr<Block> elseBranch; 
 
     IfStmt(std::unique_ptr<Expr> cond, std::unique_ptr<Block> thenB, std::unique_ptr<Block> elseB)
-        : condition(std::move(cond)), thenBranch(std::move(thenB)), elseBranch(std::move(elseB)) {}
+        : Stmt(NodeKind::If), condition(std::move(cond)), thenBranch(std::move(thenB)), elseBranch(std::move(elseB)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "IfStmt\n";
@@ -225,7 +274,7 @@ struct WhileStmt : public Stmt {
     std::unique_ptr<Block> body;
 
     WhileStmt(std::unique_ptr<Expr> cond, std::unique_ptr<Block> body)
-        : condition(std::move(cond)), body(std::move(body)) {}
+        : Stmt(NodeKind::While), condition(std::move(cond)), body(std::move(body)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "WhileStmt\n";
@@ -243,7 +292,7 @@ struct ForStmt : public Stmt {
     std::unique_ptr<Block> body;
 
     ForStmt(std::string variable, std::unique_ptr<Expr> iterator, std::unique_ptr<Block> body)
-        : variable(std::move(variable)), iterator(std::move(iterator)), body(std::move(body)) {}
+        : Stmt(NodeKind::For), variable(std::move(variable)), iterator(std::move(iterator)), body(std::move(body)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "ForStmt (" << variable << ")\n";
@@ -260,9 +309,10 @@ struct VarDeclStmt : public Stmt {
     std::string typeName; // optional
     std::unique_ptr<Expr> initializer;
     std::shared_ptr<Type> type; // Populated by Sema
+    bool global = false; // Set by Sema on a top-level variable that functions use; CodeGen makes it a global
 
     VarDeclStmt(std::string name, std::string typeName, std::unique_ptr<Expr> init)
-        : name(std::move(name)), typeName(std::move(typeName)), initializer(std::move(init)) {}
+        : Stmt(NodeKind::VarDecl), name(std::move(name)), typeName(std::move(typeName)), initializer(std::move(init)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "VarDecl: " << name << " : " << (typeName.empty() ? "?" : typeName) << "\n";
@@ -281,7 +331,7 @@ struct FunctionStmt : public Stmt {
                  std::vector<std::pair<std::string, std::string>> params, 
                  std::string returnType,
                  std::unique_ptr<Block> body)
-        : name(std::move(name)), params(std::move(params)), returnType(std::move(returnType)), body(std::move(body)) {}
+        : Stmt(NodeKind::Function), name(std::move(name)), params(std::move(params)), returnType(std::move(returnType)), body(std::move(body)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "FunctionStmt: " << name << " -> " << returnType << "\n";
@@ -300,7 +350,7 @@ struct StructDeclStmt : public Stmt {
     std::vector<std::pair<std::string, std::string>> fields; // Name, Type
 
     StructDeclStmt(std::string name, std::vector<std::pair<std::string, std::string>> fields)
-        : name(std::move(name)), fields(std::move(fields)) {}
+        : Stmt(NodeKind::StructDecl), name(std::move(name)), fields(std::move(fields)) {}
 
     void print(int indent) const override {
         std::cout << std::string(indent, ' ') << "StructDecl: " << name << "\n";
@@ -311,6 +361,111 @@ struct StructDeclStmt : public Stmt {
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
+// One alternative of an enum, with the fields of its payload
+struct EnumVariant {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> fields; // Name, Type
+};
+
+struct EnumDeclStmt : public Stmt {
+    std::string name;
+    std::vector<EnumVariant> variants;
+
+    EnumDeclStmt(std::string name, std::vector<EnumVariant> variants)
+        : Stmt(NodeKind::EnumDecl), name(std::move(name)), variants(std::move(variants)) {}
+
+    void print(int indent) const override {
+        std::cout << std::string(indent, ' ') << "EnumDecl: " << name << "\n";
+        for (const auto& v : variants) {
+            std::cout << std::string(indent + 2, ' ') << v.name << "\n";
+            for (const auto& f : v.fields) {
+                std::cout << std::string(indent + 4, ' ') << f.first << ": " << f.second << "\n";
+            }
+        }
+    }
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// `case Variant(a, b)`: binds the payload fields, in order, to new variables
+// of the body; no names binds none, and `_` skips a field
+struct MatchCase {
+    std::string variant;
+    std::vector<std::string> bindings;
+    std::unique_ptr<Block> body;
+};
+
+struct MatchStmt : public Stmt {
+    std::unique_ptr<Expr> subject;
+    std::vector<MatchCase> cases;
+    std::unique_ptr<Block> elseBranch; // Variants without a case
+
+    MatchStmt(std::unique_ptr<Expr> subject, std::vector<MatchCase> cases, std::unique_ptr<Block> elseB)
+        : Stmt(NodeKind::Match), subject(std::move(subject)), cases(std::move(cases)), elseBranch(std::move(elseB)) {}
+
+    void print(int indent) const override {
+        std::cout << std::string(indent, ' ') << "MatchStmt\n";
+        subject->print(indent + 2);
+        for (const auto& c : cases) {
+            std::cout << std::string(indent + 2, ' ') << "Case: " << c.variant;
+            for (const auto& name : c.bindings) std::cout << " " << name;
+            std::cout << "\n";
+            c.body->print(indent + 4);
+        }
+        if (elseBranch) {
+            std::cout << std::string(indent + 2, ' ') << "Else:\n";
+            elseBranch->print(indent + 4);
+        }
+    }
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// Visitor dispatched by a switch on ASTNode::kind instead of a virtual call
+// per node. Each visit returns its result, so a pass that computes a value per
+// expression (a type, an llvm::Value) gets it back from visitExpr() rather
+// than through a member variable, and calls to the Derived overloads can be
+// inlined. Derived defines visit(X&) for every node type:
+//
+//   struct Depth : StaticASTVisitor<Depth, int> {
+//       int visit(BinaryExpr& expr) { return 1 + std::max(visitExpr(*expr.left), visitExpr(*expr.right)); }
+//       ...
+//   };
+template <typename Derived, typename ExprResult, typename StmtResult = void>
+class StaticASTVisitor {
+public:
+    ExprResult visitExpr(Expr& expr) {
+        switch (expr.kind) {
+            case NodeKind::Literal: return self().visit(static_cast<LiteralExpr&>(expr));
+            case NodeKind::Variable: return self().visit(static_cast<VariableExpr&>(expr));
+            case NodeKind::Binary: return self().visit(static_cast<BinaryExpr&>(expr));
+            case NodeKind::Call: return self().visit(static_cast<CallExpr&>(expr));
+            case NodeKind::MemberAccess: return self().visit(static_cast<MemberAccessExpr&>(expr));
+            case NodeKind::Index: return self().visit(static_cast<IndexExpr&>(expr));
+            case NodeKind::ArrayLiteral: return self().visit(static_cast<ArrayLiteralExpr&>(expr));
+            default: llvm_unreachable("statement kind on an expression");
+        }
+    }
+
+    StmtResult visitStmt(Stmt& stmt) {
+        switch (stmt.kind) {
+            case NodeKind::ExprStmt: return self().visit(static_cast<ExprStmt&>(stmt));
+            case NodeKind::Return: return self().visit(static_cast<ReturnStmt&>(stmt));
+            case NodeKind::Block: return self().visit(static_cast<Block&>(stmt));
+            case NodeKind::If: return self().visit(static_cast<IfStmt&>(stmt));
+            case NodeKind::While: return self().visit(static_cast<WhileStmt&>(stmt));
+            case NodeKind::For: return self().visit(static_cast<ForStmt&>(stmt));
+            case NodeKind::Function: return self().visit(static_cast<FunctionStmt&>(stmt));
+            case NodeKind::VarDecl: return self().visit(static_cast<VarDeclStmt&>(stmt));
+            case NodeKind::StructDecl: return self().visit(static_cast<StructDeclStmt&>(stmt));
+            case NodeKind::EnumDecl: return self().visit(static_cast<EnumDeclStmt&>(stmt));
+            case NodeKind::Match: return self().visit(static_cast<MatchStmt&>(stmt));
+            default: llvm_unreachable("expression kind on a statement");
+        }
+    }
+
+private:
+    Derived& self() { return static_cast<Derived&>(*this); }
+};
+
 } // namespace pynext
 
 #endif // PYNEXT_AST_H
@@ -0,0 +1,370 @@
+#include "FlatAST.h"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+
+namespace pynext {
+
+// Appends every node after its children, so a node's handle is known when
+// its parent is written
+class FlatASTBuilder : public ASTVisitor {
+public:
+    explicit FlatASTBuilder(FlatAST& ast) : ast(ast) {}
+
+    NodeRef build(ASTNode& node) {
+        node.accept(*this);
+        return result;
+    }
+    NodeRef buildOptional(ASTNode* node) { return node ? build(*node) : NodeRef(); }
+
+    ListRange buildList(llvm::ArrayRef<NodeRef> refs) {
+        ListRange range{static_cast<uint32_t>(ast.childLists.size()), static_cast<uint32_t>(refs.size())};
+        ast.childLists.insert(ast.childLists.end(), refs.begin(), refs.end());
+        return range;
+    }
+
+    template <typename T>
+    ListRange buildChildren(const std::vector<std::unique_ptr<T>>& nodes) {
+        std::vector<NodeRef> refs;
+        refs.reserve(nodes.size());
+        for (const auto& node : nodes) refs.push_back(build(*node));
+        return buildList(refs);
+    }
+
+    ListRange buildMembers(const std::vector<std::pair<std::string, std::string>>& pairs) {
+        ListRange range{static_cast<uint32_t>(ast.memberLists.size()), static_cast<uint32_t>(pairs.size())};
+        for (const auto& [name, typeName] : pairs) ast.memberLists.push_back({intern(name), intern(typeName)});
+        return range;
+    }
+
+    NameId intern(const std::string& text) {
+        if (text.empty()) return 0;
+        auto [it, inserted] = nameIds.try_emplace(text, static_cast<NameId>(ast.names.size()));
+        if (inserted) ast.names.push_back(text);
+        return it->second;
+    }
+
+    TypeId intern(const std::shared_ptr<Type>& type) {
+        if (!type) return 0;
+        auto [it, inserted] = typeIds.try_emplace(type.get(), static_cast<TypeId>(ast.types.size()));
+        if (inserted) ast.types.push_back(type);
+        return it->second;
+    }
+
+    static Position position(const ASTNode& node) {
+        return {static_cast<uint32_t>(node.line), static_cast<uint32_t>(node.column)};
+    }
+
+    template <typename T>
+    void append(NodeKind kind, std::vector<T>& nodes, T node) {
+        result = NodeRef(kind, static_cast<uint32_t>(nodes.size()));
+        nodes.push_back(node);
+    }
+
+    void visit(LiteralExpr& expr) override {
+        LiteralKind kind = expr.isString ? LiteralKind::String
+                         : expr.isBool   ? LiteralKind::Bool
+                         : expr.isFloat  ? LiteralKind::Float
+                                         : LiteralKind::Int;
+        append(NodeKind::Literal, ast.literalNodes,
+               LiteralNode{position(expr), intern(expr.value), intern(expr.type), kind});
+    }
+    void visit(VariableExpr& expr) override {
+        append(NodeKind::Variable, ast.variableNodes,
+               VariableNode{position(expr), intern(expr.name), intern(expr.type)});
+    }
+    void visit(BinaryExpr& expr) override {
+        NodeRef left = build(*expr.left);
+        NodeRef right = build(*expr.right);
+        append(NodeKind::Binary, ast.binaryNodes,
+               BinaryNode{position(expr), intern(expr.op), intern(expr.type), left, right});
+    }
+    void visit(CallExpr& expr) override {
+        ListRange args = buildChildren(expr.args);
+        append(NodeKind::Call, ast.callNodes, CallNode{position(expr), intern(expr.callee), intern(expr.type), args});
+    }
+    void visit(MemberAccessExpr& expr) override {
+        NodeRef object = build(*expr.object);
+        append(NodeKind::MemberAccess, ast.memberNodes,
+               MemberAccessNode{position(expr), intern(expr.member), intern(expr.type), object});
+    }
+    void visit(IndexExpr& expr) override {
+        NodeRef object = build(*expr.object);
+        NodeRef index = build(*expr.index);
+        append(NodeKind::Index, ast.indexNodes, IndexNode{position(expr), intern(expr.type), object, index});
+    }
+    void visit(ArrayLiteralExpr& expr) override {
+        ListRange elements = buildChildren(expr.elements);
+        append(NodeKind::ArrayLiteral, ast.arrayNodes, ArrayLiteralNode{position(expr), intern(expr.type), elements});
+    }
+    void visit(ExprStmt& stmt) override {
+        NodeRef expr = build(*stmt.expr);
+        append(NodeKind::ExprStmt, ast.exprStmtNodes, ExprStmtNode{position(stmt), expr});
+    }
+    void visit(ReturnStmt& stmt) override {
+        NodeRef value = buildOptional(stmt.value.get());
+        append(NodeKind::Return, ast.returnNodes, ReturnNode{position(stmt), value});
+    }
+    void visit(Block& stmt) override {
+        ListRange statements = buildChildren(stmt.statements);
+        append(NodeKind::Block, ast.blockNodes, BlockNode{position(stmt), statements});
+    }
+    void visit(IfStmt& stmt) override {
+        NodeRef condition = build(*stmt.condition);
+        NodeRef thenBranch = build(*stmt.thenBranch);
+        NodeRef elseBranch = buildOptional(stmt.elseBranch.get());
+        append(NodeKind::If, ast.ifNodes, IfNode{position(stmt), condition, thenBranch, elseBranch});
+    }
+    void visit(WhileStmt& stmt) override {
+        NodeRef condition = build(*stmt.condition);
+        NodeRef body = build(*stmt.body);
+        append(NodeKind::While, ast.whileNodes, WhileNode{position(stmt), condition, body});
+    }
+    void visit(ForStmt& stmt) override {
+        NodeRef iterator = build(*stmt.iterator);
+        NodeRef body = build(*stmt.body);
+        append(NodeKind::For, ast.forNodes, ForNode{position(stmt), intern(stmt.variable), iterator, body});
+    }
+    void visit(FunctionStmt& stmt) override {
+        ListRange params = buildMembers(stmt.params);
+        NodeRef body = buildOptional(stmt.body.get());
+        append(NodeKind::Function, ast.functionNodes,
+               FunctionNode{position(stmt), intern(stmt.name), intern(stmt.returnType), params, body});
+    }
+    void visit(VarDeclStmt& stmt) override {
+        NodeRef initializer = buildOptional(stmt.initializer.get());
+        append(NodeKind::VarDecl, ast.varDeclNodes,
+               VarDeclNode{position(stmt), intern(stmt.name), intern(stmt.typeName), intern(stmt.type), initializer,
+                           stmt.global});
+    }
+    void visit(StructDeclStmt& stmt) override {
+        ListRange fields = buildMembers(stmt.fields);
+        append(NodeKind::StructDecl, ast.structNodes, StructDeclNode{position(stmt), intern(stmt.name), fields});
+    }
+    void visit(EnumDeclStmt& stmt) override {
+        std::vector<Variant> variants;
+        for (const auto& variant : stmt.variants) {
+            variants.push_back({intern(variant.name), buildMembers(variant.fields)});
+        }
+        ListRange range{static_cast<uint32_t>(ast.variantLists.size()), static_cast<uint32_t>(variants.size())};
+        ast.variantLists.insert(ast.variantLists.end(), variants.begin(), variants.end());
+        append(NodeKind::EnumDecl, ast.enumNodes, EnumDeclNode{position(stmt), intern(stmt.name), range});
+    }
+    void visit(MatchStmt& stmt) override {
+        NodeRef subject = build(*stmt.subject);
+        std::vector<Case> cases;
+        for (const auto& matchCase : stmt.cases) {
+            std::vector<std::pair<std::string, std::string>> bindings;
+            for (const auto& name : matchCase.bindings) bindings.emplace_back(name, "");
+            ListRange bindingRange = buildMembers(bindings);
+            cases.push_back({intern(matchCase.variant), bindingRange, build(*matchCase.body)});
+        }
+        ListRange range{static_cast<uint32_t>(ast.caseLists.size()), static_cast<uint32_t>(cases.size())};
+        ast.caseLists.insert(ast.caseLists.end(), cases.begin(), cases.end());
+        NodeRef elseBranch = buildOptional(stmt.elseBranch.get());
+        append(NodeKind::Match, ast.matchNodes, MatchNode{position(stmt), subject, range, elseBranch});
+    }
+
+private:
+    FlatAST& ast;
+    NodeRef result;
+    llvm::StringMap<NameId> nameIds;
+    llvm::DenseMap<const Type*, TypeId> typeIds;
+};
+
+FlatAST FlatAST::fromTree(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+    FlatAST ast;
+    FlatASTBuilder builder(ast);
+    for (const auto& stmt : stmts) ast.roots.push_back(builder.build(*stmt));
+    return ast;
+}
+
+namespace {
+
+class TreeBuilder {
+public:
+    explicit TreeBuilder(const FlatAST& ast) : ast(ast) {}
+
+    template <typename T>
+    static std::unique_ptr<T> at(std::unique_ptr<T> node, Position pos) {
+        node->line = static_cast<int>(pos.line);
+        node->column = static_cast<int>(pos.column);
+        return node;
+    }
+
+    template <typename T>
+    std::unique_ptr<T> typed(std::unique_ptr<T> expr, Position pos, TypeId type) {
+        expr->type = ast.type(type);
+        return at(std::move(expr), pos);
+    }
+
+    std::string text(NameId id) const { return ast.name(id).str(); }
+
+    std::vector<std::pair<std::string, std::string>> members(ListRange range) const {
+        std::vector<std::pair<std::string, std::string>> pairs;
+        for (const Member& member : ast.members(range)) pairs.emplace_back(text(member.name), text(member.typeName));
+        return pairs;
+    }
+
+    std::vector<std::unique_ptr<Expr>> exprs(ListRange range) {
+        std::vector<std::unique_ptr<Expr>> result;
+        for (NodeRef ref : ast.children(range)) result.push_back(expr(ref));
+        return result;
+    }
+
+    std::unique_ptr<Expr> expr(NodeRef ref) {
+        if (!ref) return nullptr;
+        switch (ref.kind()) {
+            case NodeKind::Literal: {
+                const LiteralNode& node = ast.literal(ref);
+                return typed(std::make_unique<LiteralExpr>(text(node.text), node.kind == LiteralKind::Float,
+                                                           node.kind == LiteralKind::Bool,
+                                                           node.kind == LiteralKind::String),
+                             node.pos, node.type);
+            }
+            case NodeKind::Variable: {
+                const VariableNode& node = ast.variable(ref);
+                return typed(std::make_unique<VariableExpr>(text(node.name)), node.pos, node.type);
+            }
+            case NodeKind::Binary: {
+                const BinaryNode& node = ast.binary(ref);
+                return typed(std::make_unique<BinaryExpr>(text(node.op), expr(node.left), expr(node.right)),
+                             node.pos, node.type);
+            }
+            case NodeKind::Call: {
+                const CallNode& node = ast.call(ref);
+                return typed(std::make_unique<CallExpr>(text(node.callee), exprs(node.args)), node.pos, node.type);
+            }
+            case NodeKind::MemberAccess: {
+                const MemberAccessNode& node = ast.memberAccess(ref);
+                return typed(std::make_unique<MemberAccessExpr>(expr(node.object), text(node.member)), node.pos,
+                             node.type);
+            }
+            case NodeKind::Index: {
+                const IndexNode& node = ast.indexExpr(ref);
+                return typed(std::make_unique<IndexExpr>(expr(node.object), expr(node.index)), node.pos, node.type);
+            }
+            case NodeKind::ArrayLiteral: {
+                const ArrayLiteralNode& node = ast.arrayLiteral(ref);
+                return typed(std::make_unique<ArrayLiteralExpr>(exprs(node.elements)), node.pos, node.type);
+            }
+            default: return nullptr;
+        }
+    }
+
+    std::unique_ptr<Block> block(NodeRef ref) {
+        if (!ref) return nullptr;
+        const BlockNode& node = ast.block(ref);
+        auto result = at(std::make_unique<Block>(), node.pos);
+        for (NodeRef child : ast.children(node.statements)) result->statements.push_back(stmt(child));
+        return result;
+    }
+
+    std::unique_ptr<Stmt> stmt(NodeRef ref) {
+        switch (ref.kind()) {
+            case NodeKind::ExprStmt: {
+                const ExprStmtNode& node = ast.exprStmt(ref);
+                return at(std::make_unique<ExprStmt>(expr(node.expr)), node.pos);
+            }
+            case NodeKind::Return: {
+                const ReturnNode& node = ast.returnStmt(ref);
+                return at(std::make_unique<ReturnStmt>(expr(node.value)), node.pos);
+            }
+            case NodeKind::Block: return block(ref);
+            case NodeKind::If: {
+                const IfNode& node = ast.ifStmt(ref);
+                return at(std::make_unique<IfStmt>(expr(node.condition), block(node.thenBranch),
+                                                   block(node.elseBranch)),
+                          node.pos);
+            }
+            case NodeKind::While: {
+                const WhileNode& node = ast.whileStmt(ref);
+                return at(std::make_unique<WhileStmt>(expr(node.condition), block(node.body)), node.pos);
+            }
+            case NodeKind::For: {
+                const ForNode& node = ast.forStmt(ref);
+                return at(std::make_unique<ForStmt>(text(node.variable), expr(node.iterator), block(node.body)),
+                          node.pos);
+            }
+            case NodeKind::Function: {
+                const FunctionNode& node = ast.function(ref);
+                return at(std::make_unique<FunctionStmt>(text(node.name), members(node.params),
+                                                         text(node.returnType), block(node.body)),
+                          node.pos);
+            }
+            case NodeKind::VarDecl: {
+                const VarDeclNode& node = ast.varDecl(ref);
+                auto result = std::make_unique<VarDeclStmt>(text(node.name), text(node.typeName),
+                                                            expr(node.initializer));
+                result->type = ast.type(node.type);
+                result->global = node.global;
+                return at(std::move(result), node.pos);
+            }
+            case NodeKind::StructDecl: {
+                const StructDeclNode& node = ast.structDecl(ref);
+                return at(std::make_unique<StructDeclStmt>(text(node.name), members(node.fields)), node.pos);
+            }
+            case NodeKind::EnumDecl: {
+                const EnumDeclNode& node = ast.enumDecl(ref);
+                std::vector<EnumVariant> variants;
+                for (const Variant& variant : ast.variants(node.variants)) {
+                    variants.push_back({text(variant.name), members(variant.fields)});
+                }
+                return at(std::make_unique<EnumDeclStmt>(text(node.name), std::move(variants)), node.pos);
+            }
+            case NodeKind::Match: {
+                const MatchNode& node = ast.match(ref);
+                std::vector<MatchCase> cases;
+                for (const Case& matchCase : ast.cases(node.cases)) {
+                    std::vector<std::string> bindings;
+                    for (const Member& member : ast.members(matchCase.bindings)) bindings.push_back(text(member.name));
+                    cases.push_back({text(matchCase.variant), std::move(bindings), block(matchCase.body)});
+                }
+                return at(std::make_unique<MatchStmt>(expr(node.subject), std::move(cases), block(node.elseBranch)),
+                          node.pos);
+            }
+            default: return nullptr;
+        }
+    }
+
+private:
+    const FlatAST& ast;
+};
+
+template <typename T>
+size_t capacityBytes(const std::vector<T>& nodes) {
+    return nodes.capacity() * sizeof(T);
+}
+
+} // namespace
+
+std::vector<std::unique_ptr<Stmt>> FlatAST::toTree() const {
+    TreeBuilder builder(*this);
+    std::vector<std::unique_ptr<Stmt>> stmts;
+    for (NodeRef root : roots) stmts.push_back(builder.stmt(root));
+    return stmts;
+}
+
+size_t FlatAST::nodeCount() const {
+    return literalNodes.size() + variableNodes.size() + binaryNodes.size() + callNodes.size() + memberNodes.size() +
+           indexNodes.size() + arrayNodes.size() + exprStmtNodes.size() + returnNodes.size() + blockNodes.size() +
+           ifNodes.size() + whileNodes.size() + forNodes.size() + functionNodes.size() + varDeclNodes.size() +
+           structNodes.size() + enumNodes.size() + matchNodes.size();
+}
+
+size_t FlatAST::bytes() const {
+    size_t total = capacityBytes(roots) + capacityBytes(literalNodes) + capacityBytes(variableNodes) +
+                   capacityBytes(binaryNodes) + capacityBytes(callNodes) + capacityBytes(memberNodes) +
+                   capacityBytes(indexNodes) + capacityBytes(arrayNodes) + capacityBytes(exprStmtNodes) +
+                   capacityBytes(returnNodes) + capacityBytes(blockNodes) + capacityBytes(ifNodes) +
+                   capacityBytes(whileNodes) + capacityBytes(forNodes) + capacityBytes(functionNodes) +
+                   capacityBytes(varDeclNodes) + capacityBytes(structNodes) + capacityBytes(enumNodes) +
+                   capacityBytes(matchNodes) + capacityBytes(childLists) + capacityBytes(memberLists) +
+                   capacityBytes(variantLists) + capacityBytes(caseLists) + capacityBytes(names) +
+                   capacityBytes(types);
+    for (const auto& name : names) {
+        if (name.capacity() > std::string().capacity()) total += name.capacity() + 1;
+    }
+    return total;
+}
+
+} // namespace pynext
@@ -0,0 +1,320 @@
+#ifndef PYNEXT_FLAT_AST_H
+#define PYNEXT_FLAT_AST_H
+
+#include "AST.h"
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// A compact alternative to the pointer tree of AST.h. Nodes live in one
+// contiguous array per kind and refer to their children by 32-bit handle;
+// names are interned and referred to by 32-bit id, and sema types by 32-bit
+// id into a side table. There are no vtables, no per-node allocations and no
+// shared_ptr copies, so a traversal walks a few dense arrays instead of
+// chasing pointers across the heap, and a pass that only cares about one
+// kind of node (every call, every variable declaration) is a linear scan of
+// that kind's array.
+//
+// Built from a parsed (and optionally type-checked) tree with fromTree();
+// toTree() rebuilds an equivalent tree.
+
+// Kind in the top 5 bits, index into that kind's array in the low 27
+class NodeRef {
+public:
+    NodeRef() = default;
+    NodeRef(NodeKind kind, uint32_t index) : bits(static_cast<uint32_t>(kind) << kIndexBits | index) {}
+
+    bool valid() const { return bits != kInvalid; }
+    explicit operator bool() const { return valid(); }
+    NodeKind kind() const { return static_cast<NodeKind>(bits >> kIndexBits); }
+    uint32_t index() const { return bits & ((1u << kIndexBits) - 1); }
+
+    static constexpr uint32_t kIndexBits = 27;
+
+private:
+    static constexpr uint32_t kInvalid = ~0u;
+    uint32_t bits = kInvalid;
+};
+
+using NameId = uint32_t; // Into FlatAST::name(); 0 is ""
+using TypeId = uint32_t; // Into FlatAST::type(); 0 is "not type-checked"
+
+// A run of child handles or name pairs in FlatAST's shared list arrays
+struct ListRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+struct Member {
+    NameId name;
+    NameId typeName;
+};
+
+struct Position {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+enum class LiteralKind : uint8_t { Int, Float, Bool, String };
+
+struct LiteralNode { Position pos; NameId text; TypeId type; LiteralKind kind; };
+struct VariableNode { Position pos; NameId name; TypeId type; };
+struct BinaryNode { Position pos; NameId op; TypeId type; NodeRef left, right; };
+struct CallNode { Position pos; NameId callee; TypeId type; ListRange args; };
+struct MemberAccessNode { Position pos; NameId member; TypeId type; NodeRef object; };
+struct IndexNode { Position pos; TypeId type; NodeRef object, index; };
+struct ArrayLiteralNode { Position pos; TypeId type; ListRange elements; };
+struct ExprStmtNode { Position pos; NodeRef expr; };
+struct ReturnNode { Position pos; NodeRef value; }; // value is invalid for a bare return
+struct BlockNode { Position pos; ListRange statements; };
+struct IfNode { Position pos; NodeRef condition, thenBranch, elseBranch; };
+struct WhileNode { Position pos; NodeRef condition, body; };
+struct ForNode { Position pos; NameId variable; NodeRef iterator, body; };
+struct FunctionNode { Position pos; NameId name; NameId returnType; ListRange params; NodeRef body; }; // No body: extern
+struct VarDeclNode { Position pos; NameId name; NameId typeName; TypeId type; NodeRef initializer; bool global; };
+struct StructDeclNode { Position pos; NameId name; ListRange fields; };
+struct EnumDeclNode { Position pos; NameId name; ListRange variants; };
+struct MatchNode { Position pos; NodeRef subject; ListRange cases; NodeRef elseBranch; };
+
+struct Variant {
+    NameId name;
+    ListRange fields; // Into members()
+};
+
+struct Case {
+    NameId variant;
+    ListRange bindings; // Into members(), without type names
+    NodeRef body;
+};
+
+class FlatAST {
+public:
+    static FlatAST fromTree(const std::vector<std::unique_ptr<Stmt>>& stmts);
+    std::vector<std::unique_ptr<Stmt>> toTree() const;
+
+    llvm::ArrayRef<NodeRef> topLevel() const { return roots; }
+
+    // Every node of a kind, in the order the tree was walked (children
+    // before their parents)
+    llvm::ArrayRef<LiteralNode> literals() const { return literalNodes; }
+    llvm::ArrayRef<VariableNode> variables() const { return variableNodes; }
+    llvm::ArrayRef<BinaryNode> binaries() const { return binaryNodes; }
+    llvm::ArrayRef<CallNode> calls() const { return callNodes; }
+    llvm::ArrayRef<MemberAccessNode> memberAccesses() const { return memberNodes; }
+    llvm::ArrayRef<IndexNode> indexes() const { return indexNodes; }
+    llvm::ArrayRef<ArrayLiteralNode> arrayLiterals() const { return arrayNodes; }
+    llvm::ArrayRef<ExprStmtNode> exprStmts() const { return exprStmtNodes; }
+    llvm::ArrayRef<ReturnNode> returns() const { return returnNodes; }
+    llvm::ArrayRef<BlockNode> blocks() const { return blockNodes; }
+    llvm::ArrayRef<IfNode> ifs() const { return ifNodes; }
+    llvm::ArrayRef<WhileNode> whiles() const { return whileNodes; }
+    llvm::ArrayRef<ForNode> fors() const { return forNodes; }
+    llvm::ArrayRef<FunctionNode> functions() const { return functionNodes; }
+    llvm::ArrayRef<VarDeclNode> varDecls() const { return varDeclNodes; }
+    llvm::ArrayRef<StructDeclNode> structDecls() const { return structNodes; }
+    llvm::ArrayRef<EnumDeclNode> enumDecls() const { return enumNodes; }
+    llvm::ArrayRef<MatchNode> matches() const { return matchNodes; }
+
+    const LiteralNode& literal(NodeRef ref) const { return literalNodes[ref.index()]; }
+    const VariableNode& variable(NodeRef ref) const { return variableNodes[ref.index()]; }
+    const BinaryNode& binary(NodeRef ref) const { return binaryNodes[ref.index()]; }
+    const CallNode& call(NodeRef ref) const { return callNodes[ref.index()]; }
+    const MemberAccessNode& memberAccess(NodeRef ref) const { return memberNodes[ref.index()]; }
+    const IndexNode& indexExpr(NodeRef ref) const { return indexNodes[ref.index()]; }
+    const ArrayLiteralNode& arrayLiteral(NodeRef ref) const { return arrayNodes[ref.index()]; }
+    const ExprStmtNode& exprStmt(NodeRef ref) const { return exprStmtNodes[ref.index()]; }
+    const ReturnNode& returnStmt(NodeRef ref) const { return returnNodes[ref.index()]; }
+    const BlockNode& block(NodeRef ref) const { return blockNodes[ref.index()]; }
+    const IfNode& ifStmt(NodeRef ref) const { return ifNodes[ref.index()]; }
+    const WhileNode& whileStmt(NodeRef ref) const { return whileNodes[ref.index()]; }
+    const ForNode& forStmt(NodeRef ref) const { return forNodes[ref.index()]; }
+    const FunctionNode& function(NodeRef ref) const { return functionNodes[ref.index()]; }
+    const VarDeclNode& varDecl(NodeRef ref) const { return varDeclNodes[ref.index()]; }
+    const StructDeclNode& structDecl(NodeRef ref) const { return structNodes[ref.index()]; }
+    const EnumDeclNode& enumDecl(NodeRef ref) const { return enumNodes[ref.index()]; }
+    const MatchNode& match(NodeRef ref) const { return matchNodes[ref.index()]; }
+
+    llvm::ArrayRef<NodeRef> children(ListRange range) const {
+        return llvm::ArrayRef<NodeRef>(childLists).slice(range.first, range.count);
+    }
+    llvm::ArrayRef<Member> members(ListRange range) const {
+        return llvm::ArrayRef<Member>(memberLists).slice(range.first, range.count);
+    }
+    llvm::ArrayRef<Variant> variants(ListRange range) const {
+        return llvm::ArrayRef<Variant>(variantLists).slice(range.first, range.count);
+    }
+    llvm::ArrayRef<Case> cases(ListRange range) const {
+        return llvm::ArrayRef<Case>(caseLists).slice(range.first, range.count);
+    }
+    llvm::StringRef name(NameId id) const { return names[id]; }
+    const std::shared_ptr<Type>& type(TypeId id) const { return types[id]; }
+
+    size_t nodeCount() const;
+    // Heap bytes held by the node arrays, child lists and name table
+    size_t bytes() const;
+
+private:
+    friend class FlatASTBuilder;
+
+    std::vector<NodeRef> roots;
+    std::vector<LiteralNode> literalNodes;
+    std::vector<VariableNode> variableNodes;
+    std::vector<BinaryNode> binaryNodes;
+    std::vector<CallNode> callNodes;
+    std::vector<MemberAccessNode> memberNodes;
+    std::vector<IndexNode> indexNodes;
+    std::vector<ArrayLiteralNode> arrayNodes;
+    std::vector<ExprStmtNode> exprStmtNodes;
+    std::vector<ReturnNode> returnNodes;
+    std::vector<BlockNode> blockNodes;
+    std::vector<IfNode> ifNodes;
+    std::vector<WhileNode> whileNodes;
+    std::vector<ForNode> forNodes;
+    std::vector<FunctionNode> functionNodes;
+    std::vector<VarDeclNode> varDeclNodes;
+    std::vector<StructDeclNode> structNodes;
+    std::vector<EnumDeclNode> enumNodes;
+    std::vector<MatchNode> matchNodes;
+
+    std::vector<NodeRef> childLists;
+    std::vector<Member> memberLists;
+    std::vector<Variant> variantLists;
+    std::vector<Case> caseLists;
+    std::vector<std::string> names{""};
+    std::vector<std::shared_ptr<Type>> types{nullptr};
+};
+
+// Depth-first traversal of a FlatAST by kind switch, without virtual calls.
+// Derived classes define the visitX methods they care about and call
+// visitChildren() to descend; the defaults only descend.
+//
+//   struct CallCounter : FlatVisitor<CallCounter> {
+//       using FlatVisitor::FlatVisitor;
+//       size_t calls = 0;
+//       void visitCall(NodeRef ref, const CallNode&) { calls++; visitChildren(ref); }
+//   };
+template <typename Derived>
+class FlatVisitor {
+public:
+    explicit FlatVisitor(const FlatAST& ast) : ast(ast) {}
+
+    void visitAll() {
+        for (NodeRef root : ast.topLevel()) self().visit(root);
+    }
+
+    // Derived classes may hide this to see every node before its visitX
+    void visit(NodeRef ref) {
+        switch (ref.kind()) {
+            case NodeKind::Literal: return self().visitLiteral(ref, ast.literal(ref));
+            case NodeKind::Variable: return self().visitVariable(ref, ast.variable(ref));
+            case NodeKind::Binary: return self().visitBinary(ref, ast.binary(ref));
+            case NodeKind::Call: return self().visitCall(ref, ast.call(ref));
+            case NodeKind::MemberAccess: return self().visitMemberAccess(ref, ast.memberAccess(ref));
+            case NodeKind::Index: return self().visitIndex(ref, ast.indexExpr(ref));
+            case NodeKind::ArrayLiteral: return self().visitArrayLiteral(ref, ast.arrayLiteral(ref));
+            case NodeKind::ExprStmt: return self().visitExprStmt(ref, ast.exprStmt(ref));
+            case NodeKind::Return: return self().visitReturn(ref, ast.returnStmt(ref));
+            case NodeKind::Block: return self().visitBlock(ref, ast.block(ref));
+            case NodeKind::If: return self().visitIf(ref, ast.ifStmt(ref));
+            case NodeKind::While: return self().visitWhile(ref, ast.whileStmt(ref));
+            case NodeKind::For: return self().visitFor(ref, ast.forStmt(ref));
+            case NodeKind::Function: return self().visitFunction(ref, ast.function(ref));
+            case NodeKind::VarDecl: return self().visitVarDecl(ref, ast.varDecl(ref));
+            case NodeKind::StructDecl: return self().visitStructDecl(ref, ast.structDecl(ref));
+            case NodeKind::EnumDecl: return self().visitEnumDecl(ref, ast.enumDecl(ref));
+            case NodeKind::Match: return self().visitMatch(ref, ast.match(ref));
+        }
+    }
+
+    void visitChildren(NodeRef ref) {
+        auto visitIfValid = [this](NodeRef child) {
+            if (child) self().visit(child);
+        };
+        switch (ref.kind()) {
+            case NodeKind::Literal:
+            case NodeKind::Variable:
+            case NodeKind::StructDecl:
+            case NodeKind::EnumDecl:
+                return;
+            case NodeKind::Binary: {
+                const BinaryNode& node = ast.binary(ref);
+                self().visit(node.left);
+                return self().visit(node.right);
+            }
+            case NodeKind::Call:
+                for (NodeRef arg : ast.children(ast.call(ref).args)) self().visit(arg);
+                return;
+            case NodeKind::MemberAccess: return self().visit(ast.memberAccess(ref).object);
+            case NodeKind::Index: {
+                const IndexNode& node = ast.indexExpr(ref);
+                self().visit(node.object);
+                return self().visit(node.index);
+            }
+            case NodeKind::ArrayLiteral:
+                for (NodeRef element : ast.children(ast.arrayLiteral(ref).elements)) self().visit(element);
+                return;
+            case NodeKind::ExprStmt: return self().visit(ast.exprStmt(ref).expr);
+            case NodeKind::Return: return visitIfValid(ast.returnStmt(ref).value);
+            case NodeKind::Block:
+                for (NodeRef stmt : ast.children(ast.block(ref).statements)) self().visit(stmt);
+                return;
+            case NodeKind::If: {
+                const IfNode& node = ast.ifStmt(ref);
+                self().visit(node.condition);
+                self().visit(node.thenBranch);
+                return visitIfValid(node.elseBranch);
+            }
+            case NodeKind::While: {
+                const WhileNode& node = ast.whileStmt(ref);
+                self().visit(node.condition);
+                return self().visit(node.body);
+            }
+            case NodeKind::For: {
+                const ForNode& node = ast.forStmt(ref);
+                self().visit(node.iterator);
+                return self().visit(node.body);
+            }
+            case NodeKind::Function: return visitIfValid(ast.function(ref).body);
+            case NodeKind::VarDecl: return visitIfValid(ast.varDecl(ref).initializer);
+            case NodeKind::Match: {
+                const MatchNode& node = ast.match(ref);
+                self().visit(node.subject);
+                for (const Case& matchCase : ast.cases(node.cases)) self().visit(matchCase.body);
+                return visitIfValid(node.elseBranch);
+            }
+        }
+    }
+
+    void visitLiteral(NodeRef ref, const LiteralNode&) { visitChildren(ref); }
+    void visitVariable(NodeRef ref, const VariableNode&) { visitChildren(ref); }
+    void visitBinary(NodeRef ref, const BinaryNode&) { visitChildren(ref); }
+    void visitCall(NodeRef ref, const CallNode&) { visitChildren(ref); }
+    void visitMemberAccess(NodeRef ref, const MemberAccessNode&) { visitChildren(ref); }
+    void visitIndex(NodeRef ref, const IndexNode&) { visitChildren(ref); }
+    void visitArrayLiteral(NodeRef ref, const ArrayLiteralNode&) { visitChildren(ref); }
+    void visitExprStmt(NodeRef ref, const ExprStmtNode&) { visitChildren(ref); }
+    void visitReturn(NodeRef ref, const ReturnNode&) { visitChildren(ref); }
+    void visitBlock(NodeRef ref, const BlockNode&) { visitChildren(ref); }
+    void visitIf(NodeRef ref, const IfNode&) { visitChildren(ref); }
+    void visitWhile(NodeRef ref, const WhileNode&) { visitChildren(ref); }
+    void visitFor(NodeRef ref, const ForNode&) { visitChildren(ref); }
+    void visitFunction(NodeRef ref, const FunctionNode&) { visitChildren(ref); }
+    void visitVarDecl(NodeRef ref, const VarDeclNode&) { visitChildren(ref); }
+    void visitStructDecl(NodeRef ref, const StructDeclNode&) { visitChildren(ref); }
+    void visitEnumDecl(NodeRef ref, const EnumDeclNode&) { visitChildren(ref); }
+    void visitMatch(NodeRef ref, const MatchNode&) { visitChildren(ref); }
+
+protected:
+    Derived& self() { return static_cast<Derived&>(*this); }
+
+    const FlatAST& ast;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_FLAT_AST_H
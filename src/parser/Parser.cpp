@@ -20,23 +20,52 @@ Token Parser::consume(TokenKind kind, const std::string& errorMsg) {
         advance();
         return token;
     }
-    std::cerr << "Parser Error: " << errorMsg << " Got: " << toString(currentToken.kind) << "\n";
-    // For now, return error token or throw (simple recovery approach: exit)
-    exit(1); 
+    fail(errorMsg + " Got: " + toString(currentToken.kind));
+    return currentToken;
+}
+
+// Reports the first error and skips to the end of input, which ends every
+// parsing loop; later errors are follow-on noise.
+void Parser::fail(const std::string& message) {
+    if (!failed) std::cerr << "Parser Error: " << message << "\n";
+    failed = true;
+    while (currentToken.kind != TokenKind::EndOfFile) advance();
+}
+
+const std::vector<ImportDecl>& Parser::parseImports() {
+    if (importsParsed) return imports;
+    importsParsed = true;
+    while (currentToken.kind == TokenKind::Import) {
+        Token start = currentToken;
+        advance();
+        Token name = consume(TokenKind::Identifier, "Expected module name after 'import'");
+        if (failed) break;
+        imports.push_back({std::string(name.text), start.line, start.column});
+    }
+    return imports;
 }
 
 std::vector<std::unique_ptr<Stmt>> Parser::parseModule() {
+    parseImports();
     std::vector<std::unique_ptr<Stmt>> statements;
     while (currentToken.kind != TokenKind::EndOfFile) {
+        Token start = currentToken;
+        if (currentToken.kind == TokenKind::Import) {
+            fail("'import' must come before all other statements (line " + std::to_string(start.line) + ")");
+            break;
+        }
         if (currentToken.kind == TokenKind::Def) {
             statements.push_back(parseFunction());
         } else if (currentToken.kind == TokenKind::Struct) {
             statements.push_back(parseStruct());
+        } else if (currentToken.kind == TokenKind::Enum) {
+            statements.push_back(parseEnum());
         } else if (currentToken.kind == TokenKind::Extern) {
             statements.push_back(parseExtern());
         } else {
             statements.push_back(parseStatement());
         }
+        setLocation(*statements.back(), start);
     }
     return statements;
 }
@@ -57,6 +86,69 @@ std::unique_ptr<StructDeclStmt> Parser::parseStruct() {
     return std::make_unique<StructDeclStmt>(name, fields);
 }
 
+// enum Shape
+//     Circle(radius: float)
+//     Empty
+// end
+std::unique_ptr<EnumDeclStmt> Parser::parseEnum() {
+    consume(TokenKind::Enum, "Expected 'enum'");
+    std::string name = std::string(consume(TokenKind::Identifier, "Expected enum name").text);
+
+    std::vector<EnumVariant> variants;
+    while (currentToken.kind != TokenKind::End && currentToken.kind != TokenKind::EndOfFile) {
+        EnumVariant variant;
+        variant.name = std::string(consume(TokenKind::Identifier, "Expected variant name").text);
+        if (match(TokenKind::LParen)) {
+            do {
+                std::string fieldName = std::string(consume(TokenKind::Identifier, "Expected field name").text);
+                consume(TokenKind::Colon, "Expected ':'");
+                variant.fields.push_back({fieldName, parseTypeName()});
+            } while (match(TokenKind::Comma));
+            consume(TokenKind::RParen, "Expected ')' after variant fields");
+        }
+        variants.push_back(std::move(variant));
+    }
+    consume(TokenKind::End, "Expected 'end' after enum body");
+
+    return std::make_unique<EnumDeclStmt>(name, std::move(variants));
+}
+
+// match s
+// case Circle(r)
+//     ...
+// else
+//     ...
+// end
+std::unique_ptr<MatchStmt> Parser::parseMatch() {
+    consume(TokenKind::Match, "Expected 'match'");
+    auto subject = parseExpression();
+
+    std::vector<MatchCase> cases;
+    while (currentToken.kind == TokenKind::Case) {
+        Token start = currentToken;
+        advance();
+        MatchCase matchCase;
+        matchCase.variant = std::string(consume(TokenKind::Identifier, "Expected variant name after 'case'").text);
+        if (match(TokenKind::LParen)) {
+            do {
+                matchCase.bindings.emplace_back(consume(TokenKind::Identifier, "Expected a name to bind").text);
+            } while (match(TokenKind::Comma));
+            consume(TokenKind::RParen, "Expected ')' after bound names");
+        }
+        matchCase.body = parseBlock();
+        setLocation(*matchCase.body, start);
+        cases.push_back(std::move(matchCase));
+    }
+    if (cases.empty()) fail("Expected 'case' after match subject. Got: " + toString(currentToken.kind));
+
+    std::unique_ptr<Block> elseBranch = nullptr;
+    if (match(TokenKind::Else)) {
+        elseBranch = parseBlock();
+    }
+    consume(TokenKind::End, "Expected 'end' after match");
+    return std::make_unique<MatchStmt>(std::move(subject), std::move(cases), std::move(elseBranch));
+}
+
 std::unique_ptr<FunctionStmt> Parser::parseExtern() {
     consume(TokenKind::Extern, "Expected 'extern'");
     consume(TokenKind::Def, "Expected 'def' after 'extern'");
@@ -112,10 +204,14 @@ std::unique_ptr<FunctionStmt> Parser::parseFunction() {
 
 std::unique_ptr<Block> Parser::parseBlock() {
     auto block = std::make_unique<Block>();
+    setLocation(*block, currentToken);
     while (currentToken.kind != TokenKind::End && 
            currentToken.kind != TokenKind::Else && 
+           currentToken.kind != TokenKind::Case &&
            currentToken.kind != TokenKind::EndOfFile) {
+        Token start = currentToken;
         block->statements.push_back(parseStatement());
+        setLocation(*block->statements.back(), start);
     }
     return block;
 }
@@ -123,7 +219,7 @@ std::unique_ptr<Block> Parser::parseBlock() {
 std::unique_ptr<Stmt> Parser::parseStatement() {
     if (match(TokenKind::Return)) {
         if (currentToken.kind == TokenKind::End || currentToken.kind == TokenKind::EndOfFile || 
-            currentToken.kind == TokenKind::Else) {
+            currentToken.kind == TokenKind::Else || currentToken.kind == TokenKind::Case) {
              // Empty return ? technically valid in void functions
              // But for now let's assume valid return is expression
              return std::make_unique<ReturnStmt>(nullptr); 
@@ -146,6 +242,10 @@ std::unique_ptr<Stmt> Parser::parseStatement() {
         return std::make_unique<IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
     }
 
+    if (currentToken.kind == TokenKind::Match) {
+        return parseMatch();
+    }
+
     if (match(TokenKind::While)) {
         auto condition = parseExpression();
         auto body = parseBlock();
@@ -192,6 +292,7 @@ std::unique_ptr<Expr> Parser::parseExpression() {
 }
 
 std::unique_ptr<Expr> Parser::parsePrimary() {
+    Token start = currentToken;
     std::unique_ptr<Expr> lhs;
     if (currentToken.kind == TokenKind::Identifier) {
         std::string name = std::string(currentToken.text);
@@ -238,22 +339,39 @@ std::unique_ptr<Expr> Parser::parsePrimary() {
         consume(TokenKind::RBracket, "Expected ']'");
         lhs = std::make_unique<ArrayLiteralExpr>(std::move(elements));
     } else if (match(TokenKind::LParen)) {
+        // Keeps the location of the inner expression
         lhs = parseExpression();
         consume(TokenKind::RParen, "Expected ')'");
     } else {
-        std::cerr << "Unexpected token in expression: " << toString(currentToken.kind) << "\n";
-        exit(1);
+        fail(std::string("Unexpected token in expression: ") + toString(currentToken.kind));
+        lhs = std::make_unique<LiteralExpr>("0", false);
     }
+    if (lhs->line == 0) setLocation(*lhs, start);
     
     // Handle Postfix Expressions (Member Access, Indexing)
     while (true) {
         if (match(TokenKind::Dot)) {
             std::string member = std::string(consume(TokenKind::Identifier, "Expected member name after '.'").text);
-            lhs = std::make_unique<MemberAccessExpr>(std::move(lhs), member);
+            if (lhs->kind == NodeKind::Variable && match(TokenKind::LParen)) {
+                // Shape.Circle(r) constructs an enum value; there are no methods
+                std::vector<std::unique_ptr<Expr>> args;
+                if (currentToken.kind != TokenKind::RParen) {
+                    do {
+                        args.push_back(parseExpression());
+                    } while (match(TokenKind::Comma));
+                }
+                consume(TokenKind::RParen, "Expected ')'");
+                std::string callee = static_cast<VariableExpr&>(*lhs).name + "." + member;
+                lhs = std::make_unique<CallExpr>(callee, std::move(args));
+            } else {
+                lhs = std::make_unique<MemberAccessExpr>(std::move(lhs), member);
+            }
+            setLocation(*lhs, start);
         } else if (match(TokenKind::LBracket)) {
             auto index = parseExpression();
             consume(TokenKind::RBracket, "Expected ']' after index");
             lhs = std::make_unique<IndexExpr>(std::move(lhs), std::move(index));
+            setLocation(*lhs, start);
         } else {
             break;
         }
@@ -292,11 +410,19 @@ std::unique_ptr<Expr> Parser::parseBinary(int exprPrec, std::unique_ptr<Expr> lh
         }
         
         lhs = std::make_unique<BinaryExpr>(std::string(opToken.text), std::move(lhs), std::move(rhs));
+        setLocation(*lhs, opToken);
     }
 }
 
 std::string Parser::parseTypeName() {
     std::string type = std::string(consume(TokenKind::Identifier, "Expected type name").text);
+    if (type == "dict" && match(TokenKind::LBracket)) {
+        std::string keyType = parseTypeName();
+        consume(TokenKind::Comma, "Expected ',' between the key and value types of a dict");
+        std::string valueType = parseTypeName();
+        consume(TokenKind::RBracket, "Expected ']' after dict value type");
+        type = "dict[" + keyType + "," + valueType + "]";
+    }
     while (match(TokenKind::LBracket)) {
         consume(TokenKind::RBracket, "Expected ']' after '[' in type name");
         type += "[]";
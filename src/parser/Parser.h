@@ -8,6 +8,13 @@
 
 namespace pynext {
 
+// `import foo` at the top of a file
+struct ImportDecl {
+    std::string module;
+    int line = 0;
+    int column = 0;
+};
+
 class Parser {
 public:
     explicit Parser(Lexer& lexer) : lexer(lexer) {
@@ -17,13 +24,30 @@ public:
 
     std::vector<std::unique_ptr<Stmt>> parseModule();
 
+    // The imports that open the module. parseModule calls this first; call
+    // it alone to find a file's imports without parsing the rest.
+    const std::vector<ImportDecl>& parseImports();
+    const std::vector<ImportDecl>& getImports() const { return imports; }
+
+    // A syntax error skips the rest of the input; the statements returned
+    // by parseModule are then incomplete and must not be compiled.
+    bool hadError() const { return failed; }
+
 private:
     Lexer& lexer;
     Token currentToken;
+    bool failed = false;
+    bool importsParsed = false;
+    std::vector<ImportDecl> imports;
 
     void advance();
     bool match(TokenKind kind);
     Token consume(TokenKind kind, const std::string& errorMsg);
+    void fail(const std::string& message);
+    static void setLocation(ASTNode& node, const Token& token) {
+        node.line = token.line;
+        node.column = token.column;
+    }
 
     // Initial simple grammar
     // Module -> (FunctionDecl | Statement)*
@@ -33,6 +57,8 @@ private:
     std::unique_ptr<Stmt> parseStatement();
     std::unique_ptr<FunctionStmt> parseFunction();
     std::unique_ptr<StructDeclStmt> parseStruct();
+    std::unique_ptr<EnumDeclStmt> parseEnum();
+    std::unique_ptr<MatchStmt> parseMatch();
     std::unique_ptr<FunctionStmt> parseExtern();
     std::unique_ptr<Block> parseBlock();
     
@@ -0,0 +1,163 @@
+#include "AllocTracker.h"
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
+namespace pynext {
+
+namespace {
+
+struct SiteStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+struct Allocation {
+    uint64_t size;
+    int32_t site;
+};
+
+struct FreedBlock {
+    int32_t allocSite;
+    int32_t freeSite;
+};
+
+struct BadFree {
+    int32_t freeSite;
+    int32_t allocSite;     // -1 if the pointer never came from the tracker
+    int32_t firstFreeSite; // -1 for invalid frees
+};
+
+// Freed blocks stay in `freed` until malloc hands their address out again,
+// so a second free of the same block is reported instead of reaching free().
+struct Tracker {
+    std::mutex mutex;
+    std::unordered_map<void*, Allocation> live;
+    std::unordered_map<void*, FreedBlock> freed;
+    std::vector<SiteStats> sites;
+    std::vector<BadFree> badFrees;
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t totalBytes = 0;
+    uint64_t liveBytes = 0;
+    uint64_t peakLiveBytes = 0;
+};
+
+Tracker& tracker() {
+    static Tracker* instance = new Tracker(); // Never destroyed: JIT code may outlive static destructors
+    return *instance;
+}
+
+std::string label(const std::vector<std::string>& labels, int32_t site) {
+    if (site >= 0 && (size_t)site < labels.size()) return labels[site];
+    return "<unknown site>";
+}
+
+void printSites(llvm::raw_ostream& out, const std::vector<std::pair<int32_t, SiteStats>>& rows,
+                const std::vector<std::string>& labels) {
+    out << llvm::formatv("{0,12} {1,14}  {2}\n", "count", "bytes", "site");
+    for (const auto& [site, stats] : rows) {
+        out << llvm::formatv("{0,12} {1,14}  {2}\n", stats.count, stats.bytes, label(labels, site));
+    }
+}
+
+} // namespace
+
+void registerAllocTrackerRuntime() {
+    llvm::sys::DynamicLibrary::AddSymbol("__pynext_alloc", (void*)__pynext_alloc);
+    llvm::sys::DynamicLibrary::AddSymbol("__pynext_free", (void*)__pynext_free);
+}
+
+bool reportAllocations(llvm::raw_ostream& out, const std::vector<std::string>& siteLabels) {
+    Tracker& t = tracker();
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    out << llvm::formatv("Allocations: {0} arrays, {1} bytes, {2} freed, peak live {3} bytes\n",
+                         t.allocations, t.totalBytes, t.frees, t.peakLiveBytes);
+
+    auto byBytes = [](const auto& a, const auto& b) {
+        if (a.second.bytes != b.second.bytes) return a.second.bytes > b.second.bytes;
+        return a.first < b.first;
+    };
+
+    std::vector<std::pair<int32_t, SiteStats>> hot;
+    for (size_t i = 0; i < t.sites.size(); ++i) {
+        if (t.sites[i].count) hot.push_back({(int32_t)i, t.sites[i]});
+    }
+    std::sort(hot.begin(), hot.end(), byBytes);
+    if (hot.size() > 10) hot.resize(10);
+    if (!hot.empty()) {
+        out << "Allocation sites by bytes:\n";
+        printSites(out, hot, siteLabels);
+    }
+
+    std::unordered_map<int32_t, SiteStats> leakedBySite;
+    for (const auto& [ptr, alloc] : t.live) {
+        leakedBySite[alloc.site].count++;
+        leakedBySite[alloc.site].bytes += alloc.size;
+    }
+    if (leakedBySite.empty()) {
+        out << "No leaks\n";
+    } else {
+        std::vector<std::pair<int32_t, SiteStats>> leaks(leakedBySite.begin(), leakedBySite.end());
+        std::sort(leaks.begin(), leaks.end(), byBytes);
+        out << llvm::formatv("Leaks: {0} arrays, {1} bytes still live at exit\n", t.live.size(), t.liveBytes);
+        printSites(out, leaks, siteLabels);
+    }
+
+    for (const auto& bad : t.badFrees) {
+        if (bad.allocSite < 0) {
+            out << "Invalid free at " << label(siteLabels, bad.freeSite) << "\n";
+        } else {
+            out << "Double free at " << label(siteLabels, bad.freeSite) << " of the array from "
+                << label(siteLabels, bad.allocSite) << ", already freed at "
+                << label(siteLabels, bad.firstFreeSite) << "\n";
+        }
+    }
+    return leakedBySite.empty() && t.badFrees.empty();
+}
+
+} // namespace pynext
+
+extern "C" void* __pynext_alloc(int64_t size, int32_t site) {
+    void* ptr = malloc(size);
+    if (!ptr) return nullptr;
+
+    pynext::Tracker& t = pynext::tracker();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    t.freed.erase(ptr);
+    t.live[ptr] = {(uint64_t)size, site};
+    if ((size_t)site >= t.sites.size()) t.sites.resize(site + 1);
+    t.sites[site].count++;
+    t.sites[site].bytes += size;
+    t.allocations++;
+    t.totalBytes += size;
+    t.liveBytes += size;
+    t.peakLiveBytes = std::max(t.peakLiveBytes, t.liveBytes);
+    return ptr;
+}
+
+extern "C" void __pynext_free(void* ptr, int32_t site) {
+    pynext::Tracker& t = pynext::tracker();
+    {
+        std::lock_guard<std::mutex> lock(t.mutex);
+        auto it = t.live.find(ptr);
+        if (it == t.live.end()) {
+            auto prev = t.freed.find(ptr);
+            if (prev != t.freed.end()) {
+                t.badFrees.push_back({site, prev->second.allocSite, prev->second.freeSite});
+            } else {
+                t.badFrees.push_back({site, -1, -1});
+            }
+            return;
+        }
+        t.liveBytes -= it->second.size;
+        t.frees++;
+        t.freed[ptr] = {it->second.site, site};
+        t.live.erase(it);
+    }
+    free(ptr);
+}
@@ -0,0 +1,28 @@
+#ifndef PYNEXT_ALLOC_TRACKER_H
+#define PYNEXT_ALLOC_TRACKER_H
+
+#include <llvm/Support/raw_ostream.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tracking allocator used by code compiled with CodeGenOptions::trackAllocations.
+// Site ids index CodeGen::getAllocationSites() of the CodeGen that emitted the calls.
+extern "C" {
+void* __pynext_alloc(int64_t size, int32_t site);
+void __pynext_free(void* ptr, int32_t site);
+}
+
+namespace pynext {
+
+// Makes the hooks above resolvable by the JIT. Call before JIT code runs.
+void registerAllocTrackerRuntime();
+
+// Prints allocation counts, bytes and peak live bytes, the busiest allocation
+// sites, the allocations still live (leaks) and every double or invalid free.
+// Returns true when there were no leaks or bad frees.
+bool reportAllocations(llvm::raw_ostream& out, const std::vector<std::string>& siteLabels);
+
+} // namespace pynext
+
+#endif // PYNEXT_ALLOC_TRACKER_H
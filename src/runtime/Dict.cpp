@@ -0,0 +1,304 @@
+#include "Dict.h"
+#include "AllocTracker.h"
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/xxhash.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace pynext {
+
+namespace {
+
+constexpr size_t kGroupWidth = 16;
+constexpr int8_t kEmpty = -128;  // 0b10000000
+constexpr int8_t kDeleted = -2;  // 0b11111110; full slots are 0b0xxxxxxx
+
+// A slot is the key word followed by the value, so a hit touches one cache
+// line past the control bytes
+struct Dict {
+    int8_t* ctrl = nullptr; // `capacity` control bytes, then the slots
+    uint8_t* slots = nullptr;
+    uint64_t capacity = 0; // 0 until the first insert, then a power of two >= kGroupWidth
+    uint64_t size = 0;
+    uint64_t growthLeft = 0; // Empty slots that may still be filled before a rehash
+    uint64_t valueSize = 0;
+    uint64_t slotSize = 0; // 8 + valueSize rounded up to 8
+    bool ownsKeys = false; // Keys point to copies that the dict frees
+
+    uint64_t& key(uint64_t slot) const { return *reinterpret_cast<uint64_t*>(slots + slot * slotSize); }
+    uint8_t* value(uint64_t slot) const { return slots + slot * slotSize + sizeof(uint64_t); }
+};
+
+// Bit i of a mask is set for control byte i of the group. Groups are aligned
+// and probed whole, so a probe never wraps around within a group.
+#if defined(__SSE2__)
+struct Group {
+    __m128i ctrl;
+    explicit Group(const int8_t* pos) : ctrl(_mm_load_si128(reinterpret_cast<const __m128i*>(pos))) {}
+    uint32_t match(int8_t h2) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)); }
+    uint32_t matchEmpty() const { return match(kEmpty); }
+    uint32_t matchEmptyOrDeleted() const { return _mm_movemask_epi8(ctrl); } // Sign bit set
+};
+#else
+struct Group {
+    const int8_t* ctrl;
+    explicit Group(const int8_t* pos) : ctrl(pos) {}
+    uint32_t match(int8_t h2) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) mask |= uint32_t(ctrl[i] == h2) << i;
+        return mask;
+    }
+    uint32_t matchEmpty() const { return match(kEmpty); }
+    uint32_t matchEmptyOrDeleted() const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) mask |= uint32_t(ctrl[i] < 0) << i;
+        return mask;
+    }
+};
+#endif
+
+// The low 7 bits go into the control byte, the rest pick the first group
+inline int8_t h2(uint64_t hash) { return hash & 0x7F; }
+inline uint64_t h1(uint64_t hash) { return hash >> 7; }
+
+// One 128-bit multiply, folded: sequential ints spread over every group
+struct IntKey {
+    using Type = int64_t;
+    static uint64_t hash(uint64_t key) {
+        __uint128_t product = __uint128_t(key) * 0x9E3779B97F4A7C15ULL;
+        return uint64_t(product) ^ uint64_t(product >> 64);
+    }
+    static uint64_t word(int64_t key) { return uint64_t(key); }
+    static bool equal(uint64_t stored, int64_t key) { return stored == uint64_t(key); }
+    static constexpr bool kOwned = false;
+    static uint64_t store(int64_t key) { return uint64_t(key); }
+};
+
+// Strings are stored as pointers to copies of the characters, since the
+// caller's may not outlive the entry (a line from lines() is overwritten
+// by the next one)
+struct StringKey {
+    using Type = const char*;
+    static uint64_t hash(uint64_t key) {
+        const char* text = reinterpret_cast<const char*>(key);
+        return llvm::xxHash64(llvm::StringRef(text, strlen(text)));
+    }
+    static uint64_t word(const char* key) { return reinterpret_cast<uint64_t>(key); }
+    static bool equal(uint64_t stored, const char* key) {
+        return strcmp(reinterpret_cast<const char*>(stored), key) == 0;
+    }
+    static constexpr bool kOwned = true;
+    static uint64_t store(const char* key) {
+        char* copy = strdup(key);
+        if (!copy) {
+            fprintf(stderr, "Runtime Error: out of memory copying a dict key\n");
+            exit(1);
+        }
+        return reinterpret_cast<uint64_t>(copy);
+    }
+};
+
+// Groups are visited in triangular order, which reaches all of them when
+// their number is a power of two
+struct ProbeSequence {
+    uint64_t mask;
+    uint64_t group;
+    uint64_t step = 0;
+    ProbeSequence(uint64_t hash, uint64_t capacity)
+        : mask(capacity / kGroupWidth - 1), group(h1(hash) & mask) {}
+    uint64_t offset() const { return group * kGroupWidth; }
+    void next() { group = (group + ++step) & mask; }
+};
+
+inline int lowestBit(uint32_t mask) { return __builtin_ctz(mask); }
+
+void allocateTable(Dict& dict, uint64_t capacity) {
+    uint64_t bytes = capacity + capacity * dict.slotSize; // A multiple of 16, as aligned_alloc needs
+    auto* memory = static_cast<uint8_t*>(std::aligned_alloc(kGroupWidth, bytes));
+    if (!memory) {
+        fprintf(stderr, "Runtime Error: out of memory growing a dict to %llu entries\n", (unsigned long long)capacity);
+        exit(1);
+    }
+#if defined(MADV_HUGEPAGE)
+    // Lookups in a large table hit random pages; huge pages keep them in the TLB
+    constexpr uint64_t kHugePage = 2 << 20;
+    if (bytes >= 4 * kHugePage) {
+        uint64_t start = (reinterpret_cast<uint64_t>(memory) + kHugePage - 1) & ~(kHugePage - 1);
+        uint64_t end = (reinterpret_cast<uint64_t>(memory) + bytes) & ~(kHugePage - 1);
+        madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE);
+    }
+#endif
+    dict.ctrl = reinterpret_cast<int8_t*>(memory);
+    dict.slots = memory + capacity;
+    dict.capacity = capacity;
+    dict.growthLeft = capacity - capacity / 8; // Load factor 7/8
+    memset(dict.ctrl, kEmpty, capacity);
+}
+
+// First empty or deleted slot on the probe sequence of `hash`
+uint64_t findFreeSlot(const Dict& dict, uint64_t hash) {
+    for (ProbeSequence probe(hash, dict.capacity);; probe.next()) {
+        if (uint32_t available = Group(dict.ctrl + probe.offset()).matchEmptyOrDeleted()) {
+            return probe.offset() + lowestBit(available);
+        }
+    }
+}
+
+// Moves every entry into a fresh table. Drops the deleted markers, and
+// doubles the capacity unless they were what filled the table.
+template <typename Key>
+void rehash(Dict& dict) {
+    Dict old = dict;
+    uint64_t capacity = old.capacity == 0 ? kGroupWidth : old.capacity;
+    if (old.capacity && old.size >= old.capacity * 7 / 16) capacity *= 2;
+    allocateTable(dict, capacity);
+    for (uint64_t i = 0; i < old.capacity; ++i) {
+        if (old.ctrl[i] < 0) continue;
+        uint64_t hash = Key::hash(old.key(i));
+        uint64_t slot = findFreeSlot(dict, hash);
+        dict.ctrl[slot] = h2(hash);
+        memcpy(dict.slots + slot * dict.slotSize, old.slots + i * old.slotSize, dict.slotSize);
+    }
+    dict.growthLeft -= dict.size;
+    free(old.ctrl);
+}
+
+template <typename Key>
+int64_t findIndex(const Dict& dict, typename Key::Type key, uint64_t hash) {
+    if (dict.capacity == 0) return -1;
+    for (ProbeSequence probe(hash, dict.capacity);; probe.next()) {
+        Group group(dict.ctrl + probe.offset());
+        for (uint32_t match = group.match(h2(hash)); match; match &= match - 1) {
+            uint64_t slot = probe.offset() + lowestBit(match);
+            if (Key::equal(dict.key(slot), key)) return slot;
+        }
+        // A key is never placed past a group with an empty slot
+        if (group.matchEmpty()) return -1;
+    }
+}
+
+template <typename Key>
+void* find(void* handle, typename Key::Type key) {
+    Dict& dict = *static_cast<Dict*>(handle);
+    int64_t slot = findIndex<Key>(dict, key, Key::hash(Key::word(key)));
+    return slot < 0 ? nullptr : dict.value(slot);
+}
+
+template <typename Key>
+void* insert(void* handle, typename Key::Type key) {
+    Dict& dict = *static_cast<Dict*>(handle);
+    uint64_t hash = Key::hash(Key::word(key));
+    int64_t found = findIndex<Key>(dict, key, hash);
+    if (found >= 0) return dict.value(found);
+
+    uint64_t slot = dict.capacity ? findFreeSlot(dict, hash) : 0;
+    // Reusing a deleted slot does not use up an empty one
+    if (dict.capacity == 0 || (dict.growthLeft == 0 && dict.ctrl[slot] == kEmpty)) {
+        rehash<Key>(dict);
+        slot = findFreeSlot(dict, hash);
+    }
+    dict.growthLeft -= dict.ctrl[slot] == kEmpty;
+    dict.size++;
+    dict.ctrl[slot] = h2(hash);
+    dict.key(slot) = Key::store(key);
+    if (Key::kOwned) dict.ownsKeys = true;
+    uint8_t* value = dict.value(slot);
+    memset(value, 0, dict.valueSize);
+    return value;
+}
+
+template <typename Key>
+bool erase(void* handle, typename Key::Type key) {
+    Dict& dict = *static_cast<Dict*>(handle);
+    int64_t slot = findIndex<Key>(dict, key, Key::hash(Key::word(key)));
+    if (slot < 0) return false;
+    if (Key::kOwned) free(reinterpret_cast<void*>(dict.key(slot)));
+    dict.size--;
+    // Lookups stop at a group with an empty slot, so in such a group the
+    // slot can become empty again; elsewhere it must stay a marker
+    uint64_t groupStart = slot & ~(kGroupWidth - 1);
+    if (Group(dict.ctrl + groupStart).matchEmpty()) {
+        dict.ctrl[slot] = kEmpty;
+        dict.growthLeft++;
+    } else {
+        dict.ctrl[slot] = kDeleted;
+    }
+    return true;
+}
+
+} // namespace
+
+llvm::ArrayRef<RuntimeSymbol> dictRuntimeSymbols() {
+    static const RuntimeSymbol symbols[] = {
+        {"__pynext_dict_new", (void*)__pynext_dict_new},
+        {"__pynext_dict_free", (void*)__pynext_dict_free},
+        {"__pynext_dict_len", (void*)__pynext_dict_len},
+        {"__pynext_dict_int_find", (void*)__pynext_dict_int_find},
+        {"__pynext_dict_int_insert", (void*)__pynext_dict_int_insert},
+        {"__pynext_dict_int_erase", (void*)__pynext_dict_int_erase},
+        {"__pynext_dict_str_find", (void*)__pynext_dict_str_find},
+        {"__pynext_dict_str_insert", (void*)__pynext_dict_str_insert},
+        {"__pynext_dict_str_erase", (void*)__pynext_dict_str_erase},
+        {"__pynext_dict_missing_key", (void*)__pynext_dict_missing_key},
+    };
+    return symbols;
+}
+
+void registerDictRuntime() {
+    for (const RuntimeSymbol& symbol : dictRuntimeSymbols()) {
+        llvm::sys::DynamicLibrary::AddSymbol(symbol.name, symbol.address);
+    }
+}
+
+} // namespace pynext
+
+using pynext::IntKey;
+using pynext::StringKey;
+
+extern "C" void* __pynext_dict_new(int64_t valueSize, int32_t site) {
+    void* memory = site >= 0 ? __pynext_alloc(sizeof(pynext::Dict), site) : malloc(sizeof(pynext::Dict));
+    auto* dict = new (memory) pynext::Dict();
+    dict->valueSize = valueSize;
+    dict->slotSize = sizeof(uint64_t) + ((valueSize + 7) & ~7);
+    return dict;
+}
+
+extern "C" void __pynext_dict_free(void* handle, int32_t site) {
+    auto* dict = static_cast<pynext::Dict*>(handle);
+    if (dict->ownsKeys) {
+        for (uint64_t i = 0; i < dict->capacity; ++i) {
+            if (dict->ctrl[i] >= 0) free(reinterpret_cast<void*>(dict->key(i)));
+        }
+    }
+    free(dict->ctrl);
+    if (site >= 0) {
+        __pynext_free(dict, site);
+    } else {
+        free(dict);
+    }
+}
+
+extern "C" int64_t __pynext_dict_len(void* dict) { return static_cast<pynext::Dict*>(dict)->size; }
+
+extern "C" void* __pynext_dict_int_find(void* dict, int64_t key) { return pynext::find<IntKey>(dict, key); }
+extern "C" void* __pynext_dict_int_insert(void* dict, int64_t key) { return pynext::insert<IntKey>(dict, key); }
+extern "C" bool __pynext_dict_int_erase(void* dict, int64_t key) { return pynext::erase<IntKey>(dict, key); }
+
+extern "C" void* __pynext_dict_str_find(void* dict, const char* key) { return pynext::find<StringKey>(dict, key); }
+extern "C" void* __pynext_dict_str_insert(void* dict, const char* key) {
+    return pynext::insert<StringKey>(dict, key);
+}
+extern "C" bool __pynext_dict_str_erase(void* dict, const char* key) { return pynext::erase<StringKey>(dict, key); }
+
+extern "C" void __pynext_dict_missing_key() {
+    fflush(stdout);
+    fprintf(stderr, "Runtime Error: key not found in dict\n");
+    exit(1);
+}
@@ -0,0 +1,52 @@
+#ifndef PYNEXT_DICT_H
+#define PYNEXT_DICT_H
+
+#include "RuntimeSymbol.h"
+#include <llvm/ADT/ArrayRef.h>
+#include <cstdint>
+
+// Hash map behind `dict[K, V]`: an open-addressing Swiss table. One control
+// byte per slot holds 7 bits of the key's hash, or marks the slot empty or
+// deleted; lookups compare 16 control bytes at once (SSE2) and only touch
+// the slots whose bits match. A slot holds the key and then the value,
+// stored inline, `valueSize` bytes, which CodeGen loads and stores with its
+// own type.
+//
+// Keys are 64-bit words. int, bool and float keys use the __pynext_dict_int_
+// entry points (CodeGen passes bools zero-extended and floats as their bits,
+// with -0.0 folded into 0.0); string keys use __pynext_dict_str_, which hash
+// and compare the characters. A dict is only ever used with one of the two.
+// String keys are copied on insert and freed when their entry is erased or
+// the dict is freed.
+extern "C" {
+// `site` is an allocation site of CodeGen::getAllocationSites() when the dict
+// is created by code compiled with trackAllocations, or -1
+void* __pynext_dict_new(int64_t valueSize, int32_t site);
+void __pynext_dict_free(void* dict, int32_t site);
+int64_t __pynext_dict_len(void* dict);
+
+// find returns the key's value slot or null. insert returns the slot too,
+// adding the key with a zeroed value if it is missing; the slot is valid
+// until the next insert. erase returns whether the key was present.
+void* __pynext_dict_int_find(void* dict, int64_t key);
+void* __pynext_dict_int_insert(void* dict, int64_t key);
+bool __pynext_dict_int_erase(void* dict, int64_t key);
+void* __pynext_dict_str_find(void* dict, const char* key);
+void* __pynext_dict_str_insert(void* dict, const char* key);
+bool __pynext_dict_str_erase(void* dict, const char* key);
+
+// Reading a missing key: reports it and exits
+void __pynext_dict_missing_key();
+}
+
+namespace pynext {
+
+// The entry points above, for JITs that resolve them by name
+llvm::ArrayRef<RuntimeSymbol> dictRuntimeSymbols();
+
+// Makes them resolvable by the MCJIT engine. Call before JIT code runs.
+void registerDictRuntime();
+
+} // namespace pynext
+
+#endif // PYNEXT_DICT_H
@@ -0,0 +1,201 @@
+#include "File.h"
+#include "AllocTracker.h"
+#include <llvm/Support/DynamicLibrary.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pynext {
+
+namespace {
+
+constexpr size_t kBlock = 64; // Bytes per newline mask
+
+struct File {
+    std::string path; // For errors
+    int fd = -1;
+    // Bytes [begin, end) of the buffer are unread. Those before `scanned` are
+    // already in `newlines`: bit i set for a "\n" at maskBase + i that has
+    // not been returned yet.
+    char* buffer = nullptr;
+    size_t capacity = 0; // Plus kBlock bytes of padding for the last mask
+    size_t begin = 0;
+    size_t scanned = 0;
+    size_t end = 0;
+    size_t maskBase = 0;
+    uint64_t newlines = 0;
+    bool atEnd = false; // read() returned 0
+};
+
+[[noreturn]] void fail(const char* what, const char* text, const char* detail = nullptr) {
+    fflush(stdout);
+    fprintf(stderr, "Runtime Error: %s '%s'%s%s\n", what, text, detail ? ": " : "", detail ? detail : "");
+    exit(1);
+}
+
+// Bit i set when block[i] is "\n"
+uint64_t newlineMask(const char* block) {
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        mask |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)))) << (16 * i);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (size_t i = 0; i < kBlock; ++i) mask |= uint64_t(block[i] == '\n') << i;
+    return mask;
+#endif
+}
+
+// Cuts the line at `newline` (or at a "\r" before it)
+void terminate(char* line, char* newline) {
+    if (newline > line && newline[-1] == '\r') newline--;
+    *newline = '\0';
+}
+
+// Reads more input after the unread bytes, moving them to the front of the
+// buffer first and growing it if a line fills most of it
+void fill(File& file) {
+    if (file.begin > 0) {
+        memmove(file.buffer, file.buffer + file.begin, file.end - file.begin);
+        file.end -= file.begin;
+        file.scanned -= file.begin;
+        file.begin = 0;
+    }
+    if (file.capacity - file.end < kReadBufferSize / 2) {
+        file.capacity *= 2;
+        file.buffer = static_cast<char*>(realloc(file.buffer, file.capacity + kBlock));
+    }
+    while (true) {
+        // One byte is kept for the NUL of a last line without "\n"
+        ssize_t count = read(file.fd, file.buffer + file.end, file.capacity - file.end - 1);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) fail("cannot read", file.path.c_str(), strerror(errno));
+        if (count == 0) file.atEnd = true;
+        file.end += count;
+        return;
+    }
+}
+
+const char* nextLine(File& file) {
+    while (!file.newlines) {
+        if (file.scanned < file.end) {
+            // Bytes past `end` are masked off; the padding keeps the load in bounds
+            size_t count = std::min(kBlock, file.end - file.scanned);
+            file.maskBase = file.scanned;
+            file.newlines = newlineMask(file.buffer + file.scanned) & (~0ULL >> (kBlock - count));
+            file.scanned += count;
+        } else if (!file.atEnd) {
+            fill(file);
+        } else if (file.begin < file.end) {
+            char* line = file.buffer + file.begin; // The last line has no "\n"
+            terminate(line, file.buffer + file.end);
+            file.begin = file.end;
+            return line;
+        } else {
+            return nullptr;
+        }
+    }
+    char* newline = file.buffer + file.maskBase + __builtin_ctzll(file.newlines);
+    file.newlines &= file.newlines - 1;
+    char* line = file.buffer + file.begin;
+    file.begin = newline - file.buffer + 1;
+    terminate(line, newline);
+    return line;
+}
+
+// Skips spaces and tabs on both ends of `text`
+std::pair<const char*, const char*> trim(const char* text) {
+    const char* first = text;
+    while (*first == ' ' || *first == '\t') first++;
+    const char* last = first + strlen(first);
+    while (last > first && (last[-1] == ' ' || last[-1] == '\t')) last--;
+    return {first, last};
+}
+
+} // namespace
+
+llvm::ArrayRef<RuntimeSymbol> fileRuntimeSymbols() {
+    static const RuntimeSymbol symbols[] = {
+        {"__pynext_file_open", (void*)__pynext_file_open},
+        {"__pynext_file_close", (void*)__pynext_file_close},
+        {"__pynext_file_next_line", (void*)__pynext_file_next_line},
+        {"__pynext_parse_int", (void*)__pynext_parse_int},
+        {"__pynext_parse_float", (void*)__pynext_parse_float},
+    };
+    return symbols;
+}
+
+void registerFileRuntime() {
+    for (const RuntimeSymbol& symbol : fileRuntimeSymbols()) {
+        llvm::sys::DynamicLibrary::AddSymbol(symbol.name, symbol.address);
+    }
+}
+
+} // namespace pynext
+
+using pynext::File;
+
+extern "C" void* __pynext_file_open(const char* path, int32_t site) {
+    bool standardInput = strcmp(path, "-") == 0;
+    int fd = standardInput ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) pynext::fail("cannot open", path, strerror(errno));
+
+    void* memory = site >= 0 ? __pynext_alloc(sizeof(File), site) : malloc(sizeof(File));
+    auto* file = new (memory) File();
+    file->path = path;
+    file->fd = fd;
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // Larger readahead; fails harmlessly on pipes
+#endif
+    file->capacity = pynext::kReadBufferSize;
+    file->buffer = static_cast<char*>(malloc(file->capacity + pynext::kBlock));
+    return file;
+}
+
+extern "C" void __pynext_file_close(void* handle, int32_t site) {
+    auto* file = static_cast<File*>(handle);
+    if (file->fd != STDIN_FILENO) close(file->fd);
+    free(file->buffer);
+    file->~File();
+    if (site >= 0) {
+        __pynext_free(file, site);
+    } else {
+        free(file);
+    }
+}
+
+extern "C" const char* __pynext_file_next_line(void* handle) {
+    return pynext::nextLine(*static_cast<File*>(handle));
+}
+
+extern "C" int64_t __pynext_parse_int(const char* text) {
+    auto [first, last] = pynext::trim(text);
+    if (last - first > 1 && *first == '+' && first[1] != '-') first++; // from_chars takes only "-"
+    int64_t value = 0;
+    auto [end, error] = std::from_chars(first, last, value);
+    if (first == last || error != std::errc() || end != last) pynext::fail("invalid int", text);
+    return value;
+}
+
+extern "C" double __pynext_parse_float(const char* text) {
+    auto [first, last] = pynext::trim(text);
+    if (last - first > 1 && *first == '+' && first[1] != '-') first++;
+    double value = 0;
+    auto [end, error] = std::from_chars(first, last, value);
+    if (first == last || error != std::errc() || end != last) pynext::fail("invalid float", text);
+    return value;
+}
@@ -0,0 +1,47 @@
+#ifndef PYNEXT_FILE_H
+#define PYNEXT_FILE_H
+
+#include "RuntimeSymbol.h"
+#include <llvm/ADT/ArrayRef.h>
+#include <cstdint>
+
+// Files behind `open(path)`, `for line in lines(f)`, `parse_int` and
+// `parse_float`.
+//
+// Files, pipes and "-" (standard input) are all read kReadBufferSize bytes at
+// a time into one buffer, grown for longer lines. Lines are not copied out of
+// it: each is terminated in place by overwriting its "\n" (or "\r\n") with a
+// NUL, and stays valid until the next line is read. Newlines are found 64
+// bytes at a time, as a bit mask (SSE2), so a line costs a few instructions
+// beyond the call.
+//
+// Mapping regular files instead was measured slower: terminating lines in a
+// private mapping faults and copies every page.
+extern "C" {
+// `site` is an allocation site of CodeGen::getAllocationSites() when the file
+// is opened by code compiled with trackAllocations, or -1. A file that cannot
+// be opened is reported, and the program exits.
+void* __pynext_file_open(const char* path, int32_t site);
+void __pynext_file_close(void* file, int32_t site);
+// The next line, or null at the end of the file
+const char* __pynext_file_next_line(void* file);
+
+// Decimal numbers with optional surrounding spaces or tabs, parsed without
+// allocating. Anything else is reported, and the program exits.
+int64_t __pynext_parse_int(const char* text);
+double __pynext_parse_float(const char* text);
+}
+
+namespace pynext {
+
+constexpr size_t kReadBufferSize = 1 << 20;
+
+// The entry points above, for JITs that resolve them by name
+llvm::ArrayRef<RuntimeSymbol> fileRuntimeSymbols();
+
+// Makes them resolvable by the MCJIT engine. Call before JIT code runs.
+void registerFileRuntime();
+
+} // namespace pynext
+
+#endif // PYNEXT_FILE_H
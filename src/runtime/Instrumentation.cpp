@@ -0,0 +1,175 @@
+#include "Instrumentation.h"
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace pynext {
+
+namespace {
+
+struct FunctionCounters {
+    uint64_t calls = 0;
+    uint64_t selfTicks = 0;
+    uint64_t totalTicks = 0; // Outermost activations only, so recursion is not counted twice
+    uint32_t active = 0;     // Activations currently on the stack
+};
+
+struct LoopCounters {
+    uint64_t executions = 0;
+    uint64_t trips = 0;
+};
+
+struct Frame {
+    int32_t id;
+    uint64_t start;
+    uint64_t childTicks;
+};
+
+// Per-thread counters. They are never freed, so the report also covers
+// threads that have already exited.
+struct ThreadCounters {
+    std::vector<FunctionCounters> functions;
+    std::vector<LoopCounters> loops;
+    std::vector<Frame> stack;
+};
+
+std::mutex registryMutex;
+std::vector<ThreadCounters*> registry;
+
+ThreadCounters& threadCounters() {
+    thread_local ThreadCounters* counters = [] {
+        auto* c = new ThreadCounters();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(c);
+        return c;
+    }();
+    return *counters;
+}
+
+// Time stamp counter on x86, nanoseconds elsewhere
+inline uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+uint64_t startTicks = 0;
+std::chrono::steady_clock::time_point startTime;
+
+} // namespace
+
+void registerInstrumentationRuntime() {
+    llvm::sys::DynamicLibrary::AddSymbol("__pynext_instr_enter", (void*)__pynext_instr_enter);
+    llvm::sys::DynamicLibrary::AddSymbol("__pynext_instr_exit", (void*)__pynext_instr_exit);
+    llvm::sys::DynamicLibrary::AddSymbol("__pynext_instr_loop", (void*)__pynext_instr_loop);
+    startTicks = readTicks();
+    startTime = std::chrono::steady_clock::now();
+}
+
+void reportInstrumentation(llvm::raw_ostream& out,
+                           const std::vector<std::string>& functionLabels,
+                           const std::vector<std::string>& loopLabels) {
+    std::vector<FunctionCounters> functions(functionLabels.size());
+    std::vector<LoopCounters> loops(loopLabels.size());
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const ThreadCounters* t : registry) {
+            for (size_t i = 0; i < t->functions.size() && i < functions.size(); ++i) {
+                functions[i].calls += t->functions[i].calls;
+                functions[i].selfTicks += t->functions[i].selfTicks;
+                functions[i].totalTicks += t->functions[i].totalTicks;
+            }
+            for (size_t i = 0; i < t->loops.size() && i < loops.size(); ++i) {
+                loops[i].executions += t->loops[i].executions;
+                loops[i].trips += t->loops[i].trips;
+            }
+        }
+    }
+
+    // Calibrate ticks against the wall clock over the whole run
+    double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+    uint64_t elapsedTicks = readTicks() - startTicks;
+    double nsPerTick = elapsedTicks > 0 ? elapsedNs / elapsedTicks : 1.0;
+
+    uint64_t selfSum = 0;
+    std::vector<size_t> order;
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (functions[i].calls == 0) continue;
+        selfSum += functions[i].selfTicks;
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return functions[a].selfTicks > functions[b].selfTicks; });
+
+    out << "Instrumentation: functions by self time\n";
+    out << llvm::formatv("{0,12} {1,12} {2,7} {3,12} {4,12}  {5}\n",
+                         "calls", "self(ms)", "self%", "total(ms)", "ns/call", "function");
+    for (size_t i : order) {
+        const auto& c = functions[i];
+        double selfMs = c.selfTicks * nsPerTick / 1e6;
+        double totalMs = c.totalTicks * nsPerTick / 1e6;
+        double pct = selfSum ? 100.0 * c.selfTicks / selfSum : 0.0;
+        out << llvm::formatv("{0,12} {1,12:F3} {2,6:F1}% {3,12:F3} {4,12:F1}  {5}\n",
+                             c.calls, selfMs, pct, totalMs, c.selfTicks * nsPerTick / c.calls, functionLabels[i]);
+    }
+
+    std::vector<size_t> loopOrder;
+    for (size_t i = 0; i < loops.size(); ++i) {
+        if (loops[i].executions) loopOrder.push_back(i);
+    }
+    if (loopOrder.empty()) return;
+    std::stable_sort(loopOrder.begin(), loopOrder.end(),
+                     [&](size_t a, size_t b) { return loops[a].trips > loops[b].trips; });
+
+    out << "Loops by trip count\n";
+    out << llvm::formatv("{0,12} {1,14} {2,12}  {3}\n", "executions", "trips", "trips/exec", "loop");
+    for (size_t i : loopOrder) {
+        const auto& l = loops[i];
+        out << llvm::formatv("{0,12} {1,14} {2,12:F1}  {3}\n",
+                             l.executions, l.trips, double(l.trips) / l.executions, loopLabels[i]);
+    }
+}
+
+} // namespace pynext
+
+using pynext::threadCounters;
+
+extern "C" void __pynext_instr_enter(int32_t functionId) {
+    auto& t = threadCounters();
+    if ((size_t)functionId >= t.functions.size()) t.functions.resize(functionId + 1);
+    t.functions[functionId].active++;
+    t.stack.push_back({functionId, pynext::readTicks(), 0});
+}
+
+extern "C" void __pynext_instr_exit(int32_t functionId) {
+    uint64_t now = pynext::readTicks();
+    auto& t = threadCounters();
+    if (t.stack.empty() || t.stack.back().id != functionId) return;
+
+    pynext::Frame frame = t.stack.back();
+    t.stack.pop_back();
+    uint64_t elapsed = now - frame.start;
+
+    auto& c = t.functions[functionId];
+    c.calls++;
+    c.selfTicks += elapsed - std::min(elapsed, frame.childTicks);
+    if (--c.active == 0) c.totalTicks += elapsed;
+    if (!t.stack.empty()) t.stack.back().childTicks += elapsed;
+}
+
+extern "C" void __pynext_instr_loop(int32_t loopId, int64_t trips) {
+    auto& t = threadCounters();
+    if ((size_t)loopId >= t.loops.size()) t.loops.resize(loopId + 1);
+    t.loops[loopId].executions++;
+    t.loops[loopId].trips += trips;
+}
@@ -0,0 +1,32 @@
+#ifndef PYNEXT_INSTRUMENTATION_H
+#define PYNEXT_INSTRUMENTATION_H
+
+#include <llvm/Support/raw_ostream.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hooks called by code compiled with CodeGenOptions::instrument. Ids index
+// the function and loop tables of the CodeGen that emitted the calls.
+extern "C" {
+void __pynext_instr_enter(int32_t functionId);
+void __pynext_instr_exit(int32_t functionId);
+void __pynext_instr_loop(int32_t loopId, int64_t trips);
+}
+
+namespace pynext {
+
+// Makes the hooks above resolvable by the JIT and starts the clock used to
+// convert ticks to time. Call before JIT code runs.
+void registerInstrumentationRuntime();
+
+// Prints per-function call counts and self/total time, sorted by self time,
+// followed by loop trip counts. Counters of all threads are summed. The
+// labels name each function and loop id.
+void reportInstrumentation(llvm::raw_ostream& out,
+                           const std::vector<std::string>& functionLabels,
+                           const std::vector<std::string>& loopLabels);
+
+} // namespace pynext
+
+#endif // PYNEXT_INSTRUMENTATION_H
@@ -0,0 +1,76 @@
+#include "ProfileRuntime.h"
+#include <llvm/IR/Constants.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/InstrProfWriter.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace pynext {
+
+namespace {
+
+// Value profiling (indirect call targets, memory intrinsic sizes) is dropped
+void instrumentTarget(uint64_t, void*, uint32_t) {}
+void instrumentMemop(uint64_t, void*, uint32_t) {}
+
+} // namespace
+
+void ProfileCollector::collect(llvm::Module& module) {
+    const llvm::StringRef counterPrefix = "__profc_";
+    for (llvm::GlobalVariable& counters : module.globals()) {
+        llvm::StringRef varName = counters.getName();
+        if (!varName.starts_with(counterPrefix)) continue;
+
+        llvm::StringRef funcName = varName.drop_front(counterPrefix.size());
+        auto* data = module.getNamedGlobal(("__profd_" + funcName).str());
+        auto* arrayTy = llvm::dyn_cast<llvm::ArrayType>(counters.getValueType());
+        if (!data || !data->hasInitializer() || !arrayTy) continue;
+
+        // __profd_ starts with { i64 NameRef, i64 FuncHash, ... }
+        auto* record = llvm::dyn_cast<llvm::ConstantStruct>(data->getInitializer());
+        auto* hash = record ? llvm::dyn_cast<llvm::ConstantInt>(record->getOperand(1)) : nullptr;
+        if (!hash) continue;
+
+        counters.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        functions.push_back({funcName.str(), varName.str(), hash->getZExtValue(), arrayTy->getNumElements()});
+    }
+}
+
+void ProfileCollector::registerRuntime() {
+    llvm::sys::DynamicLibrary::AddSymbol("__llvm_profile_instrument_target", (void*)instrumentTarget);
+    llvm::sys::DynamicLibrary::AddSymbol("__llvm_profile_instrument_memop", (void*)instrumentMemop);
+}
+
+bool ProfileCollector::write(const std::string& path,
+                             const std::function<uint64_t(const std::string&)>& addressOf,
+                             std::string& error) const {
+    llvm::InstrProfWriter writer;
+    if (llvm::Error err = writer.mergeProfileKind(llvm::InstrProfKind::IRInstrumentation)) {
+        error = llvm::toString(std::move(err));
+        return false;
+    }
+
+    for (const auto& f : functions) {
+        uint64_t address = addressOf(f.counterVar);
+        if (!address) continue;
+        const auto* values = reinterpret_cast<const uint64_t*>(address);
+        std::vector<uint64_t> counts(values, values + f.numCounters);
+        writer.addRecord(llvm::NamedInstrProfRecord(f.name, f.hash, std::move(counts)),
+                         [&](llvm::Error err) { error = llvm::toString(std::move(err)); });
+    }
+    if (!error.empty()) return false;
+
+    std::error_code ec;
+    llvm::raw_fd_ostream out(path, ec);
+    if (ec) {
+        error = ec.message();
+        return false;
+    }
+    if (llvm::Error err = writer.write(out)) {
+        error = llvm::toString(std::move(err));
+        return false;
+    }
+    return true;
+}
+
+} // namespace pynext
@@ -0,0 +1,48 @@
+#ifndef PYNEXT_PROFILE_RUNTIME_H
+#define PYNEXT_PROFILE_RUNTIME_H
+
+#include <llvm/IR/Module.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// Minimal replacement for compiler-rt's profile runtime, which is not linked
+// into the JIT. Code instrumented by LLVM's IR-level PGO (ProfileGuidance::
+// Mode::Generate) bumps one __profc_<function> counter array per function.
+// The collector finds those arrays in the module before it is JIT-compiled,
+// then reads them out of JIT memory once the program has run and writes an
+// indexed .profdata file, ready for --pgo-use and llvm-profdata.
+class ProfileCollector {
+public:
+    // Records the counter arrays of the instrumented `module` and gives them
+    // external linkage so their JIT addresses can be looked up. Call after
+    // optimizeModule and before the module is handed to the JIT.
+    void collect(llvm::Module& module);
+
+    // Makes the value-profiling hooks resolvable by the JIT. They are no-ops:
+    // only edge counters are written to the profile.
+    static void registerRuntime();
+
+    size_t functionCount() const { return functions.size(); }
+
+    // Writes the current counter values. `addressOf` returns the JIT address
+    // of a global by name, or 0.
+    bool write(const std::string& path, const std::function<uint64_t(const std::string&)>& addressOf,
+               std::string& error) const;
+
+private:
+    struct FunctionCounters {
+        std::string name;        // PGO function name
+        std::string counterVar;  // __profc_<name>
+        uint64_t hash;           // CFG hash the use pass checks against
+        uint64_t numCounters;
+    };
+    std::vector<FunctionCounters> functions;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_PROFILE_RUNTIME_H
@@ -0,0 +1,274 @@
+#include "Profiler.h"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <algorithm>
+#include <dlfcn.h>
+#include <map>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+namespace pynext {
+
+namespace {
+
+// Buffer capacity in words; about three minutes of samples at 1 ms with a
+// typical stack depth before samples start being dropped.
+constexpr size_t kBufferWords = size_t(1) << 21;
+
+SamplingProfiler* activeProfiler = nullptr;
+struct sigaction previousAction;
+
+void onSigprof(int, siginfo_t*, void* context) {
+    SamplingProfiler* profiler = activeProfiler;
+    if (!profiler) return;
+
+    auto* uc = static_cast<ucontext_t*>(context);
+#if defined(__linux__) && defined(__x86_64__)
+    profiler->record(uc->uc_mcontext.gregs[REG_RIP], uc->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__linux__) && defined(__aarch64__)
+    profiler->record(uc->uc_mcontext.pc, uc->uc_mcontext.regs[29]);
+#else
+    (void)uc;
+#endif
+}
+
+} // namespace
+
+SamplingProfiler::SamplingProfiler(unsigned intervalMicros)
+    : intervalMicros(intervalMicros), buffer(kBufferWords) {}
+
+SamplingProfiler::~SamplingProfiler() {
+    stop();
+}
+
+void SamplingProfiler::addFunction(llvm::StringRef name, uint64_t address, uint64_t size, int line) {
+    symbols.push_back({address, address + size, name.str(), line});
+}
+
+void SamplingProfiler::addLine(uint64_t address, int line) {
+    lineRows.emplace_back(address, line);
+}
+
+bool SamplingProfiler::start() {
+    if (running || activeProfiler) return false;
+    std::sort(symbols.begin(), symbols.end(),
+              [](const Symbol& a, const Symbol& b) { return a.start < b.start; });
+    std::stable_sort(lineRows.begin(), lineRows.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // Frame pointers are only followed while they stay inside this thread's stack
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void* stackAddr = nullptr;
+        size_t stackSize = 0;
+        pthread_attr_getstack(&attr, &stackAddr, &stackSize);
+        pthread_attr_destroy(&attr);
+        stackLow = reinterpret_cast<uintptr_t>(stackAddr);
+        stackHigh = stackLow + stackSize;
+    }
+
+    struct sigaction action = {};
+    action.sa_sigaction = onSigprof;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previousAction) != 0) return false;
+    activeProfiler = this;
+
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = intervalMicros / 1000000;
+    timer.it_interval.tv_usec = intervalMicros % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        sigaction(SIGPROF, &previousAction, nullptr);
+        activeProfiler = nullptr;
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void SamplingProfiler::stop() {
+    if (!running) return;
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &previousAction, nullptr);
+    activeProfiler = nullptr;
+    running = false;
+}
+
+void SamplingProfiler::record(uintptr_t pc, uintptr_t fp) {
+    uintptr_t frames[kMaxDepth];
+    unsigned depth = 0;
+    frames[depth++] = pc;
+
+    // Each frame starts with [saved frame pointer, return address]. Stop at the
+    // first pointer that leaves the stack, is misaligned or does not move
+    // towards the stack base; code without frame pointers ends the walk there.
+    while (depth < kMaxDepth && stackLow <= fp && fp + 2 * sizeof(uintptr_t) <= stackHigh &&
+           fp % sizeof(uintptr_t) == 0) {
+        auto* frame = reinterpret_cast<const uintptr_t*>(fp);
+        uintptr_t next = frame[0];
+        uintptr_t ret = frame[1];
+        if (ret == 0) break;
+        frames[depth++] = ret;
+        if (next <= fp) break;
+        fp = next;
+    }
+
+    size_t pos = used.load(std::memory_order_relaxed);
+    if (pos + depth + 1 > buffer.size()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer[pos] = depth;
+    std::copy(frames, frames + depth, buffer.begin() + pos + 1);
+    used.store(pos + depth + 1, std::memory_order_release);
+    samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+const SamplingProfiler::Symbol* SamplingProfiler::findSymbol(uintptr_t address) const {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address,
+                               [](uintptr_t addr, const Symbol& s) { return addr < s.start; });
+    if (it == symbols.begin()) return nullptr;
+    --it;
+    return address < it->end ? &*it : nullptr;
+}
+
+int SamplingProfiler::findLine(uintptr_t address, const Symbol& symbol) const {
+    auto it = std::upper_bound(lineRows.begin(), lineRows.end(), address,
+                               [](uintptr_t addr, const auto& row) { return addr < row.first; });
+    if (it == lineRows.begin()) return 0;
+    --it;
+    return it->first >= symbol.start ? it->second : 0;
+}
+
+std::string SamplingProfiler::frameName(uintptr_t address) const {
+    if (const Symbol* symbol = findSymbol(address)) return symbol->name;
+
+    // Runtime and libc code: name it from the dynamic symbol table if possible
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(address), &info)) {
+        if (info.dli_sname) return info.dli_sname;
+        if (info.dli_fname) {
+            llvm::StringRef file = info.dli_fname;
+            return "[" + file.substr(file.rfind('/') + 1).str() + "]";
+        }
+    }
+    return "[unknown]";
+}
+
+std::vector<std::vector<std::string>> SamplingProfiler::symbolizedStacks() const {
+    std::vector<std::vector<std::string>> stacks;
+    size_t end = used.load(std::memory_order_acquire);
+    for (size_t pos = 0; pos < end;) {
+        size_t depth = buffer[pos];
+        const uintptr_t* frames = &buffer[pos + 1];
+        pos += depth + 1;
+
+        // Drop the driver's frames above the outermost JIT function
+        size_t keep = 1;
+        for (size_t i = 0; i < depth; ++i) {
+            // Return addresses point after the call; look up the call itself
+            if (findSymbol(i == 0 ? frames[i] : frames[i] - 1)) keep = i + 1;
+        }
+
+        std::vector<std::string> stack;
+        for (size_t i = keep; i-- > 0;) {
+            stack.push_back(frameName(i == 0 ? frames[i] : frames[i] - 1));
+        }
+        stacks.push_back(std::move(stack));
+    }
+    return stacks;
+}
+
+void SamplingProfiler::report(llvm::raw_ostream& out) const {
+    auto stacks = symbolizedStacks();
+    size_t total = stacks.size();
+
+    struct Counts {
+        size_t self = 0;
+        size_t cumulative = 0;
+    };
+    std::map<std::string, Counts> counts;
+    for (const auto& stack : stacks) {
+        counts[stack.back()].self++;
+        // Recursive functions count once per sample in the cumulative column
+        std::vector<llvm::StringRef> seen;
+        for (const auto& frame : stack) {
+            if (std::find(seen.begin(), seen.end(), frame) != seen.end()) continue;
+            seen.push_back(frame);
+            counts[frame].cumulative++;
+        }
+    }
+
+    llvm::StringMap<int> lines;
+    for (const auto& s : symbols) lines[s.name] = s.line;
+
+    std::vector<std::pair<std::string, Counts>> rows(counts.begin(), counts.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        if (a.second.self != b.second.self) return a.second.self > b.second.self;
+        return a.second.cumulative > b.second.cumulative;
+    });
+
+    out << llvm::formatv("Profile: {0} samples every {1:F3} ms of CPU time", total, intervalMicros / 1000.0);
+    if (dropped) out << " (" << dropped.load() << " dropped, buffer full)";
+    out << "\n";
+    if (total == 0) return;
+
+    out << llvm::formatv("{0,7} {1,8} {2,7} {3,8}  {4}\n", "self%", "self", "total%", "total", "function");
+    for (const auto& [name, c] : rows) {
+        std::string label = name;
+        auto it = lines.find(name);
+        if (it != lines.end() && it->second > 0) label += " (line " + std::to_string(it->second) + ")";
+        out << llvm::formatv("{0,6:F1}% {1,8} {2,6:F1}% {3,8}  {4}\n",
+                             100.0 * c.self / total, c.self, 100.0 * c.cumulative / total, c.cumulative, label);
+    }
+    if (!lineRows.empty()) reportLines(out, total);
+}
+
+void SamplingProfiler::reportLines(llvm::raw_ostream& out, size_t total) const {
+    // Only the interrupted instruction is attributed; a caller's return
+    // address would name the line of the call, which `total` already covers
+    std::map<std::pair<std::string, int>, size_t> counts;
+    size_t end = used.load(std::memory_order_acquire);
+    for (size_t pos = 0; pos < end; pos += buffer[pos] + 1) {
+        uintptr_t pc = buffer[pos + 1];
+        if (const Symbol* symbol = findSymbol(pc)) counts[{symbol->name, findLine(pc, *symbol)}]++;
+    }
+    if (counts.empty()) return;
+
+    std::vector<std::pair<std::pair<std::string, int>, size_t>> rows(counts.begin(), counts.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    if (rows.size() > 10) rows.resize(10);
+
+    out << "Lines by self samples\n";
+    out << llvm::formatv("{0,7} {1,8}  {2}\n", "self%", "self", "line");
+    for (const auto& [key, count] : rows) {
+        std::string label = key.first + (key.second > 0 ? " (line " + std::to_string(key.second) + ")" : " (no line)");
+        out << llvm::formatv("{0,6:F1}% {1,8}  {2}\n", 100.0 * count / total, count, label);
+    }
+}
+
+bool SamplingProfiler::writeCollapsed(const std::string& path) const {
+    std::map<std::string, size_t> folded;
+    for (const auto& stack : symbolizedStacks()) {
+        std::string key;
+        for (const auto& frame : stack) {
+            if (!key.empty()) key += ';';
+            key += frame;
+        }
+        folded[key]++;
+    }
+
+    std::error_code ec;
+    llvm::raw_fd_ostream out(path, ec);
+    if (ec) return false;
+    for (const auto& [stack, count] : folded) {
+        out << stack << " " << count << "\n";
+    }
+    return true;
+}
+
+} // namespace pynext
@@ -0,0 +1,87 @@
+#ifndef PYNEXT_PROFILER_H
+#define PYNEXT_PROFILER_H
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// Statistical CPU profiler for JIT-compiled programs.
+//
+// While running, a SIGPROF timer (setitimer(ITIMER_PROF)) interrupts the
+// program every `intervalMicros` of CPU time. The signal handler walks the
+// frame-pointer chain of the interrupted thread and appends the raw return
+// addresses to a preallocated buffer; nothing is allocated or symbolized in
+// signal context. Stacks are only complete when the JIT code keeps its frame
+// pointers (CodeGenOptions::framePointers).
+//
+// After stop(), addresses are mapped to the functions registered with
+// addFunction(), and the profile is reported as a flat/cumulative table and
+// as collapsed stacks ("main;outer;inner <count>") for flamegraph.pl. When
+// line table rows were registered with addLine(), the report also attributes
+// self samples to the source line of the interrupted instruction.
+class SamplingProfiler {
+public:
+    explicit SamplingProfiler(unsigned intervalMicros = 1000);
+    ~SamplingProfiler();
+
+    // Registers a JIT-compiled function. `line` is the line of its `def`, or 0.
+    void addFunction(llvm::StringRef name, uint64_t address, uint64_t size, int line);
+    // Registers a line table row: the code from `address` up to the next row
+    // belongs to source line `line` (0 for code without a source line).
+    void addLine(uint64_t address, int line);
+
+    // Installs the SIGPROF handler and arms the timer. Only one profiler can
+    // be active at a time.
+    bool start();
+    void stop();
+
+    size_t sampleCount() const { return samples; }
+
+    // Captures one stack starting at the interrupted `pc` and frame pointer.
+    // Async-signal-safe; called from the SIGPROF handler.
+    void record(uintptr_t pc, uintptr_t fp);
+
+    void report(llvm::raw_ostream& out) const;
+    bool writeCollapsed(const std::string& path) const;
+
+private:
+    struct Symbol {
+        uint64_t start;
+        uint64_t end;
+        std::string name;
+        int line;
+    };
+
+    static constexpr unsigned kMaxDepth = 128;
+
+    unsigned intervalMicros;
+    std::vector<Symbol> symbols;
+    std::vector<std::pair<uint64_t, int>> lineRows;
+
+    // Sample buffer: each record is [depth, pc0 (leaf), pc1, ..., pc(depth-1)]
+    std::vector<uintptr_t> buffer;
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> samples{0};
+    std::atomic<size_t> dropped{0};
+    uintptr_t stackLow = 0;
+    uintptr_t stackHigh = 0;
+    bool running = false;
+
+    const Symbol* findSymbol(uintptr_t address) const;
+    // Line of the row covering `address` inside `symbol`, or 0
+    int findLine(uintptr_t address, const Symbol& symbol) const;
+    void reportLines(llvm::raw_ostream& out, size_t total) const;
+    std::string frameName(uintptr_t address) const;
+    // Symbolized stacks, outermost frame first, with frames above the
+    // outermost JIT function (the driver itself) removed.
+    std::vector<std::vector<std::string>> symbolizedStacks() const;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_PROFILER_H
@@ -0,0 +1,14 @@
+#ifndef PYNEXT_RUNTIME_SYMBOL_H
+#define PYNEXT_RUNTIME_SYMBOL_H
+
+namespace pynext {
+
+// An entry point of the runtime library, for JITs that resolve it by name
+struct RuntimeSymbol {
+    const char* name;
+    void* address;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_RUNTIME_SYMBOL_H
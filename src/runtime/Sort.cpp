@@ -0,0 +1,423 @@
+#include "Sort.h"
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace pynext {
+
+namespace {
+
+unsigned configuredThreads = 0;
+
+// Pattern-defeating quicksort (Orson Peters): introsort with a median of
+// medians pivot on large ranges, a check for ranges already partitioned
+// that finishes them with an insertion sort, and a shuffle of the pivot
+// candidates after a bad partition. Heapsort after log2(n) bad ones.
+constexpr ptrdiff_t kInsertionSortThreshold = 24;
+constexpr ptrdiff_t kNintherThreshold = 128;
+constexpr size_t kPartialInsertionSortLimit = 8;
+
+template <typename T, typename Less>
+void insertionSort(T* begin, T* end, Less less) {
+    if (begin == end) return;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+        T* sift = cur;
+        T* prev = cur - 1;
+        if (!less(*sift, *prev)) continue;
+        T value = std::move(*sift);
+        do {
+            *sift-- = std::move(*prev);
+        } while (sift != begin && less(value, *--prev));
+        *sift = std::move(value);
+    }
+}
+
+// begin[-1] is no greater than anything in the range and stops the scan
+template <typename T, typename Less>
+void unguardedInsertionSort(T* begin, T* end, Less less) {
+    if (begin == end) return;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+        T* sift = cur;
+        T* prev = cur - 1;
+        if (!less(*sift, *prev)) continue;
+        T value = std::move(*sift);
+        do {
+            *sift-- = std::move(*prev);
+        } while (less(value, *--prev));
+        *sift = std::move(value);
+    }
+}
+
+// Gives up, returning false, once it has moved more than a few elements
+template <typename T, typename Less>
+bool partialInsertionSort(T* begin, T* end, Less less) {
+    if (begin == end) return true;
+    size_t moved = 0;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+        T* sift = cur;
+        T* prev = cur - 1;
+        if (!less(*sift, *prev)) continue;
+        T value = std::move(*sift);
+        do {
+            *sift-- = std::move(*prev);
+        } while (sift != begin && less(value, *--prev));
+        *sift = std::move(value);
+        moved += cur - sift;
+        if (moved > kPartialInsertionSortLimit) return false;
+    }
+    return true;
+}
+
+template <typename T, typename Less>
+void sort2(T* a, T* b, Less less) {
+    if (less(*b, *a)) std::iter_swap(a, b);
+}
+
+template <typename T, typename Less>
+void sort3(T* a, T* b, T* c, Less less) {
+    sort2(a, b, less);
+    sort2(b, c, less);
+    sort2(a, b, less);
+}
+
+// Partitions around the pivot *begin: smaller elements to its left, the
+// rest to its right. Also reports whether no element had to move.
+template <typename T, typename Less>
+std::pair<T*, bool> partitionRight(T* begin, T* end, Less less) {
+    T pivot = std::move(*begin);
+    T* first = begin;
+    T* last = end;
+    while (less(*++first, pivot)) {}
+    if (first - 1 == begin) {
+        while (first < last && !less(*--last, pivot)) {}
+    } else {
+        while (!less(*--last, pivot)) {}
+    }
+    bool alreadyPartitioned = first >= last;
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (less(*++first, pivot)) {}
+        while (!less(*--last, pivot)) {}
+    }
+    T* pivotPos = first - 1;
+    *begin = std::move(*pivotPos);
+    *pivotPos = std::move(pivot);
+    return {pivotPos, alreadyPartitioned};
+}
+
+// Puts the elements equal to the pivot *begin on its left. Used when the
+// pivot equals the one before the range, so the left part needs no sorting.
+template <typename T, typename Less>
+T* partitionLeft(T* begin, T* end, Less less) {
+    T pivot = std::move(*begin);
+    T* first = begin;
+    T* last = end;
+    while (less(pivot, *--last)) {}
+    if (last + 1 == end) {
+        while (first < last && !less(pivot, *++first)) {}
+    } else {
+        while (!less(pivot, *++first)) {}
+    }
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (less(pivot, *--last)) {}
+        while (!less(pivot, *++first)) {}
+    }
+    T* pivotPos = last;
+    *begin = std::move(*pivotPos);
+    *pivotPos = std::move(pivot);
+    return pivotPos;
+}
+
+template <typename T, typename Less>
+void pdqsortLoop(T* begin, T* end, Less less, int badAllowed, bool leftmost) {
+    while (true) {
+        ptrdiff_t size = end - begin;
+        if (size < kInsertionSortThreshold) {
+            if (leftmost) insertionSort(begin, end, less);
+            else unguardedInsertionSort(begin, end, less);
+            return;
+        }
+
+        ptrdiff_t half = size / 2;
+        if (size > kNintherThreshold) {
+            sort3(begin, begin + half, end - 1, less);
+            sort3(begin + 1, begin + (half - 1), end - 2, less);
+            sort3(begin + 2, begin + (half + 1), end - 3, less);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+            std::iter_swap(begin, begin + half);
+        } else {
+            sort3(begin + half, begin, end - 1, less);
+        }
+
+        // A pivot equal to the element before the range starts a run of equal keys
+        if (!leftmost && !less(*(begin - 1), *begin)) {
+            begin = partitionLeft(begin, end, less) + 1;
+            continue;
+        }
+
+        auto [pivotPos, alreadyPartitioned] = partitionRight(begin, end, less);
+        ptrdiff_t leftSize = pivotPos - begin;
+        ptrdiff_t rightSize = end - (pivotPos + 1);
+        if (leftSize < size / 8 || rightSize < size / 8) {
+            if (--badAllowed == 0) {
+                std::make_heap(begin, end, less);
+                std::sort_heap(begin, end, less);
+                return;
+            }
+            // Break up the pattern that produced the bad pivot
+            if (leftSize >= kInsertionSortThreshold) {
+                std::iter_swap(begin, begin + leftSize / 4);
+                std::iter_swap(pivotPos - 1, pivotPos - leftSize / 4);
+                if (leftSize > kNintherThreshold) {
+                    std::iter_swap(begin + 1, begin + (leftSize / 4 + 1));
+                    std::iter_swap(begin + 2, begin + (leftSize / 4 + 2));
+                    std::iter_swap(pivotPos - 2, pivotPos - (leftSize / 4 + 1));
+                    std::iter_swap(pivotPos - 3, pivotPos - (leftSize / 4 + 2));
+                }
+            }
+            if (rightSize >= kInsertionSortThreshold) {
+                std::iter_swap(pivotPos + 1, pivotPos + (1 + rightSize / 4));
+                std::iter_swap(end - 1, end - rightSize / 4);
+                if (rightSize > kNintherThreshold) {
+                    std::iter_swap(pivotPos + 2, pivotPos + (2 + rightSize / 4));
+                    std::iter_swap(pivotPos + 3, pivotPos + (3 + rightSize / 4));
+                    std::iter_swap(end - 2, end - (1 + rightSize / 4));
+                    std::iter_swap(end - 3, end - (2 + rightSize / 4));
+                }
+            }
+        } else if (alreadyPartitioned && partialInsertionSort(begin, pivotPos, less) &&
+                   partialInsertionSort(pivotPos + 1, end, less)) {
+            return;
+        }
+
+        // Recurse into the left part, loop on the right one
+        pdqsortLoop(begin, pivotPos, less, badAllowed, leftmost);
+        begin = pivotPos + 1;
+        leftmost = false;
+    }
+}
+
+template <typename T, typename Less>
+void pdqsort(T* begin, T* end, Less less) {
+    if (end - begin < 2) return;
+    int log2 = 0;
+    for (size_t size = end - begin; size > 1; size >>= 1) log2++;
+    pdqsortLoop(begin, end, less, log2, true);
+}
+
+// Stable LSD radix sort by the unsigned 64-bit `key(element)`, 8 bits per
+// pass. One scan builds the histograms of all eight digits.
+template <typename T, typename Key>
+void radixSort(T* data, size_t count, Key key) {
+    std::vector<size_t> histograms(8 * 256);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t k = key(data[i]);
+        for (int pass = 0; pass < 8; ++pass) histograms[pass * 256 + ((k >> (pass * 8)) & 0xFF)]++;
+    }
+
+    std::unique_ptr<T[]> buffer(new T[count]);
+    T* from = data;
+    T* to = buffer.get();
+    for (int pass = 0; pass < 8; ++pass) {
+        size_t* offsets = &histograms[pass * 256];
+        int shift = pass * 8;
+        // Every key has the same digit here: the pass would move nothing
+        if (offsets[(key(from[0]) >> shift) & 0xFF] == count) continue;
+        size_t start = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t n = offsets[digit];
+            offsets[digit] = start;
+            start += n;
+        }
+        for (size_t i = 0; i < count; ++i) to[offsets[(key(from[i]) >> shift) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != data) std::copy(from, from + count, data);
+}
+
+// One run: radix sort when it pays for its passes, pdqsort below that.
+// `less` must order like `key`, breaking its ties the way a stable sort would.
+template <typename T, typename Key, typename Less>
+void sortRun(T* data, size_t count, Key key, Less less) {
+    if ((int64_t)count >= kRadixThreshold) radixSort(data, count, key);
+    else pdqsort(data, data + count, less);
+}
+
+unsigned sortThreads() { return llvm::hardware_concurrency(configuredThreads).compute_thread_count(); }
+
+// Large arrays are cut into one run per thread; the sorted runs are merged
+// pairwise, the merges of a round again in parallel.
+template <typename T, typename SortRun, typename Less>
+void sortParallel(T* data, size_t count, SortRun sortRun, Less less) {
+    // Asking for the core count costs a system call: not for small arrays
+    unsigned threads = (int64_t)count < kParallelThreshold ? 1 : sortThreads();
+    if (threads < 2) {
+        sortRun(data, count);
+        return;
+    }
+
+    std::vector<size_t> bounds(threads + 1);
+    for (unsigned i = 0; i <= threads; ++i) bounds[i] = count * i / threads;
+    llvm::ThreadPool pool(llvm::hardware_concurrency(threads));
+    for (unsigned i = 0; i < threads; ++i) {
+        pool.async([&, i] { sortRun(data + bounds[i], bounds[i + 1] - bounds[i]); });
+    }
+    pool.wait();
+
+    std::unique_ptr<T[]> buffer(new T[count]);
+    T* from = data;
+    T* to = buffer.get();
+    for (unsigned width = 1; width < threads; width *= 2) {
+        for (unsigned i = 0; i < threads; i += 2 * width) {
+            size_t lo = bounds[i];
+            size_t mid = bounds[std::min(i + width, threads)];
+            size_t hi = bounds[std::min(i + 2 * width, threads)];
+            pool.async([=] { std::merge(from + lo, from + mid, from + mid, from + hi, to + lo, less); });
+        }
+        pool.wait();
+        std::swap(from, to);
+    }
+    if (from != data) std::copy(from, from + count, data);
+}
+
+template <typename T, typename Key>
+void sortValues(T* data, int64_t count, Key key) {
+    if (count < 2) return;
+    auto less = [key](const T& a, const T& b) { return key(a) < key(b); };
+    sortParallel(data, count, [&](T* run, size_t n) { sortRun(run, n, key, less); }, less);
+}
+
+// Unsigned keys that order like the values
+uint64_t intKey(int64_t value) { return uint64_t(value) ^ (1ULL << 63); }
+
+uint64_t floatKey(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    // Negative: flip every bit, so larger magnitudes sort first. Otherwise
+    // just the sign bit, to sort after the negatives.
+    return bits ^ (uint64_t(int64_t(bits) >> 63) | (1ULL << 63));
+}
+
+struct KeyedIndex {
+    uint64_t key;
+    uint64_t index;
+};
+
+struct StringIndex {
+    const char* key;
+    uint64_t index;
+};
+
+// Moves element order[i].index of the array to position i
+template <typename Order>
+void permute(uint8_t* data, int64_t count, int64_t stride, const Order* order) {
+    std::unique_ptr<uint8_t[]> sorted(new uint8_t[count * stride]);
+    for (int64_t i = 0; i < count; ++i) memcpy(&sorted[i * stride], data + order[i].index * stride, stride);
+    memcpy(data, sorted.get(), count * stride);
+}
+
+// `fieldKey` maps the address of an element's field to its unsigned key
+template <typename FieldKey>
+void sortRecords(void* data, int64_t count, int64_t stride, int64_t offset, FieldKey fieldKey) {
+    if (count < 2) return;
+    auto* bytes = static_cast<uint8_t*>(data);
+    std::unique_ptr<KeyedIndex[]> order(new KeyedIndex[count]);
+    for (int64_t i = 0; i < count; ++i) order[i] = {fieldKey(bytes + i * stride + offset), uint64_t(i)};
+
+    auto key = [](const KeyedIndex& entry) { return entry.key; };
+    auto less = [](const KeyedIndex& a, const KeyedIndex& b) {
+        return a.key < b.key || (a.key == b.key && a.index < b.index);
+    };
+    sortParallel(order.get(), count, [&](KeyedIndex* run, size_t n) { sortRun(run, n, key, less); }, less);
+    permute(bytes, count, stride, order.get());
+}
+
+template <typename T>
+T loadField(const uint8_t* field) {
+    T value;
+    memcpy(&value, field, sizeof(T));
+    return value;
+}
+
+} // namespace
+
+void setSortThreads(unsigned threads) { configuredThreads = threads; }
+
+llvm::ArrayRef<RuntimeSymbol> sortRuntimeSymbols() {
+    static const RuntimeSymbol symbols[] = {
+        {"__pynext_sort_int", (void*)__pynext_sort_int},
+        {"__pynext_sort_float", (void*)__pynext_sort_float},
+        {"__pynext_sort_bool", (void*)__pynext_sort_bool},
+        {"__pynext_sort_string", (void*)__pynext_sort_string},
+        {"__pynext_sort_by_int", (void*)__pynext_sort_by_int},
+        {"__pynext_sort_by_float", (void*)__pynext_sort_by_float},
+        {"__pynext_sort_by_bool", (void*)__pynext_sort_by_bool},
+        {"__pynext_sort_by_string", (void*)__pynext_sort_by_string},
+    };
+    return symbols;
+}
+
+void registerSortRuntime() {
+    for (const RuntimeSymbol& symbol : sortRuntimeSymbols()) {
+        llvm::sys::DynamicLibrary::AddSymbol(symbol.name, symbol.address);
+    }
+}
+
+} // namespace pynext
+
+using namespace pynext;
+
+// Lambdas rather than the functions themselves, which would be called
+// through a pointer
+extern "C" void __pynext_sort_int(int64_t* data, int64_t count) {
+    sortValues(data, count, [](int64_t value) { return intKey(value); });
+}
+
+extern "C" void __pynext_sort_float(double* data, int64_t count) {
+    sortValues(data, count, [](double value) { return floatKey(value); });
+}
+
+// Bools are bytes holding 0 or 1: count the ones
+extern "C" void __pynext_sort_bool(uint8_t* data, int64_t count) {
+    int64_t ones = std::count_if(data, data + count, [](uint8_t value) { return value != 0; });
+    std::fill(data, data + (count - ones), 0);
+    std::fill(data + (count - ones), data + count, 1);
+}
+
+extern "C" void __pynext_sort_string(const char** data, int64_t count) {
+    if (count < 2) return;
+    auto less = [](const char* a, const char* b) { return strcmp(a, b) < 0; };
+    sortParallel(data, count, [&](const char** run, size_t n) { pdqsort(run, run + n, less); }, less);
+}
+
+extern "C" void __pynext_sort_by_int(void* data, int64_t count, int64_t stride, int64_t offset) {
+    sortRecords(data, count, stride, offset, [](const uint8_t* field) { return intKey(loadField<int64_t>(field)); });
+}
+
+extern "C" void __pynext_sort_by_float(void* data, int64_t count, int64_t stride, int64_t offset) {
+    sortRecords(data, count, stride, offset, [](const uint8_t* field) { return floatKey(loadField<double>(field)); });
+}
+
+extern "C" void __pynext_sort_by_bool(void* data, int64_t count, int64_t stride, int64_t offset) {
+    sortRecords(data, count, stride, offset, [](const uint8_t* field) { return uint64_t(*field != 0); });
+}
+
+extern "C" void __pynext_sort_by_string(void* data, int64_t count, int64_t stride, int64_t offset) {
+    if (count < 2) return;
+    auto* bytes = static_cast<uint8_t*>(data);
+    std::unique_ptr<StringIndex[]> order(new StringIndex[count]);
+    for (int64_t i = 0; i < count; ++i) order[i] = {loadField<const char*>(bytes + i * stride + offset), uint64_t(i)};
+
+    auto less = [](const StringIndex& a, const StringIndex& b) {
+        int order = strcmp(a.key, b.key);
+        return order < 0 || (order == 0 && a.index < b.index);
+    };
+    sortParallel(order.get(), count, [&](StringIndex* run, size_t n) { pdqsort(run, run + n, less); }, less);
+    permute(bytes, count, stride, order.get());
+}
@@ -0,0 +1,50 @@
+#ifndef PYNEXT_SORT_H
+#define PYNEXT_SORT_H
+
+#include "RuntimeSymbol.h"
+#include <llvm/ADT/ArrayRef.h>
+#include <cstdint>
+
+// In-place sorts behind the `sort(arr)` and `sort_by(arr, field)` builtins,
+// one entry point per element type. CodeGen passes the array's data pointer
+// and element count.
+//
+// int and float arrays of at least kRadixThreshold elements are radix
+// sorted (LSD, 8 bits per pass, skipping the passes in which every key has
+// the same digit); smaller ones and string arrays use pattern-defeating
+// quicksort. Floats are ordered by their bits with the sign flipped: -0.0
+// sorts before 0.0, and NaNs after +inf (before -inf if negative). Arrays
+// of at least kParallelThreshold elements are cut into one run per thread,
+// sorted in parallel and merged.
+//
+// sort_by sorts (key, index) pairs taken from the field at `offset` of each
+// `stride`-byte element, then moves the elements into that order, so equal
+// keys keep their order.
+extern "C" {
+void __pynext_sort_int(int64_t* data, int64_t count);
+void __pynext_sort_float(double* data, int64_t count);
+void __pynext_sort_bool(uint8_t* data, int64_t count);
+void __pynext_sort_string(const char** data, int64_t count);
+void __pynext_sort_by_int(void* data, int64_t count, int64_t stride, int64_t offset);
+void __pynext_sort_by_float(void* data, int64_t count, int64_t stride, int64_t offset);
+void __pynext_sort_by_bool(void* data, int64_t count, int64_t stride, int64_t offset);
+void __pynext_sort_by_string(void* data, int64_t count, int64_t stride, int64_t offset);
+}
+
+namespace pynext {
+
+constexpr int64_t kRadixThreshold = 256;
+constexpr int64_t kParallelThreshold = 1 << 20;
+
+// Threads used above kParallelThreshold; 0, the default, is one per core
+void setSortThreads(unsigned threads);
+
+// The entry points above, for JITs that resolve them by name
+llvm::ArrayRef<RuntimeSymbol> sortRuntimeSymbols();
+
+// Makes them resolvable by the MCJIT engine. Call before JIT code runs.
+void registerSortRuntime();
+
+} // namespace pynext
+
+#endif // PYNEXT_SORT_H
@@ -0,0 +1,245 @@
+#include "Fingerprint.h"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/MD5.h>
+
+namespace pynext {
+
+namespace {
+
+// Writes a function as an S-expression of everything CodeGen reads: node
+// kinds, names, literals, operators and the types sema attached
+class Normalizer : public ASTVisitor {
+public:
+    Normalizer(FunctionSummary& summary, bool withPositions) : summary(summary), withPositions(withPositions) {}
+
+    std::string text;
+
+    void statement(Stmt& stmt) {
+        if (withPositions) text += "@" + std::to_string(stmt.line) + ":" + std::to_string(stmt.column);
+        stmt.accept(*this);
+    }
+
+    void useType(const std::shared_ptr<Type>& type) {
+        if (!type) return;
+        if (auto st = std::dynamic_pointer_cast<StructType>(type)) summary.structs.insert(st->name);
+        if (auto et = std::dynamic_pointer_cast<EnumType>(type)) summary.structs.insert(et->name);
+        if (auto at = std::dynamic_pointer_cast<ArrayType>(type)) useType(at->elementType);
+        if (auto dt = std::dynamic_pointer_cast<DictType>(type)) useType(dt->valueType);
+    }
+
+    void useTypeName(std::string name) {
+        while (name.size() > 2 && name.compare(name.size() - 2, 2, "[]") == 0) name.resize(name.size() - 2);
+        if (name.compare(0, 5, "dict[") == 0) {
+            // dict[K,V]; keys are never structs
+            size_t comma = name.find(',');
+            if (comma != std::string::npos) useTypeName(name.substr(comma + 1, name.size() - comma - 2));
+            return;
+        }
+        if (!numericType(name) && name != "bool" && name != "string" && name != "void" && name != "file" &&
+            !name.empty()) {
+            summary.structs.insert(name);
+        }
+    }
+
+    void expression(Expr& expr) {
+        expr.accept(*this);
+        text += ":" + (expr.type ? expr.type->toString() : std::string("?"));
+        useType(expr.type);
+    }
+
+    void visit(LiteralExpr& expr) override {
+        text += "(lit ";
+        text += expr.isString ? "s" : expr.isBool ? "b" : expr.isFloat ? "f" : "i";
+        text += std::to_string(expr.value.size()) + ":" + expr.value + ")";
+    }
+    void visit(VariableExpr& expr) override { text += "(var " + expr.name + ")"; }
+    void visit(BinaryExpr& expr) override {
+        text += "(" + expr.op + " ";
+        expression(*expr.left);
+        text += " ";
+        expression(*expr.right);
+        text += ")";
+    }
+    void visit(CallExpr& expr) override {
+        summary.callees.insert(expr.callee);
+        text += "(call " + expr.callee;
+        for (auto& arg : expr.args) {
+            text += " ";
+            expression(*arg);
+        }
+        text += ")";
+    }
+    void visit(MemberAccessExpr& expr) override {
+        text += "(. ";
+        expression(*expr.object);
+        text += " " + expr.member + ")";
+    }
+    void visit(IndexExpr& expr) override {
+        text += "([] ";
+        expression(*expr.object);
+        text += " ";
+        expression(*expr.index);
+        text += ")";
+    }
+    void visit(ArrayLiteralExpr& expr) override {
+        text += "(array";
+        for (auto& element : expr.elements) {
+            text += " ";
+            expression(*element);
+        }
+        text += ")";
+    }
+    void visit(ReturnStmt& stmt) override {
+        text += "(return";
+        if (stmt.value) {
+            text += " ";
+            expression(*stmt.value);
+        }
+        text += ")";
+    }
+    void visit(Block& stmt) override {
+        text += "(block";
+        for (auto& s : stmt.statements) {
+            text += " ";
+            statement(*s);
+        }
+        text += ")";
+    }
+    void visit(IfStmt& stmt) override {
+        text += "(if ";
+        expression(*stmt.condition);
+        text += " ";
+        statement(*stmt.thenBranch);
+        if (stmt.elseBranch) {
+            text += " ";
+            statement(*stmt.elseBranch);
+        }
+        text += ")";
+    }
+    void visit(WhileStmt& stmt) override {
+        text += "(while ";
+        expression(*stmt.condition);
+        text += " ";
+        statement(*stmt.body);
+        text += ")";
+    }
+    void visit(ForStmt& stmt) override {
+        text += "(for " + stmt.variable + " ";
+        expression(*stmt.iterator);
+        text += " ";
+        statement(*stmt.body);
+        text += ")";
+    }
+    void visit(FunctionStmt& stmt) override {
+        // Nested definitions do not occur; top-level ones are summarized separately
+        text += "(def " + stmt.name + ")";
+    }
+    void visit(VarDeclStmt& stmt) override {
+        text += stmt.global ? "(global " : "(let ";
+        text += stmt.name + ":" + stmt.typeName + ":" + (stmt.type ? stmt.type->toString() : "?");
+        useTypeName(stmt.typeName);
+        useType(stmt.type);
+        if (stmt.initializer) {
+            text += " ";
+            expression(*stmt.initializer);
+        }
+        text += ")";
+    }
+    void visit(StructDeclStmt& stmt) override { text += "(struct " + stmt.name + ")"; }
+    void visit(EnumDeclStmt& stmt) override { text += "(enum " + stmt.name + ")"; }
+    void visit(MatchStmt& stmt) override {
+        text += "(match ";
+        expression(*stmt.subject);
+        for (auto& matchCase : stmt.cases) {
+            text += " (case " + matchCase.variant;
+            for (const auto& name : matchCase.bindings) text += " " + name;
+            text += " ";
+            statement(*matchCase.body);
+            text += ")";
+        }
+        if (stmt.elseBranch) {
+            text += " ";
+            statement(*stmt.elseBranch);
+        }
+        text += ")";
+    }
+    void visit(ExprStmt& stmt) override {
+        text += "(expr ";
+        expression(*stmt.expr);
+        text += ")";
+    }
+
+private:
+    FunctionSummary& summary;
+    bool withPositions;
+};
+
+std::string md5(llvm::StringRef text) {
+    llvm::MD5 hash;
+    hash.update(text);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return result.digest().str().str();
+}
+
+} // namespace
+
+std::map<std::string, FunctionSummary> summarizeFunctions(const std::vector<std::unique_ptr<Stmt>>& stmts,
+                                                          const std::string& entryName, bool withPositions) {
+    std::map<std::string, FunctionSummary> summaries;
+    FunctionSummary& entry = summaries[entryName];
+    entry.isDefinition = true;
+    entry.signature = "()->int";
+    Normalizer topLevel(entry, withPositions);
+
+    for (const auto& stmt : stmts) {
+        auto* func = dynamic_cast<FunctionStmt*>(stmt.get());
+        if (!func) {
+            if (!dynamic_cast<StructDeclStmt*>(stmt.get()) && !dynamic_cast<EnumDeclStmt*>(stmt.get())) {
+                topLevel.statement(*stmt);
+            }
+            continue;
+        }
+
+        FunctionSummary& summary = summaries[func->name];
+        Normalizer normalizer(summary, withPositions);
+        summary.signature = "(";
+        for (size_t i = 0; i < func->params.size(); ++i) {
+            if (i) summary.signature += ",";
+            summary.signature += func->params[i].second;
+            normalizer.useTypeName(func->params[i].second);
+            normalizer.text += func->params[i].first + ":" + func->params[i].second + ";";
+        }
+        summary.signature += ")->" + func->returnType;
+        normalizer.useTypeName(func->returnType);
+        if (!func->body) continue;
+
+        summary.isDefinition = true;
+        normalizer.statement(*func->body);
+        summary.bodyHash = md5(normalizer.text);
+    }
+    entry.bodyHash = md5(topLevel.text);
+    return summaries;
+}
+
+std::map<std::string, std::string> structLayouts(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+    std::map<std::string, std::string> layouts;
+    for (const auto& stmt : stmts) {
+        if (auto* decl = dynamic_cast<StructDeclStmt*>(stmt.get())) {
+            std::string& layout = layouts[decl->name];
+            for (const auto& field : decl->fields) layout += field.first + ":" + field.second + ",";
+        } else if (auto* decl = dynamic_cast<EnumDeclStmt*>(stmt.get())) {
+            // Variants in tag order, and "Variant:" for one without fields
+            std::string& layout = layouts[decl->name];
+            for (const auto& variant : decl->variants) {
+                if (variant.fields.empty()) layout += variant.name + ":,";
+                for (const auto& field : variant.fields) {
+                    layout += variant.name + "." + field.first + ":" + field.second + ",";
+                }
+            }
+        }
+    }
+    return layouts;
+}
+
+} // namespace pynext
@@ -0,0 +1,33 @@
+#ifndef PYNEXT_FINGERPRINT_H
+#define PYNEXT_FINGERPRINT_H
+
+#include "../parser/AST.h"
+#include <map>
+#include <set>
+#include <string>
+
+namespace pynext {
+
+// What the code of one function depends on, for incremental rebuilds
+struct FunctionSummary {
+    bool isDefinition = false;       // False for extern declarations
+    std::string signature;           // "(int,Point[])->float"
+    std::string bodyHash;            // MD5 of the normalized, type-checked AST
+    std::set<std::string> callees;   // Functions named by CallExprs
+    std::set<std::string> structs;   // Structs in the signature, locals and expression types
+};
+
+// Summarizes every function of a type-checked module. The top-level
+// statements form the entry function `entryName`, as in CodeGen::generate.
+// Normalization drops source positions unless `withPositions` is set (debug
+// info records them), so reformatting or moving a function keeps its hash.
+std::map<std::string, FunctionSummary> summarizeFunctions(const std::vector<std::unique_ptr<Stmt>>& stmts,
+                                                          const std::string& entryName, bool withPositions);
+
+// Field list of every struct, e.g. "x:int,y:float", and of every enum, e.g.
+// "Circle.radius:float,Empty:,", keyed by type name
+std::map<std::string, std::string> structLayouts(const std::vector<std::unique_ptr<Stmt>>& stmts);
+
+} // namespace pynext
+
+#endif // PYNEXT_FINGERPRINT_H
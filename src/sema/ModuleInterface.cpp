@@ -0,0 +1,77 @@
+#include "ModuleInterface.h"
+
+namespace pynext {
+
+ModuleInterface ModuleInterface::fromStatements(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+    ModuleInterface result;
+    for (const auto& stmt : stmts) {
+        if (auto* decl = dynamic_cast<StructDeclStmt*>(stmt.get())) {
+            result.structs.push_back({decl->name, decl->fields});
+        } else if (auto* decl = dynamic_cast<EnumDeclStmt*>(stmt.get())) {
+            result.enums.push_back({decl->name, decl->variants, result.structs.size()});
+        } else if (auto* func = dynamic_cast<FunctionStmt*>(stmt.get())) {
+            if (func->body && func->name != "main") {
+                result.functions.push_back({func->name, func->params, func->returnType});
+            }
+        }
+    }
+    return result;
+}
+
+void ModuleInterface::appendDeclarations(std::vector<std::unique_ptr<Stmt>>& out) const {
+    size_t nextStruct = 0;
+    auto appendStructs = [&](size_t end) {
+        for (; nextStruct < end && nextStruct < structs.size(); ++nextStruct) {
+            out.push_back(std::make_unique<StructDeclStmt>(structs[nextStruct].name, structs[nextStruct].fields));
+        }
+    };
+    for (const auto& decl : enums) {
+        appendStructs(decl.structsBefore);
+        out.push_back(std::make_unique<EnumDeclStmt>(decl.name, decl.variants));
+    }
+    appendStructs(structs.size());
+    for (const auto& func : functions) {
+        out.push_back(std::make_unique<FunctionStmt>(func.name, func.params, func.returnType, nullptr));
+    }
+}
+
+static void appendMembers(std::string& text, const ModuleInterface::Members& members) {
+    for (size_t i = 0; i < members.size(); ++i) {
+        if (i) text += ",";
+        text += members[i].first + ":" + members[i].second;
+    }
+}
+
+std::string ModuleInterface::summary() const {
+    std::string text;
+    size_t nextStruct = 0;
+    auto appendStructs = [&](size_t end) {
+        for (; nextStruct < end && nextStruct < structs.size(); ++nextStruct) {
+            text += "struct " + structs[nextStruct].name + "{";
+            appendMembers(text, structs[nextStruct].fields);
+            text += "}\n";
+        }
+    };
+    for (const auto& decl : enums) {
+        appendStructs(decl.structsBefore);
+        text += "enum " + decl.name + "{";
+        for (size_t i = 0; i < decl.variants.size(); ++i) {
+            if (i) text += "|";
+            text += decl.variants[i].name;
+            if (decl.variants[i].fields.empty()) continue;
+            text += "(";
+            appendMembers(text, decl.variants[i].fields);
+            text += ")";
+        }
+        text += "}\n";
+    }
+    appendStructs(structs.size());
+    for (const auto& func : functions) {
+        text += "def " + func.name + "(";
+        appendMembers(text, func.params);
+        text += ")->" + func.returnType + "\n";
+    }
+    return text;
+}
+
+} // namespace pynext
@@ -0,0 +1,53 @@
+#ifndef PYNEXT_MODULE_INTERFACE_H
+#define PYNEXT_MODULE_INTERFACE_H
+
+#include "../parser/AST.h"
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// What a module exports to the files that import it: its struct and enum
+// layouts and the signatures of its functions. Importers are type-checked and compiled
+// against these declarations; the bodies stay in the module's own object.
+struct ModuleInterface {
+    using Members = std::vector<std::pair<std::string, std::string>>; // Name, type name
+
+    struct Struct {
+        std::string name;
+        Members fields;
+    };
+
+    struct Enum {
+        std::string name;
+        std::vector<EnumVariant> variants;
+        size_t structsBefore; // Declared after this many of `structs`, which its fields may use
+    };
+
+    struct Function {
+        std::string name;
+        Members params;
+        std::string returnType;
+    };
+
+    std::vector<Struct> structs;
+    std::vector<Enum> enums;
+    std::vector<Function> functions;
+
+    // Every struct, every enum and every defined function except `main`; extern
+    // declarations are not re-exported
+    static ModuleInterface fromStatements(const std::vector<std::unique_ptr<Stmt>>& stmts);
+
+    // Struct and enum declarations, in their order in the module, and
+    // body-less function declarations, as an
+    // importer's TypeChecker and CodeGen expect them in front of its own code
+    void appendDeclarations(std::vector<std::unique_ptr<Stmt>>& out) const;
+
+    // Canonical text, e.g. "struct P{x:int,y:int}\nenum S{Dot(at:P)|None}\ndef dist(a:P,b:P)->float\n";
+    // importers are rebuilt when it changes
+    std::string summary() const;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_MODULE_INTERFACE_H
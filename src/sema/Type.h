@@ -1,6 +1,7 @@
 #ifndef PYNEXT_TYPE_H
 #define PYNEXT_TYPE_H
 
+#include <llvm/ADT/StringMap.h>
 #include <string>
 #include <vector>
 #include <memory>
@@ -17,7 +18,10 @@ enum class TypeKind {
     Struct,
     Array,
     Function,
-    TypeVariable
+    TypeVariable,
+    Dict, // After TypeVariable: the numbering is part of the AST cache format
+    File,
+    Enum,
 };
 
 struct Type {
@@ -32,14 +36,21 @@ struct VoidType : public Type {
     std::string toString() const override { return "void"; }
 };
 
+// int is i64; the others are spelled i8, u8, ..., u64
 struct IntType : public Type {
-    IntType() : Type(TypeKind::Int) {}
-    std::string toString() const override { return "int"; }
+    unsigned bits; // 8, 16, 32 or 64
+    bool isSigned;
+    explicit IntType(unsigned bits = 64, bool isSigned = true) : Type(TypeKind::Int), bits(bits), isSigned(isSigned) {}
+    std::string toString() const override {
+        return bits == 64 && isSigned ? "int" : (isSigned ? "i" : "u") + std::to_string(bits);
+    }
 };
 
+// float is f64
 struct FloatType : public Type {
-    FloatType() : Type(TypeKind::Float) {}
-    std::string toString() const override { return "float"; }
+    unsigned bits; // 32 or 64
+    explicit FloatType(unsigned bits = 64) : Type(TypeKind::Float), bits(bits) {}
+    std::string toString() const override { return bits == 64 ? "float" : "f32"; }
 };
 
 struct BoolType : public Type {
@@ -54,25 +65,53 @@ struct StringType : public Type {
 
 struct StructType : public Type {
     std::string name;
-    std::vector<std::pair<std::string, std::shared_ptr<Type>>> fields;
+    std::vector<std::pair<std::string, std::shared_ptr<Type>>> fields; // Append with addField()
+    llvm::StringMap<int> fieldIndices; // Name -> position in `fields`; the first of duplicate names
 
     StructType(std::string name, std::vector<std::pair<std::string, std::shared_ptr<Type>>> fields)
-        : Type(TypeKind::Struct), name(std::move(name)), fields(std::move(fields)) {}
+        : Type(TypeKind::Struct), name(std::move(name)), fields(std::move(fields)) {
+        for (int i = 0; i < (int)this->fields.size(); ++i) {
+            fieldIndices.try_emplace(this->fields[i].first, i);
+        }
+    }
 
     std::string toString() const override { return "struct " + name; }
+
+    void addField(std::string fieldName, std::shared_ptr<Type> fieldType) {
+        fieldIndices.try_emplace(fieldName, (int)fields.size());
+        fields.emplace_back(std::move(fieldName), std::move(fieldType));
+    }
     
-    std::shared_ptr<Type> getMemberType(const std::string& memberName) {
-        for (const auto& f : fields) {
-            if (f.first == memberName) return f.second;
-        }
-        return nullptr;
+    std::shared_ptr<Type> getMemberType(llvm::StringRef memberName) const {
+        int index = getMemberIndex(memberName);
+        return index < 0 ? nullptr : fields[index].second;
     }
     
-    int getMemberIndex(const std::string& memberName) {
-        for (int i = 0; i < (int)fields.size(); ++i) {
-            if (fields[i].first == memberName) return i;
-        }
-        return -1;
+    int getMemberIndex(llvm::StringRef memberName) const {
+        auto it = fieldIndices.find(memberName);
+        return it == fieldIndices.end() ? -1 : it->second;
+    }
+};
+
+// A tagged union: a value is one of the variants and holds the fields of
+// that variant's payload, a struct named "Enum.Variant"
+struct EnumType : public Type {
+    std::string name;
+    std::vector<std::pair<std::string, std::shared_ptr<StructType>>> variants; // Append with addVariant()
+    llvm::StringMap<int> variantIndices; // Name -> position in `variants`, which is the tag
+
+    explicit EnumType(std::string name) : Type(TypeKind::Enum), name(std::move(name)) {}
+
+    std::string toString() const override { return "enum " + name; }
+
+    void addVariant(std::string variantName, std::shared_ptr<StructType> payload) {
+        variantIndices.try_emplace(variantName, (int)variants.size());
+        variants.emplace_back(std::move(variantName), std::move(payload));
+    }
+
+    int getVariantIndex(llvm::StringRef variantName) const {
+        auto it = variantIndices.find(variantName);
+        return it == variantIndices.end() ? -1 : it->second;
     }
 };
 
@@ -86,6 +125,22 @@ struct ArrayType : public Type {
     std::string toString() const override { return elementType->toString() + "[]"; }
 };
 
+struct DictType : public Type {
+    std::shared_ptr<Type> keyType; // int, float, bool or string
+    std::shared_ptr<Type> valueType;
+
+    DictType(std::shared_ptr<Type> keyType, std::shared_ptr<Type> valueType)
+        : Type(TypeKind::Dict), keyType(std::move(keyType)), valueType(std::move(valueType)) {}
+
+    std::string toString() const override { return "dict[" + keyType->toString() + "," + valueType->toString() + "]"; }
+};
+
+// A handle from runtime/File.h, opened by open(path)
+struct FileType : public Type {
+    FileType() : Type(TypeKind::File) {}
+    std::string toString() const override { return "file"; }
+};
+
 struct FunctionType : public Type {
     std::shared_ptr<Type> returnType;
     std::vector<std::shared_ptr<Type>> paramTypes;
@@ -96,6 +151,60 @@ struct FunctionType : public Type {
     std::string toString() const override { return "function"; }
 };
 
+// The type a numeric type name spells: int, float, i8, i16, i32, i64, u8,
+// u16, u32, u64, f32 or f64. Null for any other name.
+inline std::shared_ptr<Type> numericType(llvm::StringRef name) {
+    if (name == "int" || name == "i64") return std::make_shared<IntType>();
+    if (name == "float" || name == "f64") return std::make_shared<FloatType>();
+    if (name == "f32") return std::make_shared<FloatType>(32);
+    for (unsigned bits : {8u, 16u, 32u, 64u}) {
+        std::string width = std::to_string(bits);
+        if (name == "i" + width) return std::make_shared<IntType>(bits, true);
+        if (name == "u" + width) return std::make_shared<IntType>(bits, false);
+    }
+    return nullptr;
+}
+
+inline bool isNumeric(const Type* type) {
+    return type && (type->kind == TypeKind::Int || type->kind == TypeKind::Float);
+}
+
+// The type the operands of an arithmetic operator or comparison convert to,
+// or null when they do not mix. Each operand must convert without losing a
+// value:
+// - Ints of the same signedness give the wider one. A signed int wider than
+//   an unsigned one gives the signed one, and otherwise the signed int of
+//   twice the unsigned width (u8 and i8 give i16); u64 mixes with no signed
+//   int.
+// - Floats give the wider one. An int gives the float if the float's
+//   mantissa holds all its values: up to 16 bits for f32, 32 for float.
+inline std::shared_ptr<Type> promote(const std::shared_ptr<Type>& a, const std::shared_ptr<Type>& b) {
+    if (!isNumeric(a.get()) || !isNumeric(b.get())) return nullptr;
+    if (a->kind == TypeKind::Float && b->kind == TypeKind::Float) {
+        return static_cast<FloatType&>(*a).bits >= static_cast<FloatType&>(*b).bits ? a : b;
+    }
+    if (a->kind == TypeKind::Float || b->kind == TypeKind::Float) {
+        const auto& floating = a->kind == TypeKind::Float ? a : b;
+        unsigned intBits = static_cast<IntType&>(a->kind == TypeKind::Int ? *a : *b).bits;
+        return intBits <= (static_cast<FloatType&>(*floating).bits == 32 ? 16u : 32u) ? floating : nullptr;
+    }
+    const auto& x = static_cast<IntType&>(*a);
+    const auto& y = static_cast<IntType&>(*b);
+    if (x.isSigned == y.isSigned) return x.bits >= y.bits ? a : b;
+    const IntType& unsignedInt = x.isSigned ? y : x;
+    const IntType& signedInt = x.isSigned ? x : y;
+    if (signedInt.bits > unsignedInt.bits) return x.isSigned ? a : b;
+    if (unsignedInt.bits == 64) return nullptr;
+    return std::make_shared<IntType>(unsignedInt.bits * 2, true);
+}
+
+// Whether values of `from` convert to `to` implicitly (assignments,
+// arguments, returns): only when no value is lost, as for promote()
+inline bool widens(const std::shared_ptr<Type>& from, const std::shared_ptr<Type>& to) {
+    std::shared_ptr<Type> common = promote(from, to);
+    return common && common->toString() == to->toString();
+}
+
 } // namespace pynext
 
 #endif // PYNEXT_TYPE_H
@@ -1,32 +1,178 @@
 #include "TypeChecker.h"
+#include <llvm/ADT/STLExtras.h>
 
 namespace pynext {
 
 std::shared_ptr<Type> TypeChecker::resolveType(const std::string& name) {
-    if (name == "int") return std::make_shared<IntType>();
-    if (name == "float") return std::make_shared<FloatType>();
+    if (auto numeric = numericType(name)) return numeric;
     if (name == "bool") return std::make_shared<BoolType>();
     if (name == "string") return std::make_shared<StringType>();
     if (name == "void") return std::make_shared<VoidType>();
+    if (name == "file") return std::make_shared<FileType>();
     
-    if (structDefs.count(name)) return structDefs[name];
+    if (auto st = structDefs.lookup(name)) return st;
+    if (auto et = enumDefs.lookup(name)) return et;
     
     // Array Types (e.g., int[], Point[][])
     if (name.length() > 2 && name.substr(name.length() - 2) == "[]") {
         std::string elemName = name.substr(0, name.length() - 2);
-        return std::make_shared<ArrayType>(resolveType(elemName));
+        auto elemType = resolveType(elemName);
+        if (elemType->kind == TypeKind::Dict || elemType->kind == TypeKind::File) {
+            error() << "Arrays of " << (elemType->kind == TypeKind::Dict ? "dicts" : "files") << " are not supported\n";
+        }
+        return std::make_shared<ArrayType>(elemType);
+    }
+
+    // Dict types, as Parser::parseTypeName spells them: dict[int,Point]
+    if (name.compare(0, 5, "dict[") == 0 && name.back() == ']') {
+        std::string inner = name.substr(5, name.length() - 6);
+        size_t comma = inner.find(',');
+        auto keyType = resolveType(inner.substr(0, comma));
+        auto valueType = resolveType(comma == std::string::npos ? "" : inner.substr(comma + 1));
+        bool hashable = keyType->kind == TypeKind::Int || keyType->kind == TypeKind::Float ||
+                        keyType->kind == TypeKind::Bool || keyType->kind == TypeKind::String;
+        if (!hashable) {
+            error() << "Dict keys must be int, float, bool or string, not '" << keyType->toString() << "'\n";
+        }
+        if (valueType->kind == TypeKind::Array || valueType->kind == TypeKind::Dict ||
+            valueType->kind == TypeKind::File || valueType->kind == TypeKind::Void) {
+            error() << "Dict values cannot be of type '" << valueType->toString() << "'\n";
+        }
+        return std::make_shared<DictType>(keyType, valueType);
     }
     
     return std::make_shared<VoidType>(); // Default/Error
 }
 
+void TypeChecker::define(const std::string& name, std::shared_ptr<Type> type, bool line) {
+    Symbol& slot = symbolTable[name];
+    if (!scopeStarts.empty()) shadowed.emplace_back(name, std::move(slot));
+    slot = Symbol{std::move(type), nullptr, line};
+}
+
+void TypeChecker::enterScope() {
+    scopeStarts.push_back(shadowed.size());
+}
+
+void TypeChecker::exitScope() {
+    for (size_t i = shadowed.size(); i > scopeStarts.back(); --i) {
+        auto& [name, previous] = shadowed[i - 1];
+        if (previous.type) symbolTable[name] = std::move(previous);
+        else symbolTable.erase(name);
+    }
+    shadowed.resize(scopeStarts.back());
+    scopeStarts.pop_back();
+}
+
+// A line points into the file's read buffer, which the next line may
+// overwrite. A function given one may return it.
+bool TypeChecker::isLine(const Expr& expr) {
+    if (expr.kind == NodeKind::Variable) {
+        auto it = symbolTable.find(static_cast<const VariableExpr&>(expr).name);
+        return it != symbolTable.end() && it->second.line;
+    }
+    if (expr.kind != NodeKind::Call || !expr.type || expr.type->kind != TypeKind::String) return false;
+    const auto& call = static_cast<const CallExpr&>(expr);
+    if (!symbolTable.count(call.callee)) return false; // A builtin
+    return llvm::any_of(call.args, [this](const std::unique_ptr<Expr>& arg) { return isLine(*arg); });
+}
+
+// Reading a line, passing it to a function or using it as a dict key (which
+// copies it) is fine; keeping it anywhere that outlives the iteration is not
+void TypeChecker::rejectLine(const Expr& expr, const char* use) {
+    if (isLine(expr)) {
+        error() << "A line from lines() cannot be " << use
+                << ": it is only valid until the next line is read\n";
+    }
+}
+
+std::ostream& TypeChecker::error() {
+    errorCount++;
+    return std::cerr << "Type Error: ";
+}
+
+// Number literals, or arithmetic on number literals only; `integral` leaves
+// out float literals
+static bool isNumberLiteral(const Expr& expr, bool integral) {
+    if (expr.kind == NodeKind::Literal) {
+        const auto& literal = static_cast<const LiteralExpr&>(expr);
+        return !literal.isBool && !literal.isString && !(integral && literal.isFloat);
+    }
+    if (expr.kind != NodeKind::Binary) return false;
+    const auto& binary = static_cast<const BinaryExpr&>(expr);
+    bool arithmetic = binary.op == "+" || binary.op == "-" || binary.op == "*" || binary.op == "/";
+    return arithmetic && isNumberLiteral(*binary.left, integral) && isNumberLiteral(*binary.right, integral);
+}
+
+// Number literals take the numeric type they are used as, so `var b: u8 = 2 * 100`
+// needs no conversion. Integer literals must fit in an int target. Returns
+// false, changing nothing, for any other expression or target.
+bool TypeChecker::adaptLiteral(Expr& expr, const std::shared_ptr<Type>& target) {
+    if (!isNumeric(target.get()) || !isNumberLiteral(expr, target->kind == TypeKind::Int)) return false;
+    expr.type = target;
+    if (expr.kind == NodeKind::Binary) {
+        adaptLiteral(*static_cast<BinaryExpr&>(expr).left, target);
+        adaptLiteral(*static_cast<BinaryExpr&>(expr).right, target);
+    } else if (target->kind == TypeKind::Int) {
+        const auto& intType = static_cast<IntType&>(*target);
+        const std::string& text = static_cast<LiteralExpr&>(expr).value;
+        unsigned valueBits = intType.bits - intType.isSigned;
+        if (valueBits < 64 && std::stoull(text) >> valueBits) {
+            error() << "Literal " << text << " does not fit in '" << target->toString() << "'\n";
+        }
+    }
+    return true;
+}
+
+// Checks that `expr` converts to `target` implicitly, as values do when
+// assigned, passed or returned, after adapting literals (also the elements of
+// an array literal) to it. Only numeric conversions are checked.
+void TypeChecker::coerce(Expr& expr, const std::shared_ptr<Type>& target) {
+    if (!target || !expr.type) return;
+    if (expr.kind == NodeKind::ArrayLiteral && target->kind == TypeKind::Array) {
+        for (auto& element : static_cast<ArrayLiteralExpr&>(expr).elements) {
+            coerce(*element, static_cast<ArrayType&>(*target).elementType);
+        }
+        expr.type = target;
+        return;
+    }
+    if (adaptLiteral(expr, target)) return;
+    if (isNumeric(expr.type.get()) && isNumeric(target.get()) && !widens(expr.type, target)) {
+        std::string to = target->toString();
+        error() << "Cannot convert '" << expr.type->toString() << "' to '" << to << "' implicitly; use " << to
+                << "(...)\n";
+    }
+}
+
 void TypeChecker::check(const std::vector<std::unique_ptr<Stmt>>& stmts) {
     for (const auto& stmt : stmts) {
-        stmt->accept(*this);
+        visitStmt(*stmt);
+        if (stmt->kind == NodeKind::VarDecl) {
+            auto* decl = static_cast<VarDeclStmt*>(stmt.get());
+            symbolTable[decl->name].topLevelDecl = decl;
+        }
+    }
+}
+
+bool TypeChecker::checkEntryPoint(const std::vector<std::unique_ptr<Stmt>>& stmts) {
+    bool definesMain = llvm::any_of(stmts, [](const std::unique_ptr<Stmt>& stmt) {
+        auto* func = dynamic_cast<FunctionStmt*>(stmt.get());
+        return func && func->name == "main" && func->body;
+    });
+    if (!definesMain) return true;
+    for (const auto& stmt : stmts) {
+        if (stmt->kind != NodeKind::ExprStmt) continue;
+        Expr& expr = *static_cast<ExprStmt&>(*stmt).expr;
+        if (expr.kind == NodeKind::Call && static_cast<CallExpr&>(expr).callee == "main") {
+            error() << "Top-level call to main() (line " << stmt->line
+                    << "): main already runs after the top-level code\n";
+            return false;
+        }
     }
+    return true;
 }
 
-void TypeChecker::visit(LiteralExpr& expr) {
+Type* TypeChecker::visit(LiteralExpr& expr) {
     if (expr.isBool) {
         expr.type = std::make_shared<BoolType>();
     } else if (expr.isString) {
@@ -36,119 +182,307 @@ void TypeChecker::visit(LiteralExpr& expr) {
     } else {
         expr.type = std::make_shared<IntType>();
     }
+    return expr.type.get();
 }
 
-void TypeChecker::visit(VariableExpr& expr) {
-    if (symbolTable.count(expr.name)) {
-        expr.type = symbolTable[expr.name];
+Type* TypeChecker::visit(VariableExpr& expr) {
+    auto it = symbolTable.find(expr.name);
+    if (it != symbolTable.end()) {
+        expr.type = it->second.type;
+        // A local or parameter of the same name binds without a declaration
+        if (inFunction && it->second.topLevelDecl) it->second.topLevelDecl->global = true;
     } else {
-        std::cerr << "Type Error: Undefined variable '" << expr.name << "'\n";
+        error() << "Undefined variable '" << expr.name << "'\n";
         expr.type = std::make_shared<VoidType>();
     }
+    return expr.type.get();
 }
 
-void TypeChecker::visit(BinaryExpr& expr) {
+Type* TypeChecker::visit(BinaryExpr& expr) {
     // Assignment Logic
     if (expr.op == "=") {
         // LHS can be VariableExpr or MemberAccessExpr or IndexExpr
-        bool isValidLHS = false;
-        if (dynamic_cast<VariableExpr*>(expr.left.get())) isValidLHS = true;
-        else if (dynamic_cast<MemberAccessExpr*>(expr.left.get())) isValidLHS = true;
-        else if (dynamic_cast<IndexExpr*>(expr.left.get())) isValidLHS = true;
+        NodeKind lhs = expr.left->kind;
+        bool isValidLHS = lhs == NodeKind::Variable || lhs == NodeKind::MemberAccess || lhs == NodeKind::Index;
 
         if (!isValidLHS) {
-            std::cerr << "Type Error: Assignment to non-lvalue\n";
+            error() << "Assignment to non-lvalue\n";
             expr.type = std::make_shared<VoidType>();
         } else {
-            expr.left->accept(*this); // Resolve LHS type (and validate members)
-            expr.right->accept(*this);
-            // TODO: strictly check expr.left->type == expr.right->type
-            expr.type = expr.right->type;
+            visitExpr(*expr.left); // Resolve LHS type (and validate members)
+            visitExpr(*expr.right);
+            coerce(*expr.right, expr.left->type);
+            rejectLine(*expr.right, "assigned");
+            expr.type = isNumeric(expr.left->type.get()) ? expr.left->type : expr.right->type;
         }
-        return;
+        return expr.type.get();
     }
 
-    expr.left->accept(*this);
-    expr.right->accept(*this);
-    
-    // Simplistic rule: Int + Int = Int
-    // TODO: Add strict checking
-    if (expr.left->type->kind == TypeKind::Int && expr.right->type->kind == TypeKind::Int) {
-        expr.type = std::make_shared<IntType>();
+    visitExpr(*expr.left);
+    visitExpr(*expr.right);
+    if (expr.left->type->kind == TypeKind::Enum || expr.right->type->kind == TypeKind::Enum) {
+        error() << "Operator '" << expr.op << "' does not apply to enums; use match\n";
+    }
+    if (!adaptLiteral(*expr.right, expr.left->type)) adaptLiteral(*expr.left, expr.right->type);
+
+    // Numeric operands convert to a common type, see promote()
+    std::shared_ptr<Type> common = promote(expr.left->type, expr.right->type);
+    if (!common && isNumeric(expr.left->type.get()) && isNumeric(expr.right->type.get())) {
+        error() << "Cannot mix '" << expr.left->type->toString() << "' and '" << expr.right->type->toString()
+                << "' in '" << expr.op << "'; convert one of them\n";
+    }
+    if (expr.op == "<" || expr.op == ">" || expr.op == "==" || expr.op == "!=") {
+        expr.type = std::make_shared<BoolType>();
+    } else if (common) {
+        expr.type = common;
     } else {
         // Fallback
         expr.type = expr.left->type;
     }
+    return expr.type.get();
 }
 
-void TypeChecker::visit(CallExpr& expr) {
+Type* TypeChecker::visit(CallExpr& expr) {
+    auto it = symbolTable.find(expr.callee);
+    if (it == symbolTable.end() && expr.namesBuiltin()) {
+        return checkBuiltin(expr);
+    }
+    size_t dot = expr.callee.find('.');
+    if (it == symbolTable.end() && dot != std::string::npos) {
+        return checkVariant(expr, expr.callee.substr(0, dot), expr.callee.substr(dot + 1), &expr.args);
+    }
+
     // Check args
     for (auto& arg : expr.args) {
-        arg->accept(*this);
+        visitExpr(*arg);
     }
     
-    if (symbolTable.count(expr.callee)) {
-        auto type = symbolTable[expr.callee];
-        if (auto ft = std::dynamic_pointer_cast<FunctionType>(type)) {
-            expr.type = ft->returnType;
+    if (it != symbolTable.end()) {
+        if (it->second.type->kind == TypeKind::Function) {
+            auto& funcType = static_cast<FunctionType&>(*it->second.type);
+            if (funcType.paramTypes.size() == expr.args.size()) {
+                for (size_t i = 0; i < expr.args.size(); ++i) coerce(*expr.args[i], funcType.paramTypes[i]);
+            }
+            expr.type = funcType.returnType;
         } else {
-            std::cerr << "Type Error: '" << expr.callee << "' is not a function\n";
+            error() << "'" << expr.callee << "' is not a function\n";
             expr.type = std::make_shared<VoidType>();
         }
     } else {
-        std::cerr << "Type Error: Undefined function '" << expr.callee << "'\n";
+        error() << "Undefined function '" << expr.callee << "'\n";
+        expr.type = std::make_shared<VoidType>();
+    }
+    return expr.type.get();
+}
+
+// len(a) for arrays and dicts; contains(d, k) and remove(d, k) for dicts;
+// open(path), parse_int(s) and parse_float(s) on strings; conversions named
+// after numeric types, as in u8(x)
+Type* TypeChecker::checkBuiltin(CallExpr& expr) {
+    if (expr.callee == "sort" || expr.callee == "sort_by") return checkSort(expr);
+    if (expr.callee == "lines") {
+        checkLines(expr);
+        error() << "lines() can only be iterated over by a for loop\n";
+        expr.type = std::make_shared<VoidType>();
+        return expr.type.get();
+    }
+    for (auto& arg : expr.args) {
+        visitExpr(*arg);
+    }
+
+    if (auto target = numericType(expr.callee)) {
+        if (expr.args.size() != 1) {
+            error() << "'" << expr.callee << "' takes 1 argument\n";
+        } else if (!isNumeric(expr.args[0]->type.get()) && expr.args[0]->type->kind != TypeKind::Bool) {
+            error() << "Cannot convert '" << expr.args[0]->type->toString() << "' to '" << target->toString() << "'\n";
+        }
+        expr.type = target;
+        return expr.type.get();
+    }
+
+    if (expr.callee == "open" || expr.callee == "parse_int" || expr.callee == "parse_float") {
+        if (expr.args.size() != 1) {
+            error() << "'" << expr.callee << "' takes 1 argument\n";
+        } else if (expr.args[0]->type->kind != TypeKind::String) {
+            error() << "'" << expr.callee << "' expects a string, not '" << expr.args[0]->type->toString() << "'\n";
+        }
+        if (expr.callee == "open") expr.type = std::make_shared<FileType>();
+        else if (expr.callee == "parse_int") expr.type = std::make_shared<IntType>();
+        else expr.type = std::make_shared<FloatType>();
+        return expr.type.get();
+    }
+
+    size_t arity = expr.callee == "len" ? 1 : 2;
+    Type* object = expr.args.empty() ? nullptr : expr.args[0]->type.get();
+    if (expr.args.size() != arity) {
+        error() << "'" << expr.callee << "' takes " << arity << " argument" << (arity == 1 ? "" : "s") << "\n";
+    } else if (expr.callee == "len") {
+        if (object->kind != TypeKind::Array && object->kind != TypeKind::Dict) {
+            error() << "len() of non-array, non-dict type '" << object->toString() << "'\n";
+        }
+    } else if (object->kind != TypeKind::Dict) {
+        error() << "'" << expr.callee << "' expects a dict, not '" << object->toString() << "'\n";
+    } else {
+        const auto& keyType = static_cast<DictType*>(object)->keyType;
+        coerce(*expr.args[1], keyType);
+        if (expr.args[1]->type->kind != keyType->kind) error() << "Dict key must be " << keyType->toString() << "\n";
+    }
+
+    if (expr.callee == "len") expr.type = std::make_shared<IntType>();
+    else expr.type = std::make_shared<BoolType>();
+    return expr.type.get();
+}
+
+// lines(f), as a for loop iterator: typed as the lines, strings
+void TypeChecker::checkLines(CallExpr& expr) {
+    for (auto& arg : expr.args) {
+        visitExpr(*arg);
+    }
+    if (expr.args.size() != 1) {
+        error() << "'lines' takes 1 argument\n";
+    } else if (expr.args[0]->type->kind != TypeKind::File) {
+        error() << "'lines' expects a file, not '" << expr.args[0]->type->toString() << "'\n";
+    }
+    expr.type = std::make_shared<StringType>();
+}
+
+// sort(a) for arrays of ints, floats, bools or strings. sort_by(a, field)
+// for arrays of structs, by a field of one of those types; the field is
+// named bare and typed as the field, not looked up as a variable.
+Type* TypeChecker::checkSort(CallExpr& expr) {
+    size_t arity = expr.callee == "sort" ? 1 : 2;
+    expr.type = std::make_shared<VoidType>();
+    if (expr.args.size() != arity) {
+        error() << "'" << expr.callee << "' takes " << arity << " argument" << (arity == 1 ? "" : "s") << "\n";
+        return expr.type.get();
+    }
+    Type* object = visitExpr(*expr.args[0]);
+    if (object->kind != TypeKind::Array) {
+        error() << "'" << expr.callee << "' expects an array, not '" << object->toString() << "'\n";
+        return expr.type.get();
+    }
+    std::shared_ptr<Type> key = static_cast<ArrayType*>(object)->elementType;
+
+    if (arity == 2) {
+        Expr& field = *expr.args[1];
+        if (key->kind != TypeKind::Struct) {
+            error() << "sort_by expects an array of structs, not '" << object->toString() << "'\n";
+            return expr.type.get();
+        }
+        if (field.kind != NodeKind::Variable) {
+            error() << "sort_by expects a field name\n";
+            return expr.type.get();
+        }
+        auto& structType = static_cast<StructType&>(*key);
+        const std::string& name = static_cast<VariableExpr&>(field).name;
+        key = structType.getMemberType(name);
+        if (!key) {
+            error() << "Struct '" << structType.name << "' has no member '" << name << "'\n";
+            return expr.type.get();
+        }
+        field.type = key;
+    }
+
+    // The runtime sorts 64-bit numbers only
+    bool wide = key->toString() == "int" || key->toString() == "float";
+    if (!wide && key->kind != TypeKind::Bool && key->kind != TypeKind::String) {
+        error() << "Cannot sort by '" << key->toString() << "'\n";
+    }
+    return expr.type.get();
+}
+
+// Shape.Circle(r), or Shape.Empty when `args` is null: a value of the enum
+Type* TypeChecker::checkVariant(Expr& expr, const std::string& enumName, const std::string& variant,
+                                std::vector<std::unique_ptr<Expr>>* args) {
+    if (args) {
+        for (auto& arg : *args) visitExpr(*arg);
+    }
+    auto enumType = enumDefs.lookup(enumName);
+    if (!enumType) {
+        error() << "Undefined function '" << enumName << "." << variant << "'\n";
         expr.type = std::make_shared<VoidType>();
+        return expr.type.get();
+    }
+    expr.type = enumType;
+
+    int index = enumType->getVariantIndex(variant);
+    if (index < 0) {
+        error() << "Enum '" << enumName << "' has no variant '" << variant << "'\n";
+        return expr.type.get();
+    }
+    const auto& fields = enumType->variants[index].second->fields;
+    size_t given = args ? args->size() : 0;
+    if (given != fields.size()) {
+        error() << "'" << enumName << "." << variant << "' takes " << fields.size() << " field"
+                << (fields.size() == 1 ? "" : "s") << ", not " << given << "\n";
+    } else {
+        for (size_t i = 0; i < given; ++i) {
+            coerce(*(*args)[i], fields[i].second);
+            rejectLine(*(*args)[i], "an enum field");
+        }
     }
+    return expr.type.get();
 }
 
 void TypeChecker::visit(ReturnStmt& stmt) {
     if (stmt.value) {
-        stmt.value->accept(*this);
-        // Check match with currentFunctionReturnType
-        // ...
+        visitExpr(*stmt.value);
+        if (inFunction) coerce(*stmt.value, currentFunctionReturnType);
+        rejectLine(*stmt.value, "returned");
     }
 }
 
 void TypeChecker::visit(Block& stmt) {
     for (const auto& s : stmt.statements) {
-        s->accept(*this);
+        visitStmt(*s);
     }
 }
 
 void TypeChecker::visit(IfStmt& stmt) {
-    stmt.condition->accept(*this);
-    stmt.thenBranch->accept(*this);
-    if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+    visitExpr(*stmt.condition);
+    visit(*stmt.thenBranch);
+    if (stmt.elseBranch) visit(*stmt.elseBranch);
 }
 
 void TypeChecker::visit(WhileStmt& stmt) {
-    stmt.condition->accept(*this);
+    visitExpr(*stmt.condition);
     // TODO: Verify condition is boolean/int
-    stmt.body->accept(*this);
+    visit(*stmt.body);
 }
 
 void TypeChecker::visit(ForStmt& stmt) {
-    stmt.iterator->accept(*this);
+    // for line in lines(f), unless a function named lines hides the builtin
+    auto* call = stmt.iterator->kind == NodeKind::Call ? static_cast<CallExpr*>(stmt.iterator.get()) : nullptr;
+    if (call && call->callee == "lines" && !symbolTable.count("lines")) {
+        checkLines(*call);
+        enterScope();
+        define(stmt.variable, call->type, true);
+        visit(*stmt.body);
+        exitScope();
+        return;
+    }
+
+    Type* iteratorType = visitExpr(*stmt.iterator);
     
     // Check if iterator is Array
-    auto arrType = std::dynamic_pointer_cast<ArrayType>(stmt.iterator->type);
+    auto* arrType = iteratorType->kind == TypeKind::Array ? static_cast<ArrayType*>(iteratorType) : nullptr;
     if (!arrType) {
-        std::cerr << "Type Error: For loop iterator must be an array\n";
+        error() << "For loop iterator must be an array\n";
     }
     
-    // Scope Logic (Simple Snapshot)
-    auto oldTable = symbolTable;
+    // The loop variable and everything declared in the body go out of scope after the loop
+    enterScope();
     
     // Define variable
     if (arrType) {
-        symbolTable[stmt.variable] = arrType->elementType;
+        define(stmt.variable, arrType->elementType);
     } else {
-        symbolTable[stmt.variable] = std::make_shared<VoidType>();
+        define(stmt.variable, std::make_shared<VoidType>());
     }
     
-    stmt.body->accept(*this);
+    visit(*stmt.body);
     
-    symbolTable = oldTable;
+    exitScope();
 }
 
 void TypeChecker::visit(FunctionStmt& stmt) {
@@ -160,37 +494,34 @@ void TypeChecker::visit(FunctionStmt& stmt) {
     auto returnType = resolveType(stmt.returnType);
     
     auto funcType = std::make_shared<FunctionType>(returnType, paramTypes);
-    symbolTable[stmt.name] = funcType;
+    define(stmt.name, funcType);
     
     if (!stmt.body) return; // Extern
 
-    // 2. Enter Scope (For now, just add params to global table temporarily - BAD but simple)
-    // TODO: Implement proper Scoping
+    // 2. Parameters and locals are visible in the body only; the function
+    // itself stays defined so later code (and recursion) can call it
     currentFunctionReturnType = returnType;
-    
-    auto oldTable = symbolTable; // Snapshot (Cheap copy of map?) No, deep copy of map structure.
+    inFunction = true;
+    enterScope();
     
     for (size_t i = 0; i < stmt.params.size(); ++i) {
-        symbolTable[stmt.params[i].first] = paramTypes[i];
+        define(stmt.params[i].first, paramTypes[i]);
     }
     
-    stmt.body->accept(*this);
+    visit(*stmt.body);
     
-    // Restore Scope
-    symbolTable = oldTable;
-    // Re-add function itself (snapshot removed it if it was added this cycle?)
-    // Actually, if we added it before snapshot, it's in snapshot. 
-    // Wait, I added it to `symbolTable` before snapshot. So preserving is fine.
+    exitScope();
+    inFunction = false;
 }
 
 void TypeChecker::visit(VarDeclStmt& stmt) {
     std::shared_ptr<Type> type;
     
     if (stmt.initializer) {
-        stmt.initializer->accept(*this);
+        visitExpr(*stmt.initializer);
         if (!stmt.typeName.empty()) {
             type = resolveType(stmt.typeName);
-             // TODO: Check compatibility with stmt.initializer->type
+            coerce(*stmt.initializer, type);
         } else {
             type = stmt.initializer->type;
         }
@@ -198,96 +529,203 @@ void TypeChecker::visit(VarDeclStmt& stmt) {
         if (!stmt.typeName.empty()) {
             type = resolveType(stmt.typeName);
         } else {
-             std::cerr << "Type Error: Variable declaration missing type and initializer\n";
+             error() << "Variable declaration missing type and initializer\n";
              type = std::make_shared<VoidType>();
         }
     }
     
     stmt.type = type; // Store for CodeGen
-    symbolTable[stmt.name] = type;
+    // A local copy of a line is a line too; it goes out of scope with the loop
+    define(stmt.name, type, stmt.initializer && isLine(*stmt.initializer));
 }
 
 void TypeChecker::visit(StructDeclStmt& stmt) {
     // Two pass? 
     // First, register the name (if we allow recursive structs, we need pointer types first. we don't yet).
     // So just parse fields.
+    if (enumDefs.count(stmt.name)) {
+        error() << "'" << stmt.name << "' is already an enum\n";
+    }
     std::vector<std::pair<std::string, std::shared_ptr<Type>>> fields;
     
     for (auto& f : stmt.fields) {
         // If field type is the struct itself, this will fail/recurse poorly without pointers.
         // Assuming simple composition for now.
         fields.push_back({f.first, resolveType(f.second)});
+        TypeKind kind = fields.back().second->kind;
+        if (kind == TypeKind::Dict || kind == TypeKind::File) {
+            error() << "Struct field '" << f.first << "' cannot be a " << (kind == TypeKind::Dict ? "dict" : "file")
+                    << "\n";
+        }
     }
     
     auto st = std::make_shared<StructType>(stmt.name, fields);
     structDefs[stmt.name] = st;
 }
 
-void TypeChecker::visit(MemberAccessExpr& expr) {
-    expr.object->accept(*this);
-    auto objType = expr.object->type;
+void TypeChecker::visit(EnumDeclStmt& stmt) {
+    if (structDefs.count(stmt.name)) {
+        error() << "'" << stmt.name << "' is already a struct\n";
+    }
+    if (stmt.variants.empty()) {
+        error() << "Enum '" << stmt.name << "' has no variants\n";
+    }
+
+    auto et = std::make_shared<EnumType>(stmt.name);
+    for (auto& variant : stmt.variants) {
+        if (et->getVariantIndex(variant.name) >= 0) {
+            error() << "Enum '" << stmt.name << "' has two variants named '" << variant.name << "'\n";
+        }
+        std::vector<std::pair<std::string, std::shared_ptr<Type>>> fields;
+        for (auto& f : variant.fields) {
+            fields.push_back({f.first, resolveType(f.second)});
+            TypeKind kind = fields.back().second->kind;
+            if (kind == TypeKind::Dict || kind == TypeKind::File) {
+                error() << "Variant field '" << f.first << "' cannot be a " << (kind == TypeKind::Dict ? "dict" : "file")
+                        << "\n";
+            } else if (kind == TypeKind::Void) {
+                error() << "Unknown type '" << f.second << "' for variant field '" << f.first << "'\n";
+            }
+        }
+        et->addVariant(variant.name, std::make_shared<StructType>(stmt.name + "." + variant.name, fields));
+    }
+    enumDefs[stmt.name] = et;
+}
+
+void TypeChecker::visit(MatchStmt& stmt) {
+    Type* subjectType = visitExpr(*stmt.subject);
+    auto* enumType = subjectType->kind == TypeKind::Enum ? static_cast<EnumType*>(subjectType) : nullptr;
+    if (!enumType) {
+        error() << "match expects an enum, not '" << subjectType->toString() << "'\n";
+    }
+
+    std::vector<bool> covered(enumType ? enumType->variants.size() : 0);
+    for (auto& matchCase : stmt.cases) {
+        std::shared_ptr<StructType> payload;
+        int index = enumType ? enumType->getVariantIndex(matchCase.variant) : -1;
+        if (enumType && index < 0) {
+            error() << "Enum '" << enumType->name << "' has no variant '" << matchCase.variant << "'\n";
+        } else if (enumType) {
+            if (covered[index]) error() << "Variant '" << matchCase.variant << "' is matched twice\n";
+            covered[index] = true;
+            payload = enumType->variants[index].second;
+            size_t fields = payload->fields.size();
+            if (!matchCase.bindings.empty() && matchCase.bindings.size() != fields) {
+                error() << "Variant '" << matchCase.variant << "' has " << fields << " field"
+                        << (fields == 1 ? "" : "s") << ", not " << matchCase.bindings.size() << "\n";
+            }
+        }
+
+        // The bound fields are visible in the case only
+        enterScope();
+        for (size_t i = 0; i < matchCase.bindings.size(); ++i) {
+            if (matchCase.bindings[i] == "_") continue;
+            bool known = payload && i < payload->fields.size();
+            define(matchCase.bindings[i], known ? payload->fields[i].second : std::make_shared<VoidType>());
+        }
+        visit(*matchCase.body);
+        exitScope();
+    }
+
+    if (stmt.elseBranch) {
+        visit(*stmt.elseBranch);
+    } else if (enumType) {
+        std::string missing;
+        for (size_t i = 0; i < covered.size(); ++i) {
+            if (!covered[i]) missing += (missing.empty() ? "" : ", ") + enumType->variants[i].first;
+        }
+        if (!missing.empty()) {
+            error() << "match on '" << enumType->name << "' misses " << missing << "; add cases or an else\n";
+        }
+    }
+}
+
+Type* TypeChecker::visit(MemberAccessExpr& expr) {
+    // Shape.Empty, unless a variable is named Shape
+    if (expr.object->kind == NodeKind::Variable) {
+        const std::string& name = static_cast<VariableExpr&>(*expr.object).name;
+        if (!symbolTable.count(name) && enumDefs.count(name)) {
+            checkVariant(expr, name, expr.member, nullptr);
+            expr.object->type = expr.type;
+            return expr.type.get();
+        }
+    }
+
+    Type* objType = visitExpr(*expr.object);
     
-    auto structType = std::dynamic_pointer_cast<StructType>(objType);
-    if (!structType) {
-        std::cerr << "Type Error: Member access on non-struct\n";
+    if (objType->kind != TypeKind::Struct) {
+        error() << "Member access on non-struct\n";
         expr.type = std::make_shared<VoidType>();
-        return;
+        return expr.type.get();
     }
+    auto* structType = static_cast<StructType*>(objType);
     
     auto memberType = structType->getMemberType(expr.member);
     if (!memberType) {
-        std::cerr << "Type Error: Struct '" << structType->name << "' has no member '" << expr.member << "'\n";
+        error() << "Struct '" << structType->name << "' has no member '" << expr.member << "'\n";
         expr.type = std::make_shared<VoidType>();
     } else {
         expr.type = memberType;
     }
+    return expr.type.get();
 }
 
 void TypeChecker::visit(ExprStmt& stmt) {
-    stmt.expr->accept(*this);
+    visitExpr(*stmt.expr);
 }
 
-void TypeChecker::visit(IndexExpr& expr) {
-    expr.object->accept(*this);
-    expr.index->accept(*this);
+Type* TypeChecker::visit(IndexExpr& expr) {
+    Type* objType = visitExpr(*expr.object);
+    Type* indexType = visitExpr(*expr.index);
     
+    if (objType->kind == TypeKind::Dict) {
+        auto* dictType = static_cast<DictType*>(objType);
+        coerce(*expr.index, dictType->keyType);
+        if (expr.index->type->kind != dictType->keyType->kind) {
+            error() << "Dict key must be " << dictType->keyType->toString() << "\n";
+        }
+        expr.type = dictType->valueType;
+        return expr.type.get();
+    }
+
     // Check if object is array
-    auto arrType = std::dynamic_pointer_cast<ArrayType>(expr.object->type);
-    if (!arrType) {
-        std::cerr << "Type Error: Indexing non-array type\n";
+    if (objType->kind != TypeKind::Array) {
+        error() << "Indexing non-array type\n";
         expr.type = std::make_shared<VoidType>();
-        return;
+        return expr.type.get();
     }
     
     // Check if index is int
-    if (expr.index->type->kind != TypeKind::Int) {
-        std::cerr << "Type Error: Array index must be integer\n";
+    if (indexType->kind != TypeKind::Int) {
+        error() << "Array index must be integer\n";
     }
     
-    expr.type = arrType->elementType;
+    expr.type = static_cast<ArrayType*>(objType)->elementType;
+    return expr.type.get();
 }
 
-void TypeChecker::visit(ArrayLiteralExpr& expr) {
+Type* TypeChecker::visit(ArrayLiteralExpr& expr) {
     if (expr.elements.empty()) {
         // Empty array... type is Array<Void>? Or inferred later?
         // Let's assume Void for now or Error.
         // Actually, let's use a special "Any" or "Unknown" if we had it.
         // For now: Array<Int> default?
         expr.type = std::make_shared<ArrayType>(std::make_shared<IntType>()); 
-        return;
+        return expr.type.get();
     }
     
     // Check all elements are same type
-    expr.elements[0]->accept(*this);
+    visitExpr(*expr.elements[0]);
     auto firstType = expr.elements[0]->type;
     
     for (size_t i = 1; i < expr.elements.size(); ++i) {
-        expr.elements[i]->accept(*this);
-        // Strict equality check?
-        // TODO: implement strict type equality
+        visitExpr(*expr.elements[i]);
+        coerce(*expr.elements[i], firstType);
     }
+    for (const auto& element : expr.elements) rejectLine(*element, "an array element");
     
     expr.type = std::make_shared<ArrayType>(firstType);
+    return expr.type.get();
 }
 
 } // namespace pynext
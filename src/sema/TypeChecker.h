@@ -3,40 +3,79 @@
 
 #include "../parser/AST.h"
 #include "Type.h"
-#include <map>
+#include <llvm/ADT/StringMap.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace pynext {
 
-class TypeChecker : public ASTVisitor {
+// Expression visits store the type in Expr::type and also return it
+class TypeChecker : public StaticASTVisitor<TypeChecker, Type*> {
 public:
     void check(const std::vector<std::unique_ptr<Stmt>>& stmts);
+    // For the program being run: when it defines `main`, main runs after the
+    // top-level code, so a top-level call to it would run it twice. Returns
+    // false after reporting such a call.
+    bool checkEntryPoint(const std::vector<std::unique_ptr<Stmt>>& stmts);
+    // Type errors reported so far, over every call to check()
+    size_t getErrorCount() const { return errorCount; }
 
     // Visitor
-    void visit(LiteralExpr& expr) override;
-    void visit(VariableExpr& expr) override;
-    void visit(BinaryExpr& expr) override;
-    void visit(CallExpr& expr) override;
-    void visit(ReturnStmt& stmt) override;
-    void visit(Block& stmt) override;
-    void visit(IfStmt& stmt) override;
-    void visit(WhileStmt& stmt) override;
-    void visit(ForStmt& stmt) override;
-    void visit(FunctionStmt& stmt) override;
-    void visit(VarDeclStmt& stmt) override;
-    void visit(StructDeclStmt& stmt) override;
-    void visit(ExprStmt& stmt) override;
-    void visit(MemberAccessExpr& expr) override;
-    void visit(IndexExpr& expr) override;
-    void visit(ArrayLiteralExpr& expr) override;
+    Type* visit(LiteralExpr& expr);
+    Type* visit(VariableExpr& expr);
+    Type* visit(BinaryExpr& expr);
+    Type* visit(CallExpr& expr);
+    Type* visit(MemberAccessExpr& expr);
+    Type* visit(IndexExpr& expr);
+    Type* visit(ArrayLiteralExpr& expr);
+    void visit(ReturnStmt& stmt);
+    void visit(Block& stmt);
+    void visit(IfStmt& stmt);
+    void visit(WhileStmt& stmt);
+    void visit(ForStmt& stmt);
+    void visit(FunctionStmt& stmt);
+    void visit(VarDeclStmt& stmt);
+    void visit(StructDeclStmt& stmt);
+    void visit(EnumDeclStmt& stmt);
+    void visit(MatchStmt& stmt);
+    void visit(ExprStmt& stmt);
 
 private:
-    std::map<std::string, std::shared_ptr<Type>> symbolTable;
+    struct Symbol {
+        std::shared_ptr<Type> type;
+        // The top-level declaration this name is bound to, if any; a use
+        // inside a function marks it VarDeclStmt::global
+        VarDeclStmt* topLevelDecl = nullptr;
+        // A line from lines(), or a local initialized from one: valid only
+        // until the loop reads the next line
+        bool line = false;
+    };
+    llvm::StringMap<Symbol> symbolTable;
+    // Bindings made inside the open scopes, with what each name was bound to
+    // before (null type if unbound); exitScope() undoes them in reverse
+    std::vector<std::pair<std::string, Symbol>> shadowed;
+    std::vector<size_t> scopeStarts; // Into `shadowed`, one per open scope
     std::shared_ptr<Type> currentFunctionReturnType;
-    std::map<std::string, std::shared_ptr<StructType>> structDefs;
+    bool inFunction = false;
+    llvm::StringMap<std::shared_ptr<StructType>> structDefs;
+    llvm::StringMap<std::shared_ptr<EnumType>> enumDefs;
+    size_t errorCount = 0;
     
+    void define(const std::string& name, std::shared_ptr<Type> type, bool line = false);
+    void enterScope();
+    void exitScope();
     std::shared_ptr<Type> resolveType(const std::string& name);
+    Type* checkBuiltin(CallExpr& expr);
+    void checkLines(CallExpr& expr);
+    Type* checkSort(CallExpr& expr);
+    Type* checkVariant(Expr& expr, const std::string& enumName, const std::string& variant,
+                       std::vector<std::unique_ptr<Expr>>* args);
+    bool adaptLiteral(Expr& expr, const std::shared_ptr<Type>& target);
+    void coerce(Expr& expr, const std::shared_ptr<Type>& target);
+    bool isLine(const Expr& expr);
+    void rejectLine(const Expr& expr, const char* use);
+    std::ostream& error();
 };
 
 } // namespace pynext
@@ -0,0 +1,911 @@
+#include "ModuleFile.h"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <unistd.h>
+
+namespace pynext {
+
+namespace {
+
+using llvm::support::ulittle16_t;
+using llvm::support::ulittle32_t;
+using llvm::support::ulittle64_t;
+
+constexpr char kMagic[8] = {'P', 'Y', 'N', 'X', 'A', 'S', 'T', '\n'};
+constexpr uint32_t kVersion = 4; // 2: VarDecl flags; 3: numeric type names; 4: enums and match
+constexpr uint32_t kNone = ~0u; // Absent child or type
+
+// Node kinds as stored; the numbering is part of the format, independent of
+// the NodeKind of AST.h
+enum class RecordKind : uint8_t {
+    // Expressions
+    Literal, Variable, Binary, Call, MemberAccess, Index, ArrayLiteral,
+    // Statements
+    Return, Block, If, While, For, Function, VarDecl, StructDecl, ExprStmt, EnumDecl, Match,
+    // Parts of an enum declaration and of a match
+    Variant, Case,
+    Count
+};
+
+enum LiteralFlags : uint8_t { FloatLiteral = 1, BoolLiteral = 2, StringLiteral = 4 };
+enum VarDeclFlags : uint8_t { GlobalVariable = 1 };
+
+// Strings are interned: string i spans [offsets[i], offsets[i + 1]) of the
+// string bytes
+using StringId = ulittle32_t;
+
+// What the a, b and c fields of a node hold, by kind
+enum class Slot : uint8_t { None, Expr, OptExpr, Block, OptBlock };
+// a = first, b = count; a Match lists its subject, then its Case records
+enum class List : uint8_t { None, Exprs, Stmts, Members, Variants, Match };
+
+struct Shape {
+    Slot a, b, c;
+    List list;
+};
+
+constexpr Shape kShapes[] = {
+    /* Literal      */ {Slot::None, Slot::None, Slot::None, List::None},
+    /* Variable     */ {Slot::None, Slot::None, Slot::None, List::None},
+    /* Binary       */ {Slot::Expr, Slot::Expr, Slot::None, List::None},
+    /* Call         */ {Slot::None, Slot::None, Slot::None, List::Exprs},
+    /* MemberAccess */ {Slot::Expr, Slot::None, Slot::None, List::None},
+    /* Index        */ {Slot::Expr, Slot::Expr, Slot::None, List::None},
+    /* ArrayLiteral */ {Slot::None, Slot::None, Slot::None, List::Exprs},
+    /* Return       */ {Slot::OptExpr, Slot::None, Slot::None, List::None},
+    /* Block        */ {Slot::None, Slot::None, Slot::None, List::Stmts},
+    /* If           */ {Slot::Expr, Slot::Block, Slot::OptBlock, List::None},
+    /* While        */ {Slot::Expr, Slot::Block, Slot::None, List::None},
+    /* For          */ {Slot::Expr, Slot::Block, Slot::None, List::None},
+    /* Function     */ {Slot::None, Slot::None, Slot::OptBlock, List::Members},
+    /* VarDecl      */ {Slot::OptExpr, Slot::None, Slot::None, List::None},
+    /* StructDecl   */ {Slot::None, Slot::None, Slot::None, List::Members},
+    /* ExprStmt     */ {Slot::Expr, Slot::None, Slot::None, List::None},
+    /* EnumDecl     */ {Slot::None, Slot::None, Slot::None, List::Variants},
+    /* Match        */ {Slot::None, Slot::None, Slot::OptBlock, List::Match},
+    /* Variant      */ {Slot::None, Slot::None, Slot::None, List::Members},
+    /* Case         */ {Slot::None, Slot::None, Slot::Block, List::Members}, // Bindings have no type name
+};
+static_assert(sizeof(kShapes) / sizeof(kShapes[0]) == size_t(RecordKind::Count), "one shape per node kind");
+
+// Children always precede their parent, so a valid image has no cycles
+struct NodeRecord {
+    uint8_t kind;
+    uint8_t flags; // LiteralFlags or VarDeclFlags
+    ulittle16_t column; // Saturates at 65535
+    ulittle32_t line;
+    ulittle32_t type; // Sema type of expressions and variable declarations
+    StringId name;    // Literal value, operator, callee, member, loop variable, declared name or variant
+    StringId text;    // Declared type of a variable, return type of a function
+    ulittle32_t a, b, c;
+};
+static_assert(sizeof(NodeRecord) == 32, "NodeRecord is part of the file format");
+
+// Struct fields and function parameters of types (name, type index) and of
+// declarations (name, type name)
+struct MemberRecord {
+    StringId name;
+    StringId typeName;
+    ulittle32_t type;
+};
+static_assert(sizeof(MemberRecord) == 12, "MemberRecord is part of the file format");
+
+// Struct types may refer to any type, including themselves; every other
+// type only refers to types with a lower index, except that an enum's
+// variants are the struct types of their payloads
+struct TypeRecord {
+    ulittle32_t kind;    // TypeKind
+    StringId name;       // Struct or enum name, or the name of an int or float type
+    ulittle32_t element; // Array element or function return type
+    ulittle32_t first;   // Struct fields, enum variants or function parameters in the member table
+    ulittle32_t count;
+};
+static_assert(sizeof(TypeRecord) == 20, "TypeRecord is part of the file format");
+
+struct Section {
+    ulittle32_t offset; // From the start of the file
+    ulittle32_t count;  // Records, or bytes for the string table
+};
+
+struct FileHeader {
+    char magic[8];
+    ulittle32_t version;
+    ulittle32_t rootFirst; // Top-level statements in the list table
+    ulittle32_t rootCount;
+    ulittle32_t reserved;
+    ulittle64_t sourceSize;
+    uint8_t sourceHash[16]; // MD5 of the source text
+    ulittle64_t checksum;   // xxHash64 of everything after the header
+    Section nodes, types, members, lists, stringOffsets, strings;
+};
+static_assert(sizeof(FileHeader) == 104, "FileHeader is part of the file format");
+
+void hashSource(llvm::StringRef source, uint8_t (&out)[16]) {
+    llvm::MD5 hash;
+    hash.update(source);
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    for (int i = 0; i < 16; ++i) out[i] = result[i];
+}
+
+class Writer : public ASTVisitor {
+public:
+    std::vector<NodeRecord> nodes;
+    std::vector<TypeRecord> types;
+    std::vector<MemberRecord> members;
+    std::vector<ulittle32_t> lists;
+    std::vector<ulittle32_t> stringOffsets{ulittle32_t(0)};
+    std::string strings;
+
+    Writer() { string(""); } // Id 0, the value of every unset string field
+
+    uint32_t write(ASTNode& node) {
+        node.accept(*this);
+        return result;
+    }
+
+    uint32_t writeList(const std::vector<uint32_t>& children) {
+        uint32_t first = lists.size();
+        for (uint32_t child : children) lists.push_back(ulittle32_t(child));
+        return first;
+    }
+
+    void visit(LiteralExpr& expr) override {
+        NodeRecord record = make(RecordKind::Literal, expr);
+        record.name = string(expr.value);
+        record.flags = (expr.isFloat ? FloatLiteral : 0) | (expr.isBool ? BoolLiteral : 0) |
+                       (expr.isString ? StringLiteral : 0);
+        finish(record);
+    }
+    void visit(VariableExpr& expr) override {
+        NodeRecord record = make(RecordKind::Variable, expr);
+        record.name = string(expr.name);
+        finish(record);
+    }
+    void visit(BinaryExpr& expr) override {
+        uint32_t left = write(*expr.left);
+        uint32_t right = write(*expr.right);
+        NodeRecord record = make(RecordKind::Binary, expr);
+        record.name = string(expr.op);
+        record.a = left;
+        record.b = right;
+        finish(record);
+    }
+    void visit(CallExpr& expr) override {
+        std::vector<uint32_t> args;
+        for (auto& arg : expr.args) args.push_back(write(*arg));
+        NodeRecord record = make(RecordKind::Call, expr);
+        record.name = string(expr.callee);
+        record.a = writeList(args);
+        record.b = args.size();
+        finish(record);
+    }
+    void visit(MemberAccessExpr& expr) override {
+        uint32_t object = write(*expr.object);
+        NodeRecord record = make(RecordKind::MemberAccess, expr);
+        record.name = string(expr.member);
+        record.a = object;
+        finish(record);
+    }
+    void visit(IndexExpr& expr) override {
+        uint32_t object = write(*expr.object);
+        uint32_t index = write(*expr.index);
+        NodeRecord record = make(RecordKind::Index, expr);
+        record.a = object;
+        record.b = index;
+        finish(record);
+    }
+    void visit(ArrayLiteralExpr& expr) override {
+        std::vector<uint32_t> elements;
+        for (auto& element : expr.elements) elements.push_back(write(*element));
+        NodeRecord record = make(RecordKind::ArrayLiteral, expr);
+        record.a = writeList(elements);
+        record.b = elements.size();
+        finish(record);
+    }
+    void visit(ReturnStmt& stmt) override {
+        uint32_t value = stmt.value ? write(*stmt.value) : kNone;
+        NodeRecord record = make(RecordKind::Return, stmt);
+        record.a = value;
+        finish(record);
+    }
+    void visit(Block& stmt) override {
+        std::vector<uint32_t> statements;
+        for (auto& s : stmt.statements) statements.push_back(write(*s));
+        NodeRecord record = make(RecordKind::Block, stmt);
+        record.a = writeList(statements);
+        record.b = statements.size();
+        finish(record);
+    }
+    void visit(IfStmt& stmt) override {
+        uint32_t condition = write(*stmt.condition);
+        uint32_t thenBranch = write(*stmt.thenBranch);
+        uint32_t elseBranch = stmt.elseBranch ? write(*stmt.elseBranch) : kNone;
+        NodeRecord record = make(RecordKind::If, stmt);
+        record.a = condition;
+        record.b = thenBranch;
+        record.c = elseBranch;
+        finish(record);
+    }
+    void visit(WhileStmt& stmt) override {
+        uint32_t condition = write(*stmt.condition);
+        uint32_t body = write(*stmt.body);
+        NodeRecord record = make(RecordKind::While, stmt);
+        record.a = condition;
+        record.b = body;
+        finish(record);
+    }
+    void visit(ForStmt& stmt) override {
+        uint32_t iterator = write(*stmt.iterator);
+        uint32_t body = write(*stmt.body);
+        NodeRecord record = make(RecordKind::For, stmt);
+        record.name = string(stmt.variable);
+        record.a = iterator;
+        record.b = body;
+        finish(record);
+    }
+    void visit(FunctionStmt& stmt) override {
+        uint32_t body = stmt.body ? write(*stmt.body) : kNone;
+        NodeRecord record = make(RecordKind::Function, stmt);
+        record.name = string(stmt.name);
+        record.text = string(stmt.returnType);
+        record.a = writeMembers(stmt.params);
+        record.b = stmt.params.size();
+        record.c = body;
+        finish(record);
+    }
+    void visit(VarDeclStmt& stmt) override {
+        uint32_t initializer = stmt.initializer ? write(*stmt.initializer) : kNone;
+        NodeRecord record = make(RecordKind::VarDecl, stmt);
+        record.name = string(stmt.name);
+        record.text = string(stmt.typeName);
+        record.type = type(stmt.type);
+        record.flags = stmt.global ? GlobalVariable : 0;
+        record.a = initializer;
+        finish(record);
+    }
+    void visit(StructDeclStmt& stmt) override {
+        NodeRecord record = make(RecordKind::StructDecl, stmt);
+        record.name = string(stmt.name);
+        record.a = writeMembers(stmt.fields);
+        record.b = stmt.fields.size();
+        finish(record);
+    }
+    void visit(ExprStmt& stmt) override {
+        uint32_t expr = write(*stmt.expr);
+        NodeRecord record = make(RecordKind::ExprStmt, stmt);
+        record.a = expr;
+        finish(record);
+    }
+    void visit(EnumDeclStmt& stmt) override {
+        std::vector<uint32_t> variants;
+        for (const auto& variant : stmt.variants) {
+            NodeRecord record = make(RecordKind::Variant, stmt);
+            record.name = string(variant.name);
+            record.a = writeMembers(variant.fields);
+            record.b = variant.fields.size();
+            finish(record);
+            variants.push_back(result);
+        }
+        NodeRecord record = make(RecordKind::EnumDecl, stmt);
+        record.name = string(stmt.name);
+        record.a = writeList(variants);
+        record.b = variants.size();
+        finish(record);
+    }
+    void visit(MatchStmt& stmt) override {
+        std::vector<uint32_t> parts{write(*stmt.subject)};
+        for (auto& matchCase : stmt.cases) {
+            uint32_t body = write(*matchCase.body);
+            std::vector<std::pair<std::string, std::string>> bindings;
+            for (const auto& name : matchCase.bindings) bindings.emplace_back(name, "");
+            NodeRecord record = make(RecordKind::Case, *matchCase.body);
+            record.name = string(matchCase.variant);
+            record.a = writeMembers(bindings);
+            record.b = bindings.size();
+            record.c = body;
+            finish(record);
+            parts.push_back(result);
+        }
+        uint32_t elseBranch = stmt.elseBranch ? write(*stmt.elseBranch) : kNone;
+        NodeRecord record = make(RecordKind::Match, stmt);
+        record.a = writeList(parts);
+        record.b = parts.size();
+        record.c = elseBranch;
+        finish(record);
+    }
+
+private:
+    uint32_t result = kNone;
+    llvm::StringMap<uint32_t> stringIds;
+    std::map<std::string, uint32_t> typeIndex; // Canonical spelling -> index
+
+    StringId string(llvm::StringRef text) {
+        auto [it, inserted] = stringIds.try_emplace(text, stringOffsets.size() - 1);
+        if (inserted) {
+            strings.append(text.data(), text.size());
+            stringOffsets.push_back(ulittle32_t(strings.size()));
+        }
+        return StringId(it->second);
+    }
+
+    uint32_t type(const std::shared_ptr<Type>& t) {
+        if (!t) return kNone;
+        std::string key;
+        std::vector<MemberRecord> fields;
+        TypeRecord record = {};
+        record.kind = uint32_t(t->kind);
+        record.element = kNone;
+
+        if (auto st = std::dynamic_pointer_cast<StructType>(t)) {
+            key = "S" + st->name;
+            if (auto it = typeIndex.find(key); it != typeIndex.end()) return it->second;
+            // Registered before its fields, which may refer back to it
+            uint32_t index = types.size();
+            typeIndex[key] = index;
+            types.push_back(record);
+            for (const auto& [name, fieldType] : st->fields) {
+                MemberRecord member = {};
+                member.name = string(name);
+                member.type = type(fieldType);
+                fields.push_back(member);
+            }
+            TypeRecord& placed = types[index];
+            placed.name = string(st->name);
+            placed.first = members.size();
+            placed.count = fields.size();
+            members.insert(members.end(), fields.begin(), fields.end());
+            return index;
+        }
+        if (auto et = std::dynamic_pointer_cast<EnumType>(t)) {
+            key = "E" + et->name;
+            if (auto it = typeIndex.find(key); it != typeIndex.end()) return it->second;
+            // Registered before its payloads, whose fields may refer back to it
+            uint32_t index = types.size();
+            typeIndex[key] = index;
+            types.push_back(record);
+            for (const auto& [name, payload] : et->variants) {
+                MemberRecord member = {};
+                member.name = string(name);
+                member.type = type(payload);
+                fields.push_back(member);
+            }
+            TypeRecord& placed = types[index];
+            placed.name = string(et->name);
+            placed.first = members.size();
+            placed.count = fields.size();
+            members.insert(members.end(), fields.begin(), fields.end());
+            return index;
+        }
+
+        if (auto at = std::dynamic_pointer_cast<ArrayType>(t)) {
+            record.element = type(at->elementType);
+            key = "A" + std::to_string(record.element);
+        } else if (auto ft = std::dynamic_pointer_cast<FunctionType>(t)) {
+            record.element = type(ft->returnType);
+            key = "F" + std::to_string(record.element);
+            for (const auto& param : ft->paramTypes) {
+                MemberRecord member = {};
+                member.type = type(param);
+                fields.push_back(member);
+                key += "," + std::to_string(member.type);
+            }
+        } else if (auto dt = std::dynamic_pointer_cast<DictType>(t)) {
+            // The key type is the one member
+            record.element = type(dt->valueType);
+            MemberRecord member = {};
+            member.type = type(dt->keyType);
+            fields.push_back(member);
+            key = "D" + std::to_string(member.type) + "," + std::to_string(record.element);
+        } else if (isNumeric(t.get())) {
+            record.name = string(t->toString());
+            key = "P" + t->toString();
+        } else {
+            key = "P" + std::to_string(record.kind);
+        }
+
+        if (auto it = typeIndex.find(key); it != typeIndex.end()) return it->second;
+        record.first = members.size();
+        record.count = fields.size();
+        members.insert(members.end(), fields.begin(), fields.end());
+        typeIndex[key] = types.size();
+        types.push_back(record);
+        return types.size() - 1;
+    }
+
+    uint32_t writeMembers(const std::vector<std::pair<std::string, std::string>>& list) {
+        uint32_t first = members.size();
+        for (const auto& [name, typeName] : list) {
+            MemberRecord member = {};
+            member.name = string(name);
+            member.typeName = string(typeName);
+            member.type = kNone;
+            members.push_back(member);
+        }
+        return first;
+    }
+
+    NodeRecord make(RecordKind kind, Stmt& stmt) {
+        NodeRecord record = {};
+        record.kind = uint8_t(kind);
+        record.line = stmt.line;
+        record.column = std::min(stmt.column, 0xffff);
+        record.type = kNone;
+        record.a = kNone;
+        record.b = kNone;
+        record.c = kNone;
+        return record;
+    }
+
+    NodeRecord make(RecordKind kind, Expr& expr) {
+        NodeRecord record = {};
+        record.kind = uint8_t(kind);
+        record.line = expr.line;
+        record.column = std::min(expr.column, 0xffff);
+        record.type = type(expr.type);
+        record.a = kNone;
+        record.b = kNone;
+        record.c = kNone;
+        return record;
+    }
+
+    void finish(const NodeRecord& record) {
+        result = nodes.size();
+        nodes.push_back(record);
+    }
+};
+
+// Typed views of the sections of a mapped image
+struct Image {
+    const char* base;
+    const FileHeader* header;
+    const NodeRecord* nodes;
+    const TypeRecord* types;
+    const MemberRecord* members;
+    const ulittle32_t* lists;
+    const ulittle32_t* stringOffsets;
+    const char* strings;
+
+    explicit Image(llvm::StringRef data)
+        : base(data.data()),
+          header(reinterpret_cast<const FileHeader*>(base)),
+          nodes(reinterpret_cast<const NodeRecord*>(base + header->nodes.offset)),
+          types(reinterpret_cast<const TypeRecord*>(base + header->types.offset)),
+          members(reinterpret_cast<const MemberRecord*>(base + header->members.offset)),
+          lists(reinterpret_cast<const ulittle32_t*>(base + header->lists.offset)),
+          stringOffsets(reinterpret_cast<const ulittle32_t*>(base + header->stringOffsets.offset)),
+          strings(base + header->strings.offset) {}
+
+    llvm::StringRef string(uint32_t id) const {
+        return llvm::StringRef(strings + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+    }
+};
+
+// Checks every index and range once when the file is opened, so readers
+// can follow them without bounds checks
+bool verify(const Image& image, size_t fileSize, std::string& error) {
+    const FileHeader& h = *image.header;
+    auto sectionFits = [&](const Section& section, size_t recordSize) {
+        return section.offset <= fileSize && uint64_t(section.count) * recordSize <= fileSize - section.offset;
+    };
+    if (!sectionFits(h.nodes, sizeof(NodeRecord)) || !sectionFits(h.types, sizeof(TypeRecord)) ||
+        !sectionFits(h.members, sizeof(MemberRecord)) || !sectionFits(h.lists, sizeof(ulittle32_t)) ||
+        !sectionFits(h.stringOffsets, sizeof(ulittle32_t)) || !sectionFits(h.strings, 1) ||
+        h.stringOffsets.count == 0) {
+        error = "section out of bounds";
+        return false;
+    }
+
+    // Offsets must ascend within the string bytes
+    for (uint32_t i = 0; i < h.stringOffsets.count; ++i) {
+        uint32_t offset = image.stringOffsets[i];
+        if (offset > h.strings.count || (i > 0 && offset < image.stringOffsets[i - 1])) {
+            error = "bad string table";
+            return false;
+        }
+    }
+    auto stringFits = [&](uint32_t id) { return id < h.stringOffsets.count - 1; };
+    auto rangeFits = [](uint32_t first, uint32_t count, uint32_t size) {
+        return first <= size && count <= size - first;
+    };
+
+    for (uint32_t i = 0; i < h.members.count; ++i) {
+        const MemberRecord& m = image.members[i];
+        if (!stringFits(m.name) || !stringFits(m.typeName) || (m.type != kNone && m.type >= h.types.count)) {
+            error = "bad member record";
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < h.types.count; ++i) {
+        const TypeRecord& t = image.types[i];
+        bool ok = t.kind <= uint32_t(TypeKind::Enum) && stringFits(t.name) &&
+                  rangeFits(t.first, t.count, h.members.count);
+        if (t.kind == uint32_t(TypeKind::Array) || t.kind == uint32_t(TypeKind::Function) ||
+            t.kind == uint32_t(TypeKind::Dict)) {
+            ok = ok && t.element < i;
+        }
+        if (t.kind == uint32_t(TypeKind::Dict)) ok = ok && t.count == 1;
+        if (ok && (t.kind == uint32_t(TypeKind::Int) || t.kind == uint32_t(TypeKind::Float))) {
+            auto numeric = numericType(image.string(t.name));
+            ok = numeric && uint32_t(numeric->kind) == t.kind;
+        }
+        if (ok && (t.kind == uint32_t(TypeKind::Function) || t.kind == uint32_t(TypeKind::Dict))) {
+            for (uint32_t p = 0; p < t.count; ++p) ok = ok && image.members[t.first + p].type < i;
+        }
+        if (ok && t.kind == uint32_t(TypeKind::Enum)) {
+            for (uint32_t v = 0; v < t.count; ++v) {
+                uint32_t payload = image.members[t.first + v].type;
+                ok = ok && payload < h.types.count && image.types[payload].kind == uint32_t(TypeKind::Struct);
+            }
+        }
+        if (!ok) {
+            error = "bad type record " + std::to_string(i);
+            return false;
+        }
+    }
+
+    auto isExpr = [&](uint32_t node) { return image.nodes[node].kind <= uint8_t(RecordKind::ArrayLiteral); };
+    auto isPart = [&](uint32_t node, RecordKind kind) { return image.nodes[node].kind == uint8_t(kind); };
+    auto isStmt = [&](uint32_t node) {
+        return !isExpr(node) && !isPart(node, RecordKind::Variant) && !isPart(node, RecordKind::Case);
+    };
+    auto isBlock = [&](uint32_t node) { return image.nodes[node].kind == uint8_t(RecordKind::Block); };
+    auto slotOk = [&](Slot slot, uint32_t child, uint32_t parent) {
+        switch (slot) {
+            case Slot::None: return true;
+            case Slot::OptExpr: if (child == kNone) return true; [[fallthrough]];
+            case Slot::Expr: return child < parent && isExpr(child);
+            case Slot::OptBlock: if (child == kNone) return true; [[fallthrough]];
+            case Slot::Block: return child < parent && isBlock(child);
+        }
+        return false;
+    };
+
+    for (uint32_t i = 0; i < h.nodes.count; ++i) {
+        const NodeRecord& n = image.nodes[i];
+        bool ok = n.kind < uint8_t(RecordKind::Count) && stringFits(n.name) && stringFits(n.text) &&
+                  (n.type == kNone || n.type < h.types.count);
+        if (ok) {
+            const Shape& shape = kShapes[n.kind];
+            ok = slotOk(shape.a, n.a, i) && slotOk(shape.b, n.b, i) && slotOk(shape.c, n.c, i);
+            if (shape.list == List::Members) {
+                ok = ok && rangeFits(n.a, n.b, h.members.count);
+            } else if (shape.list != List::None) {
+                ok = ok && rangeFits(n.a, n.b, h.lists.count) && (shape.list != List::Match || n.b > 0);
+                for (uint32_t k = 0; ok && k < n.b; ++k) {
+                    uint32_t child = image.lists[n.a + k];
+                    switch (shape.list) {
+                        case List::Exprs: ok = child < i && isExpr(child); break;
+                        case List::Variants: ok = child < i && isPart(child, RecordKind::Variant); break;
+                        case List::Match:
+                            ok = child < i && (k == 0 ? isExpr(child) : isPart(child, RecordKind::Case));
+                            break;
+                        default: ok = child < i && isStmt(child); break;
+                    }
+                }
+            }
+        }
+        if (!ok) {
+            error = "bad node record " + std::to_string(i);
+            return false;
+        }
+    }
+
+    bool ok = rangeFits(h.rootFirst, h.rootCount, h.lists.count);
+    for (uint32_t k = 0; ok && k < h.rootCount; ++k) {
+        uint32_t root = image.lists[h.rootFirst + k];
+        ok = root < h.nodes.count && isStmt(root);
+    }
+    if (!ok) error = "bad top-level statement list";
+    return ok;
+}
+
+class Reader {
+public:
+    explicit Reader(const Image& image) : image(image) {
+        // Structs and enums are created first and get their fields and
+        // variants last, since fields may refer to any type
+        const FileHeader& h = *image.header;
+        types.resize(h.types.count);
+        for (uint32_t i = 0; i < h.types.count; ++i) {
+            const TypeRecord& t = image.types[i];
+            if (t.kind == uint32_t(TypeKind::Struct)) {
+                types[i] = std::make_shared<StructType>(image.string(t.name).str(),
+                                                        std::vector<std::pair<std::string, std::shared_ptr<Type>>>());
+            } else if (t.kind == uint32_t(TypeKind::Enum)) {
+                types[i] = std::make_shared<EnumType>(image.string(t.name).str());
+            }
+        }
+        for (uint32_t i = 0; i < h.types.count; ++i) {
+            const TypeRecord& t = image.types[i];
+            switch (TypeKind(uint32_t(t.kind))) {
+                case TypeKind::Struct:
+                case TypeKind::Enum: break;
+                case TypeKind::Int:
+                case TypeKind::Float: types[i] = numericType(image.string(t.name)); break;
+                case TypeKind::Bool: types[i] = std::make_shared<BoolType>(); break;
+                case TypeKind::String: types[i] = std::make_shared<StringType>(); break;
+                case TypeKind::File: types[i] = std::make_shared<FileType>(); break;
+                case TypeKind::Array: types[i] = std::make_shared<ArrayType>(types[t.element]); break;
+                case TypeKind::Dict:
+                    types[i] = std::make_shared<DictType>(types[image.members[t.first].type], types[t.element]);
+                    break;
+                case TypeKind::Function: {
+                    std::vector<std::shared_ptr<Type>> params;
+                    for (uint32_t p = 0; p < t.count; ++p) params.push_back(types[image.members[t.first + p].type]);
+                    types[i] = std::make_shared<FunctionType>(types[t.element], std::move(params));
+                    break;
+                }
+                default: types[i] = std::make_shared<VoidType>(); break;
+            }
+        }
+        for (uint32_t i = 0; i < h.types.count; ++i) {
+            const TypeRecord& t = image.types[i];
+            if (t.kind == uint32_t(TypeKind::Struct)) {
+                auto st = std::static_pointer_cast<StructType>(types[i]);
+                for (uint32_t f = 0; f < t.count; ++f) {
+                    const MemberRecord& m = image.members[t.first + f];
+                    st->addField(image.string(m.name).str(), type(m.type));
+                }
+            } else if (t.kind == uint32_t(TypeKind::Enum)) {
+                auto et = std::static_pointer_cast<EnumType>(types[i]);
+                for (uint32_t v = 0; v < t.count; ++v) {
+                    const MemberRecord& m = image.members[t.first + v];
+                    et->addVariant(image.string(m.name).str(), std::static_pointer_cast<StructType>(types[m.type]));
+                }
+            }
+        }
+    }
+
+    std::unique_ptr<Expr> expr(uint32_t index) {
+        if (index == kNone) return nullptr;
+        const NodeRecord& n = image.nodes[index];
+        std::unique_ptr<Expr> result;
+        switch (RecordKind(n.kind)) {
+            case RecordKind::Literal:
+                result = std::make_unique<LiteralExpr>(str(n.name), n.flags & FloatLiteral, n.flags & BoolLiteral,
+                                                       n.flags & StringLiteral);
+                break;
+            case RecordKind::Variable: result = std::make_unique<VariableExpr>(str(n.name)); break;
+            case RecordKind::Binary: result = std::make_unique<BinaryExpr>(str(n.name), expr(n.a), expr(n.b)); break;
+            case RecordKind::Call: result = std::make_unique<CallExpr>(str(n.name), exprs(n.a, n.b)); break;
+            case RecordKind::MemberAccess: result = std::make_unique<MemberAccessExpr>(expr(n.a), str(n.name)); break;
+            case RecordKind::Index: result = std::make_unique<IndexExpr>(expr(n.a), expr(n.b)); break;
+            default: result = std::make_unique<ArrayLiteralExpr>(exprs(n.a, n.b)); break;
+        }
+        result->type = type(n.type);
+        place(*result, n);
+        return result;
+    }
+
+    std::unique_ptr<Block> block(uint32_t index) {
+        if (index == kNone) return nullptr;
+        const NodeRecord& n = image.nodes[index];
+        auto result = std::make_unique<Block>();
+        result->statements = stmts(n.a, n.b);
+        place(*result, n);
+        return result;
+    }
+
+    std::unique_ptr<Stmt> stmt(uint32_t index) {
+        const NodeRecord& n = image.nodes[index];
+        std::unique_ptr<Stmt> result;
+        switch (RecordKind(n.kind)) {
+            case RecordKind::Return: result = std::make_unique<ReturnStmt>(expr(n.a)); break;
+            case RecordKind::Block: return block(index);
+            case RecordKind::If: result = std::make_unique<IfStmt>(expr(n.a), block(n.b), block(n.c)); break;
+            case RecordKind::While: result = std::make_unique<WhileStmt>(expr(n.a), block(n.b)); break;
+            case RecordKind::For: result = std::make_unique<ForStmt>(str(n.name), expr(n.a), block(n.b)); break;
+            case RecordKind::Function:
+                result = std::make_unique<FunctionStmt>(str(n.name), namePairs(n.a, n.b), str(n.text), block(n.c));
+                break;
+            case RecordKind::VarDecl: {
+                auto decl = std::make_unique<VarDeclStmt>(str(n.name), str(n.text), expr(n.a));
+                decl->type = type(n.type);
+                decl->global = n.flags & GlobalVariable;
+                result = std::move(decl);
+                break;
+            }
+            case RecordKind::StructDecl:
+                result = std::make_unique<StructDeclStmt>(str(n.name), namePairs(n.a, n.b));
+                break;
+            case RecordKind::EnumDecl: {
+                std::vector<EnumVariant> variants;
+                for (uint32_t v = 0; v < n.b; ++v) {
+                    const NodeRecord& variant = image.nodes[image.lists[n.a + v]];
+                    variants.push_back({str(variant.name), namePairs(variant.a, variant.b)});
+                }
+                result = std::make_unique<EnumDeclStmt>(str(n.name), std::move(variants));
+                break;
+            }
+            case RecordKind::Match: {
+                std::vector<MatchCase> cases;
+                for (uint32_t k = 1; k < n.b; ++k) {
+                    const NodeRecord& matchCase = image.nodes[image.lists[n.a + k]];
+                    std::vector<std::string> bindings;
+                    for (const auto& binding : namePairs(matchCase.a, matchCase.b)) bindings.push_back(binding.first);
+                    cases.push_back({str(matchCase.name), std::move(bindings), block(matchCase.c)});
+                }
+                result = std::make_unique<MatchStmt>(expr(image.lists[n.a]), std::move(cases), block(n.c));
+                break;
+            }
+            default: result = std::make_unique<ExprStmt>(expr(n.a)); break;
+        }
+        place(*result, n);
+        return result;
+    }
+
+    std::vector<std::unique_ptr<Stmt>> stmts(uint32_t first, uint32_t count) {
+        std::vector<std::unique_ptr<Stmt>> result;
+        result.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) result.push_back(stmt(image.lists[first + i]));
+        return result;
+    }
+
+private:
+    const Image& image;
+    std::vector<std::shared_ptr<Type>> types;
+
+    std::string str(uint32_t id) const { return image.string(id).str(); }
+    std::shared_ptr<Type> type(uint32_t index) const { return index == kNone ? nullptr : types[index]; }
+
+    std::vector<std::unique_ptr<Expr>> exprs(uint32_t first, uint32_t count) {
+        std::vector<std::unique_ptr<Expr>> result;
+        result.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) result.push_back(expr(image.lists[first + i]));
+        return result;
+    }
+
+    std::vector<std::pair<std::string, std::string>> namePairs(uint32_t first, uint32_t count) const {
+        std::vector<std::pair<std::string, std::string>> result;
+        for (uint32_t i = 0; i < count; ++i) {
+            const MemberRecord& m = image.members[first + i];
+            result.emplace_back(str(m.name), str(m.typeName));
+        }
+        return result;
+    }
+
+    static void place(ASTNode& node, const NodeRecord& record) {
+        node.line = record.line;
+        node.column = record.column;
+    }
+};
+
+template <typename T>
+void writeArray(llvm::raw_ostream& out, const std::vector<T>& records) {
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+}
+
+} // namespace
+
+bool ModuleFile::write(const std::string& path, const std::vector<std::unique_ptr<Stmt>>& stmts,
+                       llvm::StringRef source, std::string& error) {
+    Writer writer;
+    std::vector<uint32_t> roots;
+    for (const auto& stmt : stmts) roots.push_back(writer.write(*stmt));
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.rootFirst = writer.writeList(roots);
+    header.rootCount = roots.size();
+    header.sourceSize = source.size();
+    hashSource(source, header.sourceHash);
+
+    uint32_t offset = sizeof(FileHeader);
+    auto place = [&](Section& section, size_t count, size_t recordSize) {
+        section.offset = offset;
+        section.count = count;
+        offset += count * recordSize;
+    };
+    place(header.nodes, writer.nodes.size(), sizeof(NodeRecord));
+    place(header.types, writer.types.size(), sizeof(TypeRecord));
+    place(header.members, writer.members.size(), sizeof(MemberRecord));
+    place(header.lists, writer.lists.size(), sizeof(ulittle32_t));
+    place(header.stringOffsets, writer.stringOffsets.size(), sizeof(ulittle32_t));
+    place(header.strings, writer.strings.size(), 1);
+
+    std::string body;
+    {
+        llvm::raw_string_ostream out(body);
+        writeArray(out, writer.nodes);
+        writeArray(out, writer.types);
+        writeArray(out, writer.members);
+        writeArray(out, writer.lists);
+        writeArray(out, writer.stringOffsets);
+        out << writer.strings;
+    }
+    header.checksum = llvm::xxHash64(body);
+
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::error_code ec;
+        llvm::raw_fd_ostream out(temp, ec);
+        if (ec) {
+            error = "cannot write " + temp + ": " + ec.message();
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out << body;
+    }
+    if (std::error_code ec = llvm::sys::fs::rename(temp, path)) {
+        llvm::sys::fs::remove(temp);
+        error = "cannot write " + path + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<ModuleFile> ModuleFile::open(const std::string& path, llvm::StringRef source, std::string& error) {
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) return nullptr;
+
+    llvm::StringRef data = (*buffer)->getBuffer();
+    if (data.size() < sizeof(FileHeader) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+        error = path + " is not a module file";
+        return nullptr;
+    }
+    Image image(data);
+    if (image.header->version != kVersion || image.header->sourceSize != source.size()) return nullptr;
+    uint8_t hash[16];
+    hashSource(source, hash);
+    if (std::memcmp(hash, image.header->sourceHash, sizeof(hash)) != 0) return nullptr;
+
+    // Catches files damaged on disk; verify() catches inconsistent ones
+    if (image.header->checksum != llvm::xxHash64(data.drop_front(sizeof(FileHeader)))) {
+        error = path + " is damaged (checksum mismatch)";
+        return nullptr;
+    }
+    if (!verify(image, data.size(), error)) {
+        error = path + ": " + error;
+        return nullptr;
+    }
+    return std::unique_ptr<ModuleFile>(new ModuleFile(std::move(*buffer)));
+}
+
+std::vector<ModuleFile::Declaration> ModuleFile::declarations(bool wantFunctions) const {
+    Image image(buffer->getBuffer());
+    std::vector<Declaration> result;
+    for (uint32_t i = 0; i < image.header->rootCount; ++i) {
+        const NodeRecord& n = image.nodes[image.lists[image.header->rootFirst + i]];
+        RecordKind kind = wantFunctions ? RecordKind::Function : RecordKind::StructDecl;
+        if (n.kind != uint8_t(kind)) continue;
+
+        Declaration decl;
+        decl.name = image.string(n.name);
+        for (uint32_t m = 0; m < n.b; ++m) {
+            const MemberRecord& member = image.members[n.a + m];
+            decl.members.emplace_back(image.string(member.name), image.string(member.typeName));
+        }
+        if (wantFunctions) {
+            decl.returnType = image.string(n.text);
+            decl.isExtern = n.c == kNone;
+        }
+        result.push_back(std::move(decl));
+    }
+    return result;
+}
+
+std::vector<ModuleFile::Declaration> ModuleFile::structs() const {
+    return declarations(false);
+}
+
+std::vector<ModuleFile::Declaration> ModuleFile::functions() const {
+    return declarations(true);
+}
+
+std::vector<std::unique_ptr<Stmt>> ModuleFile::materialize() const {
+    Image image(buffer->getBuffer());
+    Reader reader(image);
+    return reader.stmts(image.header->rootFirst, image.header->rootCount);
+}
+
+} // namespace pynext
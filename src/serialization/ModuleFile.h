@@ -0,0 +1,64 @@
+#ifndef PYNEXT_MODULE_FILE_H
+#define PYNEXT_MODULE_FILE_H
+
+#include "../parser/AST.h"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pynext {
+
+// Binary image of a type-checked module (`app.next` -> `app.nextc`), so a
+// later run can skip lexing, parsing and type checking.
+//
+// The file is a header followed by flat arrays of fixed-size little-endian
+// records: AST nodes, types, child lists, name pairs and a string table.
+// Records refer to each other by 32-bit index and to strings by offset and
+// length, never by pointer, so the file is used as mapped: the module
+// interface (struct layouts, function signatures) is read straight from the
+// image, and materialize() rebuilds the AST in one pass over the records
+// without tokenizing anything.
+class ModuleFile {
+public:
+    // A top-level struct or function as recorded in the image
+    struct Declaration {
+        llvm::StringRef name;
+        std::vector<std::pair<llvm::StringRef, llvm::StringRef>> members; // Fields or parameters: name, type
+        llvm::StringRef returnType; // Functions only
+        bool isExtern = false;      // Functions without a body
+    };
+
+    // Writes the image of `stmts`, which must have passed the type checker
+    // without errors. `source` is the text they were parsed from; the image
+    // is only valid for that text. Writes to a temporary file first, so
+    // concurrent runs never see a partial image.
+    static bool write(const std::string& path, const std::vector<std::unique_ptr<Stmt>>& stmts,
+                      llvm::StringRef source, std::string& error);
+
+    // Maps `path`. Returns null if the file does not exist, has a different
+    // format version or was written for another `source`; `error` is set only
+    // if the file exists but is malformed.
+    static std::unique_ptr<ModuleFile> open(const std::string& path, llvm::StringRef source, std::string& error);
+
+    std::vector<Declaration> structs() const;
+    std::vector<Declaration> functions() const;
+
+    // Rebuilds the typed AST, with the types sema attached to every expression
+    std::vector<std::unique_ptr<Stmt>> materialize() const;
+
+    // Where `pynext --ast-cache` keeps the image of `sourcePath`
+    static std::string cachePathFor(const std::string& sourcePath) { return sourcePath + "c"; }
+
+private:
+    explicit ModuleFile(std::unique_ptr<llvm::MemoryBuffer> buffer) : buffer(std::move(buffer)) {}
+
+    std::vector<Declaration> declarations(bool wantFunctions) const;
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+};
+
+} // namespace pynext
+
+#endif // PYNEXT_MODULE_FILE_H
@@ -0,0 +1,88 @@
+// pynext_gen: emits a synthetic, valid .next program for scaling tests.
+//
+//   pynext_gen [--functions=N] [--structs=N] [--fields=N] [--statements=N]
+//              [--depth=N] [--expr-length=N] [--array-size=N] [--lines=N]
+//              [--seed=N] [-o <file>]
+
+#include "ProgramGenerator.h"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void printUsage() {
+    std::cerr << "Usage: pynext_gen [options] [-o <file>]\n"
+              << "Options:\n"
+              << "  --functions=N    Function definitions besides main (default 100)\n"
+              << "  --structs=N      Struct declarations (default 10)\n"
+              << "  --fields=N       Int fields per struct (default 4)\n"
+              << "  --statements=N   Top-level statements per function (default 20)\n"
+              << "  --depth=N        Maximum if/while/for nesting (default 3)\n"
+              << "  --expr-length=N  Operands per expression (default 4)\n"
+              << "  --array-size=N   Elements per array literal (default 8)\n"
+              << "  --lines=N        Add functions until the program has N lines\n"
+              << "  --seed=N         Random seed (default 1)\n";
+}
+
+bool parseInt(const std::string& arg, const std::string& prefix, int& value) {
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    char* end = nullptr;
+    long parsed = std::strtol(arg.c_str() + prefix.size(), &end, 10);
+    if (*end != '\0' || parsed < 0) {
+        std::cerr << "Invalid value in " << arg << "\n";
+        std::exit(1);
+    }
+    value = (int)parsed;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    pynext::GeneratorConfig config;
+    std::string outputPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        int seed = 0;
+        if (parseInt(arg, "--functions=", config.functions) ||
+            parseInt(arg, "--structs=", config.structs) ||
+            parseInt(arg, "--fields=", config.fieldsPerStruct) ||
+            parseInt(arg, "--statements=", config.statementsPerFunction) ||
+            parseInt(arg, "--depth=", config.maxDepth) ||
+            parseInt(arg, "--expr-length=", config.exprLength) ||
+            parseInt(arg, "--array-size=", config.arraySize) ||
+            parseInt(arg, "--lines=", config.targetLines)) {
+            continue;
+        } else if (parseInt(arg, "--seed=", seed)) {
+            config.seed = (uint64_t)seed;
+        } else if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (config.exprLength < 1 || config.fieldsPerStruct < 1) {
+        std::cerr << "--expr-length and --fields must be at least 1\n";
+        return 1;
+    }
+
+    std::string program = pynext::generateProgram(config);
+    if (outputPath.empty()) {
+        std::cout << program;
+        return 0;
+    }
+
+    std::ofstream file(outputPath);
+    if (!file.is_open()) {
+        std::cerr << "Could not open file: " << outputPath << "\n";
+        return 1;
+    }
+    file << program;
+    return 0;
+}
@@ -0,0 +1,291 @@
+#include "ProgramGenerator.h"
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace pynext {
+
+namespace {
+
+class Generator {
+public:
+    explicit Generator(const GeneratorConfig& config) : config(config), rng(config.seed) {}
+
+    std::string run() {
+        line("extern def print_int(val: int)");
+        blank();
+
+        for (int i = 0; i < config.structs; ++i) {
+            emitStruct(i);
+        }
+
+        int emitted = 0;
+        while (emitted < config.functions || (config.targetLines > 0 && lines < config.targetLines)) {
+            emitFunction(emitted++);
+        }
+
+        line("def main()");
+        indent++;
+        if (emitted > 0) {
+            std::string call = "f" + std::to_string(emitted - 1) + "(";
+            for (int p = 0; p < paramCounts.back(); ++p) {
+                call += (p ? ", " : "") + std::to_string(p + 1);
+            }
+            line("print_int(" + call + "))");
+        } else {
+            line("print_int(0)");
+        }
+        indent--;
+        line("end");
+        return out.str();
+    }
+
+private:
+    struct Scope {
+        std::vector<std::string> ints;      // Assignable int variables
+        std::vector<std::string> readOnly;  // Loop counters and for-loop variables
+        std::vector<std::pair<std::string, int>> structVars; // name, struct index
+        std::vector<std::string> arrays;    // int[] variables, all of config.arraySize elements
+    };
+
+    const GeneratorConfig& config;
+    // Draws use `rng() % n` rather than <random> distributions, whose output
+    // differs between standard libraries; programs must be identical everywhere.
+    std::mt19937_64 rng;
+    std::ostringstream out;
+    int lines = 0;
+    int indent = 0;
+    int nextVar = 0;
+    std::vector<Scope> scopes;
+    std::vector<int> paramCounts;       // Per emitted function
+    std::vector<int> structLinks;       // Per struct: index of the struct held in `link`, or -1
+
+    int pick(int n) { return n <= 1 ? 0 : (int)(rng() % (uint64_t)n); }
+    bool chance(int percent) { return pick(100) < percent; }
+
+    void line(const std::string& text) {
+        out << std::string(indent * 4, ' ') << text << "\n";
+        lines++;
+    }
+    void blank() {
+        out << "\n";
+        lines++;
+    }
+
+    std::string fresh(const char* prefix) { return prefix + std::to_string(nextVar++); }
+
+    template <typename T>
+    std::vector<T> collect(std::vector<T> Scope::*member) const {
+        std::vector<T> all;
+        for (const auto& s : scopes) all.insert(all.end(), (s.*member).begin(), (s.*member).end());
+        return all;
+    }
+
+    // A random int field path below a struct of index `structIdx`, e.g. ".link.f2".
+    std::string fieldPath(int structIdx) {
+        if (structLinks[structIdx] >= 0 && chance(25)) {
+            return ".link" + fieldPath(structLinks[structIdx]);
+        }
+        return ".f" + std::to_string(pick(config.fieldsPerStruct));
+    }
+
+    std::string literal() { return std::to_string(1 + pick(100)); }
+
+    std::string operand(bool allowMemory = true) {
+        auto ints = collect(&Scope::ints);
+        auto readOnly = collect(&Scope::readOnly);
+        ints.insert(ints.end(), readOnly.begin(), readOnly.end());
+
+        int kind = pick(10);
+        if (allowMemory && kind == 0) {
+            auto structVars = collect(&Scope::structVars);
+            if (!structVars.empty()) {
+                auto& sv = structVars[pick(structVars.size())];
+                return sv.first + fieldPath(sv.second);
+            }
+        }
+        if (allowMemory && kind == 1) {
+            auto arrays = collect(&Scope::arrays);
+            if (!arrays.empty() && config.arraySize > 0) {
+                return arrays[pick(arrays.size())] + "[" + std::to_string(pick(config.arraySize)) + "]";
+            }
+        }
+        if (kind < 7 && !ints.empty()) {
+            return ints[pick(ints.size())];
+        }
+        return literal();
+    }
+
+    std::string expression(bool allowMemory = true) {
+        static const char* ops[] = {" + ", " - ", " * "};
+        std::string expr = operand(allowMemory);
+        for (int i = 1; i < config.exprLength; ++i) {
+            if (chance(15)) {
+                // Divide by a non-zero constant only
+                expr += " / " + std::to_string(1 + pick(9));
+            } else {
+                expr += ops[pick(3)] + operand(allowMemory);
+            }
+        }
+        return expr;
+    }
+
+    std::string condition() {
+        static const char* cmps[] = {" < ", " > ", " == ", " != "};
+        return expression() + cmps[pick(4)] + expression();
+    }
+
+    void emitStruct(int idx) {
+        int link = (idx > 0 && chance(30)) ? pick(idx) : -1;
+        structLinks.push_back(link);
+
+        line("struct S" + std::to_string(idx));
+        indent++;
+        for (int f = 0; f < config.fieldsPerStruct; ++f) {
+            line("f" + std::to_string(f) + ": int");
+        }
+        if (link >= 0) {
+            line("link: S" + std::to_string(link));
+        }
+        indent--;
+        line("end");
+        blank();
+    }
+
+    void emitBlock(int depth, int count) {
+        scopes.push_back({});
+        indent++;
+        for (int i = 0; i < count; ++i) {
+            emitStatement(depth);
+        }
+        indent--;
+        scopes.pop_back();
+    }
+
+    void emitVarDecl() {
+        std::string name = fresh("v");
+        line("var " + name + ": int = " + expression());
+        scopes.back().ints.push_back(name);
+    }
+
+    void emitStatement(int depth) {
+        int r = pick(100);
+        bool canNest = depth < config.maxDepth;
+
+        if (r < 25) {
+            emitVarDecl();
+        } else if (r < 45) {
+            auto ints = collect(&Scope::ints);
+            if (ints.empty()) {
+                emitVarDecl();
+                return;
+            }
+            line(ints[pick(ints.size())] + " = " + expression());
+        } else if (r < 55 && config.structs > 0) {
+            int structIdx = pick(config.structs);
+            std::string name = fresh("s");
+            line("var " + name + ": S" + std::to_string(structIdx));
+            for (int f = 0; f < config.fieldsPerStruct; ++f) {
+                line(name + ".f" + std::to_string(f) + " = " + expression());
+            }
+            scopes.back().structVars.push_back({name, structIdx});
+        } else if (r < 63 && config.arraySize > 0) {
+            std::string name = fresh("a");
+            std::string elems;
+            for (int i = 0; i < config.arraySize; ++i) {
+                elems += (i ? ", " : "") + expression(false);
+            }
+            line("var " + name + ": int[] = [" + elems + "]");
+            scopes.back().arrays.push_back(name);
+        } else if (r < 73 && canNest) {
+            line("if " + condition());
+            emitBlock(depth + 1, 1 + pick(3));
+            if (chance(50)) {
+                line("else");
+                emitBlock(depth + 1, 1 + pick(3));
+            }
+            line("end");
+        } else if (r < 81 && canNest) {
+            // Bounded trip count keeps generated programs fast to run
+            std::string counter = fresh("i");
+            line("var " + counter + ": int = 0");
+            line("while " + counter + " < " + std::to_string(1 + pick(4)));
+            scopes.push_back({});
+            scopes.back().readOnly.push_back(counter);
+            indent++;
+            int count = 1 + pick(3);
+            for (int i = 0; i < count; ++i) emitStatement(depth + 1);
+            line(counter + " = " + counter + " + 1");
+            indent--;
+            scopes.pop_back();
+            line("end");
+            scopes.back().readOnly.push_back(counter);
+        } else if (r < 89 && canNest) {
+            auto arrays = collect(&Scope::arrays);
+            if (arrays.empty()) {
+                emitVarDecl();
+                return;
+            }
+            std::string var = fresh("x");
+            line("for " + var + " in " + arrays[pick(arrays.size())]);
+            scopes.push_back({});
+            scopes.back().readOnly.push_back(var);
+            indent++;
+            int count = 1 + pick(3);
+            for (int i = 0; i < count; ++i) emitStatement(depth + 1);
+            indent--;
+            scopes.pop_back();
+            line("end");
+        } else {
+            emitVarDecl();
+        }
+    }
+
+    void emitFunction(int idx) {
+        nextVar = 0;
+        int params = 1 + pick(3);
+        paramCounts.push_back(params);
+
+        std::string sig = "def f" + std::to_string(idx) + "(";
+        scopes.push_back({});
+        for (int p = 0; p < params; ++p) {
+            std::string name = "p" + std::to_string(p);
+            sig += (p ? ", " : "") + name + ": int";
+            scopes.back().ints.push_back(name);
+        }
+        line(sig + ") -> int");
+
+        indent++;
+        for (int i = 0; i < config.statementsPerFunction; ++i) {
+            emitStatement(0);
+        }
+
+        // One call into an earlier function, outside any loop, keeps the call
+        // graph acyclic and the executed call count linear in program size.
+        if (idx > 0) {
+            int callee = pick(idx);
+            std::string call = "f" + std::to_string(callee) + "(";
+            for (int p = 0; p < paramCounts[callee]; ++p) {
+                call += (p ? ", " : "") + expression();
+            }
+            std::string name = fresh("c");
+            line("var " + name + ": int = " + call + ")");
+            scopes.back().ints.push_back(name);
+        }
+
+        line("return " + expression());
+        indent--;
+        scopes.pop_back();
+        line("end");
+        blank();
+    }
+};
+
+} // namespace
+
+std::string generateProgram(const GeneratorConfig& config) {
+    Generator generator(config);
+    return generator.run();
+}
+
+} // namespace pynext
@@ -0,0 +1,28 @@
+#ifndef PYNEXT_PROGRAM_GENERATOR_H
+#define PYNEXT_PROGRAM_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+namespace pynext {
+
+// Shape of a synthetic program. Every generated program is valid .next:
+// it type-checks, compiles and terminates when run.
+struct GeneratorConfig {
+    int functions = 100;              // Function definitions (besides main)
+    int structs = 10;                 // Struct declarations
+    int fieldsPerStruct = 4;
+    int statementsPerFunction = 20;   // Top-level statements per function body
+    int maxDepth = 3;                 // Maximum if/while/for nesting inside a body
+    int exprLength = 4;               // Operands per arithmetic expression
+    int arraySize = 8;                // Elements per array literal
+    int targetLines = 0;              // If > 0, keep adding functions until reached
+    uint64_t seed = 1;
+};
+
+// Emits the program text. The same config always yields the same program.
+std::string generateProgram(const GeneratorConfig& config);
+
+} // namespace pynext
+
+#endif // PYNEXT_PROGRAM_GENERATOR_H